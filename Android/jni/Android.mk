@@ -1,5 +1,9 @@
 LOCAL_PATH := $(call my-dir)
 
+# Uncomment to record per-frame trace zones (see MSVTrace.h). Exported by
+# VuforiaWrapper, so that the JNI zones of MoodstocksVuforia are enabled too
+# MSV_TRACE_CFLAGS := -DMSV_TRACE
+
 include $(CLEAR_VARS)
 LOCAL_MODULE := QCAR-prebuilt
 LOCAL_SRC_FILES = $(VFR_SDK)/build/lib/$(TARGET_ARCH_ABI)/libVuforia.so
@@ -8,31 +12,59 @@ include $(PREBUILT_SHARED_LIBRARY)
 
 include $(CLEAR_VARS)
 LOCAL_MODULE := VuforiaWrapper
-LOCAL_CFLAGS := -Wno-write-strings -Wno-psabi -DUSE_OPENGL_ES_2_0
-LOCAL_LDLIBS := -lGLESv2
+LOCAL_CFLAGS := -Wno-write-strings -Wno-psabi -DUSE_OPENGL_ES_2_0 $(MSV_TRACE_CFLAGS)
+LOCAL_EXPORT_CFLAGS := $(MSV_TRACE_CFLAGS)
+LOCAL_LDLIBS := -lGLESv2 -lz
 LOCAL_SHARED_LIBRARIES := QCAR-prebuilt
 LOCAL_EXPORT_C_INCLUDES := $(LOCAL_PATH)/../../CommonVuforiaWrapper
-LOCAL_SRC_FILES := ../../CommonVuforiaWrapper/MSVCallback.cpp \
+LOCAL_SRC_FILES := ../../CommonVuforiaWrapper/MSVAnimation.cpp \
+                   ../../CommonVuforiaWrapper/MSVAsset.cpp \
+                   ../../CommonVuforiaWrapper/MSVBackend.cpp \
+                   ../../CommonVuforiaWrapper/MSVBVH.cpp \
+                   ../../CommonVuforiaWrapper/MSVCallback.cpp \
                    ../../CommonVuforiaWrapper/MSVCamera.cpp \
                    ../../CommonVuforiaWrapper/MSVController.cpp \
+                   ../../CommonVuforiaWrapper/MSVEpoch.cpp \
+                   ../../CommonVuforiaWrapper/MSVFrame.cpp \
+                   ../../CommonVuforiaWrapper/MSVFrameCapture.cpp \
+                   ../../CommonVuforiaWrapper/MSVGovernor.cpp \
+                   ../../CommonVuforiaWrapper/MSVImageDecoder.cpp \
                    ../../CommonVuforiaWrapper/MSVMesh.cpp \
+                   ../../CommonVuforiaWrapper/MSVModel.cpp \
+                   ../../CommonVuforiaWrapper/MSVModelCache.cpp \
+                   ../../CommonVuforiaWrapper/MSVModelLoader.cpp \
+                   ../../CommonVuforiaWrapper/MSVPendingModel.cpp \
+                   ../../CommonVuforiaWrapper/MSVRecorder.cpp \
+                   ../../CommonVuforiaWrapper/MSVRedraw.cpp \
                    ../../CommonVuforiaWrapper/MSVRenderer.cpp \
+                   ../../CommonVuforiaWrapper/MSVReplay.cpp \
+                   ../../CommonVuforiaWrapper/MSVResourceManager.cpp \
+                   ../../CommonVuforiaWrapper/MSVSimulatedBackend.cpp \
                    ../../CommonVuforiaWrapper/MSVState.cpp \
                    ../../CommonVuforiaWrapper/MSVTargetInfo.cpp \
                    ../../CommonVuforiaWrapper/MSVTexture.cpp \
                    ../../CommonVuforiaWrapper/MSVTextureCallback.cpp \
-                   ../../CommonVuforiaWrapper/MSVTracker.cpp
+                   ../../CommonVuforiaWrapper/MSVTrace.cpp \
+                   ../../CommonVuforiaWrapper/MSVTracker.cpp \
+                   ../../CommonVuforiaWrapper/MSVVideoSource.cpp \
+                   ../../CommonVuforiaWrapper/MSVVideoTexture.cpp \
+                   ../../CommonVuforiaWrapper/MSVVuforiaBackend.cpp
 LOCAL_ARM_MODE := arm
 include $(BUILD_SHARED_LIBRARY)
 
 include $(CLEAR_VARS)
 LOCAL_MODULE := MoodstocksVuforia
 LOCAL_SHARED_LIBRARIES := VuforiaWrapper
+LOCAL_LDLIBS := -ldl
 LOCAL_SRC_FILES := Callback.cpp \
+                   CaptureListener.cpp \
                    EnvStorage.cpp \
                    JNIRenderer.cpp \
+                   JNIVideoTexture.cpp \
                    JNIVuforiaController.cpp \
                    Mesh.cpp \
+                   RedrawListener.cpp \
+                   SurfaceTextureCallback.cpp \
                    Texture.cpp \
                    TextureCallback.cpp
 LOCAL_ARM_MODE := arm
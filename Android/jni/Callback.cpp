@@ -1,6 +1,8 @@
 #include "Callback.h"
 #include "EnvStorage.h"
 
+#include <MSVTrace.h>
+
 /** Initializes the field and method IDs required to communicate
  * with the Java code.
  */
@@ -26,6 +28,7 @@ Callback::~Callback()
 void
 Callback::onStatusUpdate()
 {
+  MSV_TRACE_SCOPE("JNI onStatusUpdate");
   JNIEnv *env = EnvStorage::getJNIEnv();
   jobject local = env->NewLocalRef(jcb);
   if (!env->IsSameObject(local, NULL)) {
@@ -38,6 +41,7 @@ Callback::onStatusUpdate()
 void
 Callback::getFrame(const QCAR::Image *frame) const
 {
+  MSV_TRACE_SCOPE("JNI getFrame");
   JNIEnv *env = EnvStorage::getJNIEnv();
   jobject local = env->NewLocalRef(jcb);
   if (!env->IsSameObject(local, NULL)) {
@@ -0,0 +1,64 @@
+#include "CaptureListener.h"
+#include "EnvStorage.h"
+
+CaptureListener::CaptureListener(JNIEnv *env,
+                                 jobject listener) :
+jvm(NULL),
+env(NULL)
+{
+  env->GetJavaVM(&this->jvm);
+  this->listener = env->NewGlobalRef(listener);
+  jclass cls = env->GetObjectClass(listener);
+  this->frameCapturedID = env->GetMethodID(cls, "onFrameCaptured",
+                                           "(Ljava/nio/ByteBuffer;IID)V");
+  this->captureFinishedID = env->GetMethodID(cls, "onCaptureFinished", "()V");
+}
+
+CaptureListener::~CaptureListener()
+{
+  // Deleted on the capture thread, right after `captureFinished`, unless
+  // the capture could not start
+  if (this->env) {
+    this->env->DeleteGlobalRef(this->listener);
+    jvm->DetachCurrentThread();
+    return;
+  }
+  JNIEnv *current = EnvStorage::getJNIEnv();
+  if (current) current->DeleteGlobalRef(this->listener);
+}
+
+bool
+CaptureListener::attach()
+{
+  if (this->env) return true;
+  // The capture thread is a native thread unknown to the JVM: attaching it
+  // once saves doing it for every frame
+  return jvm->AttachCurrentThread(&this->env, NULL) == JNI_OK;
+}
+
+void
+CaptureListener::frameCaptured(const unsigned char *pixels,
+                               int width,
+                               int height,
+                               double timestamp)
+{
+  if (!attach()) return;
+  jobject buffer = env->NewDirectByteBuffer((void *)pixels,
+                                            (jlong)4*width*height);
+  if (!buffer) {
+    if (env->ExceptionCheck()) env->ExceptionClear();
+    return;
+  }
+  env->CallVoidMethod(listener, frameCapturedID, buffer,
+                      (jint)width, (jint)height, (jdouble)timestamp);
+  if (env->ExceptionCheck()) env->ExceptionClear();
+  env->DeleteLocalRef(buffer);
+}
+
+void
+CaptureListener::captureFinished()
+{
+  if (!attach()) return;
+  env->CallVoidMethod(listener, captureFinishedID);
+  if (env->ExceptionCheck()) env->ExceptionClear();
+}
@@ -0,0 +1,37 @@
+#ifndef JNI_CAPTURE_LISTENER_H
+#define JNI_CAPTURE_LISTENER_H
+
+#include <jni.h>
+
+#include <MSVFrameCapture.h>
+
+/** Android-specific implementation of MSVFrameCapture::Consumer, calling a
+ * `VuforiaController.CaptureListener`.
+ */
+class CaptureListener : public MSVFrameCapture::Consumer
+{
+  public:
+    CaptureListener(JNIEnv *env, jobject listener);
+    ~CaptureListener();
+
+    /** Implementation of MSVFrameCapture::Consumer. The pixels are wrapped
+     * in a direct ByteBuffer, without copy: the listener must not keep it.
+     */
+    void frameCaptured(const unsigned char *pixels,
+                       int width,
+                       int height,
+                       double timestamp);
+    void captureFinished();
+
+  private:
+    JavaVM *jvm;
+    /** Environment of the capture thread, attached for its lifetime */
+    JNIEnv *env;
+    jobject listener;
+    jmethodID frameCapturedID;
+    jmethodID captureFinishedID;
+
+    bool attach();
+};
+
+#endif
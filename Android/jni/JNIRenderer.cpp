@@ -1,7 +1,10 @@
+#include "RedrawListener.h"
+
 #include <jni.h>
 #include <string.h>
 
 #include <MSVController.h>
+#include <MSVRedraw.h>
 #include <MSVRenderer.h>
 #include <MSVState.h>
 
@@ -40,6 +43,14 @@ Java_com_moodstocks_vuforia_core_Renderer_updateRendering(JNIEnv*,
   MSVController::getRenderer()->updateState();
 }
 
+JNIEXPORT void JNICALL
+Java_com_moodstocks_vuforia_core_Renderer_setRenderOnDemand(JNIEnv *env,
+                                                            jobject,
+                                                            jobject view)
+{
+  MSVRedraw::setListener(view ? new RedrawListener(env, view) : NULL);
+}
+
 #ifdef __cplusplus
 }
 #endif
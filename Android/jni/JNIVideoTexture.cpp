@@ -0,0 +1,30 @@
+#include "SurfaceTextureCallback.h"
+
+#include <jni.h>
+
+#include <MSVRedraw.h>
+
+/** JNI communication layer of the Java VideoTexture objects */
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** Called from the SurfaceTexture listener thread: only flags the frame, it
+ * is latched by SurfaceTextureCallback on the GL thread, and asks for a new
+ * frame in on-demand rendering mode.
+ */
+JNIEXPORT void JNICALL
+Java_com_moodstocks_vuforia_VideoTexture_frameAvailable(JNIEnv *env,
+                                                        jclass,
+                                                        jobject jstate)
+{
+  char *addr = (char *)env->GetDirectBufferAddress(jstate);
+  if (addr) __sync_fetch_and_add((int *)(addr + VIDEO_STATE_FRAMES), 1);
+  MSVRedraw::invalidate(MSVRedraw::TEXTURE_UPDATED);
+}
+
+#ifdef __cplusplus
+}
+#endif
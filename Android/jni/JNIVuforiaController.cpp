@@ -1,14 +1,19 @@
 #include "Callback.h"
+#include "CaptureListener.h"
 #include "EnvStorage.h"
 #include "Mesh.h"
+#include "SurfaceTextureCallback.h"
 #include "Texture.h"
 #include "TextureCallback.h"
 
 #include <jni.h>
+#include <stddef.h>
+#include <stdio.h>
 #include <string.h>
 
 #include <MSVCamera.h>
 #include <MSVController.h>
+#include <MSVPendingModel.h>
 #include <MSVTargetInfo.h>
 
 /** JNI communication layer between the Java and C++ Controller objects */
@@ -24,6 +29,11 @@ static jfieldID   nameID;
 static jfieldID   widthID;
 static jfieldID   heightID;
 
+/* The Java Status class reads MSVCallback::Status at these offsets */
+typedef char statusLayoutCheck[offsetof(MSVCallback::Status, frame) == 8 &&
+                               offsetof(MSVCallback::Status, pose) == 28 &&
+                               offsetof(MSVCallback::Status, name) == 76 ? 1 : -1];
+
 void getJavaTarget(JNIEnv *env,
                    jobject jtarget,
                    char **name,
@@ -61,6 +71,23 @@ Java_com_moodstocks_vuforia_core_VuforiaController_startCameraNative(JNIEnv *,
   return MSVCamera::start();
 }
 
+void
+Java_com_moodstocks_vuforia_core_VuforiaController_setCameraProfileCache(JNIEnv *env,
+                                                                         jobject,
+                                                                         jstring jpath,
+                                                                         jstring jdevice)
+{
+  if (!jpath || !jdevice) {
+    MSVCamera::setProfileCache(NULL, NULL);
+    return;
+  }
+  const char *path = env->GetStringUTFChars(jpath, NULL);
+  const char *device = env->GetStringUTFChars(jdevice, NULL);
+  MSVCamera::setProfileCache(path, device);
+  env->ReleaseStringUTFChars(jdevice, device);
+  env->ReleaseStringUTFChars(jpath, path);
+}
+
 void
 Java_com_moodstocks_vuforia_core_VuforiaController_stopCameraNative(JNIEnv *,
                                                                     jobject)
@@ -102,6 +129,21 @@ Java_com_moodstocks_vuforia_core_VuforiaController_stopTracking(JNIEnv *,
   MSVController::stopTracking();
 }
 
+void
+Java_com_moodstocks_vuforia_core_VuforiaController_suspendTracking(JNIEnv *,
+                                                                   jobject)
+{
+  MSVController::suspendTracking();
+}
+
+void
+Java_com_moodstocks_vuforia_core_VuforiaController_setLingerTime(JNIEnv *,
+                                                                 jobject,
+                                                                 jfloat seconds)
+{
+  MSVController::setLingerTime(seconds);
+}
+
 jboolean
 Java_com_moodstocks_vuforia_core_VuforiaController_isTracking(JNIEnv *,
                                                               jobject)
@@ -113,10 +155,11 @@ jobject
 Java_com_moodstocks_vuforia_core_VuforiaController_getCurrentTarget(JNIEnv *env,
                                                                     jobject)
 {
-  const MSVTargetInfo *i = MSVController::getCurrentTarget();
-  if (!i) return NULL;
-  jstring jname = env->NewStringUTF(i->getName());
-  int dims[2] = {i->getWidth(), i->getHeight()};
+  char *name = NULL;
+  int dims[2];
+  if (!MSVController::copyCurrentTarget(&name, dims)) return NULL;
+  jstring jname = env->NewStringUTF(name);
+  free(name);
   jintArray jdims = env->NewIntArray(2);
   env->SetIntArrayRegion(jdims, 0, 2, dims);
   return env->NewObject(targetClass, ctorID, jname, jdims, NULL);
@@ -132,11 +175,48 @@ Java_com_moodstocks_vuforia_core_VuforiaController_setStaticModel(JNIEnv *env,
   Mesh *m = NULL;
   if (!env->IsSameObject(jmesh, NULL))
     m = new Mesh(env, jmesh);
-  Texture *t = NULL;
-  if (!env->IsSameObject(jtex, NULL))
-    t = new Texture(env, jtex);
+  if (m && !m->getVerticesCount()) {
+    // The model file could not be loaded: fall back to the plane
+    m->release();
+    m = NULL;
+  }
+  // Set once its texture is decoded, off the calling thread
+  MSVPendingModel *model = new MSVPendingModel();
+  Texture::addPart(env, jtex, m, model);
+  float *scale = env->GetFloatArrayElements(jscale, NULL);
+  model->commit(scale);
+  env->ReleaseFloatArrayElements(jscale, scale, JNI_ABORT);
+}
+
+void
+Java_com_moodstocks_vuforia_core_VuforiaController_setCompositeModel(JNIEnv *env,
+                                                                     jobject,
+                                                                     jobjectArray jmeshes,
+                                                                     jobjectArray jtextures,
+                                                                     jfloatArray jtransforms,
+                                                                     jfloatArray jscale)
+{
+  MSVPendingModel *model = new MSVPendingModel();
+  float *transforms = env->GetFloatArrayElements(jtransforms, NULL);
+  int n = env->GetArrayLength(jmeshes);
+  for (int i = 0; i < n; ++i) {
+    jobject jmesh = env->GetObjectArrayElement(jmeshes, i);
+    jobject jtex = env->GetObjectArrayElement(jtextures, i);
+    Mesh *m = NULL;
+    if (!env->IsSameObject(jmesh, NULL))
+      m = new Mesh(env, jmesh);
+    if (m && !m->getVerticesCount()) {
+      // The model file could not be loaded: fall back to the plane
+      m->release();
+      m = NULL;
+    }
+    Texture::addPart(env, jtex, m, model, transforms + 16*i);
+    env->DeleteLocalRef(jmesh);
+    env->DeleteLocalRef(jtex);
+  }
+  env->ReleaseFloatArrayElements(jtransforms, transforms, JNI_ABORT);
   float *scale = env->GetFloatArrayElements(jscale, NULL);
-  MSVController::setStaticModel(m, t, scale);
+  model->commit(scale);
   env->ReleaseFloatArrayElements(jscale, scale, JNI_ABORT);
 }
 
@@ -152,6 +232,19 @@ Java_com_moodstocks_vuforia_core_VuforiaController_setDynamicModel(JNIEnv *env,
   env->ReleaseFloatArrayElements(jscale, scale, JNI_ABORT);
 }
 
+void
+Java_com_moodstocks_vuforia_core_VuforiaController_setVideoModel(JNIEnv *env,
+                                                                 jobject,
+                                                                 jobject jvideo,
+                                                                 jobject jcb,
+                                                                 jfloatArray jscale)
+{
+  MSVTextureCallback *cb = new SurfaceTextureCallback(env, jvideo, jcb);
+  float *scale = env->GetFloatArrayElements(jscale, NULL);
+  MSVController::setDynamicModel(cb, scale);
+  env->ReleaseFloatArrayElements(jscale, scale, JNI_ABORT);
+}
+
 void
 Java_com_moodstocks_vuforia_core_VuforiaController_requireUpdate(JNIEnv *env,
                                                                jobject)
@@ -180,6 +273,15 @@ Java_com_moodstocks_vuforia_core_VuforiaController_isTargetLost(JNIEnv *env,
   return MSVController::getCallback()->isTargetLost() ? JNI_TRUE : JNI_FALSE;
 }
 
+jobject
+Java_com_moodstocks_vuforia_core_VuforiaController_getStatusBuffer(JNIEnv *env,
+                                                                   jobject)
+{
+  // Shared once: the Java side reads each update without calling back
+  const MSVCallback::Status *status = MSVController::getCallback()->getStatus();
+  return env->NewDirectByteBuffer((void *)status, sizeof(MSVCallback::Status));
+}
+
 int
 Java_com_moodstocks_vuforia_core_VuforiaController_obtainTextureID(JNIEnv *,
                                                                    jobject)
@@ -187,6 +289,193 @@ Java_com_moodstocks_vuforia_core_VuforiaController_obtainTextureID(JNIEnv *,
   return MSVController::obtainTextureID();
 }
 
+jboolean
+Java_com_moodstocks_vuforia_core_VuforiaController_dumpTrace(JNIEnv *env,
+                                                             jobject,
+                                                             jstring jpath)
+{
+  const char *path = env->GetStringUTFChars(jpath, NULL);
+  bool ok = MSVController::dumpTrace(path);
+  env->ReleaseStringUTFChars(jpath, path);
+  return ok ? JNI_TRUE : JNI_FALSE;
+}
+
+jboolean
+Java_com_moodstocks_vuforia_core_VuforiaController_startRecording(JNIEnv *env,
+                                                                  jobject,
+                                                                  jstring jpath,
+                                                                  jboolean compress)
+{
+  const char *path = env->GetStringUTFChars(jpath, NULL);
+  bool ok = MSVController::startRecording(path, compress == JNI_TRUE);
+  env->ReleaseStringUTFChars(jpath, path);
+  return ok ? JNI_TRUE : JNI_FALSE;
+}
+
+void
+Java_com_moodstocks_vuforia_core_VuforiaController_stopRecording(JNIEnv *,
+                                                                 jobject)
+{
+  MSVController::stopRecording();
+}
+
+void
+Java_com_moodstocks_vuforia_core_VuforiaController_setAdaptiveQuality(JNIEnv *,
+                                                                      jobject,
+                                                                      jboolean enabled,
+                                                                      jfloat budgetMs)
+{
+  MSVController::setAdaptiveQuality(enabled == JNI_TRUE, budgetMs/1000);
+}
+
+jint
+Java_com_moodstocks_vuforia_core_VuforiaController_getQualityLevel(JNIEnv *,
+                                                                   jobject)
+{
+  return MSVController::getQualityLevel();
+}
+
+jobjectArray
+Java_com_moodstocks_vuforia_core_VuforiaController_getQualityChanges(JNIEnv *env,
+                                                                     jobject)
+{
+  MSVGovernor::Change changes[QUALITY_HISTORY];
+  unsigned int n = MSVController::getQualityChanges(changes, QUALITY_HISTORY);
+  jobjectArray array = env->NewObjectArray(n, env->FindClass("java/lang/String"), NULL);
+  for (unsigned int i = 0; i < n; ++i) {
+    char desc[128];
+    snprintf(desc, sizeof(desc), "frame %u: %d -> %d (%s, %.1f ms)",
+             changes[i].frame, changes[i].from, changes[i].to,
+             MSVGovernor::reasonName(changes[i].reason),
+             1000*changes[i].frameTime);
+    jstring jdesc = env->NewStringUTF(desc);
+    env->SetObjectArrayElement(array, i, jdesc);
+    env->DeleteLocalRef(jdesc);
+  }
+  return array;
+}
+
+jboolean
+Java_com_moodstocks_vuforia_core_VuforiaController_isModelRestored(JNIEnv *,
+                                                                   jobject)
+{
+  return MSVController::isModelRestored() ? JNI_TRUE : JNI_FALSE;
+}
+
+void
+Java_com_moodstocks_vuforia_core_VuforiaController_setModelCacheBudget(JNIEnv *,
+                                                                       jobject,
+                                                                       jint bytes)
+{
+  MSVController::setModelCacheBudget(bytes > 0 ? bytes : 0);
+}
+
+jintArray
+Java_com_moodstocks_vuforia_core_VuforiaController_getModelCacheStats(JNIEnv *env,
+                                                                      jobject)
+{
+  MSVModelCache::Stats stats;
+  MSVController::getModelCacheStats(&stats);
+  jint values[5] = {(jint)stats.hits, (jint)stats.misses, (jint)stats.evictions,
+                    stats.models, (jint)stats.bytes};
+  jintArray array = env->NewIntArray(5);
+  env->SetIntArrayRegion(array, 0, 5, values);
+  return array;
+}
+
+jintArray
+Java_com_moodstocks_vuforia_core_VuforiaController_getRenderStats(JNIEnv *env,
+                                                                  jobject)
+{
+  MSVRenderer::Stats stats;
+  MSVController::getRenderStats(&stats);
+  jint values[3] = {(jint)stats.drawn, (jint)stats.culled,
+                    (jint)stats.modelsCulled};
+  jintArray array = env->NewIntArray(3);
+  env->SetIntArrayRegion(array, 0, 3, values);
+  return array;
+}
+
+jboolean
+Java_com_moodstocks_vuforia_core_VuforiaController_startCapture(JNIEnv *env,
+                                                                jobject,
+                                                                jobject listener,
+                                                                jfloat scale,
+                                                                jint frames)
+{
+  if (env->IsSameObject(listener, NULL)) return JNI_FALSE;
+  bool started = MSVController::startCapture(new CaptureListener(env, listener),
+                                             scale, frames > 0 ? frames : 0);
+  return started ? JNI_TRUE : JNI_FALSE;
+}
+
+void
+Java_com_moodstocks_vuforia_core_VuforiaController_stopCapture(JNIEnv *,
+                                                               jobject)
+{
+  MSVController::stopCapture();
+}
+
+jintArray
+Java_com_moodstocks_vuforia_core_VuforiaController_getCaptureStats(JNIEnv *env,
+                                                                   jobject)
+{
+  MSVFrameCapture::Stats stats;
+  MSVController::getCaptureStats(&stats);
+  jint values[2] = {(jint)stats.captured, (jint)stats.dropped};
+  jintArray array = env->NewIntArray(2);
+  env->SetIntArrayRegion(array, 0, 2, values);
+  return array;
+}
+
+jfloatArray
+Java_com_moodstocks_vuforia_core_VuforiaController_hitTest(JNIEnv *env,
+                                                           jobject,
+                                                           jfloat x,
+                                                           jfloat y)
+{
+  MSVRenderer::Hit hit;
+  if (!MSVController::hitTest(x, y, &hit)) return NULL;
+  jfloat values[10] = {(jfloat)hit.part, (jfloat)hit.face,
+                       hit.barycentric[0], hit.barycentric[1], hit.barycentric[2],
+                       hit.texCoords[0], hit.texCoords[1],
+                       hit.position[0], hit.position[1], hit.position[2]};
+  jfloatArray array = env->NewFloatArray(10);
+  env->SetFloatArrayRegion(array, 0, 10, values);
+  return array;
+}
+
+void
+Java_com_moodstocks_vuforia_core_VuforiaController_setOverlayScale(JNIEnv *,
+                                                                   jobject,
+                                                                   jfloat scale)
+{
+  MSVController::setOverlayScale(scale);
+}
+
+jfloat
+Java_com_moodstocks_vuforia_core_VuforiaController_getOverlayScale(JNIEnv *,
+                                                                   jobject)
+{
+  return MSVController::getOverlayScale();
+}
+
+void
+Java_com_moodstocks_vuforia_core_VuforiaController_setStereo(JNIEnv *,
+                                                             jobject,
+                                                             jboolean enabled,
+                                                             jfloat ipd)
+{
+  MSVController::setStereo(enabled == JNI_TRUE, ipd);
+}
+
+jboolean
+Java_com_moodstocks_vuforia_core_VuforiaController_isStereo(JNIEnv *,
+                                                            jobject)
+{
+  return MSVController::isStereo() ? JNI_TRUE : JNI_FALSE;
+}
+
 
 void
 getJavaTarget(JNIEnv *env,
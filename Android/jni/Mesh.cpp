@@ -1,10 +1,24 @@
 #include "Mesh.h"
 
+#include <MSVModelLoader.h>
+
 #include <stdlib.h>
 
 Mesh::Mesh(JNIEnv *env, jobject jmesh) :
 MSVMesh()
 {
-  // NOT IMPLEMENTED YET
-}
+  // Handle to the Mesh class:
+  jclass meshClass = env->GetObjectClass(jmesh);
+  jfieldID pathID = env->GetFieldID(meshClass, "path", "Ljava/lang/String;");
+  jstring jpath = reinterpret_cast<jstring>(env->GetObjectField(jmesh, pathID));
+  if (!jpath) return;
 
+  const char *path = env->GetStringUTFChars(jpath, NULL);
+  MSVModelLoader::Model model;
+  if (MSVModelLoader::load(path, &model)) {
+    set(model.nVertices, model.vertices, model.normals, model.texCoords,
+        model.nFaces, model.faces);
+    MSVModelLoader::freeModel(&model);
+  }
+  env->ReleaseStringUTFChars(jpath, path);
+}
@@ -5,12 +5,14 @@
 
 #include <MSVMesh.h>
 
-/** Scaffold of a class in charge of transforming a Java mesh object
- * to a C++ one. Not implemented yet, as there is no out-of-the-box
- * 3D model gestion in Vuforia or Android.
+/** Android-specific implementation of the MSVMesh class, loading the model
+ * file of a Java Mesh object with MSVModelLoader.
  */
 class Mesh : public MSVMesh {
   public:
+    /** Builds a new MSVMesh from a Java Mesh object. The mesh is left empty
+     * if its file cannot be loaded.
+     */
     Mesh(JNIEnv *env, jobject jmesh);
 };
 
@@ -0,0 +1,34 @@
+#include "RedrawListener.h"
+#include "EnvStorage.h"
+
+#include <stdlib.h>
+
+RedrawListener::RedrawListener(JNIEnv *env,
+                               jobject view) :
+jvm(NULL)
+{
+  env->GetJavaVM(&this->jvm);
+  this->view = env->NewGlobalRef(view);
+  this->requestRenderID = env->GetMethodID(env->GetObjectClass(view),
+                                           "requestRender", "()V");
+}
+
+RedrawListener::~RedrawListener()
+{
+  JNIEnv *env = EnvStorage::getJNIEnv();
+  if (env) env->DeleteGlobalRef(this->view);
+}
+
+void
+RedrawListener::requestRender()
+{
+  JNIEnv *env = NULL;
+  bool attached = false;
+  if (jvm->GetEnv((void **)&env, JNI_VERSION_1_4) != JNI_OK) {
+    if (jvm->AttachCurrentThread(&env, NULL) != JNI_OK) return;
+    attached = true;
+  }
+  env->CallVoidMethod(view, requestRenderID);
+  if (env->ExceptionCheck()) env->ExceptionClear();
+  if (attached) jvm->DetachCurrentThread();
+}
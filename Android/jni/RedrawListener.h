@@ -0,0 +1,28 @@
+#ifndef JNI_REDRAW_LISTENER_H
+#define JNI_REDRAW_LISTENER_H
+
+#include <jni.h>
+
+#include <MSVRedraw.h>
+
+/** Android-specific implementation of MSVRedraw::Listener, calling
+ * `GLSurfaceView.requestRender()`.
+ */
+class RedrawListener : public MSVRedraw::Listener
+{
+  public:
+    RedrawListener(JNIEnv *env, jobject view);
+    ~RedrawListener();
+
+    /** Implementation of MSVRedraw::Listener. Native threads unknown to the
+     * JVM (e.g. video decoding) are attached for the duration of the call.
+     */
+    void requestRender();
+
+  private:
+    JavaVM *jvm;
+    jobject view;
+    jmethodID requestRenderID;
+};
+
+#endif
@@ -0,0 +1,118 @@
+#include "SurfaceTextureCallback.h"
+#include "EnvStorage.h"
+
+#include <dlfcn.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* NDK ASurfaceTexture API, only available from libandroid on API 28+ */
+struct SurfaceTextureAPI {
+  ASurfaceTexture *(*fromSurfaceTexture)(JNIEnv *env, jobject st);
+  void (*release)(ASurfaceTexture *st);
+  int (*updateTexImage)(ASurfaceTexture *st);
+  void (*getTransformMatrix)(ASurfaceTexture *st, float mtx[16]);
+};
+
+static SurfaceTextureAPI api;
+static pthread_once_t apiOnce = PTHREAD_ONCE_INIT;
+
+static void
+loadAPI()
+{
+  memset(&api, 0, sizeof(SurfaceTextureAPI));
+  void *lib = dlopen("libandroid.so", RTLD_NOW);
+  if (!lib) return;
+  SurfaceTextureAPI a;
+  *(void **)&a.fromSurfaceTexture = dlsym(lib, "ASurfaceTexture_fromSurfaceTexture");
+  *(void **)&a.release = dlsym(lib, "ASurfaceTexture_release");
+  *(void **)&a.updateTexImage = dlsym(lib, "ASurfaceTexture_updateTexImage");
+  *(void **)&a.getTransformMatrix = dlsym(lib, "ASurfaceTexture_getTransformMatrix");
+  if (a.fromSurfaceTexture && a.release && a.updateTexImage && a.getTransformMatrix)
+    api = a;
+}
+
+SurfaceTextureCallback::SurfaceTextureCallback(JNIEnv *env,
+                                               jobject jvideo,
+                                               jobject jcb) :
+jcb(NULL),
+stopID(NULL),
+surfaceTexture(NULL),
+latched(false)
+{
+  jclass cls = env->GetObjectClass(jvideo);
+  this->jvideo = env->NewGlobalRef(jvideo);
+  this->updateID = env->GetMethodID(cls, "update", "()V");
+  this->texID = env->GetIntField(jvideo, env->GetFieldID(cls, "textureID", "I"));
+
+  // Shared state: kept alive by a global reference to its buffer
+  jobject state = env->GetObjectField(jvideo,
+    env->GetFieldID(cls, "state", "Ljava/nio/ByteBuffer;"));
+  this->jstate = env->NewGlobalRef(state);
+  char *addr = (char *)env->GetDirectBufferAddress(state);
+  this->frames = (volatile int *)(addr + VIDEO_STATE_FRAMES);
+  this->sharedMatrix = (const float *)(addr + VIDEO_STATE_MATRIX);
+  env->DeleteLocalRef(state);
+
+  pthread_once(&apiOnce, loadAPI);
+  if (api.fromSurfaceTexture) {
+    jobject st = env->GetObjectField(jvideo,
+      env->GetFieldID(cls, "surfaceTexture", "Landroid/graphics/SurfaceTexture;"));
+    this->surfaceTexture = api.fromSurfaceTexture(env, st);
+    env->DeleteLocalRef(st);
+  }
+
+  if (jcb) {
+    this->jcb = env->NewWeakGlobalRef(jcb);
+    this->stopID = env->GetMethodID(env->GetObjectClass(jcb), "stop", "()V");
+  }
+  memset(matrix, 0, 16*sizeof(float));
+}
+
+SurfaceTextureCallback::~SurfaceTextureCallback()
+{
+  if (surfaceTexture) api.release(surfaceTexture);
+  JNIEnv *env = EnvStorage::getJNIEnv();
+  env->DeleteGlobalRef(this->jvideo);
+  env->DeleteGlobalRef(this->jstate);
+  if (jcb) env->DeleteWeakGlobalRef(this->jcb);
+}
+
+GLuint
+SurfaceTextureCallback::getTexture(float mtx[16])
+{
+  // Latch at most one frame per rendered frame: SurfaceTexture always
+  // latches the most recent one anyway.
+  if (__sync_lock_test_and_set(frames, 0) > 0) {
+    if (surfaceTexture) {
+      if (api.updateTexImage(surfaceTexture) == 0) {
+        api.getTransformMatrix(surfaceTexture, matrix);
+        latched = true;
+      }
+    }
+    else {
+      JNIEnv *env = EnvStorage::getJNIEnv();
+      env->CallVoidMethod(jvideo, updateID);
+      if (env->ExceptionCheck()) env->ExceptionClear();
+      else {
+        memcpy(matrix, sharedMatrix, 16*sizeof(float));
+        latched = true;
+      }
+    }
+  }
+  // Before the first frame, keep the identity filled by the renderer
+  if (latched) memcpy(mtx, matrix, 16*sizeof(float));
+  return texID;
+}
+
+void
+SurfaceTextureCallback::stop()
+{
+  if (!jcb) return;
+  JNIEnv *env = EnvStorage::getJNIEnv();
+  jobject local = env->NewLocalRef(jcb);
+  if (!env->IsSameObject(local, NULL)) {
+    env->CallVoidMethod(local, stopID);
+  }
+  env->DeleteLocalRef(local);
+}
@@ -0,0 +1,55 @@
+#ifndef JNI_SURFACETEXTURECALLBACK_H
+#define JNI_SURFACETEXTURECALLBACK_H
+
+#include <jni.h>
+
+#include <MSVTextureCallback.h>
+
+/* Layout of the state buffer shared with com.moodstocks.vuforia.VideoTexture,
+ * in native byte order.
+ */
+/** int: number of frames made available since the last latch */
+#define VIDEO_STATE_FRAMES 0
+/** 16 floats: transform matrix, written by the Java fallback */
+#define VIDEO_STATE_MATRIX 4
+
+struct ASurfaceTexture;
+
+/** MSVTextureCallback displaying a VideoTexture without calling Java at
+ * each rendered frame.
+ *
+ * The SurfaceTexture listener only increments a counter in the shared state
+ * buffer. When rendering, new frames are latched natively through the NDK
+ * ASurfaceTexture API (Android 9+), looked up at runtime so that older
+ * devices keep working. On these, Java `updateTexImage` is called instead,
+ * but only when a frame is actually available. The transform matrix is
+ * cached in both cases.
+ */
+class SurfaceTextureCallback : public MSVTextureCallback
+{
+  public:
+    /** Constructor.
+     * @param jvideo the com.moodstocks.vuforia.VideoTexture to display.
+     * @param jcb the DynamicModel.Callback notified on `stop`, or NULL. Its
+     * `getTexture` method is never called.
+     */
+    SurfaceTextureCallback(JNIEnv *env, jobject jvideo, jobject jcb);
+    ~SurfaceTextureCallback();
+    GLuint getTexture(float mtx[16]);
+    void stop();
+
+  private:
+    jobject jvideo;
+    jobject jcb;
+    jmethodID updateID;
+    jmethodID stopID;
+    jobject jstate;
+    volatile int *frames;
+    const float *sharedMatrix;
+    ASurfaceTexture *surfaceTexture;
+    GLuint texID;
+    bool latched;
+    float matrix[16];
+};
+
+#endif
@@ -27,3 +27,26 @@ MSVTexture()
   env->ReleaseByteArrayElements(pixelBuffer, pixels, 0);
 }
 
+void
+Texture::addPart(JNIEnv *env,
+                 jobject jtex,
+                 MSVMesh *mesh,
+                 MSVPendingModel *model,
+                 const float transform[16])
+{
+  if (env->IsSameObject(jtex, NULL)) {
+    model->addPart(mesh, NULL, NULL, 0, transform);
+    return;
+  }
+  jclass textureClass = env->GetObjectClass(jtex);
+  jfieldID pathID = env->GetFieldID(textureClass, "path", "Ljava/lang/String;");
+  jstring jpath = reinterpret_cast<jstring>(env->GetObjectField(jtex, pathID));
+  if (!jpath) {
+    model->addPart(mesh, new Texture(env, jtex), NULL, 0, transform);
+    return;
+  }
+
+  const char *path = env->GetStringUTFChars(jpath, NULL);
+  model->addPart(mesh, NULL, path, TEXTURE_MAX_SIZE, transform);
+  env->ReleaseStringUTFChars(jpath, path);
+}
@@ -3,6 +3,7 @@
 
 #include <jni.h>
 
+#include <MSVPendingModel.h>
 #include <MSVTexture.h>
 
 /** Android-specific implementation of the MSVTexture class. */
@@ -10,6 +11,17 @@ class Texture : public MSVTexture {
   public:
     /** Build a new MSTexture from a Java Texture object */
     Texture(JNIEnv *env, jobject jtex);
+
+    /** Adds a part made of `mesh` and a Java Texture object, or of no
+     * texture if `jtex` is null, to `model`. The image file of the texture,
+     * if it has one, is decoded on the MSVImageDecoder worker thread rather
+     * than on the calling one.
+     */
+    static void addPart(JNIEnv *env,
+                        jobject jtex,
+                        MSVMesh *mesh,
+                        MSVPendingModel *model,
+                        const float transform[16] = NULL);
 };
 
 #endif
@@ -8,6 +8,7 @@ import android.widget.RelativeLayout;
 import com.moodstocks.android.MoodstocksError;
 import com.moodstocks.android.Result;
 import com.moodstocks.vuforia.core.MoodstocksController;
+import com.moodstocks.vuforia.core.Status;
 import com.moodstocks.vuforia.core.Target;
 import com.moodstocks.vuforia.core.VuforiaController;
 import com.qualcomm.QCAR.QCAR;
@@ -192,6 +193,17 @@ public class ARSession implements MoodstocksController.Listener, VuforiaControll
     moodstocks.deInit();
   }
 
+  /**
+   * Sets how long a lost target stays ready to resume. During this window,
+   * scanning resumes, but if the target comes back into view it is tracked
+   * again instantly, with the same model, without a new recognition.
+   * Disabled by default.
+   * @param ms the duration of the window, in milliseconds, 0 to disable it.
+   */
+  public void setLinger(long ms) {
+    vuforia.setLingerTime(ms / 1000.0f);
+  }
+
   /** Tool method: get a new, valid, unused OpenGL texture ID.
    * @return an OpenGL texture ID obtained with `glGenTexture` if rendering
    * has started, 0 otherwise.
@@ -206,15 +218,17 @@ public class ARSession implements MoodstocksController.Listener, VuforiaControll
   @Override
   public void onStatusUpdate() {
     if (paused) return;
-    if (vuforia.isTracking()) {
+    /* Read without native calls */
+    Status status = vuforia.getStatus();
+    if (status.isTracking()) {
       /* Vuforia is currently trying to track a target */
-      if (!vuforia.isTargetLost()) {
+      if (!status.isTargetLost()) {
         /* The target is found */
-        if (vuforia.isNewTarget()) {
-          /* it is a new target: ask for the corresponding
-           * model to be built.
+        if (status.isNewTarget() && !status.isModelRestored()) {
+          /* it is a new target whose model is not cached: ask for
+           * the corresponding model to be built.
            */
-          buildModel();
+          buildModel(status.getTarget());
         }
         else if (builtModel != null) {
           /* a new model is ready for display, either because it has
@@ -229,9 +243,9 @@ public class ARSession implements MoodstocksController.Listener, VuforiaControll
       }
       else if (System.currentTimeMillis() - lastFound > UNTRACK_DELAY) {
         /* target is lost for more than UNTRACK_DELAY ms:
-         * exit tracking mode.
+         * exit tracking mode, lingering if enabled.
          */
-        vuforia.stopTracking();
+        vuforia.suspendTracking();
       }
       vuforia.requireUpdate();
     }
@@ -286,10 +300,14 @@ public class ARSession implements MoodstocksController.Listener, VuforiaControll
    * {@link Listener#buildModel(String, int, int)} and update the displayed model.
    */
   public void buildModel() {
-    if (vuforia.getCurrentTarget() == null) return;
+    buildModel(vuforia.getCurrentTarget());
+  }
+
+  private void buildModel(Target target) {
+    if (target == null) return;
     if (modelTask != null)
       modelTask.abort();
-    modelTask = new modelBuildingTask(vuforia.getCurrentTarget());
+    modelTask = new modelBuildingTask(target);
     modelTask.execute();
   }
 
@@ -25,6 +25,7 @@ public class DynamicModel extends AbstractModel {
   }
 
   private Callback cb;
+  private VideoTexture video = null;
 
   /**
    * Constructor.
@@ -36,9 +37,30 @@ public class DynamicModel extends AbstractModel {
     this.s = scale;
   }
 
+  /**
+   * Constructor for a video decoded to a {@link VideoTexture}. New frames
+   * are then latched natively, without calling
+   * {@link Callback#getTexture(float[])} at each rendered frame.
+   * @param video the {@link VideoTexture} to display.
+   * @param callback the {@link Callback} notified when tracking stops, or
+   * {@code null}. Its {@code getTexture} method is never called.
+   * @param scale the scaling to apply to the video, as {@code [scaleX, scaleY, scaleZ]}.
+   */
+  public DynamicModel(VideoTexture video, Callback callback, float[] scale) {
+    this.video = video;
+    this.cb = callback;
+    this.s = scale;
+  }
+
   /** {@link Callback} accessor */
   public Callback getCallback() {
     return cb;
   }
 
+  /** {@link VideoTexture} accessor, {@code null} if the video is updated
+   * through {@link Callback#getTexture(float[])} */
+  public VideoTexture getVideoTexture() {
+    return video;
+  }
+
 }
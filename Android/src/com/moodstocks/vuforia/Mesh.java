@@ -1,8 +1,28 @@
 package com.moodstocks.vuforia;
 
 /**
- * Class representing a 3D model, not implemented yet!
+ * Class representing a 3D model, loaded natively from a Wavefront OBJ or
+ * binary glTF 2.0 (.glb) file.
  */
 public class Mesh {
-  // TODO
+    /**
+     * This field is actually read from JNI, this is why
+     * we suppress the "unused" warning
+     */
+    @SuppressWarnings("unused")
+    private String path;        /// The path of the model file.
+
+    /**
+     * Creates a new Mesh from a model file. The file is parsed natively when
+     * the model is displayed, and a plane is displayed instead if it cannot
+     * be loaded.
+     * @param path the path of the .obj or .glb file. The textures it refers
+     * to are not loaded: use a {@link Texture} in the {@link StaticModel}.
+     * @return the mesh.
+     */
+    public static Mesh meshFromFile(String path) {
+      Mesh mesh = new Mesh();
+      mesh.path = path;
+      return mesh;
+    }
 }
@@ -1,13 +1,18 @@
 package com.moodstocks.vuforia;
 
+import java.util.ArrayList;
+
 /**
  * Representation of a simple textured 3D mesh to display in
- * augmented reality.
+ * augmented reality, optionally made of several parts.
  */
 public class StaticModel extends AbstractModel {
 
   private Mesh m = null;
   private Texture t = null;
+  private ArrayList<Mesh> partMeshes = new ArrayList<Mesh>();
+  private ArrayList<Texture> partTextures = new ArrayList<Texture>();
+  private ArrayList<float[]> partTransforms = new ArrayList<float[]>();
 
   /**
    * Creates a new Model from {@link Mesh} and {@link Texture}.
@@ -32,6 +37,59 @@ public class StaticModel extends AbstractModel {
     this.s = scale;
   }
 
+  /**
+   * Adds a part to the model, displayed along with its main mesh. Parts
+   * sharing a texture are merged natively, so that they are drawn at once.
+   * @param mesh the {@link Mesh} of the part, or null for a 2x2 plane.
+   * @param tex the {@link Texture} of the part.
+   * @param transform the transform of the part relative to the model, as a
+   * 4x4 column-major matrix, or null for the identity.
+   * @return this model.
+   */
+  public StaticModel addPart(Mesh mesh, Texture tex, float[] transform) {
+    partMeshes.add(mesh);
+    partTextures.add(tex);
+    partTransforms.add(transform);
+    return this;
+  }
+
+  /** Returns true if parts were added with {@link #addPart} */
+  public boolean hasParts() {
+    return !partMeshes.isEmpty();
+  }
+
+  /** Meshes of all the parts, the main mesh first */
+  public Mesh[] getPartMeshes() {
+    Mesh[] meshes = new Mesh[partMeshes.size() + 1];
+    meshes[0] = m;
+    for (int i = 0; i < partMeshes.size(); ++i)
+      meshes[i + 1] = partMeshes.get(i);
+    return meshes;
+  }
+
+  /** Textures of all the parts, the main texture first */
+  public Texture[] getPartTextures() {
+    Texture[] textures = new Texture[partTextures.size() + 1];
+    textures[0] = t;
+    for (int i = 0; i < partTextures.size(); ++i)
+      textures[i + 1] = partTextures.get(i);
+    return textures;
+  }
+
+  /** Transforms of all the parts, the main one first, as an array of
+   * 4x4 column-major matrices.
+   */
+  public float[] getPartTransforms() {
+    int n = partTransforms.size() + 1;
+    float[] transforms = new float[16*n];
+    for (int i = 0; i < n; ++i) {
+      float[] tr = (i == 0) ? null : partTransforms.get(i - 1);
+      for (int j = 0; j < 16; ++j)
+        transforms[16*i + j] = (tr != null) ? tr[j] : ((j % 5 == 0) ? 1 : 0);
+    }
+    return transforms;
+  }
+
   /** {@link Mesh} accessor */
   public Mesh getMesh() {
     return m;
@@ -20,6 +20,21 @@ public class Texture
     private int channelCount;   /// The number of channels.
     @SuppressWarnings("unused")
     private byte[] data;        /// The pixel data.
+    @SuppressWarnings("unused")
+    private String path;        /// The path of the image file.
+
+    /**
+     * Creates a new Texture from a PNG or JPEG file. The file is decoded
+     * natively when the model is displayed, without going through a
+     * {@link Bitmap}: large JPEG images are downscaled while decoding.
+     * @param path the path of the image file.
+     * @return the texture.
+     */
+    public static Texture textureFromFile(String path) {
+      Texture texture = new Texture();
+      texture.path = path;
+      return texture;
+    }
 
     /**
      * Creates a new Texture from a {@link Bitmap}.
@@ -0,0 +1,83 @@
+package com.moodstocks.vuforia;
+
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.FloatBuffer;
+
+import android.graphics.SurfaceTexture;
+
+/**
+ * Video texture fed through a {@link SurfaceTexture}, to be displayed by a
+ * {@link DynamicModel} without calling Java at each rendered frame.
+ * <p>
+ * Give {@link #getSurfaceTexture()} to the video decoder (e.g. through
+ * {@code MediaPlayer.setSurface(new Surface(st))}). New frames are latched
+ * natively by the renderer, only when the decoder actually produced one.
+ */
+public class VideoTexture implements SurfaceTexture.OnFrameAvailableListener
+{
+    /* Layout of the state buffer shared with native code, see
+     * SurfaceTextureCallback.h */
+    private static final int FRAMES_OFFSET = 0;
+    private static final int MATRIX_OFFSET = 4;
+    private static final int STATE_SIZE = MATRIX_OFFSET + 16*4;
+
+    private final int textureID;
+    private final SurfaceTexture surfaceTexture;
+    private final ByteBuffer state;
+    private final FloatBuffer matrix;
+    private final float[] mtx = new float[16];
+
+    /**
+     * Constructor.
+     * @param textureID a GL_TEXTURE_EXTERNAL_OES texture ID, obtained with
+     * {@link com.moodstocks.vuforia.core.VuforiaController#obtainTextureID()}.
+     */
+    public VideoTexture(int textureID) {
+      this.textureID = textureID;
+      this.surfaceTexture = new SurfaceTexture(textureID);
+      this.state = ByteBuffer.allocateDirect(STATE_SIZE).order(ByteOrder.nativeOrder());
+      this.state.putInt(FRAMES_OFFSET, 0);
+      ByteBuffer m = state.duplicate();
+      m.position(MATRIX_OFFSET);
+      this.matrix = m.slice().order(ByteOrder.nativeOrder()).asFloatBuffer();
+      this.surfaceTexture.setOnFrameAvailableListener(this);
+    }
+
+    /** The {@link SurfaceTexture} the video should be decoded to */
+    public SurfaceTexture getSurfaceTexture() {
+      return surfaceTexture;
+    }
+
+    /** The GL_TEXTURE_EXTERNAL_OES texture ID */
+    public int getTextureID() {
+      return textureID;
+    }
+
+    /**
+     * Releases the {@link SurfaceTexture}. Must only be called once the
+     * model displaying this texture has been replaced or tracking stopped.
+     */
+    public void release() {
+      surfaceTexture.release();
+    }
+
+    @Override
+    public void onFrameAvailable(SurfaceTexture st) {
+      frameAvailable(state);
+    }
+
+    /**
+     * Called from native code, on the GL thread, when a new frame is
+     * available and the native SurfaceTexture API is not (Android < 9).
+     */
+    @SuppressWarnings("unused")
+    private void update() {
+      surfaceTexture.updateTexImage();
+      surfaceTexture.getTransformMatrix(mtx);
+      matrix.put(mtx, 0, 16);
+      matrix.rewind();
+    }
+
+    private static native void frameAvailable(ByteBuffer state);
+}
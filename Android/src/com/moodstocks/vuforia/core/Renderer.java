@@ -38,6 +38,13 @@ public class Renderer implements GLSurfaceView.Renderer {
    */
   public native void updateRendering(int width, int height, boolean portrait);
 
+  /** Native function for switching between continuous and on-demand rendering.
+   * @param view the view to ask for new frames when needed, which must be
+   * in {@link GLSurfaceView#RENDERMODE_WHEN_DIRTY} mode, or null to render
+   * continuously.
+   */
+  public native void setRenderOnDemand(GLSurfaceView view);
+
   /**
    * <i>GLSurfaceView callback</i>
    */
@@ -0,0 +1,151 @@
+package com.moodstocks.vuforia.core;
+
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.charset.Charset;
+
+/**
+ * Snapshot of the {@link VuforiaController} status, updated by the native
+ * code right before each call to
+ * {@link VuforiaController.Listener#onStatusUpdate()}.
+ * <p>
+ * Its accessors read memory shared with the native code, without any JNI
+ * call, which makes them cheap enough to be called on every update. Their
+ * values are only consistent from within
+ * {@link VuforiaController.Listener#onStatusUpdate()}.
+ */
+public class Status {
+
+  /* Layout of the native MSVCallback::Status */
+  private static final int TIMESTAMP = 0;
+  private static final int FRAME = 8;
+  private static final int FLAGS = 12;
+  private static final int SESSION = 16;
+  private static final int WIDTH = 20;
+  private static final int HEIGHT = 24;
+  private static final int POSE = 28;
+  private static final int NAME = 76;
+  private static final int NAME_LENGTH = 64;
+
+  /* Values of the FLAGS field */
+  private static final int TRACKING = 1 << 0;
+  private static final int NEW_TARGET = 1 << 1;
+  private static final int TARGET_LOST = 1 << 2;
+  private static final int TARGET_FOUND = 1 << 3;
+  private static final int MODEL_RESTORED = 1 << 4;
+  private static final int FRAME_AVAILABLE = 1 << 5;
+
+  private static final Charset UTF8 = Charset.forName("UTF-8");
+
+  private ByteBuffer buffer;
+  /** Target of the latest session read, rebuilt when the session changes */
+  private Target target = null;
+  private int targetSession = 0;
+  private byte[] name = new byte[NAME_LENGTH];
+
+  Status(ByteBuffer buffer) {
+    this.buffer = buffer.order(ByteOrder.nativeOrder());
+  }
+
+  /**
+   * Same as {@link VuforiaController#isTracking()}.
+   * @return true if tracking, false otherwise.
+   */
+  public boolean isTracking() {
+    return (flags() & TRACKING) != 0;
+  }
+
+  /**
+   * Same as {@link VuforiaController#isNewTarget()}.
+   * @return true if a new target is tracked, false otherwise.
+   */
+  public boolean isNewTarget() {
+    return (flags() & NEW_TARGET) != 0;
+  }
+
+  /**
+   * Same as {@link VuforiaController#isTargetLost()}.
+   * @return true if the target is lost, false otherwise.
+   */
+  public boolean isTargetLost() {
+    return (flags() & TARGET_LOST) != 0;
+  }
+
+  /**
+   * Check whether the tracked target has been found in the camera frame.
+   * @return true if the target is in the frame, in which case its pose is
+   * available through {@link #getPose(float[])}.
+   */
+  public boolean isTargetFound() {
+    return (flags() & TARGET_FOUND) != 0;
+  }
+
+  /**
+   * Same as {@link VuforiaController#isModelRestored()}.
+   * @return true if the model has been restored, false otherwise.
+   */
+  public boolean isModelRestored() {
+    return (flags() & MODEL_RESTORED) != 0;
+  }
+
+  /**
+   * Check whether the camera frame can be fetched with
+   * {@link VuforiaController#getFrame()}.
+   * @return true if the frame is available, false otherwise.
+   */
+  public boolean hasFrame() {
+    return (flags() & FRAME_AVAILABLE) != 0;
+  }
+
+  /**
+   * Same as {@link VuforiaController#getCurrentTarget()}, without
+   * allocating a new {@link Target} on each update.
+   * @return the tracked target, or null if not tracking.
+   */
+  public Target getTarget() {
+    int session = buffer.getInt(SESSION);
+    if (session == 0) return null;
+    if (target == null || session != targetSession) {
+      int len = 0;
+      for (; len < NAME_LENGTH; ++len) {
+        name[len] = buffer.get(NAME + len);
+        if (name[len] == 0) break;
+      }
+      int[] dims = {buffer.getInt(WIDTH), buffer.getInt(HEIGHT)};
+      target = new Target(new String(name, 0, len, UTF8), dims);
+      targetSession = session;
+    }
+    return target;
+  }
+
+  /**
+   * Get the pose of the target in the camera frame.
+   * @param pose will be filled with the 3x4 row-major pose matrix. Only
+   * meaningful if {@link #isTargetFound()} returns true.
+   */
+  public void getPose(float[] pose) {
+    for (int i = 0; i < 12; ++i)
+      pose[i] = buffer.getFloat(POSE + 4*i);
+  }
+
+  /**
+   * Get the index of the camera frame.
+   * @return the index, increasing with each frame delivered by the camera.
+   */
+  public int getFrameIndex() {
+    return buffer.getInt(FRAME);
+  }
+
+  /**
+   * Get the timestamp of the camera frame.
+   * @return the timestamp, in seconds.
+   */
+  public double getTimestamp() {
+    return buffer.getDouble(TIMESTAMP);
+  }
+
+  private int flags() {
+    return buffer.getInt(FLAGS);
+  }
+
+}
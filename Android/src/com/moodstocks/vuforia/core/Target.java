@@ -11,7 +11,7 @@ public class Target {
   private int width = -1;
   private int height = -1;
 
-  private Target(String n, int[] dims) {
+  Target(String n, int[] dims) {
     name = n;
     width = dims[0];
     height = dims[1];
@@ -1,13 +1,17 @@
 package com.moodstocks.vuforia.core;
 
+import java.io.File;
 import java.io.IOException;
+import java.nio.ByteBuffer;
 import java.util.ArrayList;
 import java.util.Arrays;
 import java.util.List;
 
 import android.app.Activity;
 import android.content.Context;
+import android.opengl.GLSurfaceView;
 import android.os.AsyncTask;
+import android.os.Build;
 import android.view.View;
 import android.view.ViewGroup.LayoutParams;
 import android.widget.RelativeLayout;
@@ -17,6 +21,7 @@ import com.moodstocks.vuforia.StaticModel;
 import com.moodstocks.vuforia.DynamicModel;
 import com.moodstocks.vuforia.Mesh;
 import com.moodstocks.vuforia.Texture;
+import com.moodstocks.vuforia.VideoTexture;
 import com.qualcomm.QCAR.QCAR;
 
 /** Class wrapping the Vuforia SDK */
@@ -46,6 +51,12 @@ public class VuforiaController {
   /** Store the current state of the camera */
   private boolean cameraRunning = false;
 
+  /** Whether frames are only rendered when something changed */
+  private boolean renderOnDemand = false;
+
+  /** The status shared with the native code, once initialized */
+  private Status status = null;
+
   /** Listener interface to be notified of Vuforia SDK status updates */
   public static interface Listener {
     /** Informs the listener that a new frame has been processed by
@@ -54,6 +65,24 @@ public class VuforiaController {
     public void onStatusUpdate();
   }
 
+  /** Listener interface receiving the frames captured with
+   * {@link #startCapture(CaptureListener, float, int)}. Its methods are
+   * called on a dedicated capture thread.
+   */
+  public static interface CaptureListener {
+    /** Receives a captured frame.
+     * @param pixels the RGBA pixels, rows bottom-up. Only valid during the
+     * call: copy them to keep them.
+     * @param width the frame width.
+     * @param height the frame height.
+     * @param timestamp the timestamp of the camera frame, in seconds.
+     */
+    public void onFrameCaptured(ByteBuffer pixels, int width, int height, double timestamp);
+
+    /** Informs the listener that the capture is over. */
+    public void onCaptureFinished();
+  }
+
   /** Constructor.
    * @param parent the parent {@link Activity}
    * @param preview the {@link RelativeLayout} into which the camera preview
@@ -107,6 +136,25 @@ public class VuforiaController {
     return true;
   }
 
+  /**
+   * Enable or disable the benchmark of the camera video modes. By default,
+   * the smallest video mode fitting the Moodstocks SDK requirements is used.
+   * When enabled, the first start of the camera on this device model
+   * measures the frame rate actually delivered by the candidate modes, which
+   * may block {@link #start()} for a few seconds, and the choice is cached
+   * for the next starts.
+   * @param enabled true to enable the benchmark.
+   */
+  public void setCameraBenchmark(boolean enabled) {
+    if (enabled) {
+      File cache = new File(parent.getCacheDir(), CAMERA_PROFILE_CACHE);
+      setCameraProfileCache(cache.getPath(), Build.MANUFACTURER + " " + Build.MODEL);
+    }
+    else {
+      setCameraProfileCache(null, null);
+    }
+  }
+
   /** Stops the camera */
   public void stop() {
     stopTracking();
@@ -144,6 +192,20 @@ public class VuforiaController {
    */
   public native void stopTracking();
 
+  /** Stop tracking a lost target, but keep it ready to resume during the
+   * linger window set with {@link #setLingerTime(float)}. Meanwhile,
+   * {@link #isTracking()} returns false so that scanning can resume. If the
+   * target is found again in the camera frames, or passed again to
+   * {@link #startTracking(Target, String)}, tracking resumes instantly with
+   * the same model, and {@link #isNewTarget()} stays false.
+   */
+  public native void suspendTracking();
+
+  /** Set the duration of the linger window used by {@link #suspendTracking()}.
+   * @param seconds the duration, 0 (default) to stop tracking right away.
+   */
+  public native void setLingerTime(float seconds);
+
   /**
    * Check whether this Controller is currently tracking
    * a target.
@@ -164,14 +226,37 @@ public class VuforiaController {
   public void changeCurrentModel(AbstractModel model) {
     if (model.isDynamic()) {
       DynamicModel m = (DynamicModel)model;
-      this.setDynamicModel(m.getCallback(), m.getScale());
+      if (m.getVideoTexture() != null)
+        this.setVideoModel(m.getVideoTexture(), m.getCallback(), m.getScale());
+      else
+        this.setDynamicModel(m.getCallback(), m.getScale());
     }
     else {
       StaticModel m = (StaticModel)model;
-      this.setStaticModel(m.getMesh(), m.getTexture(), m.getScale());
+      if (m.hasParts())
+        this.setCompositeModel(m.getPartMeshes(), m.getPartTextures(),
+                               m.getPartTransforms(), m.getScale());
+      else
+        this.setStaticModel(m.getMesh(), m.getTexture(), m.getScale());
     }
   }
 
+  /**
+   * Switch between continuous and on-demand rendering.
+   * <p>
+   * In on-demand mode, a frame is only rendered when a new camera frame is
+   * delivered, the model or a video texture is updated, or the surface
+   * changes, which saves power on long sessions. Models whose
+   * {@link DynamicModel.Callback} animates on its own are still redrawn at
+   * the camera rate while tracked.
+   * @param onDemand true to render on demand, false to render continuously
+   * (default).
+   */
+  public void setRenderOnDemand(boolean onDemand) {
+    renderOnDemand = onDemand;
+    if (mGlView != null) applyRenderMode();
+  }
+
   /**
    * Require an update of the {@link VuforiaController} status through
    * the {@link Listener#onStatusUpdate()} method.
@@ -199,6 +284,113 @@ public class VuforiaController {
    */
   public native boolean isNewTarget();
 
+  /**
+   * Call this method to know if the model of the target being tracked
+   * has been restored from the model cache, in which case it does not
+   * need to be built again.
+   * @return true if the model has been restored, false otherwise.
+   */
+  public native boolean isModelRestored();
+
+  /**
+   * Set the byte budget of the model cache, which keeps the static models
+   * of the targets once they are no longer tracked, so that they are
+   * restored immediately when tracked again.
+   * @param bytes the budget, 0 to disable the cache.
+   */
+  public native void setModelCacheBudget(int bytes);
+
+  /**
+   * Get the model cache statistics.
+   * @return the number of hits, misses and evictions, followed by the
+   * number of cached models and their size in bytes.
+   */
+  public native int[] getModelCacheStats();
+
+  /**
+   * Get the renderer culling statistics since startup.
+   * @return the number of meshes drawn, the number of meshes skipped
+   * because out of the view, and the number of frames whose model was
+   * entirely out of the view.
+   */
+  public native int[] getRenderStats();
+
+  /**
+   * Start capturing the rendered frames, video background and models
+   * included. Frames are read back asynchronously and reach the listener
+   * a couple of frames after being rendered, without slowing rendering
+   * down.
+   * @param listener the {@link CaptureListener} receiving the frames.
+   * @param scale the size of the frames relative to the view, in (0, 1].
+   * @param frames the number of frames to capture, 0 to capture until
+   * {@link #stopCapture()} is called.
+   * @return false if a capture is already in progress.
+   */
+  public native boolean startCapture(CaptureListener listener, float scale, int frames);
+
+  /**
+   * Stop capturing the rendered frames.
+   */
+  public native void stopCapture();
+
+  /**
+   * Get the frame capture statistics since startup.
+   * @return the number of frames captured, and the number of frames
+   * dropped because the listener could not keep up.
+   */
+  public native int[] getCaptureStats();
+
+  /**
+   * Find the face of the tracked model displayed under a point of the
+   * view, for example to react to taps on a part of a 3D model. Fast
+   * enough to be called on every touch move.
+   * @param x the horizontal coordinate of the point, in pixels from the
+   * left of the {@link GLSurfaceView}.
+   * @param y the vertical coordinate of the point, in pixels from the top
+   * of the {@link GLSurfaceView}.
+   * @return null if the model is not under the point. Otherwise the index
+   * of the model part (0 for the main mesh, then 1 for the first part added
+   * with {@link com.moodstocks.vuforia.StaticModel#addPart}, and so on), the
+   * index of the face in the mesh of that part, the 3
+   * barycentric coordinates of the point in the face, its 2 texture
+   * coordinates, and its 3 coordinates in the model space.
+   */
+  public native float[] hitTest(float x, float y);
+
+  /**
+   * Set the resolution at which the model is rendered, relative to the
+   * view. Below 1, the model is rendered offscreen at this scale, then
+   * upscaled over the camera image, which saves fill rate on high-density
+   * screens at the cost of sharpness. The adaptive quality governor may
+   * lower it further.
+   * @param scale the scale, between 0.25 and 1. 1 by default.
+   */
+  public native void setOverlayScale(float scale);
+
+  /**
+   * Get the resolution at which the model is rendered, relative to the view.
+   * @return the scale set by {@link #setOverlayScale(float)}.
+   */
+  public native float getOverlayScale();
+
+  /**
+   * Enable or disable side-by-side stereo rendering, for headset viewers.
+   * Each half of the {@link GLSurfaceView} then shows the camera image and
+   * the model as seen from one eye. Both eyes are drawn in a single pass.
+   * In stereo, the model is always rendered at full resolution, and
+   * {@link #hitTest(float, float)} applies to the left eye.
+   * @param enabled true to render in stereo. False by default.
+   * @param ipd the distance between the eyes, in the units of the target
+   * size.
+   */
+  public native void setStereo(boolean enabled, float ipd);
+
+  /**
+   * Call this method to know if the view is rendered in stereo.
+   * @return the state set by {@link #setStereo(boolean, float)}.
+   */
+  public native boolean isStereo();
+
   /**
    * Call this method to know if the target that was being tracked
    * has been lost in this frame.
@@ -211,6 +403,19 @@ public class VuforiaController {
    */
   public native boolean isTargetLost();
 
+  /**
+   * Get the status reported to {@link Listener#onStatusUpdate()}. Reading
+   * it takes no native call, unlike {@link #isTracking()},
+   * {@link #isNewTarget()}, {@link #isTargetLost()} and
+   * {@link #getCurrentTarget()}.
+   * <p>
+   * Should be read <b>only</b> from {@link Listener#onStatusUpdate()}.
+   * @return the {@link Status}, or null before initialization.
+   */
+  public Status getStatus() {
+    return status;
+  }
+
   /**
    * Get a new, valid, unused OpenGL texture ID.
    * @return an OpenGL texture ID obtained with `glGenTexture` if rendering
@@ -218,6 +423,54 @@ public class VuforiaController {
    */
   public native int obtainTextureID();
 
+  /**
+   * Write the per-frame trace zones recorded by the native code, in the
+   * Chrome trace event JSON format.
+   * <p>
+   * Only available if the native library has been built with
+   * <code>MSV_TRACE</code> defined.
+   * @param path the path of the file to write.
+   * @return true if the trace has been written, false otherwise.
+   */
+  public native boolean dumpTrace(String path);
+
+  /**
+   * Start recording the camera frames, tracking results and projection
+   * matrices, so that the session can be replayed on a host for
+   * benchmarking.
+   * @param path the path of the file to write.
+   * @param compress true to compress the camera frames.
+   * @return true if the recording started, false otherwise.
+   */
+  public native boolean startRecording(String path, boolean compress);
+
+  /** Stop the current recording, if any. */
+  public native void stopRecording();
+
+  /**
+   * Enable or disable the adaptive quality governor, which lowers the
+   * model level of detail, texture and rendering resolutions and scan
+   * frequency when frames take longer than the budget, and restores them
+   * once there is headroom again.
+   * @param enabled true to enable the governor, false to disable it and go
+   * back to the full quality.
+   * @param budgetMs the target frame time, in milliseconds.
+   */
+  public native void setAdaptiveQuality(boolean enabled, float budgetMs);
+
+  /**
+   * Get the current quality level.
+   * @return the level, 0 being the full quality.
+   */
+  public native int getQualityLevel();
+
+  /**
+   * Get a description of the latest quality level changes, with their
+   * reasons.
+   * @return the changes, oldest first.
+   */
+  public native String[] getQualityChanges();
+
   /** Called from native shortly after a call to {@link #requireUpdate()} */
   private void onStatusUpdate() {
     if (listener != null) listener.onStatusUpdate();
@@ -245,6 +498,10 @@ public class VuforiaController {
   private native boolean startCameraNative();
   /** Native method to stop the camera */
   private native void stopCameraNative();
+  /** Native method to set the camera profile cache file */
+  private native void setCameraProfileCache(String path, String device);
+  /** Name of the camera profile cache file */
+  private static final String CAMERA_PROFILE_CACHE = "camera_profile";
 
   /** Cache the list of available assets */
   private static List<String> assets = null;
@@ -281,6 +538,7 @@ public class VuforiaController {
                "Vuforia SDK Error: initialization failed.";
       }
       initNative();
+      status = new Status(getStatusBuffer());
       initGL();
       this.execute();
       return null;
@@ -294,6 +552,7 @@ public class VuforiaController {
 
     public void deInit() {
       synchronized (mShutdownLock) {
+        status = null;
         deInitNative();
         QCAR.deinit();
       }
@@ -312,6 +571,8 @@ public class VuforiaController {
   private native void initNative();
   /** Deinitializes the native part of the code */
   private native void deInitNative();
+  /** Returns the direct buffer wrapping the native status */
+  private native ByteBuffer getStatusBuffer();
 
   /**
    * Method to initialize the {@link Renderer} and the GLView.
@@ -323,12 +584,21 @@ public class VuforiaController {
 
     mRenderer = new Renderer(parent);
     mGlView.setRenderer(mRenderer);
+    applyRenderMode();
 
     mRenderer.mIsActive = true;
     preview.addView(mGlView, new LayoutParams(LayoutParams.MATCH_PARENT,
                                               LayoutParams.MATCH_PARENT));
   }
 
+  /** Applies {@link #renderOnDemand} to the GLView and native renderer */
+  private void applyRenderMode() {
+    mGlView.setRenderMode(renderOnDemand ?
+                          GLSurfaceView.RENDERMODE_WHEN_DIRTY :
+                          GLSurfaceView.RENDERMODE_CONTINUOUSLY);
+    mRenderer.setRenderOnDemand(renderOnDemand ? mGlView : null);
+  }
+
   /** Checks that a Vuforia dataset exists */
   private static boolean datasetExists(Context ctx, String name) {
     try {
@@ -343,6 +613,11 @@ public class VuforiaController {
 
   private native void setStaticModel(Mesh mesh, Texture tex, float[] scale);
 
+  private native void setCompositeModel(Mesh[] meshes, Texture[] textures,
+                                        float[] transforms, float[] scale);
+
   private native void setDynamicModel(DynamicModel.Callback cb, float[] scale);
 
+  private native void setVideoModel(VideoTexture video, DynamicModel.Callback cb, float[] scale);
+
 }
@@ -0,0 +1,190 @@
+#include "MSVAnimation.h"
+#include "MSVAsset.h"
+
+#include <math.h>
+#include <string.h>
+
+MSVAnimation::MSVAnimation(float duration, bool loop) :
+duration(duration),
+loop(loop)
+{
+  memset(&morph, 0, sizeof(morph));
+  memset(bones, 0, sizeof(bones));
+}
+
+MSVAnimation::~MSVAnimation()
+{
+  delete [] morph.times;
+  delete [] morph.values;
+  for (int b = 0; b < MESH_MAX_BONES; ++b) {
+    delete [] bones[b].times;
+    delete [] bones[b].values;
+  }
+}
+
+bool
+MSVAnimation::setMorphTrack(unsigned int nKeys,
+                            const float *times,
+                            const float *weights)
+{
+  return setTrack(&morph, nKeys, times, weights, MESH_MAX_MORPH_TARGETS);
+}
+
+bool
+MSVAnimation::setBoneTrack(unsigned int bone,
+                           unsigned int nKeys,
+                           const float *times,
+                           const float *poses)
+{
+  if (bone >= MESH_MAX_BONES) return false;
+  return setTrack(&bones[bone], nKeys, times, poses, BONE_POSE_SIZE);
+}
+
+bool
+MSVAnimation::setTrack(Track *track,
+                       unsigned int nKeys,
+                       const float *times,
+                       const float *values,
+                       int stride)
+{
+  if (!nKeys) return false;
+  for (unsigned int k = 1; k < nKeys; ++k)
+    if (times[k] < times[k-1]) return false;
+  delete [] track->times;
+  delete [] track->values;
+  track->nKeys = nKeys;
+  track->times = new float[nKeys];
+  memcpy(track->times, times, nKeys*sizeof(float));
+  track->values = new float[nKeys*stride];
+  memcpy(track->values, values, nKeys*stride*sizeof(float));
+  return true;
+}
+
+float
+MSVAnimation::getDuration() const
+{
+  return duration;
+}
+
+bool
+MSVAnimation::isLooping() const
+{
+  return loop;
+}
+
+float
+MSVAnimation::clipTime(float time) const
+{
+  if (duration <= 0 || time <= 0) return 0;
+  if (!loop) return time < duration ? time : duration;
+  return fmodf(time, duration);
+}
+
+bool
+MSVAnimation::sampleMorph(float time, float weights[MESH_MAX_MORPH_TARGETS]) const
+{
+  if (!morph.nKeys) return false;
+  sample(&morph, MESH_MAX_MORPH_TARGETS, clipTime(time), weights);
+  return true;
+}
+
+bool
+MSVAnimation::sampleBone(unsigned int bone,
+                         float time,
+                         float pose[BONE_POSE_SIZE]) const
+{
+  if (bone >= MESH_MAX_BONES || !bones[bone].nKeys) return false;
+  const Track *track = &bones[bone];
+  sample(track, BONE_POSE_SIZE, clipTime(time), pose);
+  // Back to a unit quaternion
+  float *q = pose + 3;
+  float len = sqrtf(q[0]*q[0] + q[1]*q[1] + q[2]*q[2] + q[3]*q[3]);
+  if (len > 0) {
+    for (int i = 0; i < 4; ++i) q[i] /= len;
+  }
+  else {
+    q[0] = q[1] = q[2] = 0;
+    q[3] = 1;
+  }
+  return true;
+}
+
+void
+MSVAnimation::sample(const Track *track, int stride, float time, float *out)
+{
+  const float *t = track->times;
+  unsigned int n = track->nKeys;
+  if (n == 1 || time <= t[0]) {
+    memcpy(out, track->values, stride*sizeof(float));
+    return;
+  }
+  if (time >= t[n-1]) {
+    memcpy(out, track->values + (n-1)*stride, stride*sizeof(float));
+    return;
+  }
+  // Last key at or before `time`
+  unsigned int lo = 0, hi = n - 1;
+  while (hi - lo > 1) {
+    unsigned int mid = (lo + hi)/2;
+    if (t[mid] <= time) lo = mid;
+    else hi = mid;
+  }
+  float span = t[hi] - t[lo];
+  float f = span > 0 ? (time - t[lo])/span : 0;
+  const float *a = track->values + lo*stride;
+  const float *b = track->values + hi*stride;
+  float sign = 1;
+  if (stride == BONE_POSE_SIZE) {
+    // Quaternions q and -q are the same rotation: take the closest one
+    float dot = a[3]*b[3] + a[4]*b[4] + a[5]*b[5] + a[6]*b[6];
+    if (dot < 0) sign = -1;
+  }
+  for (int i = 0; i < stride; ++i) {
+    float s = (stride == BONE_POSE_SIZE && i >= 3 && i < 7) ? sign : 1;
+    out[i] = a[i] + f*(s*b[i] - a[i]);
+  }
+}
+
+uint64_t
+MSVAnimation::contentHash(uint64_t seed) const
+{
+  float header[2] = {duration, loop ? 1.0f : 0.0f};
+  uint64_t h = MSVAsset::hash(header, sizeof(header), seed);
+  h = MSVAsset::hash(morph.times, morph.nKeys*sizeof(float), h);
+  h = MSVAsset::hash(morph.values,
+                     morph.nKeys*MESH_MAX_MORPH_TARGETS*sizeof(float), h);
+  for (int b = 0; b < MESH_MAX_BONES; ++b) {
+    h = MSVAsset::hash(bones[b].times, bones[b].nKeys*sizeof(float), h);
+    h = MSVAsset::hash(bones[b].values,
+                       bones[b].nKeys*BONE_POSE_SIZE*sizeof(float), h);
+  }
+  return h;
+}
+
+static bool
+sameTrack(unsigned int nA, const float *timesA, const float *valuesA,
+          unsigned int nB, const float *timesB, const float *valuesB,
+          int stride)
+{
+  return nA == nB &&
+         !memcmp(timesA, timesB, nA*sizeof(float)) &&
+         !memcmp(valuesA, valuesB, nA*stride*sizeof(float));
+}
+
+bool
+MSVAnimation::sameContent(const MSVAnimation *other) const
+{
+  if (duration != other->duration || loop != other->loop) return false;
+  if (!sameTrack(morph.nKeys, morph.times, morph.values,
+                 other->morph.nKeys, other->morph.times, other->morph.values,
+                 MESH_MAX_MORPH_TARGETS))
+    return false;
+  for (int b = 0; b < MESH_MAX_BONES; ++b) {
+    const Track *x = &bones[b];
+    const Track *y = &other->bones[b];
+    if (!sameTrack(x->nKeys, x->times, x->values,
+                   y->nKeys, y->times, y->values, BONE_POSE_SIZE))
+      return false;
+  }
+  return true;
+}
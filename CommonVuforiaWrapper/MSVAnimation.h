@@ -0,0 +1,96 @@
+#ifndef MSV_ANIMATION_H
+#define MSV_ANIMATION_H
+
+#include <stdint.h>
+
+/** Maximal number of morph targets of a mesh, each one being an extra vertex
+ * attribute: with the position, normal, texture coordinates and the two
+ * skinning attributes, this is the 8 attributes OpenGL ES 2.0 guarantees.
+ */
+#define MESH_MAX_MORPH_TARGETS  3
+/** Maximal number of bones of a skinned mesh. The palette is passed as 3
+ * vec4 per bone, within the 128 vertex uniform vectors OpenGL ES 2.0
+ * guarantees.
+ */
+#define MESH_MAX_BONES          32
+/** Number of bones each vertex of a skinned mesh is attached to */
+#define MESH_BONE_INFLUENCES    4
+/** Number of floats of a bone pose: translation, rotation quaternion
+ * (x, y, z, w) and scale.
+ */
+#define BONE_POSE_SIZE          10
+
+/** Class representing an animation clip of a mesh (see MSVMesh).
+ *
+ * A clip is made of key-framed tracks: one for the weights of the morph
+ * targets, and one per animated bone for its pose relative to its parent.
+ * Tracks are sampled on the CPU, which only amounts to a few uniforms per
+ * frame: vertices are blended and skinned by the vertex shader.
+ */
+class MSVAnimation {
+  public:
+    /** @param duration the length of the clip, in seconds.
+     * @param loop true if the clip restarts once over, false if it stays on
+     * its last frame.
+     */
+    MSVAnimation(float duration, bool loop = true);
+    ~MSVAnimation();
+
+    /** Sets the morph weights track.
+     * @param times the `nKeys` key times, in increasing order.
+     * @param weights MESH_MAX_MORPH_TARGETS weights per key.
+     * @return false if the keys are invalid.
+     */
+    bool setMorphTrack(unsigned int nKeys,
+                       const float *times,
+                       const float *weights);
+
+    /** Sets the track of a bone.
+     * @param poses BONE_POSE_SIZE floats per key, relative to the parent
+     * bone. Bones without track stay in their rest pose.
+     * @return false if the bone or the keys are invalid.
+     */
+    bool setBoneTrack(unsigned int bone,
+                      unsigned int nKeys,
+                      const float *times,
+                      const float *poses);
+
+    float getDuration() const;
+    bool isLooping() const;
+
+    /** Samples the morph weights at `time` seconds from the start of the
+     * clip. Returns false if the clip has no morph track.
+     */
+    bool sampleMorph(float time, float weights[MESH_MAX_MORPH_TARGETS]) const;
+    /** Samples the pose of a bone, with quaternions interpolated linearly
+     * then normalized. Returns false if the bone has no track.
+     */
+    bool sampleBone(unsigned int bone, float time, float pose[BONE_POSE_SIZE]) const;
+
+    /** Hashes the content, chained from `seed` */
+    uint64_t contentHash(uint64_t seed) const;
+    /** Compares the content with another clip */
+    bool sameContent(const MSVAnimation *other) const;
+
+  private:
+    struct Track {
+      unsigned int nKeys;
+      float *times;
+      float *values;
+    };
+
+    float duration;
+    bool loop;
+    Track morph;
+    Track bones[MESH_MAX_BONES];
+
+    float clipTime(float time) const;
+    static bool setTrack(Track *track,
+                         unsigned int nKeys,
+                         const float *times,
+                         const float *values,
+                         int stride);
+    static void sample(const Track *track, int stride, float time, float *out);
+};
+
+#endif
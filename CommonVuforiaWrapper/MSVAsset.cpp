@@ -0,0 +1,120 @@
+#include "MSVAsset.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_ENTRY_NUMBER 16
+
+#define HASH_BASIS  0xcbf29ce484222325ULL
+#define HASH_PRIME  0x100000001b3ULL
+
+// Initialize static variables
+MSVAsset::Entry *MSVAsset::entries = NULL;
+int MSVAsset::entry_nb = 0;
+int MSVAsset::entry_capacity = 0;
+pthread_mutex_t MSVAsset::lock = PTHREAD_MUTEX_INITIALIZER;
+
+MSVAsset::MSVAsset(Kind kind) :
+kind(kind),
+refs(1),
+registered(false)
+{}
+
+MSVAsset::~MSVAsset()
+{
+  if (!registered) return;
+  pthread_mutex_lock(&lock);
+  for (int i = 0; i < entry_nb; ++i) {
+    if (entries[i].asset == this) {
+      entries[i] = entries[--entry_nb];
+      break;
+    }
+  }
+  pthread_mutex_unlock(&lock);
+}
+
+void
+MSVAsset::retain()
+{
+  __sync_fetch_and_add(&refs, 1);
+}
+
+void
+MSVAsset::release()
+{
+  if (__sync_sub_and_fetch(&refs, 1) == 0) delete this;
+}
+
+bool
+MSVAsset::tryRetain()
+{
+  // Fails if the asset is being deleted, i.e. has no reference left
+  int r = refs;
+  while (r > 0) {
+    int prev = __sync_val_compare_and_swap(&refs, r, r + 1);
+    if (prev == r) return true;
+    r = prev;
+  }
+  return false;
+}
+
+MSVAsset *
+MSVAsset::intern(MSVAsset *asset)
+{
+  if (!asset || asset->registered) return asset;
+  uint64_t h = asset->contentHash();
+  MSVAsset *found = NULL;
+  MSVAsset *mismatch = NULL;
+  pthread_mutex_lock(&lock);
+  for (int i = 0; i < entry_nb; ++i) {
+    MSVAsset *a = entries[i].asset;
+    if (entries[i].hash != h || a->kind != asset->kind) continue;
+    if (!a->tryRetain()) continue;
+    // Only compare once retained: the content cannot be freed meanwhile
+    if (asset->sameContent(a)) found = a;
+    else mismatch = a;
+    break;
+  }
+  if (!found) {
+    if (entry_nb == entry_capacity) {
+      entry_capacity = entry_capacity ? 2*entry_capacity : INITIAL_ENTRY_NUMBER;
+      entries = (Entry *)realloc(entries, entry_capacity*sizeof(Entry));
+    }
+    entries[entry_nb].asset = asset;
+    entries[entry_nb].hash = h;
+    entry_nb++;
+    asset->registered = true;
+  }
+  pthread_mutex_unlock(&lock);
+  // Released outside of the lock, since it may delete and unregister
+  if (mismatch) mismatch->release();
+  if (!found) return asset;
+  asset->release();
+  return found;
+}
+
+int
+MSVAsset::getRegisteredCount()
+{
+  pthread_mutex_lock(&lock);
+  int n = entry_nb;
+  pthread_mutex_unlock(&lock);
+  return n;
+}
+
+uint64_t
+MSVAsset::hash(const void *data, size_t size, uint64_t seed)
+{
+  // FNV-1a, fed with 64-bit words rather than bytes
+  const unsigned char *p = (const unsigned char *)data;
+  uint64_t h = seed ? seed : HASH_BASIS;
+  for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t), p += sizeof(uint64_t)) {
+    uint64_t w;
+    memcpy(&w, p, sizeof(w));
+    h = (h ^ w) * HASH_PRIME;
+  }
+  for (; size > 0; --size, ++p) {
+    h = (h ^ *p) * HASH_PRIME;
+  }
+  return h ^ (h >> 32);
+}
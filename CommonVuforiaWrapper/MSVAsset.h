@@ -0,0 +1,76 @@
+#ifndef MSV_ASSET_H
+#define MSV_ASSET_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Base class of the reference-counted assets: meshes, textures and the
+ * models made of them.
+ *
+ * An asset is created with one reference, owned by its creator, and is
+ * deleted when its last reference is released. Assets are never deleted
+ * directly, so that several targets can share them.
+ *
+ * `intern` deduplicates assets by content: identical textures or meshes
+ * supplied for different targets end up as one object, uploaded once.
+ * The registry only holds weak references, and forgets an asset when it
+ * is deleted.
+ */
+class MSVAsset {
+  public:
+    enum Kind {
+      MESH = 0,
+      TEXTURE,
+      MODEL
+    };
+
+    /** Adds a reference. Can be called from any thread. */
+    void retain();
+    /** Releases a reference, deleting the asset if it was the last one.
+     * Can be called from any thread.
+     */
+    void release();
+
+    /** Returns a registered asset with the same content, or registers this
+     * one. Must only be called once the content is final.
+     * @param asset the asset, whose reference is transferred.
+     * @return a reference to the shared asset: either `asset`, or an
+     * identical one, in which case `asset` is released.
+     */
+    static MSVAsset *intern(MSVAsset *asset);
+
+    /** Returns the number of registered assets */
+    static int getRegisteredCount();
+
+    /** Tool method: hashes `size` bytes, chained from `seed` */
+    static uint64_t hash(const void *data, size_t size, uint64_t seed = 0);
+
+  protected:
+    MSVAsset(Kind kind);
+    virtual ~MSVAsset();
+
+    /** Returns a hash of the content */
+    virtual uint64_t contentHash() const = 0;
+    /** Compares the content with another asset of the same kind */
+    virtual bool sameContent(const MSVAsset *other) const = 0;
+
+  private:
+    struct Entry {
+      MSVAsset *asset;
+      uint64_t hash;
+    };
+
+    Kind kind;
+    volatile int refs;
+    bool registered;
+
+    static Entry *entries;
+    static int entry_nb;
+    static int entry_capacity;
+    static pthread_mutex_t lock;
+
+    bool tryRetain();
+};
+
+#endif
@@ -0,0 +1,339 @@
+#include "MSVBVH.h"
+#include "MSVTrace.h"
+
+#include <float.h>
+#include <string.h>
+
+/** Range of triangles waiting to be split */
+struct BuildTask {
+  unsigned int node;
+  unsigned int first;
+  unsigned int count;
+  unsigned int depth;
+};
+
+/** Bounds and centroid of a triangle, swapped along with its index to
+ * keep the triangles of a node contiguous in memory
+ */
+struct Primitive {
+  float min[3];
+  float max[3];
+  float centroid[3];
+  unsigned int face;
+};
+
+/** Triangles of a bin, and their bounds */
+struct Bin {
+  float min[3];
+  float max[3];
+  unsigned int count;
+};
+
+static void
+resetBox(float min[3], float max[3])
+{
+  for (int k = 0; k < 3; ++k) {
+    min[k] = FLT_MAX;
+    max[k] = -FLT_MAX;
+  }
+}
+
+static void
+growBox(float min[3], float max[3], const float boxMin[3], const float boxMax[3])
+{
+  // Selects rather than branches, which the compiler turns into min/max
+  // instructions
+  for (int k = 0; k < 3; ++k) {
+    min[k] = boxMin[k] < min[k] ? boxMin[k] : min[k];
+    max[k] = boxMax[k] > max[k] ? boxMax[k] : max[k];
+  }
+}
+
+/** Half the surface area of a box, 0 if empty */
+static float
+boxArea(const float min[3], const float max[3])
+{
+  if (min[0] > max[0]) return 0;
+  float dx = max[0] - min[0];
+  float dy = max[1] - min[1];
+  float dz = max[2] - min[2];
+  return dx*dy + dy*dz + dz*dx;
+}
+
+MSVBVH::MSVBVH(const float *vertices, unsigned int nFaces, const float *faces) :
+vertices(vertices),
+nodes(NULL),
+nNodes(0),
+tris(NULL),
+faceIds(NULL),
+nTris(nFaces)
+{
+  build(faces);
+}
+
+MSVBVH::~MSVBVH()
+{
+  delete [] nodes;
+  delete [] tris;
+  delete [] faceIds;
+}
+
+unsigned int
+MSVBVH::getNodesCount() const
+{
+  return nNodes;
+}
+
+size_t
+MSVBVH::getSize() const
+{
+  return nNodes*sizeof(Node) + nTris*4*sizeof(unsigned int);
+}
+
+void
+MSVBVH::build(const float *faces)
+{
+  MSV_TRACE_SCOPE("buildBVH");
+  // A binary tree with one triangle per leaf at worst
+  nodes = new Node[nTris ? 2*nTris - 1 : 1];
+  faceIds = new unsigned int[nTris];
+  tris = new unsigned int[3*nTris];
+  Primitive *prims = new Primitive[nTris];
+  for (unsigned int i = 0; i < nTris; ++i) {
+    Primitive *prim = &prims[i];
+    resetBox(prim->min, prim->max);
+    for (int j = 0; j < 3; ++j) {
+      const float *p = vertices + 3*(unsigned int)faces[3*i + j];
+      growBox(prim->min, prim->max, p, p);
+    }
+    for (int k = 0; k < 3; ++k)
+      prim->centroid[k] = 0.5f*(prim->min[k] + prim->max[k]);
+    prim->face = i;
+  }
+
+  nNodes = 1;
+  BuildTask stack[2*BVH_MAX_DEPTH + 2];
+  int top = 0;
+  BuildTask root = {0, 0, nTris, 0};
+  stack[top++] = root;
+  while (top > 0) {
+    BuildTask task = stack[--top];
+    Node *node = &nodes[task.node];
+    Primitive *first = prims + task.first;
+    Primitive *end = first + task.count;
+    float cMin[3], cMax[3];
+    resetBox(node->min, node->max);
+    resetBox(cMin, cMax);
+    for (Primitive *prim = first; prim < end; ++prim) {
+      growBox(node->min, node->max, prim->min, prim->max);
+      growBox(cMin, cMax, prim->centroid, prim->centroid);
+    }
+    node->first = task.first;
+    node->count = task.count;
+    if (task.count <= BVH_LEAF_SIZE || task.depth + 1 >= BVH_MAX_DEPTH)
+      continue;
+
+    // Evaluate the cost of the planes between bins along each axis: the
+    // triangles count of each side times its surface area
+    int bestAxis = -1;
+    int bestSplit = 0;
+    float bestCost = FLT_MAX;
+    Bin bins[3][BVH_BINS];
+    float binScale[3];
+    for (int axis = 0; axis < 3; ++axis) {
+      float extent = cMax[axis] - cMin[axis];
+      binScale[axis] = extent > 0 ? BVH_BINS/extent : 0;
+      for (int b = 0; b < BVH_BINS; ++b) {
+        resetBox(bins[axis][b].min, bins[axis][b].max);
+        bins[axis][b].count = 0;
+      }
+    }
+    // All the axes in one pass over the triangles
+    for (Primitive *prim = first; prim < end; ++prim) {
+      for (int axis = 0; axis < 3; ++axis) {
+        int b = (int)((prim->centroid[axis] - cMin[axis])*binScale[axis]);
+        if (b >= BVH_BINS) b = BVH_BINS - 1;
+        growBox(bins[axis][b].min, bins[axis][b].max, prim->min, prim->max);
+        bins[axis][b].count++;
+      }
+    }
+    for (int axis = 0; axis < 3; ++axis) {
+      if (!(binScale[axis] > 0)) continue;
+      // Right sides first, then left sides while sweeping
+      const Bin *axisBins = bins[axis];
+      float rightCost[BVH_BINS];
+      float lo[3], hi[3];
+      resetBox(lo, hi);
+      unsigned int n = 0;
+      for (int b = BVH_BINS - 1; b > 0; --b) {
+        growBox(lo, hi, axisBins[b].min, axisBins[b].max);
+        n += axisBins[b].count;
+        rightCost[b] = n ? n*boxArea(lo, hi) : -1;
+      }
+      resetBox(lo, hi);
+      n = 0;
+      for (int b = 0; b < BVH_BINS - 1; ++b) {
+        growBox(lo, hi, axisBins[b].min, axisBins[b].max);
+        n += axisBins[b].count;
+        if (!n || rightCost[b + 1] < 0) continue;
+        float cost = n*boxArea(lo, hi) + rightCost[b + 1];
+        if (cost < bestCost) {
+          bestCost = cost;
+          bestAxis = axis;
+          bestSplit = b + 1;
+        }
+      }
+    }
+    // All the centroids are at the same place
+    if (bestAxis < 0) continue;
+
+    // Partition the triangles around the plane
+    Primitive *i = first;
+    Primitive *j = end;
+    while (i < j) {
+      int b = (int)((i->centroid[bestAxis] - cMin[bestAxis])*binScale[bestAxis]);
+      if (b >= BVH_BINS) b = BVH_BINS - 1;
+      if (b < bestSplit) {
+        i++;
+      }
+      else {
+        Primitive tmp = *i;
+        *i = *--j;
+        *j = tmp;
+      }
+    }
+    unsigned int leftCount = i - first;
+    if (!leftCount || leftCount == task.count) continue;
+
+    node->first = nNodes;
+    node->count = 0;
+    BuildTask left = {nNodes, task.first, leftCount, task.depth + 1};
+    BuildTask right = {nNodes + 1, task.first + leftCount,
+                       task.count - leftCount, task.depth + 1};
+    nNodes += 2;
+    stack[top++] = right;
+    stack[top++] = left;
+  }
+
+  // Leaves hold several triangles: most of the nodes are unused
+  Node *used = new Node[nNodes];
+  memcpy(used, nodes, nNodes*sizeof(Node));
+  delete [] nodes;
+  nodes = used;
+  for (unsigned int i = 0; i < nTris; ++i) {
+    faceIds[i] = prims[i].face;
+    for (int j = 0; j < 3; ++j)
+      tris[3*i + j] = (unsigned int)faces[3*faceIds[i] + j];
+  }
+  delete [] prims;
+}
+
+bool
+MSVBVH::intersectBox(const Node *node,
+                     const float origin[3],
+                     const float invDir[3],
+                     float maxT,
+                     float *tNear)
+{
+  float tEnter = 0;
+  float tExit = maxT;
+  for (int k = 0; k < 3; ++k) {
+    float t1 = (node->min[k] - origin[k])*invDir[k];
+    float t2 = (node->max[k] - origin[k])*invDir[k];
+    if (t1 > t2) {
+      float tmp = t1;
+      t1 = t2;
+      t2 = tmp;
+    }
+    if (t1 > tEnter) tEnter = t1;
+    if (t2 < tExit) tExit = t2;
+    if (tEnter > tExit) return false;
+  }
+  *tNear = tEnter;
+  return true;
+}
+
+bool
+MSVBVH::intersectTriangle(unsigned int i,
+                          const float origin[3],
+                          const float dir[3],
+                          int cull,
+                          Hit *hit) const
+{
+  // Moller-Trumbore
+  const float *p0 = vertices + 3*tris[3*i];
+  const float *p1 = vertices + 3*tris[3*i + 1];
+  const float *p2 = vertices + 3*tris[3*i + 2];
+  float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+  float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+  float p[3] = {dir[1]*e2[2] - dir[2]*e2[1],
+                dir[2]*e2[0] - dir[0]*e2[2],
+                dir[0]*e2[1] - dir[1]*e2[0]};
+  // Positive when the vertices are counter-clockwise along the ray
+  float det = e1[0]*p[0] + e1[1]*p[1] + e1[2]*p[2];
+  if (det == 0 || (cull > 0 && det < 0) || (cull < 0 && det > 0)) return false;
+  float inv = 1.0f/det;
+  float s[3] = {origin[0] - p0[0], origin[1] - p0[1], origin[2] - p0[2]};
+  float u = (s[0]*p[0] + s[1]*p[1] + s[2]*p[2])*inv;
+  if (u < 0 || u > 1) return false;
+  float q[3] = {s[1]*e1[2] - s[2]*e1[1],
+                s[2]*e1[0] - s[0]*e1[2],
+                s[0]*e1[1] - s[1]*e1[0]};
+  float v = (dir[0]*q[0] + dir[1]*q[1] + dir[2]*q[2])*inv;
+  if (v < 0 || u + v > 1) return false;
+  float t = (e2[0]*q[0] + e2[1]*q[1] + e2[2]*q[2])*inv;
+  if (t < 0 || t >= hit->t) return false;
+  hit->face = faceIds[i];
+  hit->t = t;
+  hit->u = u;
+  hit->v = v;
+  return true;
+}
+
+bool
+MSVBVH::intersect(const float origin[3],
+                  const float dir[3],
+                  int cull,
+                  float maxT,
+                  Hit *hit) const
+{
+  if (!nTris) return false;
+  float invDir[3];
+  for (int k = 0; k < 3; ++k)
+    invDir[k] = dir[k] != 0 ? 1.0f/dir[k] : (dir[k] < 0 ? -FLT_MAX : FLT_MAX);
+  Hit best;
+  best.t = maxT;
+  bool found = false;
+
+  // Nearest child first, so that farther boxes get skipped once a hit is
+  // closer than them
+  unsigned int stack[BVH_MAX_DEPTH + 1];
+  int top = 0;
+  float tNear;
+  if (!intersectBox(&nodes[0], origin, invDir, best.t, &tNear)) return false;
+  stack[top++] = 0;
+  while (top > 0) {
+    const Node *node = &nodes[stack[--top]];
+    if (node->count) {
+      for (unsigned int i = node->first; i < node->first + node->count; ++i)
+        found = intersectTriangle(i, origin, dir, cull, &best) || found;
+      continue;
+    }
+    float tLeft, tRight;
+    bool left = intersectBox(&nodes[node->first], origin, invDir, best.t, &tLeft);
+    bool right = intersectBox(&nodes[node->first + 1], origin, invDir, best.t, &tRight);
+    if (left && right) {
+      bool leftFirst = tLeft <= tRight;
+      stack[top++] = node->first + (leftFirst ? 1 : 0);
+      stack[top++] = node->first + (leftFirst ? 0 : 1);
+    }
+    else if (left) {
+      stack[top++] = node->first;
+    }
+    else if (right) {
+      stack[top++] = node->first + 1;
+    }
+  }
+  if (found) *hit = best;
+  return found;
+}
@@ -0,0 +1,96 @@
+#ifndef MSV_BVH_H
+#define MSV_BVH_H
+
+#include <stddef.h>
+
+/** Number of bins the surface area heuristic evaluates per axis */
+#define BVH_BINS          16
+/** Maximal number of triangles of a leaf, unless they cannot be split */
+#define BVH_LEAF_SIZE     4
+/** Maximal depth of the tree, deeper nodes being turned into leaves */
+#define BVH_MAX_DEPTH     48
+
+/** Bounding volume hierarchy of the triangles of a mesh, for ray casting.
+ *
+ * Nodes are axis-aligned boxes, split recursively along the plane that
+ * minimizes the surface area heuristic, evaluated on BVH_BINS bins of the
+ * triangle centroids. A ray then only tests the triangles of the few leaves
+ * whose boxes it crosses, which takes a few microseconds even for meshes of
+ * 100k triangles.
+ *
+ * The tree references the vertices of the mesh it has been built from,
+ * which must outlive it. Immutable once built: can be used from any thread.
+ */
+class MSVBVH {
+  public:
+    /** Intersection of a ray with a triangle */
+    struct Hit {
+      /** Index of the face in the mesh */
+      unsigned int face;
+      /** Distance along the ray, in units of its direction */
+      float t;
+      /** Barycentric coordinates of the second and third vertices */
+      float u;
+      float v;
+    };
+
+    /** Builds the tree of `nFaces` triangles.
+     * @param vertices the vertex positions, 3 per vertex.
+     * @param faces the vertex indices, 3 per face, as stored by MSVMesh.
+     */
+    MSVBVH(const float *vertices, unsigned int nFaces, const float *faces);
+    ~MSVBVH();
+
+    /** Finds the nearest triangle crossed by a ray.
+     * @param origin the origin of the ray.
+     * @param dir the direction of the ray, not necessarily normalized.
+     * @param cull 1 to ignore the triangles seen from behind, i.e. whose
+     * vertices are clockwise when looking along the ray, -1 to ignore the
+     * ones seen from the front, 0 to keep both.
+     * @param maxT hits farther than `maxT` are ignored.
+     * @return false if the ray hits no triangle.
+     */
+    bool intersect(const float origin[3],
+                   const float dir[3],
+                   int cull,
+                   float maxT,
+                   Hit *hit) const;
+
+    unsigned int getNodesCount() const;
+    /** Size of the tree in memory, in bytes */
+    size_t getSize() const;
+
+  private:
+    /** Inner nodes have 2 children, at `first` and `first + 1`. Leaves
+     * have `count` triangles, from `first` in `tris`.
+     */
+    struct Node {
+      float min[3];
+      unsigned int first;
+      float max[3];
+      unsigned int count;
+    };
+
+    const float *vertices;
+    Node *nodes;
+    unsigned int nNodes;
+    /** Vertex indices of the triangles, in leaf order */
+    unsigned int *tris;
+    /** Index in the mesh of each triangle of `tris` */
+    unsigned int *faceIds;
+    unsigned int nTris;
+
+    void build(const float *faces);
+    bool intersectTriangle(unsigned int i,
+                           const float origin[3],
+                           const float dir[3],
+                           int cull,
+                           Hit *hit) const;
+    static bool intersectBox(const Node *node,
+                             const float origin[3],
+                             const float invDir[3],
+                             float maxT,
+                             float *tNear);
+};
+
+#endif
@@ -0,0 +1,3 @@
+#include "MSVBackend.h"
+
+MSVBackend::~MSVBackend() {}
@@ -0,0 +1,95 @@
+#ifndef MSV_BACKEND_H
+#define MSV_BACKEND_H
+
+class MSVCallback;
+class MSVFrame;
+
+/** Abstract interface to the camera, the tracker and the tracking state.
+ *
+ * The core classes (MSVController, MSVTracker, MSVCamera, MSVRenderer) only
+ * talk to the tracking SDK through this interface. MSVVuforiaBackend is the
+ * implementation used on devices, and MSVSimulatedBackend allows running the
+ * whole pipeline without a camera nor the Vuforia SDK.
+ */
+class MSVBackend {
+  public:
+    /** A video mode of the camera */
+    struct VideoMode {
+      int width;
+      int height;
+      /** Nominal frame rate, or 0 if unknown */
+      float frameRate;
+    };
+
+    virtual ~MSVBackend();
+
+    /* Camera */
+
+    /** Initializes the camera, making its video modes available.
+     * @return false if the camera could not be initialized.
+     */
+    virtual bool initCamera() = 0;
+    /** Returns the number of video modes of the initialized camera */
+    virtual int getVideoModeCount() = 0;
+    /** Gets a video mode of the initialized camera.
+     * @param index the mode index, in [0, getVideoModeCount()[.
+     */
+    virtual void getVideoMode(int index, VideoMode *mode) = 0;
+    /** Selects a video mode and starts the initialized camera. See
+     * MSVCamera::start for the choice of the mode.
+     * @return false if the camera could not be started.
+     */
+    virtual bool startCamera(int mode) = 0;
+    /** Stops and de-initializes the camera */
+    virtual void stopCamera() = 0;
+    /** Gets the size of the camera frames, i.e. of the selected video mode */
+    virtual void getVideoSize(int *width, int *height) = 0;
+    /** Computes the OpenGL projection matrix of the camera.
+     * @param nearPlane the near clipping plane distance.
+     * @param farPlane the far clipping plane distance.
+     * @param matrix filled with the 4x4 column-major projection matrix.
+     */
+    virtual void getProjectionMatrix(float nearPlane,
+                                     float farPlane,
+                                     float matrix[16]) = 0;
+
+    /* Tracker */
+
+    /** Initializes the tracker */
+    virtual void initTracker() = 0;
+    /** De-initializes the tracker, destroying all its datasets */
+    virtual void deinitTracker() = 0;
+    /** Loads a bundled dataset. See MSVController::addDataset */
+    virtual void addDataset(const char *dataset) = 0;
+    /** Checks that the name/dataset pair exists */
+    virtual bool hasTarget(const char *name,
+                           const char *dataset) = 0;
+    /** Activates the given dataset and starts tracking */
+    virtual void startTracker(const char *dataset) = 0;
+    /** Deactivates the active dataset, if any, and stops tracking */
+    virtual void stopTracker() = 0;
+
+    /* State */
+
+    /** Returns true if the GL surface needs an alpha channel */
+    virtual bool requiresAlpha() = 0;
+    /** Sets the callback to notify with each new camera frame, through
+     * MSVCallback::onFrame. May be NULL.
+     */
+    virtual void setCallback(MSVCallback *cb) = 0;
+    /** Adapts the camera background of the selected video mode to the GL
+     * view. Called from GL thread.
+     */
+    virtual void configureVideoBackground(int glWidth,
+                                          int glHeight,
+                                          bool portrait) = 0;
+    /** Marks the beginning of a rendering section: draws the camera
+     * background, and fills `frame` with the current tracking state. Its
+     * `projection` field is left untouched. Called from GL thread.
+     */
+    virtual void beginRender(MSVFrame *frame) = 0;
+    /** Marks the end of the rendering section */
+    virtual void endRender() = 0;
+};
+
+#endif
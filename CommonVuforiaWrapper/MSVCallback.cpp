@@ -1,46 +1,75 @@
 #include "MSVCallback.h"
+#include "MSVCamera.h"
 #include "MSVController.h"
+#include "MSVEpoch.h"
+#include "MSVFrame.h"
+#include "MSVGovernor.h"
+#include "MSVRecorder.h"
+#include "MSVRedraw.h"
+#include "MSVTargetInfo.h"
+#include "MSVTrace.h"
 
 #include <assert.h>
 #include <string.h>
 
 MSVCallback::MSVCallback() :
-imgIndex(-1),
 currentFrame(NULL),
 needUpdate(true),
 wasTracking(false),
 isNew(false),
 isLost(false),
-lostCounter(0)
-{};
+lostCounter(0),
+session(0),
+skippedFrames(0)
+{
+  memset(&status, 0, sizeof(status));
+};
 
 MSVCallback::~MSVCallback() {}
 
 void
 MSVCallback::QCAR_onUpdate(QCAR::State &state)
 {
+  MSV_TRACE_SCOPE("QCAR_onUpdate");
+  MSVFrame frame;
+  frame.set(state);
+  onFrame(frame);
+}
+
+void
+MSVCallback::onFrame(const MSVFrame &frame)
+{
+  MSVCamera::onFrame();
+  MSVRecorder::recordFrame(frame);
+  MSVRedraw::invalidate(MSVRedraw::CAMERA_FRAME);
+  // A lingering target found again: report it without waiting for a scan
+  if (MSVController::updateLinger(frame)) needUpdate = true;
+  // Under load, only process one frame out of `scanInterval`
+  if (++skippedFrames < MSVGovernor::getSettings()->scanInterval) return;
+  skippedFrames = 0;
   // Store frame
   if (needUpdate) {
+    MSVEpoch::enter(MSVEpoch::READER_UPDATE);
     needUpdate = false;
     isNew = false;
     isLost = false;
-    if (imgIndex < 0) {
-      for (int i = 0; i < state.getFrame().getNumImages(); ++i) {
-        if (state.getFrame().getImage(i)->getFormat() == QCAR::GRAYSCALE) {
-          imgIndex = i;
-          break;
-        }
-      }
-    }
-    currentFrame = state.getFrame().getImage(imgIndex);
-    if (MSVController::isTracking()) {
-      if (!wasTracking) {
+    currentFrame = frame.image;
+    bool tracking = MSVController::isTracking();
+    const MSVTargetInfo *info = NULL;
+    int found = -1;
+    if (tracking) {
+      info = MSVController::getCurrentTarget();
+      found = MSVController::currentTargetFound(frame, info);
+      unsigned int s = MSVController::getTrackingSession();
+      if (!wasTracking || s != session) {
         wasTracking = true;
-        isNew = true;
+        // A lingering target resumes in the same session: it is not new
+        isNew = (s != session);
+        session = s;
         lostCounter = 0;
       }
       else {
-        if (MSVController::currentTargetFound(state) < 0) {
+        if (found < 0) {
           if (lostCounter >= 0) lostCounter++;
           if (lostCounter > LOST_FRAMES_TOL || lostCounter < 0) isLost = true;
         }
@@ -50,10 +79,15 @@ MSVCallback::QCAR_onUpdate(QCAR::State &state)
     else {
       if (wasTracking) wasTracking = false;
     }
+    updateStatus(frame, tracking, info, found);
     // Callback
-    onStatusUpdate();
+    {
+      MSV_TRACE_SCOPE("onStatusUpdate");
+      onStatusUpdate();
+    }
     // Reset currentFrame to avoid calling it outside of onStatusUpdate
     currentFrame = NULL;
+    MSVEpoch::leave(MSVEpoch::READER_UPDATE);
   }
 }
 
@@ -84,3 +118,43 @@ MSVCallback::isTargetLost() const
 {
   return isLost;
 }
+
+const MSVCallback::Status *
+MSVCallback::getStatus() const
+{
+  return &status;
+}
+
+void
+MSVCallback::updateStatus(const MSVFrame &frame,
+                          bool tracking,
+                          const MSVTargetInfo *info,
+                          int found)
+{
+  status.timestamp = frame.timestamp;
+  status.frame = frame.index;
+  status.flags = 0;
+  if (tracking) status.flags |= TRACKING;
+  if (isNew) status.flags |= NEW_TARGET;
+  if (isLost) status.flags |= TARGET_LOST;
+  if (found >= 0) status.flags |= TARGET_FOUND;
+  if (MSVController::isModelRestored()) status.flags |= MODEL_RESTORED;
+  if (currentFrame) status.flags |= FRAME;
+  if (info) {
+    status.session = session;
+    status.width = info->getWidth();
+    status.height = info->getHeight();
+    strncpy(status.name, info->getName(), MAX_TRACKABLE_NAME - 1);
+    status.name[MAX_TRACKABLE_NAME - 1] = '\0';
+  }
+  else {
+    status.session = 0;
+    status.width = 0;
+    status.height = 0;
+    status.name[0] = '\0';
+  }
+  if (found >= 0)
+    memcpy(status.pose, frame.results[found].pose, sizeof(status.pose));
+  else
+    memset(status.pose, 0, sizeof(status.pose));
+}
@@ -4,6 +4,8 @@
 #include <QCAR/UpdateCallback.h>
 #include <QCAR/Image.h>
 
+#include "MSVFrame.h"
+
 #define LOST_FRAMES_TOL 15
 
 class MSVTargetInfo;
@@ -16,12 +18,54 @@ class MSVTargetInfo;
 class MSVCallback : public QCAR::UpdateCallback
 {
   public:
+    /** Flags of a Status */
+    enum StatusFlag {
+      TRACKING       = 1 << 0,
+      NEW_TARGET     = 1 << 1,
+      TARGET_LOST    = 1 << 2,
+      /** The target is in the frame, at `pose` */
+      TARGET_FOUND   = 1 << 3,
+      MODEL_RESTORED = 1 << 4,
+      /** The camera frame can be fetched with `getFrame()` */
+      FRAME          = 1 << 5
+    };
+
+    /** Snapshot of the state reported to `onStatusUpdate`, written once
+     * per update right before it is called. Plain data with a fixed layout,
+     * so that bindings can share it as is (the Android one wraps it in a
+     * direct ByteBuffer) instead of making a call per query.
+     */
+    struct Status {
+      /** QCAR timestamp of the camera frame, in seconds */
+      double timestamp;
+      /** QCAR index of the camera frame */
+      int frame;
+      /** Combination of StatusFlag values */
+      unsigned int flags;
+      /** Tracking session of the target, 0 if not tracking (see
+       * MSVController::getTrackingSession)
+       */
+      unsigned int session;
+      /** Dimensions of the target */
+      int width;
+      int height;
+      /** 3x4 row-major pose of the target, if TARGET_FOUND */
+      float pose[12];
+      /** Name of the target, empty if not tracking */
+      char name[MAX_TRACKABLE_NAME];
+    };
+
     MSVCallback();
     virtual ~MSVCallback();
 
     /** Implementation of QCAR::UpdateCallback */
     void QCAR_onUpdate(QCAR::State& state);
 
+    /** Processes a frame extracted from a QCAR::State, or replayed from a
+     * recorded session (see MSVReplay).
+     */
+    void onFrame(const MSVFrame &frame);
+
     /** Requires a new call to `onStatusUpdate` as soon as possible */
     void requireUpdate();
 
@@ -44,6 +88,12 @@ class MSVCallback : public QCAR::UpdateCallback
      */
     bool isTargetLost() const;
 
+    /** Returns the status of the latest update. Its content is only
+     * consistent inside `onStatusUpdate`, after which it may be rewritten
+     * at any time by the next update.
+     */
+    const Status *getStatus() const;
+
   protected:
     /** Virtual method that will get called each time `requireUpdate()`
      * is called. It should be used to take actions depending on the
@@ -58,7 +108,6 @@ class MSVCallback : public QCAR::UpdateCallback
     virtual void getFrame(const QCAR::Image *frame) const = 0;
 
   private:
-    int imgIndex;
     const QCAR::Image *currentFrame;
     bool needUpdate;
     bool wasTracking;
@@ -73,6 +122,23 @@ class MSVCallback : public QCAR::UpdateCallback
      * be able to find the target.
      */
     int lostCounter;
+
+    /* Tracking session of the current target, to tell a new target from a
+     * lingering one that resumes (see MSVController::suspendTracking).
+     */
+    unsigned int session;
+
+    /* Camera frames received since the last status update, to space the
+     * updates as the MSVGovernor quality level requires.
+     */
+    int skippedFrames;
+
+    Status status;
+
+    void updateStatus(const MSVFrame &frame,
+                      bool tracking,
+                      const MSVTargetInfo *info,
+                      int found);
 };
 
 #endif
@@ -1,23 +1,48 @@
+#include "MSVBackend.h"
 #include "MSVCamera.h"
-#include "MSVState.h"
+#include "MSVController.h"
 
-#include <QCAR/CameraDevice.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Frames skipped after starting a mode, while the camera settles */
+#define BENCH_WARMUP_FRAMES  5
+/* Frames measured per mode */
+#define BENCH_FRAMES         30
+/* Maximal duration of each benchmark phase, in seconds */
+#define BENCH_TIMEOUT        2.0
+/* Maximal length of a cache line */
+#define PROFILE_LINE         256
+
+char *MSVCamera::cachePath = NULL;
+char *MSVCamera::cacheDevice = NULL;
+volatile unsigned int MSVCamera::frames = 0;
+
+/* Returns true if mode `a` is a better candidate than mode `b` */
+static bool
+isBetter(const MSVBackend::VideoMode &a, const MSVBackend::VideoMode &b)
+{
+  bool slowA = a.frameRate > 0 && a.frameRate < CAM_MIN_FPS;
+  bool slowB = b.frameRate > 0 && b.frameRate < CAM_MIN_FPS;
+  if (slowA != slowB) return slowB;
+  int pixelsA = a.width * a.height;
+  int pixelsB = b.width * b.height;
+  if (pixelsA != pixelsB) return pixelsA < pixelsB;
+  return a.frameRate > b.frameRate;
+}
 
 bool
 MSVCamera::start()
 {
-  // Initialize the camera:
-  if (!QCAR::CameraDevice::getInstance().init()) return false;
-  // Set video mode
-  if (!QCAR::CameraDevice::getInstance().selectVideoMode(CAM_QUALITY)) return false;
-  // Check that the frame resolution fits the Moodstocks SDK requirements, i.e.
-  // its largest dimensions is >= 480 pixels.
-  QCAR::VideoMode mode = QCAR::CameraDevice::getInstance().getVideoMode(CAM_QUALITY);
-  if (!(mode.mWidth >= 480 || mode.mHeight >= 480)) return false;
-  // Start the camera:
-  if (!QCAR::CameraDevice::getInstance().start()) return false;
-  if (!QCAR::CameraDevice::getInstance().setFocusMode(QCAR::CameraDevice::FOCUS_MODE_CONTINUOUSAUTO)) {
-    QCAR::CameraDevice::getInstance().setFocusMode(QCAR::CameraDevice::FOCUS_MODE_NORMAL);
+  MSVBackend *backend = MSVController::getBackend();
+  if (!backend->initCamera()) return false;
+  int mode = selectMode();
+  if (mode < 0 || !backend->startCamera(mode)) {
+    backend->stopCamera();
+    return false;
   }
   return true;
 }
@@ -25,6 +50,163 @@ MSVCamera::start()
 void
 MSVCamera::stop()
 {
-  QCAR::CameraDevice::getInstance().stop();
-  QCAR::CameraDevice::getInstance().deinit();
+  MSVController::getBackend()->stopCamera();
+}
+
+void
+MSVCamera::setProfileCache(const char *path, const char *device)
+{
+  free(cachePath);
+  free(cacheDevice);
+  cachePath = (path && device) ? strdup(path) : NULL;
+  cacheDevice = (path && device) ? strdup(device) : NULL;
+}
+
+void
+MSVCamera::onFrame()
+{
+  __sync_fetch_and_add(&frames, 1);
+}
+
+int
+MSVCamera::selectMode()
+{
+  // A previous benchmark on this device model already made the choice
+  int width, height;
+  if (cachePath && loadProfile(&width, &height)) {
+    int mode = findMode(width, height);
+    if (mode >= 0) return mode;
+  }
+
+  // Sort the modes fitting the requirements, best first
+  MSVBackend *backend = MSVController::getBackend();
+  int count = backend->getVideoModeCount();
+  if (count > CAM_MAX_MODES) count = CAM_MAX_MODES;
+  MSVBackend::VideoMode modes[CAM_MAX_MODES];
+  int candidates[CAM_MAX_MODES];
+  int n = 0;
+  for (int i = 0; i < count; ++i) {
+    MSVBackend::VideoMode *m = &modes[i];
+    backend->getVideoMode(i, m);
+    if (m->width < CAM_MIN_SIZE && m->height < CAM_MIN_SIZE) continue;
+    int j = n++;
+    for (; j > 0 && isBetter(*m, modes[candidates[j-1]]); --j) {
+      candidates[j] = candidates[j-1];
+    }
+    candidates[j] = i;
+  }
+  if (!n) return -1;
+  if (!cachePath || n == 1) return candidates[0];
+  return benchmark(candidates, n);
+}
+
+int
+MSVCamera::benchmark(const int *candidates, int count)
+{
+  MSVBackend *backend = MSVController::getBackend();
+  int best = candidates[0];
+  double bestRate = 0;
+  for (int i = 0; i < count; ++i) {
+    double rate = 0;
+    if (backend->startCamera(candidates[i])) {
+      unsigned int first = frames;
+      double t0 = now();
+      while (frames - first < BENCH_WARMUP_FRAMES && now() - t0 < BENCH_TIMEOUT) {
+        usleep(10000);
+      }
+      first = frames;
+      t0 = now();
+      double t = t0;
+      while (frames - first < BENCH_FRAMES && t - t0 < BENCH_TIMEOUT) {
+        usleep(10000);
+        t = now();
+      }
+      rate = (frames - first) / (t - t0);
+    }
+    // The selected mode is started again by `start`
+    backend->stopCamera();
+    if (!backend->initCamera()) return -1;
+    if (rate > bestRate) {
+      best = candidates[i];
+      bestRate = rate;
+    }
+    // Candidates are sorted: stop at the first one fast enough
+    if (rate >= CAM_MIN_FPS) break;
+  }
+  // No frame at all: no callback to count them, the result is meaningless
+  if (bestRate <= 0) return candidates[0];
+  MSVBackend::VideoMode m;
+  backend->getVideoMode(best, &m);
+  storeProfile(m.width, m.height);
+  return best;
+}
+
+int
+MSVCamera::findMode(int width, int height)
+{
+  MSVBackend *backend = MSVController::getBackend();
+  int count = backend->getVideoModeCount();
+  for (int i = 0; i < count; ++i) {
+    MSVBackend::VideoMode m;
+    backend->getVideoMode(i, &m);
+    if (m.width == width && m.height == height) return i;
+  }
+  return -1;
+}
+
+bool
+MSVCamera::loadProfile(int *width, int *height)
+{
+  FILE *f = fopen(cachePath, "r");
+  if (!f) return false;
+  // One "<width> <height> <device>" line per device model
+  char line[PROFILE_LINE];
+  bool found = false;
+  while (!found && fgets(line, PROFILE_LINE, f)) {
+    int len = 0;
+    if (sscanf(line, "%d %d %n", width, height, &len) < 2 || !len) continue;
+    line[strcspn(line, "\n")] = '\0';
+    found = !strcmp(line + len, cacheDevice);
+  }
+  fclose(f);
+  return found;
+}
+
+void
+MSVCamera::storeProfile(int width, int height)
+{
+  // Keep the lines of the other device models
+  char *others = NULL;
+  size_t size = 0;
+  FILE *f = fopen(cachePath, "r");
+  if (f) {
+    char line[PROFILE_LINE];
+    while (fgets(line, PROFILE_LINE, f)) {
+      int w, h, len = 0;
+      if (sscanf(line, "%d %d %n", &w, &h, &len) < 2 || !len) continue;
+      size_t l = strcspn(line, "\n");
+      line[l] = '\0';
+      if (!strcmp(line + len, cacheDevice)) continue;
+      others = (char *)realloc(others, size + l + 1);
+      memcpy(others + size, line, l);
+      others[size + l] = '\n';
+      size += l + 1;
+    }
+    fclose(f);
+  }
+  f = fopen(cachePath, "w");
+  if (f) {
+    if (size) fwrite(others, 1, size, f);
+    fprintf(f, "%d %d %s\n", width, height, cacheDevice);
+    fclose(f);
+  }
+  free(others);
+}
+
+double
+MSVCamera::now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
 }
@@ -1,11 +1,60 @@
 #ifndef MSV_CAMERA_H
 #define MSV_CAMERA_H
 
-/** Helper class around QCAR::CameraDevice */
+/** Minimal size of the largest dimension of the camera frames required by
+ * the Moodstocks SDK, in pixels.
+ */
+#define CAM_MIN_SIZE        480
+/** Frame rate below which a video mode is only used as a last resort */
+#define CAM_MIN_FPS         24
+/** Maximal number of video modes considered */
+#define CAM_MAX_MODES       32
+
+/** Helper class around the camera of the current MSVBackend.
+ *
+ * Larger camera frames cost more to copy, gate and scan, without improving
+ * recognition once the Moodstocks SDK requirements are met. `start` thus
+ * selects the smallest video mode whose largest dimension is at least
+ * CAM_MIN_SIZE, preferring the modes reaching CAM_MIN_FPS.
+ *
+ * The nominal frame rate of a mode is not always the one delivered: some
+ * devices crop or bin their smallest modes at a lower rate. If a profile
+ * cache is set, the candidate modes are benchmarked the first time the
+ * camera starts on a device model, and the choice is cached for later
+ * starts.
+ */
 class MSVCamera {
   public:
+    /** Selects a video mode, and starts the camera.
+     * @return false if the camera could not be started, or if none of its
+     * video modes fits the Moodstocks SDK requirements.
+     */
     static bool start();
     static void stop();
+
+    /** Enables the benchmark of the video modes, and the cache of its
+     * result. The benchmark blocks `start` for up to a few seconds, and
+     * needs a callback to be registered (see MSVController::init).
+     * @param path the cache file, or NULL to disable the benchmark
+     * (default).
+     * @param device the device model, used as cache key.
+     */
+    static void setProfileCache(const char *path, const char *device);
+
+    /** Called by MSVCallback with each camera frame */
+    static void onFrame();
+
+  private:
+    static char *cachePath;
+    static char *cacheDevice;
+    static volatile unsigned int frames;
+
+    static int selectMode();
+    static int benchmark(const int *candidates, int count);
+    static int findMode(int width, int height);
+    static bool loadProfile(int *width, int *height);
+    static void storeProfile(int width, int height);
+    static double now();
 };
 
 #endif
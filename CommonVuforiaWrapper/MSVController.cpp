@@ -1,28 +1,61 @@
+#include "MSVBackend.h"
 #include "MSVCallback.h"
 #include "MSVController.h"
+#include "MSVEpoch.h"
+#include "MSVFrame.h"
+#include "MSVMesh.h"
+#include "MSVModel.h"
+#include "MSVModelCache.h"
+#include "MSVRecorder.h"
+#include "MSVRedraw.h"
 #include "MSVRenderer.h"
 #include "MSVState.h"
 #include "MSVTargetInfo.h"
+#include "MSVTexture.h"
+#include "MSVTrace.h"
 #include "MSVTracker.h"
+#include "MSVWhichOS.h"
+
+#if (defined(__MSV_SYS_HOST__))
+#include "MSVSimulatedBackend.h"
+#else
+#include "MSVVuforiaBackend.h"
+#endif
 
 #include <math.h>
 #include <string.h>
-
-#include <QCAR/QCAR.h>
-#include <QCAR/TrackableResult.h>
+#include <time.h>
 
 // Initialize static variables
+MSVBackend *MSVController::ms_Backend = NULL;
 MSVRenderer *MSVController::ms_Renderer = NULL;
 MSVTracker *MSVController::ms_Tracker = NULL;
 MSVCallback *MSVController::ms_Callback = NULL;
 
-bool MSVController::tracking = false;
-MSVTargetInfo *MSVController::currentInfo = NULL;
+volatile bool MSVController::tracking = false;
+MSVTargetInfo * volatile MSVController::currentInfo = NULL;
+pthread_mutex_t MSVController::writeLock = PTHREAD_MUTEX_INITIALIZER;
+
+char *MSVController::currentDataset = NULL;
+float MSVController::lingerTime = 0;
+double MSVController::lingerDeadline = 0;
+volatile bool MSVController::lingering = false;
+volatile unsigned int MSVController::session = 0;
+volatile bool MSVController::modelRestored = false;
+unsigned int MSVController::modelTicket = 0;
+unsigned int MSVController::ticketSession = 0;
+
+void
+MSVController::setBackend(MSVBackend *backend)
+{
+  if (MSVController::ms_Backend) delete MSVController::ms_Backend;
+  MSVController::ms_Backend = backend;
+}
 
 void
 MSVController::init()
 {
-  MSVController::ms_Tracker  = new MSVTracker();
+  MSVController::ms_Tracker  = new MSVTracker(getBackend());
 }
 
 bool
@@ -30,7 +63,7 @@ MSVController::registerCallback(MSVCallback *cb)
 {
   if (MSVController::ms_Callback) return false;
   MSVController::ms_Callback = cb;
-  QCAR::registerCallback(cb);
+  getBackend()->setCallback(cb);
   return true;
 }
 
@@ -40,7 +73,7 @@ MSVController::unregisterCallback()
   if (!MSVController::ms_Callback) return NULL;
   MSVCallback *cb = MSVController::ms_Callback;
   MSVController::ms_Callback = NULL;
-  QCAR::registerCallback(NULL);
+  getBackend()->setCallback(NULL);
   return cb;
 }
 
@@ -57,6 +90,24 @@ MSVController::deInit()
   MSVController::ms_Renderer = NULL;
   delete MSVController::ms_Tracker;
   MSVController::ms_Tracker = NULL;
+  MSVModelCache::clear();
+  MSVEpoch::reclaimAll();
+  delete MSVController::ms_Backend;
+  MSVController::ms_Backend = NULL;
+  MSVRedraw::setListener(NULL);
+}
+
+MSVBackend *
+MSVController::getBackend()
+{
+  if (!MSVController::ms_Backend) {
+#if (defined(__MSV_SYS_HOST__))
+    MSVController::ms_Backend = new MSVSimulatedBackend();
+#else
+    MSVController::ms_Backend = new MSVVuforiaBackend();
+#endif
+  }
+  return MSVController::ms_Backend;
 }
 
 MSVRenderer *
@@ -88,31 +139,128 @@ MSVController::startTracking(const char *name,
                              const int dims[2],
                              const char *dataset)
 {
+  pthread_mutex_lock(&writeLock);
   if (tracking)
     goto fail;
+  if (lingering) {
+    // The lingering target is recognized again: resume it as is
+    if (!strcmp(currentInfo->getName(), name) && !strcmp(currentDataset, dataset)) {
+      lingering = false;
+      tracking = true;
+      pthread_mutex_unlock(&writeLock);
+      return;
+    }
+    stopTrackingLocked();
+  }
   if (!ms_Tracker->has(name, dataset))
     goto fail;
   tracking = true;
-  if (currentInfo) delete currentInfo;
-  currentInfo = new MSVTargetInfo(name, dims);
+  session++;
+  currentDataset = strdup(dataset);
+  {
+    MSVTargetInfo *info = new MSVTargetInfo(name, dims);
+    // Restore the model built the last time this target was tracked
+    MSVModel *model;
+    float scale[3];
+    modelRestored = MSVModelCache::get(name, dataset, &model, scale);
+    if (modelRestored) {
+      info->setStatic(model);
+      info->changeScale(scale);
+    }
+    publish(info);
+  }
   ms_Tracker->start(dataset);
+  pthread_mutex_unlock(&writeLock);
   return;
 fail:
-  stopTracking();
+  stopTrackingLocked();
+  pthread_mutex_unlock(&writeLock);
 }
 
 void
 MSVController::stopTracking()
 {
-  tracking = false;
-  if (currentInfo) {
-    if (currentInfo->isDynamicTarget()) {
-      currentInfo->getDynamicTextureCallback()->stop();
+  pthread_mutex_lock(&writeLock);
+  stopTrackingLocked();
+  pthread_mutex_unlock(&writeLock);
+}
+
+void
+MSVController::suspendTracking()
+{
+  pthread_mutex_lock(&writeLock);
+  if (tracking && currentInfo && lingerTime > 0) {
+    lingerDeadline = now() + lingerTime;
+    lingering = true;
+    tracking = false;
+  }
+  else if (!lingering) {
+    stopTrackingLocked();
+  }
+  pthread_mutex_unlock(&writeLock);
+}
+
+void
+MSVController::setLingerTime(float seconds)
+{
+  pthread_mutex_lock(&writeLock);
+  lingerTime = seconds > 0 ? seconds : 0;
+  if (lingering) lingerDeadline = now() + lingerTime;
+  pthread_mutex_unlock(&writeLock);
+}
+
+bool
+MSVController::isLingering()
+{
+  return lingering;
+}
+
+unsigned int
+MSVController::getTrackingSession()
+{
+  return session;
+}
+
+bool
+MSVController::updateLinger(const MSVFrame &frame)
+{
+  if (!lingering) return false;
+  // Never wait here: the writer may be stopping the tracker, which waits for
+  // the current update to complete. Simply retry with the next frame.
+  if (pthread_mutex_trylock(&writeLock)) return false;
+  bool resumed = false;
+  if (lingering) {
+    if (currentTargetFound(frame, currentInfo) >= 0) {
+      lingering = false;
+      tracking = true;
+      resumed = true;
+    }
+    else if (now() >= lingerDeadline) {
+      stopTrackingLocked();
     }
-    delete currentInfo;
   }
-  currentInfo = NULL;
+  pthread_mutex_unlock(&writeLock);
+  return resumed;
+}
+
+void
+MSVController::stopTrackingLocked()
+{
+  tracking = false;
+  lingering = false;
+  free(currentDataset);
+  currentDataset = NULL;
+  publish(NULL);
   ms_Tracker->stop();
+  MSVModelCache::unpin();
+}
+
+double
+MSVController::now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
 }
 
 void
@@ -120,41 +268,149 @@ MSVController::setStaticModel(MSVMesh *mesh,
                               MSVTexture *tex,
                               const float scale[3])
 {
-  if (!tracking) return;
-  if (!currentInfo) return;
-  currentInfo->setStatic(mesh, tex);
-  currentInfo->changeScale(scale);
+  bool empty = !mesh && !tex;
+  MSVModel *model = new MSVModel();
+  model->addPart(mesh, tex);
+  setModel(model, scale, !empty, 0);
+}
+
+void
+MSVController::setModel(MSVModel *model, const float scale[3])
+{
+  setModel(model, scale, true, 0);
+}
+
+unsigned int
+MSVController::reserveModel()
+{
+  pthread_mutex_lock(&writeLock);
+  // 0 stands for no ticket
+  if (!++modelTicket) modelTicket++;
+  unsigned int ticket = modelTicket;
+  ticketSession = session;
+  pthread_mutex_unlock(&writeLock);
+  return ticket;
+}
+
+void
+MSVController::setReservedModel(MSVModel *model,
+                                const float scale[3],
+                                unsigned int ticket,
+                                bool cache)
+{
+  setModel(model, scale, cache, ticket);
+}
+
+void
+MSVController::setModel(MSVModel *model, const float scale[3], bool cache,
+                        unsigned int ticket)
+{
+  // Merged and sorted out of the lock, as it may take a while
+  model->build();
+  pthread_mutex_lock(&writeLock);
+  // A model set right away outdates the reserved ones
+  bool current = ticket ? ticket == modelTicket && ticketSession == session : true;
+  if (!ticket) modelTicket++;
+  const MSVTargetInfo *cur = currentInfo;
+  if (current && tracking && cur) {
+    int dims[2] = {cur->getWidth(), cur->getHeight()};
+    MSVTargetInfo *next = new MSVTargetInfo(cur->getName(), dims);
+    bool cached = cache && MSVModelCache::getBudget() > 0;
+    next->setStatic(model);
+    next->changeScale(scale);
+    publish(next);
+    if (cached) {
+      MSVModelCache::put(next->getName(), currentDataset, model, scale);
+    }
+  }
+  else {
+    model->release();
+  }
+  pthread_mutex_unlock(&writeLock);
 }
 
 void
 MSVController::setDynamicModel(MSVTextureCallback *cb,
                                const float scale[3])
 {
-  if (!tracking) return;
-  if (!currentInfo) return;
-  currentInfo->setDynamic(cb);
-  currentInfo->changeScale(scale);
+  pthread_mutex_lock(&writeLock);
+  modelTicket++;
+  const MSVTargetInfo *cur = currentInfo;
+  if (tracking && cur) {
+    int dims[2] = {cur->getWidth(), cur->getHeight()};
+    MSVTargetInfo *next = new MSVTargetInfo(cur->getName(), dims);
+    next->setDynamic(cb);
+    next->changeScale(scale);
+    publish(next);
+    // Dynamic models are not cached: forget the previous static one
+    MSVModelCache::remove(next->getName(), currentDataset);
+  }
+  else {
+    delete cb;
+  }
+  pthread_mutex_unlock(&writeLock);
+}
+
+void
+MSVController::publish(MSVTargetInfo *info)
+{
+  // Releases the snapshot content to the readers: __sync_lock_test_and_set
+  // would only be an acquire barrier
+  MSVTargetInfo *old = __atomic_exchange_n(&currentInfo, info, __ATOMIC_SEQ_CST);
+  MSVRedraw::invalidate(MSVRedraw::MODEL_CHANGED);
+  if (!old) return;
+  // Stop the video right away, the callback itself is freed later
+  if (old->isDynamicTarget() && old->getDynamicTextureCallback()) {
+    old->getDynamicTextureCallback()->stop();
+  }
+  MSVEpoch::retire(old, MSVController::destroyInfo);
+}
+
+void
+MSVController::destroyInfo(void *info)
+{
+  delete (MSVTargetInfo *)info;
 }
 
 const MSVTargetInfo *
 MSVController::getCurrentTarget()
 {
-  return currentInfo;
+  // Ordered after the MSVEpoch::enter of the reader
+  return __atomic_load_n(&currentInfo, __ATOMIC_SEQ_CST);
 }
 
-int
-MSVController::currentTargetFound(QCAR::State &state)
+bool
+MSVController::copyCurrentTarget(char **name, int dims[2])
 {
-  int result = -1;
-  if (!currentInfo) return result;
-  for (int i = 0; i < state.getNumTrackableResults(); ++i) {
-    if ( !strcmp(state.getTrackableResult(0)->getTrackable().getName(),
-                 currentInfo->getName()) ) {
-      result = i;
-      break;
+  bool found = false;
+  pthread_mutex_lock(&writeLock);
+  const MSVTargetInfo *cur = currentInfo;
+  if (cur) {
+    if (name) *name = strdup(cur->getName());
+    if (dims) {
+      dims[0] = cur->getWidth();
+      dims[1] = cur->getHeight();
     }
+    found = true;
   }
-  return result;
+  pthread_mutex_unlock(&writeLock);
+  return found;
+}
+
+int
+MSVController::currentTargetFound(QCAR::State &state)
+{
+  MSVFrame frame;
+  frame.set(state);
+  return currentTargetFound(frame, getCurrentTarget());
+}
+
+int
+MSVController::currentTargetFound(const MSVFrame &frame,
+                                  const MSVTargetInfo *info)
+{
+  if (!info) return -1;
+  return frame.find(info->getName());
 }
 
 bool
@@ -169,3 +425,115 @@ MSVController::obtainTextureID()
   if (!ms_Renderer) return 0;
   return ms_Renderer->obtainTextureID();
 }
+
+bool
+MSVController::dumpTrace(const char *path)
+{
+  return MSV_TRACE_DUMP(path);
+}
+
+bool
+MSVController::startRecording(const char *path, bool compress)
+{
+  return MSVRecorder::start(path, compress);
+}
+
+void
+MSVController::stopRecording()
+{
+  MSVRecorder::stop();
+}
+
+bool
+MSVController::isModelRestored()
+{
+  return modelRestored;
+}
+
+void
+MSVController::setModelCacheBudget(size_t bytes)
+{
+  MSVModelCache::setBudget(bytes);
+}
+
+void
+MSVController::getModelCacheStats(MSVModelCache::Stats *stats)
+{
+  MSVModelCache::getStats(stats);
+}
+
+void
+MSVController::getRenderStats(MSVRenderer::Stats *stats)
+{
+  MSVRenderer::getStats(stats);
+}
+
+bool
+MSVController::startCapture(MSVFrameCapture::Consumer *consumer,
+                            float scale,
+                            unsigned int frames)
+{
+  return MSVFrameCapture::start(consumer, scale, frames);
+}
+
+void
+MSVController::stopCapture()
+{
+  MSVFrameCapture::stop();
+}
+
+void
+MSVController::getCaptureStats(MSVFrameCapture::Stats *stats)
+{
+  MSVFrameCapture::getStats(stats);
+}
+
+bool
+MSVController::hitTest(float x, float y, MSVRenderer::Hit *hit)
+{
+  MSVRenderer *renderer = MSVController::ms_Renderer;
+  return renderer ? renderer->hitTest(x, y, hit) : false;
+}
+
+void
+MSVController::setOverlayScale(float scale)
+{
+  MSVRenderer::setOverlayScale(scale);
+}
+
+float
+MSVController::getOverlayScale()
+{
+  return MSVRenderer::getOverlayScale();
+}
+
+void
+MSVController::setStereo(bool enabled, float ipd)
+{
+  MSVRenderer::setStereo(enabled, ipd);
+}
+
+bool
+MSVController::isStereo()
+{
+  return MSVRenderer::isStereo();
+}
+
+void
+MSVController::setAdaptiveQuality(bool enabled, float budget)
+{
+  MSVGovernor::setEnabled(enabled, budget);
+}
+
+int
+MSVController::getQualityLevel()
+{
+  return MSVGovernor::getLevel();
+}
+
+unsigned int
+MSVController::getQualityChanges(MSVGovernor::Change *changes,
+                                 unsigned int max)
+{
+  return MSVGovernor::copyChanges(changes, max);
+}
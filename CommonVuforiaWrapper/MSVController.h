@@ -1,15 +1,23 @@
 #ifndef MSV_CONTROLLER_H
 #define MSV_CONTROLLER_H
 
+#include <pthread.h>
 #include <stdlib.h>
 
 #include <QCAR/State.h>
 
-class MSVRenderer;
+#include "MSVFrameCapture.h"
+#include "MSVGovernor.h"
+#include "MSVModelCache.h"
+#include "MSVRenderer.h"
+
+class MSVBackend;
 class MSVTracker;
 class MSVTargetInfo;
 class MSVCallback;
+class MSVFrame;
 class MSVMesh;
+class MSVModel;
 class MSVTexture;
 class MSVTextureCallback;
 
@@ -17,6 +25,14 @@ class MSVTextureCallback;
 class MSVController {
 
   public:
+    /** Sets the backend providing the camera, tracker and state. Must be
+     * called before `init`. If never called, a MSVVuforiaBackend is used (a
+     * MSVSimulatedBackend on host builds).
+     * @param backend the backend to use. Its ownership is transferred to the
+     * MSVController, which deletes it in `deInit`.
+     */
+    static void setBackend(MSVBackend *backend);
+
     /** Initializes the non-rendering-related components */
     static void init();
 
@@ -70,28 +86,150 @@ class MSVController {
      */
     static void stopTracking();
 
+    /** Stops tracking a lost target, but keeps its dataset active and its
+     * MSVTargetInfo, model included, for the linger window (see
+     * `setLingerTime`). Meanwhile `isTracking` returns false so that
+     * scanning can resume. If the target is found again in a camera frame,
+     * or passed again to `startTracking`, tracking resumes instantly,
+     * without a new tracking session. Once the window has elapsed, this is
+     * equivalent to `stopTracking`.
+     */
+    static void suspendTracking();
+
+    /** Sets the duration of the linger window, in seconds. 0 (default)
+     * makes `suspendTracking` equivalent to `stopTracking`.
+     */
+    static void setLingerTime(float seconds);
+
+    /** Returns true during the linger window of a suspended target */
+    static bool isLingering();
+
+    /** Returns the number of tracking sessions started so far. It changes
+     * each time a new target starts being tracked, but not when a lingering
+     * target resumes.
+     */
+    static unsigned int getTrackingSession();
+
+    /** Resumes tracking if the lingering target is in the frame, or ends the
+     * linger window once elapsed. Called by MSVCallback with each frame.
+     * @return true if tracking has resumed.
+     */
+    static bool updateLinger(const MSVFrame &frame);
+
     /** Ask whether the Vuforia SDK is currently in tracking mode
      * @return true if the Vuforia SDK is tracking, false otherwise.
      */
     static bool isTracking();
 
-    /** Returns the MSVTargetInfo object corresponding to the target
+    /** Returns the MSVTargetInfo snapshot corresponding to the target
      * currently being tracked, if any.
+     * The returned object is immutable, and is only guaranteed to stay alive
+     * inside a read section (see MSVEpoch). Outside of the rendering and
+     * QCAR update threads, use `copyCurrentTarget` instead.
      */
     static const MSVTargetInfo *getCurrentTarget();
 
+    /** Copies the name and dimensions of the target currently being tracked.
+     * Can be called from any thread.
+     * @param name will be filled with a copy of the target name, that should
+     * be released using `free()`.
+     * @param dims will be filled with the target dimensions.
+     * @return true if a target is being tracked, false otherwise.
+     */
+    static bool copyCurrentTarget(char **name, int dims[2]);
+
+    /** Returns true if the model of the current target has been restored
+     * from the MSVModelCache by `startTracking`, so that it does not need to
+     * be built again.
+     */
+    static bool isModelRestored();
+
+    /** Sets the byte budget of the MSVModelCache, 0 disabling it */
+    static void setModelCacheBudget(size_t bytes);
+
+    /** Gets the MSVModelCache hit/miss statistics */
+    static void getModelCacheStats(MSVModelCache::Stats *stats);
+
+    /** Gets the number of meshes drawn and culled by the renderer */
+    static void getRenderStats(MSVRenderer::Stats *stats);
+
+    /** Starts capturing the rendered frames, see MSVFrameCapture::start */
+    static bool startCapture(MSVFrameCapture::Consumer *consumer,
+                             float scale = 1,
+                             unsigned int frames = 0);
+
+    /** Stops capturing the rendered frames */
+    static void stopCapture();
+
+    /** Gets the number of frames captured and dropped */
+    static void getCaptureStats(MSVFrameCapture::Stats *stats);
+
+    /** Finds the face of the tracked model displayed under a point of the
+     * view, e.g. to react to taps on a part of the model. Fast enough to be
+     * called on every touch move. See MSVRenderer::hitTest.
+     * @param x, y the point, in pixels from the top-left corner of the GL
+     * view.
+     * @return false if the model is not under the point.
+     */
+    static bool hitTest(float x, float y, MSVRenderer::Hit *hit);
+
+    /** Sets the resolution of the rendered model relative to the view, to
+     * save fill rate on high-density screens. See
+     * MSVRenderer::setOverlayScale.
+     */
+    static void setOverlayScale(float scale);
+    static float getOverlayScale();
+
+    /** Enables or disables side-by-side stereo rendering, for headset
+     * viewers. See MSVRenderer::setStereo.
+     */
+    static void setStereo(bool enabled, float ipd);
+    static bool isStereo();
+
     /** Changes the currently displayed model to a static mesh and texture.
-     * @param mesh the new MSVMesh to use, or NULL to use a plane. Its ownership
-     * is transferred to the MSVController.
-     * @param tex the new Texture to use. Its ownership is transferred to the
+     * @param mesh the new MSVMesh to use, or NULL to use a plane. Its
+     * reference is transferred to the MSVController.
+     * @param tex the new Texture to use. Its reference is transferred to the
      * MSVController.
+     * Both are deduplicated (see MSVAsset::intern): models sharing a mesh or
+     * a texture share its memory and GPU resources.
      * @param scale the scaling to apply to the mesh and texture at rendering
      *   time, formatted as {scale_x, scale_y, scale_z}.
+     * The model is kept in the MSVModelCache, to be restored the next time
+     * the target is tracked.
      */
     static void setStaticModel(MSVMesh *mesh,
                                MSVTexture *tex,
                                const float scale[3]);
 
+    /** Changes the currently displayed model to a static model made of
+     * several parts.
+     * @param model the new MSVModel to use, built (see MSVModel::build) if
+     * needed. Its reference is transferred to the MSVController.
+     * @param scale the scaling to apply to the whole model at rendering
+     *   time, formatted as {scale_x, scale_y, scale_z}.
+     * The model is kept in the MSVModelCache, to be restored the next time
+     * the target is tracked.
+     */
+    static void setModel(MSVModel *model, const float scale[3]);
+
+    /** Reserves the next model change, for a model whose loading completes
+     * later, e.g. once its textures are decoded (see MSVPendingModel).
+     * @return the ticket to pass to `setReservedModel`.
+     */
+    static unsigned int reserveModel();
+
+    /** Same as setModel, for the model reserved with `ticket`. The model is
+     * released instead if another model was set or reserved, or another
+     * tracking session started, since.
+     * @param cache false not to keep the model in the MSVModelCache, as for
+     * the plane of `setStaticModel(NULL, NULL, scale)`.
+     */
+    static void setReservedModel(MSVModel *model,
+                                 const float scale[3],
+                                 unsigned int ticket,
+                                 bool cache);
+
     /** Changes the currently displayed model to a plane with dynamic texture (for
      * example for video playback).
      * @param cb the `MSVTextureCallback` object to call for each frame. Its
@@ -110,7 +248,14 @@ class MSVController {
      */
     static int currentTargetFound(QCAR::State &state);
 
+    /** Same as above, using a MSVFrame and the given MSVTargetInfo snapshot
+     * instead of the current one.
+     */
+    static int currentTargetFound(const MSVFrame &frame,
+                                  const MSVTargetInfo *info);
+
     /** Accessors to the sub-components */
+    static MSVBackend *getBackend();
     static MSVRenderer *getRenderer();
     static MSVTracker *getTracker();
     static MSVCallback *getCallback();
@@ -121,13 +266,74 @@ class MSVController {
      */
     static int obtainTextureID();
 
+    /** Writes the zones recorded since startup in the Chrome trace event
+     * JSON format. Only available if compiled with `MSV_TRACE` defined.
+     * @param path the path of the file to write.
+     * @return true if the trace has been written, false otherwise.
+     */
+    static bool dumpTrace(const char *path);
+
+    /** Starts recording the camera frames, poses and projection matrices
+     * to a file that can be replayed with MSVReplay.
+     * @param path the path of the file to write.
+     * @param compress true to compress the camera frames.
+     * @return true if the recording started, false otherwise.
+     */
+    static bool startRecording(const char *path, bool compress);
+
+    /** Stops the current recording, if any */
+    static void stopRecording();
+
+    /** Enables or disables the adaptive quality governor (see MSVGovernor),
+     * which lowers the rendering and scanning quality when frames take
+     * longer than `budget` seconds.
+     */
+    static void setAdaptiveQuality(bool enabled, float budget = QUALITY_BUDGET);
+
+    /** Returns the current quality level, 0 being the full quality */
+    static int getQualityLevel();
+
+    /** Copies the latest quality level changes, oldest first.
+     * @return the number of changes copied, up to `max`.
+     */
+    static unsigned int getQualityChanges(MSVGovernor::Change *changes,
+                                          unsigned int max);
+
   private:
+    static MSVBackend *ms_Backend;
     static MSVRenderer *ms_Renderer;
     static MSVTracker *ms_Tracker;
     static MSVCallback *ms_Callback;
 
-    static bool tracking;
-    static MSVTargetInfo *currentInfo;
+    /* `currentInfo` is an immutable snapshot, read without locking by the
+     * rendering and QCAR threads. Writers build a new snapshot, publish it
+     * atomically and retire the previous one through MSVEpoch. `writeLock`
+     * only serializes writers against each other.
+     */
+    static volatile bool tracking;
+    static MSVTargetInfo * volatile currentInfo;
+    static pthread_mutex_t writeLock;
+
+    /* Linger state, see `suspendTracking`. Written under `writeLock`. */
+    static char *currentDataset;
+    static float lingerTime;
+    static double lingerDeadline;
+    static volatile bool lingering;
+    static volatile unsigned int session;
+    static volatile bool modelRestored;
+
+    /* Ticket of the latest model change, and session it was reserved in.
+     * Written under `writeLock`.
+     */
+    static unsigned int modelTicket;
+    static unsigned int ticketSession;
+
+    static void publish(MSVTargetInfo *info);
+    static void setModel(MSVModel *model, const float scale[3], bool cache,
+                         unsigned int ticket);
+    static void stopTrackingLocked();
+    static double now();
+    static void destroyInfo(void *info);
 
 };
 #endif
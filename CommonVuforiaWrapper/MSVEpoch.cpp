@@ -0,0 +1,87 @@
+#include "MSVEpoch.h"
+
+#include <limits.h>
+#include <stdlib.h>
+
+// Initialize static variables
+volatile unsigned int MSVEpoch::globalEpoch = 1;
+volatile unsigned int MSVEpoch::readers[MSVEpoch::READER_COUNT] = {0};
+MSVEpoch::Retired * volatile MSVEpoch::retired = NULL;
+
+void
+MSVEpoch::enter(Reader r)
+{
+  // Make the slot visible before any shared pointer is loaded
+  __atomic_store_n(&readers[r], __atomic_load_n(&globalEpoch, __ATOMIC_SEQ_CST),
+                   __ATOMIC_SEQ_CST);
+}
+
+void
+MSVEpoch::leave(Reader r)
+{
+  // Make sure all shared accesses are done before releasing the slot
+  __atomic_store_n(&readers[r], 0, __ATOMIC_RELEASE);
+}
+
+void
+MSVEpoch::retire(void *obj, Deleter del)
+{
+  if (!obj) return;
+  Retired *r = new Retired();
+  r->obj = obj;
+  r->del = del;
+  // Full barrier: the object has been unpublished before this point, so
+  // any reader entering with a greater epoch cannot see it.
+  r->epoch = __sync_fetch_and_add(&globalEpoch, 1);
+  push(r);
+}
+
+void
+MSVEpoch::reclaim()
+{
+  Retired *list = __sync_lock_test_and_set(&retired, (Retired *)NULL);
+  if (!list) return;
+  __sync_synchronize();
+
+  // Oldest epoch still observed by a reader
+  unsigned int oldest = UINT_MAX;
+  for (int i = 0; i < READER_COUNT; ++i) {
+    unsigned int e = __atomic_load_n(&readers[i], __ATOMIC_SEQ_CST);
+    if (e && e < oldest) oldest = e;
+  }
+
+  while (list) {
+    Retired *r = list;
+    list = list->next;
+    if (r->epoch < oldest) {
+      r->del(r->obj);
+      delete r;
+    }
+    else {
+      push(r);
+    }
+  }
+}
+
+void
+MSVEpoch::reclaimAll()
+{
+  Retired *list = __sync_lock_test_and_set(&retired, (Retired *)NULL);
+  __sync_synchronize();
+  while (list) {
+    Retired *r = list;
+    list = list->next;
+    r->del(r->obj);
+    delete r;
+  }
+}
+
+void
+MSVEpoch::push(Retired *r)
+{
+  Retired *head;
+  do {
+    head = __atomic_load_n(&retired, __ATOMIC_RELAXED);
+    r->next = head;
+  } while (!__sync_bool_compare_and_swap(&retired, head, r));
+}
@@ -0,0 +1,65 @@
+#ifndef MSV_EPOCH_H
+#define MSV_EPOCH_H
+
+/** Epoch-based deferred reclamation.
+ *
+ * Objects shared with the rendering thread (such as the MSVTargetInfo
+ * snapshot currently displayed) are never deleted by the thread replacing
+ * them. They are instead retired, and actually freed later by `reclaim()`,
+ * which is called from the GL thread once no reader can still hold a
+ * reference to them.
+ *
+ * Each kind of reader owns a slot, and must bracket its accesses to shared
+ * objects with `enter()` and `leave()`. These calls never block.
+ */
+class MSVEpoch {
+  public:
+    /** Reader slots. Each slot must only be used by one thread at a time. */
+    enum Reader {
+      READER_RENDER = 0,  // GL thread, in MSVRenderer::renderFrame
+      READER_UPDATE,      // QCAR thread, in MSVCallback::QCAR_onUpdate
+      READER_HIT_TEST,    // Any thread, in MSVRenderer::hitTest, serialized
+      READER_COUNT
+    };
+
+    /** Function used to free a retired object */
+    typedef void (*Deleter)(void *obj);
+
+    /** Marks the beginning of a read section for the given reader */
+    static void enter(Reader r);
+
+    /** Marks the end of a read section for the given reader */
+    static void leave(Reader r);
+
+    /** Retires an object that has been unpublished, so that it gets freed
+     * using `del` as soon as no reader can access it anymore.
+     * Can be called from any thread.
+     */
+    static void retire(void *obj, Deleter del);
+
+    /** Frees all the retired objects that can no longer be accessed.
+     * Must be called from the GL thread, outside of any read section.
+     */
+    static void reclaim();
+
+    /** Frees all the retired objects, regardless of the readers.
+     * Must only be called once all readers are stopped, e.g. on `deInit`.
+     */
+    static void reclaimAll();
+
+  private:
+    struct Retired {
+      void *obj;
+      Deleter del;
+      unsigned int epoch;
+      Retired *next;
+    };
+
+    static volatile unsigned int globalEpoch;
+    static volatile unsigned int readers[READER_COUNT];
+    static Retired * volatile retired;
+
+    static void push(Retired *r);
+};
+
+#endif
@@ -0,0 +1,121 @@
+#include "MSVFrame.h"
+
+#include <string.h>
+
+#include <QCAR/Frame.h>
+#include <QCAR/Trackable.h>
+#include <QCAR/TrackableResult.h>
+
+MSVFrame::MSVFrame() :
+timestamp(0),
+index(-1),
+image(NULL),
+resultCount(0)
+{
+  memset(projection, 0, 16*sizeof(float));
+}
+
+void
+MSVFrame::set(const QCAR::State &state)
+{
+  QCAR::Frame f = state.getFrame();
+  timestamp = f.getTimeStamp();
+  index = f.getIndex();
+  image = NULL;
+  for (int i = 0; i < f.getNumImages(); ++i) {
+    if (f.getImage(i)->getFormat() == QCAR::GRAYSCALE) {
+      image = f.getImage(i);
+      break;
+    }
+  }
+  resultCount = 0;
+  for (int i = 0; i < state.getNumTrackableResults(); ++i) {
+    if (resultCount == MAX_FRAME_RESULTS) break;
+    const QCAR::TrackableResult *r = state.getTrackableResult(i);
+    MSVFrameResult *res = &results[resultCount++];
+    strncpy(res->name, r->getTrackable().getName(), MAX_TRACKABLE_NAME - 1);
+    res->name[MAX_TRACKABLE_NAME - 1] = '\0';
+    memcpy(res->pose, r->getPose().data, 12*sizeof(float));
+  }
+}
+
+int
+MSVFrame::find(const char *name) const
+{
+  for (int i = 0; i < resultCount; ++i) {
+    if (!strcmp(results[i].name, name)) return i;
+  }
+  return -1;
+}
+
+MSVImage::MSVImage() :
+width(0),
+height(0),
+capacity(0),
+data(NULL)
+{}
+
+MSVImage::~MSVImage()
+{
+  if (data) delete [] data;
+}
+
+void
+MSVImage::resize(int width, int height)
+{
+  if (width*height > capacity) {
+    if (data) delete [] data;
+    capacity = width*height;
+    data = new unsigned char[capacity];
+  }
+  this->width = width;
+  this->height = height;
+}
+
+unsigned char *
+MSVImage::getData()
+{
+  return data;
+}
+
+int
+MSVImage::getWidth() const
+{
+  return width;
+}
+
+int
+MSVImage::getHeight() const
+{
+  return height;
+}
+
+int
+MSVImage::getBufferWidth() const
+{
+  return width;
+}
+
+int
+MSVImage::getBufferHeight() const
+{
+  return height;
+}
+
+int
+MSVImage::getStride() const
+{
+  return width;
+}
+
+QCAR::PIXEL_FORMAT
+MSVImage::getFormat() const
+{
+  return QCAR::GRAYSCALE;
+}
+
+const void *
+MSVImage::getPixels() const
+{
+  return data;
+}
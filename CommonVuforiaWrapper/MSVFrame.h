@@ -0,0 +1,77 @@
+#ifndef MSV_FRAME_H
+#define MSV_FRAME_H
+
+#include <QCAR/Image.h>
+#include <QCAR/State.h>
+
+/** Maximum number of trackable results stored in a MSVFrame */
+#define MAX_FRAME_RESULTS 5
+/** Maximum length of a trackable name, including the trailing '\0' */
+#define MAX_TRACKABLE_NAME 64
+
+/** A trackable found in a frame, with its pose */
+struct MSVFrameResult {
+  char name[MAX_TRACKABLE_NAME];
+  /** 3x4 row-major pose matrix, as QCAR::Matrix34F */
+  float pose[12];
+};
+
+/** Snapshot of what the wrapper needs from a QCAR::State: the grayscale
+ * camera image and the trackables found in it.
+ *
+ * It decouples MSVCallback and MSVRenderer from the QCAR::State object, so
+ * that frames can also come from a recorded session (see MSVReplay).
+ */
+class MSVFrame {
+  public:
+    MSVFrame();
+
+    /** Fills the frame from a QCAR::State. The image pointer is only valid
+     * as long as the state is.
+     */
+    void set(const QCAR::State &state);
+
+    /** Returns the index of the result matching `name`, or -1 */
+    int find(const char *name) const;
+
+    /** QCAR timestamp of the camera frame, in seconds */
+    double timestamp;
+    /** QCAR index of the camera frame */
+    int index;
+    /** Grayscale camera image, or NULL if not available */
+    const QCAR::Image *image;
+    /** Trackables found in this frame */
+    int resultCount;
+    MSVFrameResult results[MAX_FRAME_RESULTS];
+    /** Projection matrix used to render this frame, in OpenGL order */
+    float projection[16];
+};
+
+/** QCAR::Image implementation owning a grayscale pixel buffer */
+class MSVImage : public QCAR::Image {
+  public:
+    MSVImage();
+    ~MSVImage();
+
+    /** Resizes the buffer, whose content becomes undefined */
+    void resize(int width, int height);
+    /** Returns the pixel buffer, of `width * height` bytes */
+    unsigned char *getData();
+
+    /** Implementation of QCAR::Image */
+    int getWidth() const;
+    int getHeight() const;
+    int getBufferWidth() const;
+    int getBufferHeight() const;
+    int getStride() const;
+    QCAR::PIXEL_FORMAT getFormat() const;
+    const void *getPixels() const;
+
+  private:
+    int width;
+    int height;
+    int capacity;
+    unsigned char *data;
+};
+
+#endif
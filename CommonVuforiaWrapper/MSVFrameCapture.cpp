@@ -0,0 +1,178 @@
+#include "MSVFrameCapture.h"
+#include "MSVRedraw.h"
+
+#include <stdlib.h>
+
+MSVFrameCapture::Consumer *MSVFrameCapture::consumer = NULL;
+volatile bool MSVFrameCapture::capturing = false;
+float MSVFrameCapture::scale = 1;
+long MSVFrameCapture::remaining = -1;
+bool MSVFrameCapture::running = false;
+bool MSVFrameCapture::threaded = false;
+pthread_t MSVFrameCapture::thread;
+MSVFrameCapture::Slot MSVFrameCapture::slots[CAPTURE_QUEUE_SIZE];
+int MSVFrameCapture::writeIdx = 0;
+int MSVFrameCapture::readIdx = 0;
+MSVFrameCapture::Stats MSVFrameCapture::stats = {0, 0};
+pthread_mutex_t MSVFrameCapture::lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t MSVFrameCapture::cond = PTHREAD_COND_INITIALIZER;
+
+bool
+MSVFrameCapture::start(Consumer *c, float s, unsigned int frames)
+{
+  pthread_mutex_lock(&lock);
+  if (capturing) {
+    pthread_mutex_unlock(&lock);
+    delete c;
+    return false;
+  }
+  // The consumer thread of the previous capture is over or about to be
+  bool join = threaded;
+  threaded = false;
+  pthread_mutex_unlock(&lock);
+  if (join) pthread_join(thread, NULL);
+
+  pthread_mutex_lock(&lock);
+  if (capturing || threaded) {
+    pthread_mutex_unlock(&lock);
+    delete c;
+    return false;
+  }
+  consumer = c;
+  scale = (s > 0 && s < 1) ? s : 1;
+  remaining = frames ? (long)frames : -1;
+  running = true;
+  threaded = pthread_create(&thread, NULL, MSVFrameCapture::run, NULL) == 0;
+  if (!threaded) {
+    consumer = NULL;
+    running = false;
+    pthread_mutex_unlock(&lock);
+    delete c;
+    return false;
+  }
+  capturing = true;
+  pthread_mutex_unlock(&lock);
+  MSVRedraw::invalidate(MSVRedraw::FRAME_CAPTURE);
+  return true;
+}
+
+void
+MSVFrameCapture::stop()
+{
+  pthread_mutex_lock(&lock);
+  capturing = false;
+  running = false;
+  pthread_cond_signal(&cond);
+  pthread_mutex_unlock(&lock);
+}
+
+bool
+MSVFrameCapture::isCapturing()
+{
+  return capturing;
+}
+
+void
+MSVFrameCapture::getStats(Stats *s)
+{
+  pthread_mutex_lock(&lock);
+  *s = stats;
+  pthread_mutex_unlock(&lock);
+}
+
+float
+MSVFrameCapture::getScale()
+{
+  return scale;
+}
+
+bool
+MSVFrameCapture::takeFrame()
+{
+  if (!capturing || remaining == 0) return false;
+  if (remaining > 0) remaining--;
+  return true;
+}
+
+unsigned char *
+MSVFrameCapture::acquireBuffer(int width, int height)
+{
+  pthread_mutex_lock(&lock);
+  Slot *slot = &slots[writeIdx];
+  // Copies still in flight once stopped are not wanted anymore
+  if (!capturing) {
+    pthread_mutex_unlock(&lock);
+    return NULL;
+  }
+  if (slot->state != SLOT_FREE) {
+    stats.dropped++;
+    pthread_mutex_unlock(&lock);
+    return NULL;
+  }
+  slot->state = SLOT_ACQUIRED;
+  pthread_mutex_unlock(&lock);
+
+  // The slot belongs to the GL thread until it is submitted
+  size_t size = 4*(size_t)width*height;
+  if (slot->size < size) {
+    free(slot->pixels);
+    slot->pixels = (unsigned char *)malloc(size);
+    slot->size = slot->pixels ? size : 0;
+  }
+  slot->width = width;
+  slot->height = height;
+  if (!slot->pixels) {
+    pthread_mutex_lock(&lock);
+    slot->state = SLOT_FREE;
+    stats.dropped++;
+    pthread_mutex_unlock(&lock);
+  }
+  return slot->pixels;
+}
+
+void
+MSVFrameCapture::submit(unsigned char *buffer, double timestamp)
+{
+  pthread_mutex_lock(&lock);
+  Slot *slot = &slots[writeIdx];
+  if (slot->state == SLOT_ACQUIRED && slot->pixels == buffer) {
+    if (capturing) {
+      slot->timestamp = timestamp;
+      slot->state = SLOT_QUEUED;
+      writeIdx = (writeIdx + 1) % CAPTURE_QUEUE_SIZE;
+      pthread_cond_signal(&cond);
+    }
+    else {
+      // Stopped meanwhile
+      slot->state = SLOT_FREE;
+    }
+  }
+  pthread_mutex_unlock(&lock);
+}
+
+void *
+MSVFrameCapture::run(void *)
+{
+  pthread_mutex_lock(&lock);
+  for (;;) {
+    while (running && slots[readIdx].state != SLOT_QUEUED)
+      pthread_cond_wait(&cond, &lock);
+    Slot *slot = &slots[readIdx];
+    // Once stopped, deliver what is queued, then leave
+    if (slot->state != SLOT_QUEUED) break;
+    slot->state = SLOT_BUSY;
+    pthread_mutex_unlock(&lock);
+    consumer->frameCaptured(slot->pixels, slot->width, slot->height,
+                            slot->timestamp);
+    pthread_mutex_lock(&lock);
+    slot->state = SLOT_FREE;
+    stats.captured++;
+    readIdx = (readIdx + 1) % CAPTURE_QUEUE_SIZE;
+  }
+  Consumer *c = consumer;
+  consumer = NULL;
+  pthread_mutex_unlock(&lock);
+  c->captureFinished();
+  delete c;
+  return NULL;
+}
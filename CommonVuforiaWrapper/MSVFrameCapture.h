@@ -0,0 +1,135 @@
+#ifndef MSV_FRAMECAPTURE_H
+#define MSV_FRAMECAPTURE_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+/** Number of frames between the GPU copy of a frame and its readback */
+#define CAPTURE_LATENCY    2
+/** Number of captured frames waiting for, or being processed by, the
+ * consumer. Frames are dropped beyond.
+ */
+#define CAPTURE_QUEUE_SIZE 3
+
+/** Capture of the composited AR view, for screenshots and clips.
+ *
+ * Reading the framebuffer back right after drawing it stalls until the GPU
+ * is done. Instead, MSVRenderer copies each frame on the GPU into a ring
+ * of framebuffer objects, downscaled if requested, and only reads a copy
+ * back two frames later, once the GPU is done with it. Frames are then
+ * handed to the Consumer on a worker thread, so that encoding or saving
+ * them never delays rendering.
+ *
+ * This class holds the capture settings and the worker side; the GL side
+ * lives in MSVRenderer.
+ */
+class MSVFrameCapture {
+  public:
+    /** Interface receiving the captured frames */
+    class Consumer {
+      public:
+        virtual ~Consumer() {}
+        /** Called on the capture thread for each frame.
+         * @param pixels the RGBA pixels, rows bottom-up as OpenGL reads them.
+         * Only valid during the call.
+         * @param timestamp the QCAR timestamp of the camera frame, in
+         * seconds.
+         */
+        virtual void frameCaptured(const unsigned char *pixels,
+                                   int width,
+                                   int height,
+                                   double timestamp) = 0;
+        /** Called on the capture thread once the capture is over, i.e. the
+         * requested frames have been delivered or `stop()` was called. The
+         * consumer is deleted right after.
+         */
+        virtual void captureFinished() {}
+    };
+
+    /** Capture statistics, since startup */
+    struct Stats {
+      /** Frames delivered to consumers */
+      unsigned int captured;
+      /** Frames dropped because the consumer could not keep up */
+      unsigned int dropped;
+    };
+
+    /** Starts capturing the rendered frames. Can be called from any thread.
+     * @param consumer the object receiving the frames. Its ownership is
+     * transferred to the MSVFrameCapture.
+     * @param scale the size of the frames relative to the view, in (0, 1].
+     * @param frames the number of frames to capture, 0 to capture until
+     * `stop()` is called.
+     * @return false if a capture is already in progress, in which case
+     * `consumer` is deleted.
+     * Must not be called from a consumer.
+     */
+    static bool start(Consumer *consumer, float scale = 1, unsigned int frames = 0);
+
+    /** Stops capturing. Frames already handed to the consumer thread are
+     * still delivered. Can be called from any thread, including from the
+     * consumer.
+     */
+    static void stop();
+
+    /** Returns true if frames are being captured */
+    static bool isCapturing();
+
+    static void getStats(Stats *stats);
+
+    /** Renderer side, GL thread only */
+    /** Returns the scale of the frames to capture */
+    static float getScale();
+    /** Counts a frame copied on the GPU.
+     * @return false if enough frames have been copied already: the capture
+     * must be stopped once they have all been submitted.
+     */
+    static bool takeFrame();
+    /** Returns a buffer to read a frame of `width` x `height` back into, or
+     * NULL if the consumer is late, in which case the frame is dropped.
+     */
+    static unsigned char *acquireBuffer(int width, int height);
+    /** Hands a buffer returned by `acquireBuffer` to the consumer */
+    static void submit(unsigned char *buffer, double timestamp);
+
+  private:
+    enum SlotState {
+      SLOT_FREE = 0,
+      /** Being filled by the GL thread */
+      SLOT_ACQUIRED,
+      SLOT_QUEUED,
+      /** Being processed by the consumer */
+      SLOT_BUSY
+    };
+
+    struct Slot {
+      unsigned char *pixels;
+      size_t size;
+      int width;
+      int height;
+      double timestamp;
+      SlotState state;
+    };
+
+    static Consumer *consumer;
+    static volatile bool capturing;
+    static float scale;
+    /** Frames left to copy, -1 for no limit */
+    static long remaining;
+    static bool running;
+    static bool threaded;
+    static pthread_t thread;
+    static Slot slots[CAPTURE_QUEUE_SIZE];
+    /** Next slot to be filled by the GL thread, and to be read by the
+     * consumer
+     */
+    static int writeIdx;
+    static int readIdx;
+    static Stats stats;
+    static pthread_mutex_t lock;
+    static pthread_cond_t cond;
+
+    static void *run(void *);
+};
+
+#endif
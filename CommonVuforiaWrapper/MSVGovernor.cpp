@@ -0,0 +1,164 @@
+#include "MSVGovernor.h"
+#include "MSVRedraw.h"
+
+#include <string.h>
+#include <time.h>
+
+/* Consecutive frames over budget before stepping down */
+#define MISSED_FRAMES    5
+/* Consecutive frames with headroom before stepping up (~3s at 30 fps) */
+#define HEADROOM_FRAMES  90
+/* Frames ignored after a change, while its effect settles */
+#define COOLDOWN_FRAMES  30
+/* Smoothed frame time, relative to the budget, below which there is headroom */
+#define HEADROOM_RATIO   0.7f
+/* Periods longer than this many budgets are idle times */
+#define IDLE_RATIO       4.0f
+/* Weight of a new frame in the smoothed frame time */
+#define SMOOTHING        0.1f
+
+static const MSVGovernor::Level levels[QUALITY_LEVELS] = {
+  /* meshLod, textureLodBias, overlayScale, scanInterval */
+  {0, 0.0f, 1.0f,  1},
+  {1, 0.5f, 0.75f, 2},
+  {1, 1.0f, 0.5f,  3},
+  {2, 1.5f, 0.5f,  4}
+};
+
+bool MSVGovernor::enabled = false;
+float MSVGovernor::budget = QUALITY_BUDGET;
+volatile int MSVGovernor::level = 0;
+unsigned int MSVGovernor::frameIndex = 0;
+double MSVGovernor::frameStart = 0;
+double MSVGovernor::lastStart = 0;
+float MSVGovernor::average = 0;
+int MSVGovernor::missed = 0;
+int MSVGovernor::headroom = 0;
+int MSVGovernor::cooldown = 0;
+MSVGovernor::Change MSVGovernor::history[QUALITY_HISTORY];
+unsigned int MSVGovernor::historyCount = 0;
+pthread_mutex_t MSVGovernor::lock = PTHREAD_MUTEX_INITIALIZER;
+
+void
+MSVGovernor::setEnabled(bool e, float b)
+{
+  enabled = e;
+  budget = b > 0 ? b : QUALITY_BUDGET;
+  lastStart = 0;
+  average = 0;
+  missed = headroom = cooldown = 0;
+  if (!e && level) change(0, FORCED);
+}
+
+bool
+MSVGovernor::isEnabled()
+{
+  return enabled;
+}
+
+int
+MSVGovernor::getLevel()
+{
+  return level;
+}
+
+const MSVGovernor::Level *
+MSVGovernor::getSettings()
+{
+  return &levels[level];
+}
+
+void
+MSVGovernor::setLevel(int l)
+{
+  if (l < 0) l = 0;
+  if (l >= QUALITY_LEVELS) l = QUALITY_LEVELS - 1;
+  if (l != level) change(l, FORCED);
+  missed = headroom = 0;
+  cooldown = COOLDOWN_FRAMES;
+}
+
+unsigned int
+MSVGovernor::copyChanges(Change *changes, unsigned int max)
+{
+  pthread_mutex_lock(&lock);
+  unsigned int n = historyCount < QUALITY_HISTORY ? historyCount : QUALITY_HISTORY;
+  if (n > max) n = max;
+  for (unsigned int i = 0; i < n; ++i)
+    changes[i] = history[(historyCount - n + i) % QUALITY_HISTORY];
+  pthread_mutex_unlock(&lock);
+  return n;
+}
+
+const char *
+MSVGovernor::reasonName(Reason reason)
+{
+  switch (reason) {
+    case BUDGET_MISSED: return "budget missed";
+    case HEADROOM:      return "headroom";
+    case FORCED:        return "forced";
+  }
+  return "unknown";
+}
+
+void
+MSVGovernor::beginFrame()
+{
+  frameStart = now();
+}
+
+void
+MSVGovernor::endFrame()
+{
+  frameIndex++;
+  if (!enabled) return;
+  double end = now();
+  float t = (float)(end - frameStart);
+  // On demand, frames wait for the next redraw request, usually the camera
+  if (lastStart > 0 && !MSVRedraw::isOnDemand()) {
+    float period = (float)(frameStart - lastStart);
+    if (period > t && period < IDLE_RATIO*budget) t = period;
+  }
+  lastStart = frameStart;
+  average = average > 0 ? average + SMOOTHING*(t - average) : t;
+
+  if (cooldown > 0) {
+    cooldown--;
+    return;
+  }
+  missed = (t > budget) ? missed + 1 : 0;
+  headroom = (average < HEADROOM_RATIO*budget) ? headroom + 1 : 0;
+  if (missed >= MISSED_FRAMES && level < QUALITY_LEVELS - 1) {
+    change(level + 1, BUDGET_MISSED);
+  }
+  else if (headroom >= HEADROOM_FRAMES && level > 0) {
+    change(level - 1, HEADROOM);
+  }
+  else {
+    return;
+  }
+  missed = headroom = 0;
+  cooldown = COOLDOWN_FRAMES;
+}
+
+void
+MSVGovernor::change(int to, Reason reason)
+{
+  pthread_mutex_lock(&lock);
+  Change *c = &history[historyCount++ % QUALITY_HISTORY];
+  c->frame = frameIndex;
+  c->from = level;
+  c->to = to;
+  c->reason = reason;
+  c->frameTime = average;
+  level = to;
+  pthread_mutex_unlock(&lock);
+}
+
+double
+MSVGovernor::now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
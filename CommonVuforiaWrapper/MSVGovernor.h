@@ -0,0 +1,116 @@
+#ifndef MSV_GOVERNOR_H
+#define MSV_GOVERNOR_H
+
+#include <pthread.h>
+
+/** Number of quality levels, 0 being the full quality */
+#define QUALITY_LEVELS      4
+/** Number of quality changes kept for `copyChanges` */
+#define QUALITY_HISTORY     16
+/** Default frame budget, in seconds: the camera frame rate */
+#define QUALITY_BUDGET      (1.0f/30)
+
+/** Adaptive quality governor.
+ *
+ * The renderer reports the start and end of each frame. The governor
+ * measures the CPU time spent rendering and the period between frames:
+ * OpenGL ES 2 has no timer queries, but a GPU falling behind makes the
+ * buffer swap block, which lengthens the period. Periods much longer than
+ * the budget are idle times (paused view) and ignored. With on-demand
+ * rendering (see MSVRedraw) the period is paced by the camera and other
+ * redraw requests rather than by the GPU, so only the CPU time is measured.
+ *
+ * When the budget is missed several frames in a row, the quality level is
+ * stepped down. It is stepped back up only once the smoothed frame time has
+ * stayed well under the budget for a few seconds, so that the level does
+ * not oscillate.
+ */
+class MSVGovernor {
+  public:
+    /** Settings of a quality level */
+    struct Level {
+      /** Mesh level of detail, see MSVMesh::glIndexBuffer */
+      int meshLod;
+      /** Bias added to the mipmap level of the static textures */
+      float textureLodBias;
+      /** Scale of the overlay render target, relative to the view */
+      float overlayScale;
+      /** Number of camera frames per status update, i.e. per scan */
+      int scanInterval;
+    };
+
+    /** Reason of a level change */
+    enum Reason {
+      /** The frame budget has been missed */
+      BUDGET_MISSED = 0,
+      /** Frames have been well within budget for a while */
+      HEADROOM,
+      /** Changed through `setLevel` or `setEnabled` */
+      FORCED
+    };
+
+    /** A level change */
+    struct Change {
+      /** Index of the frame at which the level changed */
+      unsigned int frame;
+      int from;
+      int to;
+      Reason reason;
+      /** Smoothed frame time at the time of the change, in seconds */
+      float frameTime;
+    };
+
+    /** Enables or disables the governor. When disabled, the level is reset
+     * to 0 and never changes. Disabled by default.
+     * @param budget the target frame time, in seconds.
+     */
+    static void setEnabled(bool enabled, float budget = QUALITY_BUDGET);
+    static bool isEnabled();
+
+    /** Returns the current level. Can be called from any thread. */
+    static int getLevel();
+    /** Returns the settings of the current level. Can be called from any
+     * thread.
+     */
+    static const Level *getSettings();
+    /** Forces the current level. The governor may change it again at the
+     * next frames if enabled.
+     */
+    static void setLevel(int level);
+
+    /** Copies the latest level changes, oldest first.
+     * @param changes filled with up to `max` changes.
+     * @return the number of changes copied.
+     */
+    static unsigned int copyChanges(Change *changes, unsigned int max);
+
+    /** Returns a description of a reason */
+    static const char *reasonName(Reason reason);
+
+    /** Called by the renderer at the beginning and end of each frame, from
+     * GL thread.
+     */
+    static void beginFrame();
+    static void endFrame();
+
+  private:
+    static bool enabled;
+    static float budget;
+    static volatile int level;
+    static unsigned int frameIndex;
+    static double frameStart;
+    static double lastStart;
+    static float average;
+    static int missed;
+    static int headroom;
+    static int cooldown;
+
+    static Change history[QUALITY_HISTORY];
+    static unsigned int historyCount;
+    static pthread_mutex_t lock;
+
+    static void change(int to, Reason reason);
+    static double now();
+};
+
+#endif
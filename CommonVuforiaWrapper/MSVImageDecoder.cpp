@@ -0,0 +1,832 @@
+#include "MSVImageDecoder.h"
+#include "MSVTrace.h"
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#if (defined(__ARM_NEON__) || defined(__ARM_NEON))
+  #include <arm_neon.h>
+  #define MSV_NEON
+#elif (defined(__SSE2__))
+  #include <emmintrin.h>
+  #define MSV_SSE2
+#endif
+
+/* Largest width or height of a decoded image */
+#define IMAGE_MAX_SIZE    16384
+
+/* JPEG markers */
+#define JPEG_SOF0         0xc0
+#define JPEG_SOF1         0xc1
+#define JPEG_DHT          0xc4
+#define JPEG_RST0         0xd0
+#define JPEG_RST7         0xd7
+#define JPEG_SOI          0xd8
+#define JPEG_EOI          0xd9
+#define JPEG_SOS          0xda
+#define JPEG_DQT          0xdb
+#define JPEG_DRI          0xdd
+/* Bits of the Huffman codes looked up in one step */
+#define HUFFMAN_FAST_BITS 9
+#define HUFFMAN_NONE      0xffff
+
+MSVImageDecoder::Task *MSVImageDecoder::head = NULL;
+MSVImageDecoder::Task *MSVImageDecoder::tail = NULL;
+bool MSVImageDecoder::started = false;
+pthread_mutex_t MSVImageDecoder::lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t MSVImageDecoder::cond = PTHREAD_COND_INITIALIZER;
+
+static inline uint32_t
+readBE32(const unsigned char *p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static inline unsigned int
+readBE16(const unsigned char *p)
+{
+  return (p[0] << 8) | p[1];
+}
+
+static inline unsigned char
+clamp(int v)
+{
+  return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+bool
+MSVImageDecoder::decode(const unsigned char *data,
+                        size_t size,
+                        unsigned int maxWidth,
+                        unsigned int maxHeight,
+                        Image *image)
+{
+  MSV_TRACE_SCOPE("decodeImage");
+  memset(image, 0, sizeof(Image));
+  if (size >= 8 && !memcmp(data, "\x89PNG\r\n\x1a\n", 8))
+    return decodePNG(data, size, image);
+  if (size >= 2 && data[0] == 0xff && data[1] == JPEG_SOI)
+    return decodeJPEG(data, size, maxWidth, maxHeight, image);
+  return false;
+}
+
+bool
+MSVImageDecoder::decodeFile(const char *path,
+                            unsigned int maxWidth,
+                            unsigned int maxHeight,
+                            Image *image)
+{
+  memset(image, 0, sizeof(Image));
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  void *data = MAP_FAILED;
+  if (!fstat(fd, &st) && st.st_size > 0)
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) return false;
+  bool ok = decode((const unsigned char *)data, st.st_size, maxWidth, maxHeight, image);
+  munmap(data, st.st_size);
+  return ok;
+}
+
+/* Premultiplication: c*a/255, rounded, computed exactly as
+ * (x + ((x + 128) >> 8) + 128) >> 8 with x = c*a.
+ */
+
+static inline unsigned char
+multiply(unsigned int c, unsigned int a)
+{
+  unsigned int x = c*a;
+  return (x + ((x + 128) >> 8) + 128) >> 8;
+}
+
+void
+MSVImageDecoder::premultiply(unsigned char *pixels, size_t count)
+{
+  size_t i = 0;
+#if (defined(MSV_NEON))
+  for (; i + 8 <= count; i += 8) {
+    uint8x8x4_t px = vld4_u8(pixels + 4*i);
+    for (int c = 0; c < 3; ++c) {
+      uint16x8_t x = vmull_u8(px.val[c], px.val[3]);
+      px.val[c] = vraddhn_u16(x, vrshrq_n_u16(x, 8));
+    }
+    vst4_u8(pixels + 4*i, px);
+  }
+#elif (defined(MSV_SSE2))
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i half = _mm_set1_epi16(128);
+  // Alpha lanes are multiplied by 255, which leaves them unchanged
+  const __m128i alphaMask = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+  const __m128i alphaOne = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+  for (; i + 4 <= count; i += 4) {
+    __m128i px = _mm_loadu_si128((const __m128i *)(pixels + 4*i));
+    __m128i halves[2] = {_mm_unpacklo_epi8(px, zero), _mm_unpackhi_epi8(px, zero)};
+    for (int h = 0; h < 2; ++h) {
+      __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(halves[h], 0xff), 0xff);
+      a = _mm_or_si128(_mm_andnot_si128(alphaMask, a), alphaOne);
+      __m128i x = _mm_mullo_epi16(halves[h], a);
+      __m128i r = _mm_srli_epi16(_mm_add_epi16(x, half), 8);
+      halves[h] = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(x, r), half), 8);
+    }
+    _mm_storeu_si128((__m128i *)(pixels + 4*i), _mm_packus_epi16(halves[0], halves[1]));
+  }
+#endif
+  for (; i < count; ++i) {
+    unsigned char *p = pixels + 4*i;
+    p[0] = multiply(p[0], p[3]);
+    p[1] = multiply(p[1], p[3]);
+    p[2] = multiply(p[2], p[3]);
+  }
+}
+
+/* PNG */
+
+static inline unsigned char
+paeth(int a, int b, int c)
+{
+  int p = a + b - c;
+  int pa = abs(p - a);
+  int pb = abs(p - b);
+  int pc = abs(p - c);
+  if (pa <= pb && pa <= pc) return a;
+  return pb <= pc ? b : c;
+}
+
+/* Reverts the filters of the rows, in place */
+static bool
+unfilter(unsigned char *raw, unsigned int height, size_t rowBytes, int bpp)
+{
+  const unsigned char *prev = NULL;
+  for (unsigned int y = 0; y < height; ++y) {
+    unsigned char *row = raw + y*(rowBytes + 1);
+    unsigned char *cur = row + 1;
+    switch (row[0]) {
+      case 0:
+        break;
+      case 1:
+        for (size_t i = bpp; i < rowBytes; ++i) cur[i] += cur[i - bpp];
+        break;
+      case 2:
+        if (prev) for (size_t i = 0; i < rowBytes; ++i) cur[i] += prev[i];
+        break;
+      case 3:
+        for (size_t i = 0; i < rowBytes; ++i) {
+          int left = i >= (size_t)bpp ? cur[i - bpp] : 0;
+          int up = prev ? prev[i] : 0;
+          cur[i] += (left + up) >> 1;
+        }
+        break;
+      case 4:
+        for (size_t i = 0; i < rowBytes; ++i) {
+          int left = i >= (size_t)bpp ? cur[i - bpp] : 0;
+          int up = prev ? prev[i] : 0;
+          int upLeft = (prev && i >= (size_t)bpp) ? prev[i - bpp] : 0;
+          cur[i] += paeth(left, up, upLeft);
+        }
+        break;
+      default:
+        return false;
+    }
+    prev = cur;
+  }
+  return true;
+}
+
+/* Returns the sample `i` of a row, at full precision */
+static inline unsigned int
+sample(const unsigned char *row, unsigned int i, int depth)
+{
+  if (depth == 8) return row[i];
+  if (depth == 16) return readBE16(row + 2*i);
+  unsigned int bit = i*depth;
+  return (row[bit >> 3] >> (8 - depth - (bit & 7))) & ((1 << depth) - 1);
+}
+
+bool
+MSVImageDecoder::decodePNG(const unsigned char *data, size_t size, Image *image)
+{
+  unsigned int width = 0, height = 0;
+  int depth = 0, colorType = -1, channels = 0;
+  size_t rowBytes = 0;
+  unsigned char palette[256*4];
+  memset(palette, 255, sizeof(palette));
+  bool hasKey = false;
+  unsigned int key[3] = {0, 0, 0};
+  bool hasAlpha = false;
+  unsigned char *raw = NULL;
+  z_stream zs;
+  memset(&zs, 0, sizeof(z_stream));
+  bool inflating = false;
+
+  // Chunks of {length, type, data, crc}
+  bool ok = true;
+  bool end = false;
+  size_t pos = 8;
+  while (ok && !end && pos + 12 <= size) {
+    uint32_t len = readBE32(data + pos);
+    const unsigned char *type = data + pos + 4;
+    const unsigned char *chunk = data + pos + 8;
+    if (len > size - pos - 12) break;
+    if (!memcmp(type, "IHDR", 4)) {
+      if (len < 13 || inflating) {
+        ok = false;
+        break;
+      }
+      width = readBE32(chunk);
+      height = readBE32(chunk + 4);
+      depth = chunk[8];
+      colorType = chunk[9];
+      switch (colorType) {
+        case 0: channels = 1; ok = depth && depth <= 16 && !(depth & (depth - 1)); break;
+        case 2: channels = 3; ok = depth == 8 || depth == 16; break;
+        case 3: channels = 1; ok = depth && depth <= 8 && !(depth & (depth - 1)); break;
+        case 4: channels = 2; ok = depth == 8 || depth == 16; break;
+        case 6: channels = 4; ok = depth == 8 || depth == 16; break;
+        default: ok = false;
+      }
+      // Interlaced images are not supported
+      ok = ok && !chunk[10] && !chunk[11] && !chunk[12] &&
+           width && height && width <= IMAGE_MAX_SIZE && height <= IMAGE_MAX_SIZE;
+      if (!ok) break;
+      hasAlpha = (colorType == 4 || colorType == 6);
+      rowBytes = ((size_t)width*channels*depth + 7)/8;
+      raw = (unsigned char *)malloc(height*(rowBytes + 1));
+      ok = raw && inflateInit(&zs) == Z_OK;
+      inflating = ok;
+      zs.next_out = raw;
+      zs.avail_out = height*(rowBytes + 1);
+    }
+    else if (!memcmp(type, "PLTE", 4)) {
+      for (uint32_t i = 0; i < len/3 && i < 256; ++i)
+        memcpy(&palette[4*i], chunk + 3*i, 3);
+    }
+    else if (!memcmp(type, "tRNS", 4)) {
+      if (colorType == 3) {
+        for (uint32_t i = 0; i < len && i < 256; ++i) palette[4*i+3] = chunk[i];
+        hasAlpha = true;
+      }
+      else if (len >= 2*(uint32_t)channels && (colorType == 0 || colorType == 2)) {
+        for (int c = 0; c < channels; ++c) key[c] = readBE16(chunk + 2*c);
+        hasKey = hasAlpha = true;
+      }
+    }
+    else if (!memcmp(type, "IDAT", 4)) {
+      if (!inflating) {
+        ok = false;
+        break;
+      }
+      zs.next_in = (Bytef *)chunk;
+      zs.avail_in = len;
+      int r = inflate(&zs, Z_NO_FLUSH);
+      ok = (r == Z_OK || r == Z_STREAM_END || r == Z_BUF_ERROR);
+    }
+    else if (!memcmp(type, "IEND", 4)) {
+      end = true;
+    }
+    else if (!(type[0] & 0x20)) {
+      // Unknown critical chunk
+      ok = false;
+    }
+    pos += len + 12;
+  }
+  if (inflating) {
+    ok = ok && zs.avail_out == 0;
+    inflateEnd(&zs);
+  }
+  ok = ok && inflating && unfilter(raw, height, rowBytes, (channels*depth + 7)/8);
+  if (!ok) {
+    free(raw);
+    return false;
+  }
+
+  unsigned char *pixels = new unsigned char[(size_t)width*height*4];
+  int maxValue = (1 << depth) - 1;
+  for (unsigned int y = 0; y < height; ++y) {
+    const unsigned char *src = raw + y*(rowBytes + 1) + 1;
+    // Bottom-up, as MSVTexture stores the rows
+    unsigned char *dst = pixels + (size_t)(height - 1 - y)*width*4;
+    if (colorType == 6 && depth == 8) {
+      memcpy(dst, src, 4*width);
+      continue;
+    }
+    for (unsigned int x = 0; x < width; ++x, dst += 4) {
+      unsigned int s[4] = {0, 0, 0, 0};
+      for (int c = 0; c < channels; ++c) s[c] = sample(src, x*channels + c, depth);
+      switch (colorType) {
+        case 0:
+          dst[0] = dst[1] = dst[2] = (depth == 16) ? s[0] >> 8 : s[0]*255/maxValue;
+          dst[3] = (hasKey && s[0] == key[0]) ? 0 : 255;
+          break;
+        case 2:
+          for (int c = 0; c < 3; ++c) dst[c] = (depth == 16) ? s[c] >> 8 : s[c];
+          dst[3] = (hasKey && s[0] == key[0] && s[1] == key[1] && s[2] == key[2]) ? 0 : 255;
+          break;
+        case 3:
+          memcpy(dst, &palette[4*s[0]], 4);
+          break;
+        case 4:
+          dst[0] = dst[1] = dst[2] = (depth == 16) ? s[0] >> 8 : s[0];
+          dst[3] = (depth == 16) ? s[1] >> 8 : s[1];
+          break;
+        case 6:
+          for (int c = 0; c < 4; ++c) dst[c] = s[c] >> 8;
+          break;
+      }
+    }
+  }
+  free(raw);
+  if (hasAlpha) premultiply(pixels, (size_t)width*height);
+  image->width = width;
+  image->height = height;
+  image->pixels = pixels;
+  return true;
+}
+
+/* JPEG */
+
+static const unsigned char zigzag[64] = {
+   0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+  12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+  35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+  58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+};
+
+struct Huffman {
+  /* Index of the symbol of the codes of up to HUFFMAN_FAST_BITS bits, or
+   * HUFFMAN_NONE
+   */
+  uint16_t fast[1 << HUFFMAN_FAST_BITS];
+  unsigned char sizes[256];
+  unsigned char values[256];
+  int minCode[17];
+  int maxCode[17];
+  int valuePtr[17];
+};
+
+struct JpegComponent {
+  int id;
+  int h;
+  int v;
+  int quant;
+  int dcTable;
+  int acTable;
+  int pred;
+  /* Decoded samples, at the reduced size */
+  unsigned char *plane;
+  int stride;
+};
+
+struct BitReader {
+  const unsigned char *p;
+  const unsigned char *end;
+  uint32_t bits;
+  int count;
+  /* A marker was met: zeros are read until the next restart */
+  bool marker;
+  /* Bits of zeros read at a marker or past the end, last in `bits` */
+  int zeros;
+};
+
+/* Inverse DCT weights for 1, 2, 4 and 8 points outputs */
+static float idctWeights[4][8][8];
+static pthread_once_t idctOnce = PTHREAD_ONCE_INIT;
+
+static void
+initIdct()
+{
+  for (int l = 0; l < 4; ++l) {
+    int n = 1 << l;
+    for (int x = 0; x < n; ++x) {
+      for (int u = 0; u < n; ++u) {
+        float c = u ? 1.0f : (float)M_SQRT1_2;
+        idctWeights[l][x][u] = 0.5f*c*cosf((2*x + 1)*u*(float)M_PI/(2*n));
+      }
+    }
+  }
+}
+
+static bool
+buildHuffman(Huffman *h, const unsigned char *counts, const unsigned char *values, int total)
+{
+  for (int i = 0; i < (1 << HUFFMAN_FAST_BITS); ++i) h->fast[i] = HUFFMAN_NONE;
+  memcpy(h->values, values, total);
+  int code = 0;
+  int k = 0;
+  for (int len = 1; len <= 16; ++len) {
+    h->valuePtr[len] = k;
+    h->minCode[len] = code;
+    for (int i = 0; i < counts[len - 1]; ++i, ++k, ++code) {
+      // More codes than there are of this length
+      if (code >= (1 << len)) return false;
+      h->sizes[k] = len;
+      if (len <= HUFFMAN_FAST_BITS) {
+        int first = code << (HUFFMAN_FAST_BITS - len);
+        for (int j = 0; j < (1 << (HUFFMAN_FAST_BITS - len)); ++j) h->fast[first + j] = k;
+      }
+    }
+    h->maxCode[len] = counts[len - 1] ? code - 1 : -1;
+    code <<= 1;
+  }
+  return true;
+}
+
+static inline void
+fill(BitReader *br)
+{
+  while (br->count <= 24) {
+    unsigned int byte = 0;
+    bool read = false;
+    if (!br->marker && br->p < br->end) {
+      byte = *br->p;
+      if (byte != 0xff) {
+        br->p++;
+        read = true;
+      }
+      else if (br->p + 1 == br->end) {
+        // Truncated within a marker: nothing more to read
+        br->p = br->end;
+        byte = 0;
+      }
+      else if (!br->p[1]) {
+        br->p += 2;
+        read = true;
+      }
+      else {
+        br->marker = true;
+        byte = 0;
+      }
+    }
+    if (!read) br->zeros += 8;
+    br->bits |= byte << (24 - br->count);
+    br->count += 8;
+  }
+}
+
+static inline int
+getBits(BitReader *br, int n)
+{
+  fill(br);
+  int v = br->bits >> (32 - n);
+  br->bits <<= n;
+  br->count -= n;
+  return v;
+}
+
+/* Extends a `n` bits magnitude category value to its signed value */
+static inline int
+extend(int v, int n)
+{
+  return v < (1 << (n - 1)) ? v - (1 << n) + 1 : v;
+}
+
+static int
+decodeSymbol(BitReader *br, const Huffman *h)
+{
+  fill(br);
+  int k = h->fast[br->bits >> (32 - HUFFMAN_FAST_BITS)];
+  if (k == HUFFMAN_NONE) {
+    for (int len = HUFFMAN_FAST_BITS + 1; len <= 16; ++len) {
+      int code = br->bits >> (32 - len);
+      if (h->maxCode[len] >= 0 && code <= h->maxCode[len]) {
+        k = h->valuePtr[len] + code - h->minCode[len];
+        break;
+      }
+    }
+    if (k == HUFFMAN_NONE) return -1;
+  }
+  br->bits <<= h->sizes[k];
+  br->count -= h->sizes[k];
+  return h->values[k];
+}
+
+/* Decodes a block, and writes its n*n reduced inverse DCT */
+static bool
+decodeBlock(BitReader *br, JpegComponent *c, const Huffman *dc, const Huffman *ac,
+            const uint16_t *quant, int level, unsigned char *out, int stride)
+{
+  float coefs[64];
+  memset(coefs, 0, sizeof(coefs));
+  int s = decodeSymbol(br, dc);
+  if (s < 0 || s > 11) return false;
+  if (s) c->pred += extend(getBits(br, s), s);
+  coefs[0] = (float)(c->pred*quant[0]);
+  for (int k = 1; k < 64; ) {
+    int rs = decodeSymbol(br, ac);
+    if (rs < 0) return false;
+    int r = rs >> 4;
+    s = rs & 15;
+    if (!s) {
+      if (r != 15) break;
+      k += 16;
+      continue;
+    }
+    k += r;
+    if (k > 63) return false;
+    coefs[zigzag[k]] = (float)(extend(getBits(br, s), s)*quant[k]);
+    k++;
+  }
+
+  // Separable inverse DCT of the n*n lowest frequencies
+  int n = 1 << level;
+  float tmp[8][8];
+  for (int v = 0; v < n; ++v) {
+    for (int x = 0; x < n; ++x) {
+      float sum = 0;
+      for (int u = 0; u < n; ++u) sum += idctWeights[level][x][u]*coefs[8*v + u];
+      tmp[v][x] = sum;
+    }
+  }
+  for (int y = 0; y < n; ++y) {
+    for (int x = 0; x < n; ++x) {
+      float sum = 0;
+      for (int v = 0; v < n; ++v) sum += idctWeights[level][y][v]*tmp[v][x];
+      out[y*stride + x] = clamp((int)lrintf(sum) + 128);
+    }
+  }
+  return true;
+}
+
+bool
+MSVImageDecoder::decodeJPEG(const unsigned char *data, size_t size,
+                            unsigned int maxWidth, unsigned int maxHeight,
+                            Image *image)
+{
+  pthread_once(&idctOnce, initIdct);
+  uint16_t quant[4][64];
+  bool quantDefined[4] = {false, false, false, false};
+  Huffman *huffman = (Huffman *)malloc(8*sizeof(Huffman));
+  if (!huffman) return false;
+  bool defined[8] = {false, false, false, false, false, false, false, false};
+  JpegComponent comps[3];
+  memset(comps, 0, sizeof(comps));
+  int compCount = 0;
+  unsigned int width = 0, height = 0;
+  int restartInterval = 0;
+  bool frame = false, decoded = false, ok = true;
+
+  size_t pos = 2;
+  while (ok && !decoded && pos + 4 <= size) {
+    if (data[pos] != 0xff) {
+      ok = false;
+      break;
+    }
+    int marker = data[pos + 1];
+    if (marker == 0xff) {
+      // Fill byte
+      pos++;
+      continue;
+    }
+    if (marker == JPEG_EOI) break;
+    size_t len = readBE16(data + pos + 2);
+    const unsigned char *seg = data + pos + 4;
+    if (len < 2 || pos + 2 + len > size) {
+      ok = false;
+      break;
+    }
+    len -= 2;
+    switch (marker) {
+      case JPEG_DQT:
+        for (size_t i = 0; ok && i < len; ) {
+          int precision = seg[i] >> 4;
+          int id = seg[i] & 15;
+          size_t tableSize = precision ? 128 : 64;
+          if (id > 3 || i + 1 + tableSize > len) {
+            ok = false;
+            break;
+          }
+          for (int k = 0; k < 64; ++k)
+            quant[id][k] = precision ? readBE16(seg + i + 1 + 2*k) : seg[i + 1 + k];
+          quantDefined[id] = true;
+          i += 1 + tableSize;
+        }
+        break;
+      case JPEG_DHT:
+        for (size_t i = 0; ok && i < len; ) {
+          int cls = seg[i] >> 4;
+          int id = seg[i] & 15;
+          if (cls > 1 || id > 3 || i + 17 > len) {
+            ok = false;
+            break;
+          }
+          int total = 0;
+          for (int k = 0; k < 16; ++k) total += seg[i + 1 + k];
+          if (total > 256 || i + 17 + total > len) {
+            ok = false;
+            break;
+          }
+          ok = buildHuffman(&huffman[4*cls + id], seg + i + 1, seg + i + 17, total);
+          defined[4*cls + id] = ok;
+          i += 17 + total;
+        }
+        break;
+      case JPEG_DRI:
+        restartInterval = len >= 2 ? readBE16(seg) : 0;
+        break;
+      case JPEG_SOF0:
+      case JPEG_SOF1:
+        height = len >= 6 ? readBE16(seg + 1) : 0;
+        width = len >= 6 ? readBE16(seg + 3) : 0;
+        compCount = len >= 6 ? seg[5] : 0;
+        // 8-bit grayscale or YCbCr only
+        ok = seg[0] == 8 && width && height && width <= IMAGE_MAX_SIZE &&
+             height <= IMAGE_MAX_SIZE && (compCount == 1 || compCount == 3) &&
+             len >= 6 + 3*(size_t)compCount;
+        for (int c = 0; ok && c < compCount; ++c) {
+          comps[c].id = seg[6 + 3*c];
+          comps[c].h = seg[7 + 3*c] >> 4;
+          comps[c].v = seg[7 + 3*c] & 15;
+          comps[c].quant = seg[8 + 3*c];
+          ok = comps[c].h >= 1 && comps[c].h <= 4 && comps[c].v >= 1 &&
+               comps[c].v <= 4 && comps[c].quant <= 3;
+        }
+        frame = ok;
+        break;
+      case JPEG_SOS: {
+        // A single scan with all the components
+        int scanCount = len >= 1 ? seg[0] : 0;
+        ok = frame && scanCount == compCount && len >= 4 + 2*(size_t)scanCount;
+        for (int s = 0; ok && s < scanCount; ++s) {
+          ok = seg[1 + 2*s] == comps[s].id;
+          comps[s].dcTable = seg[2 + 2*s] >> 4;
+          comps[s].acTable = seg[2 + 2*s] & 15;
+          ok = ok && comps[s].dcTable <= 3 && comps[s].acTable <= 3 &&
+               defined[comps[s].dcTable] && defined[4 + comps[s].acTable] &&
+               quantDefined[comps[s].quant];
+        }
+        if (!ok) break;
+
+        // The smallest downscaling fitting the requested size
+        int level = 3;
+        while (level > 0 &&
+               ((maxWidth && ((width << level) + 7)/8 > maxWidth) ||
+                (maxHeight && ((height << level) + 7)/8 > maxHeight)))
+          level--;
+        int n = 1 << level;
+        int hMax = 1, vMax = 1;
+        for (int c = 0; c < compCount; ++c) {
+          if (comps[c].h > hMax) hMax = comps[c].h;
+          if (comps[c].v > vMax) vMax = comps[c].v;
+        }
+        // A single component scan is not interleaved: its MCU is one block
+        if (compCount == 1) {
+          hMax = vMax = 1;
+          comps[0].h = comps[0].v = 1;
+        }
+        int mcusX = (width + 8*hMax - 1)/(8*hMax);
+        int mcusY = (height + 8*vMax - 1)/(8*vMax);
+        for (int c = 0; c < compCount; ++c) {
+          comps[c].stride = mcusX*comps[c].h*n;
+          comps[c].plane = (unsigned char *)malloc((size_t)comps[c].stride*mcusY*comps[c].v*n);
+          ok = ok && comps[c].plane;
+        }
+        if (!ok) break;
+
+        BitReader br;
+        br.p = seg + len;
+        br.end = data + size;
+        br.bits = 0;
+        br.count = 0;
+        br.marker = false;
+        br.zeros = 0;
+        int mcus = 0;
+        for (int my = 0; ok && my < mcusY; ++my) {
+          for (int mx = 0; ok && mx < mcusX; ++mx) {
+            if (restartInterval && mcus && !(mcus % restartInterval)) {
+              // Skip the padding bits to the restart marker, and reset the
+              // predictors
+              while (br.p + 1 < br.end &&
+                     !(br.p[0] == 0xff && br.p[1] >= JPEG_RST0 && br.p[1] <= JPEG_RST7))
+                br.p++;
+              br.p = br.p + 1 < br.end ? br.p + 2 : br.end;
+              br.marker = false;
+              br.bits = 0;
+              br.count = 0;
+              br.zeros = 0;
+              for (int c = 0; c < compCount; ++c) comps[c].pred = 0;
+            }
+            // Every MCU has bits: once only zeros are left, the scan is
+            // truncated, and would otherwise be decoded to its last MCU
+            fill(&br);
+            if (br.count <= br.zeros) {
+              ok = false;
+              break;
+            }
+            for (int c = 0; ok && c < compCount; ++c) {
+              JpegComponent *comp = &comps[c];
+              for (int by = 0; ok && by < comp->v; ++by) {
+                for (int bx = 0; ok && bx < comp->h; ++bx) {
+                  int x = (mx*comp->h + bx)*n;
+                  int y = (my*comp->v + by)*n;
+                  ok = decodeBlock(&br, comp, &huffman[comp->dcTable],
+                                   &huffman[4 + comp->acTable], quant[comp->quant],
+                                   level, comp->plane + (size_t)y*comp->stride + x,
+                                   comp->stride);
+                }
+              }
+            }
+            mcus++;
+          }
+        }
+        if (!ok) break;
+
+        // Color conversion, with nearest chroma upsampling, bottom-up
+        unsigned int outWidth = ((width << level) + 7)/8;
+        unsigned int outHeight = ((height << level) + 7)/8;
+        unsigned char *pixels = new unsigned char[(size_t)outWidth*outHeight*4];
+        for (unsigned int y = 0; y < outHeight; ++y) {
+          unsigned char *dst = pixels + (size_t)(outHeight - 1 - y)*outWidth*4;
+          const unsigned char *lum = comps[0].plane +
+                                     (size_t)(y*comps[0].v/vMax)*comps[0].stride;
+          if (compCount == 1) {
+            for (unsigned int x = 0; x < outWidth; ++x, dst += 4) {
+              dst[0] = dst[1] = dst[2] = lum[x];
+              dst[3] = 255;
+            }
+            continue;
+          }
+          const unsigned char *cb = comps[1].plane +
+                                    (size_t)(y*comps[1].v/vMax)*comps[1].stride;
+          const unsigned char *cr = comps[2].plane +
+                                    (size_t)(y*comps[2].v/vMax)*comps[2].stride;
+          for (unsigned int x = 0; x < outWidth; ++x, dst += 4) {
+            // BT.601 full range, in 16.16 fixed point
+            int l = lum[x*comps[0].h/hMax] << 16;
+            int b = cb[x*comps[1].h/hMax] - 128;
+            int r = cr[x*comps[2].h/hMax] - 128;
+            dst[0] = clamp((l + 91881*r + 32768) >> 16);
+            dst[1] = clamp((l - 22554*b - 46802*r + 32768) >> 16);
+            dst[2] = clamp((l + 116130*b + 32768) >> 16);
+            dst[3] = 255;
+          }
+        }
+        image->width = outWidth;
+        image->height = outHeight;
+        image->pixels = pixels;
+        decoded = true;
+        break;
+      }
+      default:
+        // Progressive and arithmetic coding are not supported
+        if (marker >= 0xc2 && marker <= 0xcf && marker != JPEG_DHT) ok = false;
+        break;
+    }
+    pos += 2 + len + 2;
+  }
+  for (int c = 0; c < 3; ++c) free(comps[c].plane);
+  free(huffman);
+  return ok && decoded;
+}
+
+/* Worker */
+
+void
+MSVImageDecoder::post(Job job, void *arg)
+{
+  Task *t = (Task *)malloc(sizeof(Task));
+  t->job = job;
+  t->arg = arg;
+  t->next = NULL;
+  pthread_mutex_lock(&lock);
+  if (!started) {
+    pthread_t thread;
+    started = !pthread_create(&thread, NULL, MSVImageDecoder::run, NULL);
+    if (started) pthread_detach(thread);
+  }
+  if (!started) {
+    // No worker: run it inline
+    pthread_mutex_unlock(&lock);
+    free(t);
+    job(arg);
+    return;
+  }
+  if (tail) tail->next = t;
+  else head = t;
+  tail = t;
+  pthread_cond_signal(&cond);
+  pthread_mutex_unlock(&lock);
+}
+
+void *
+MSVImageDecoder::run(void *)
+{
+  for (;;) {
+    pthread_mutex_lock(&lock);
+    while (!head) pthread_cond_wait(&cond, &lock);
+    Task *t = head;
+    head = t->next;
+    if (!head) tail = NULL;
+    pthread_mutex_unlock(&lock);
+    t->job(t->arg);
+    free(t);
+  }
+  return NULL;
+}
@@ -0,0 +1,76 @@
+#ifndef MSV_IMAGEDECODER_H
+#define MSV_IMAGEDECODER_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+/** Native PNG and JPEG decoder, producing MSVTexture pixels directly.
+ *
+ * Decoded pixels are RGBA with premultiplied alpha, and rows are written
+ * bottom-up as MSVTexture stores them, so that no conversion nor flip copy
+ * is needed afterwards.
+ *
+ * Supported formats are non-interlaced PNG of any color type and bit depth,
+ * and baseline JPEG (grayscale or YCbCr, any chroma subsampling). JPEG
+ * images can be downscaled by 2, 4 or 8 while decoding, by computing
+ * reduced size inverse DCTs from the low frequencies of each block only.
+ */
+class MSVImageDecoder {
+  public:
+    /** Decoded image */
+    struct Image {
+      unsigned int width;
+      unsigned int height;
+      /** RGBA pixels, bottom row first, allocated with new[] */
+      unsigned char *pixels;
+    };
+
+    /** Decodes a PNG or JPEG image, whose format is detected from its
+     * content.
+     * @param maxWidth, maxHeight the size the image should fit in, 0 for
+     * no limit. JPEG images are downscaled by the smallest factor that fits,
+     * up to 8. Other images are decoded at full size.
+     * @return false if the image could not be decoded.
+     */
+    static bool decode(const unsigned char *data,
+                       size_t size,
+                       unsigned int maxWidth,
+                       unsigned int maxHeight,
+                       Image *image);
+
+    /** Same as above, from a file */
+    static bool decodeFile(const char *path,
+                           unsigned int maxWidth,
+                           unsigned int maxHeight,
+                           Image *image);
+
+    /** Premultiplies `count` RGBA pixels by their alpha, in place */
+    static void premultiply(unsigned char *pixels, size_t count);
+
+    typedef void (*Job)(void *arg);
+    /** Runs a job on the decoding worker thread, started on first use.
+     * Jobs are run one at a time, in order.
+     */
+    static void post(Job job, void *arg);
+
+  private:
+    struct Task {
+      Job job;
+      void *arg;
+      Task *next;
+    };
+
+    static Task *head;
+    static Task *tail;
+    static bool started;
+    static pthread_mutex_t lock;
+    static pthread_cond_t cond;
+
+    static bool decodePNG(const unsigned char *data, size_t size, Image *image);
+    static bool decodeJPEG(const unsigned char *data, size_t size,
+                           unsigned int maxWidth, unsigned int maxHeight,
+                           Image *image);
+    static void *run(void *arg);
+};
+
+#endif
@@ -1,24 +1,69 @@
+#include "MSVBVH.h"
 #include "MSVMesh.h"
 #include "MSVPlane.h"
+#include "MSVTrace.h"
 
+#include <math.h>
 #include <string.h>
 
+pthread_mutex_t MSVMesh::bvhLock = PTHREAD_MUTEX_INITIALIZER;
+MSVMesh *MSVMesh::plane = NULL;
+pthread_once_t MSVMesh::planeOnce = PTHREAD_ONCE_INIT;
+
 MSVMesh::MSVMesh() :
+MSVAsset(MESH),
 nVertices(0),
 vertices(NULL),
 normals(NULL),
 texCoords(NULL),
 nFaces(0),
-faces(NULL)
-{}
+faces(NULL),
+nMorphs(0),
+nBones(0),
+boneParents(NULL),
+restPose(NULL),
+inverseBind(NULL),
+boneIndices(NULL),
+boneWeights(NULL),
+animation(NULL),
+sphereRadius(0),
+bvh(NULL),
+vbo(0),
+lodsBuilt(false)
+{
+  memset(morphs, 0, sizeof(morphs));
+  memset(ibo, 0, sizeof(ibo));
+  memset(lodFaces, 0, sizeof(lodFaces));
+  memset(lodIndices, 0, sizeof(lodIndices));
+  memset(boundsMin, 0, sizeof(boundsMin));
+  memset(boundsMax, 0, sizeof(boundsMax));
+  memset(sphereCenter, 0, sizeof(sphereCenter));
+}
 
 MSVMesh::MSVMesh(unsigned int nVertices,
                  float *vertices,
                  float *normals,
                  float *texCoords,
                  unsigned int nFaces,
-                 float *faces)
+                 float *faces) :
+MSVAsset(MESH),
+nMorphs(0),
+nBones(0),
+boneParents(NULL),
+restPose(NULL),
+inverseBind(NULL),
+boneIndices(NULL),
+boneWeights(NULL),
+animation(NULL),
+sphereRadius(0),
+bvh(NULL),
+vbo(0),
+lodsBuilt(false)
 {
+  memset(morphs, 0, sizeof(morphs));
+  memset(ibo, 0, sizeof(ibo));
+  memset(lodFaces, 0, sizeof(lodFaces));
+  memset(lodIndices, 0, sizeof(lodIndices));
   set(nVertices, vertices, normals, texCoords, nFaces, faces);
 }
 
@@ -40,19 +85,292 @@ MSVMesh::set(unsigned int nVertices,
   this->nFaces = nFaces;
   this->faces     = new float[3*nFaces];
   memcpy(this->faces, faces, 3*nFaces*sizeof(float));
+  computeBounds();
+}
+
+void
+MSVMesh::computeBounds()
+{
+  if (!nVertices) {
+    memset(boundsMin, 0, sizeof(boundsMin));
+    memset(boundsMax, 0, sizeof(boundsMax));
+    memset(sphereCenter, 0, sizeof(sphereCenter));
+    sphereRadius = 0;
+    return;
+  }
+  memcpy(boundsMin, vertices, sizeof(boundsMin));
+  memcpy(boundsMax, vertices, sizeof(boundsMax));
+  for (unsigned int i = 1; i < nVertices; ++i) {
+    const float *v = vertices + 3*i;
+    for (int c = 0; c < 3; ++c) {
+      if (v[c] < boundsMin[c]) boundsMin[c] = v[c];
+      if (v[c] > boundsMax[c]) boundsMax[c] = v[c];
+    }
+  }
+  // Centered on the box, which is tighter than the half diagonal for most
+  // models
+  float r2 = 0;
+  for (int c = 0; c < 3; ++c)
+    sphereCenter[c] = 0.5f*(boundsMin[c] + boundsMax[c]);
+  for (unsigned int i = 0; i < nVertices; ++i) {
+    const float *v = vertices + 3*i;
+    float dx = v[0] - sphereCenter[0];
+    float dy = v[1] - sphereCenter[1];
+    float dz = v[2] - sphereCenter[2];
+    float d2 = dx*dx + dy*dy + dz*dz;
+    if (d2 > r2) r2 = d2;
+  }
+  sphereRadius = sqrtf(r2);
 }
 
 MSVMesh::~MSVMesh()
 {
+  if (vbo) MSVResourceManager::release(MSVResourceManager::BUFFER, vbo);
+  for (int i = 0; i < MESH_LODS; ++i) {
+    if (ibo[i]) MSVResourceManager::release(MSVResourceManager::BUFFER, ibo[i]);
+    delete [] lodIndices[i];
+  }
   if (vertices)  delete [] vertices;
   if (normals)   delete [] normals;
   if (texCoords) delete [] texCoords;
   if (faces)     delete [] faces;
+  for (unsigned int i = 0; i < nMorphs; ++i)
+    delete [] morphs[i];
+  delete [] boneParents;
+  delete [] restPose;
+  delete [] inverseBind;
+  delete [] boneIndices;
+  delete [] boneWeights;
+  delete animation;
+  delete bvh;
+}
+
+bool
+MSVMesh::addMorphTarget(const float *deltas)
+{
+  if (nMorphs == MESH_MAX_MORPH_TARGETS) return false;
+  morphs[nMorphs] = new float[3*nVertices];
+  memcpy(morphs[nMorphs], deltas, 3*nVertices*sizeof(float));
+  nMorphs++;
+  // Weights add up the offsets: grow the bounds by the extreme ones
+  float lo[3] = {0, 0, 0};
+  float hi[3] = {0, 0, 0};
+  float r2 = 0;
+  for (unsigned int i = 0; i < nVertices; ++i) {
+    const float *d = deltas + 3*i;
+    for (int c = 0; c < 3; ++c) {
+      if (d[c] < lo[c]) lo[c] = d[c];
+      if (d[c] > hi[c]) hi[c] = d[c];
+    }
+    float d2 = d[0]*d[0] + d[1]*d[1] + d[2]*d[2];
+    if (d2 > r2) r2 = d2;
+  }
+  for (int c = 0; c < 3; ++c) {
+    boundsMin[c] += lo[c];
+    boundsMax[c] += hi[c];
+  }
+  sphereRadius += sqrtf(r2);
+  return true;
+}
+
+unsigned int
+MSVMesh::getMorphTargetsCount() const
+{
+  return nMorphs;
+}
+
+bool
+MSVMesh::setSkin(unsigned int nBones,
+                 const int *parents,
+                 const float *restPose,
+                 const float *inverseBindMatrices,
+                 const float *boneIndices,
+                 const float *boneWeights)
+{
+  if (!nBones || nBones > MESH_MAX_BONES) return false;
+  // Parents first, so that the palette is computed in one pass
+  for (unsigned int b = 0; b < nBones; ++b)
+    if (parents[b] >= (int)b) return false;
+  for (unsigned int i = 0; i < MESH_BONE_INFLUENCES*nVertices; ++i)
+    if (boneIndices[i] < 0 || boneIndices[i] >= nBones) return false;
+  delete [] boneParents;
+  delete [] this->restPose;
+  delete [] inverseBind;
+  delete [] this->boneIndices;
+  delete [] this->boneWeights;
+  this->nBones = nBones;
+  boneParents = new int[nBones];
+  memcpy(boneParents, parents, nBones*sizeof(int));
+  this->restPose = new float[BONE_POSE_SIZE*nBones];
+  memcpy(this->restPose, restPose, BONE_POSE_SIZE*nBones*sizeof(float));
+  inverseBind = new float[16*nBones];
+  memcpy(inverseBind, inverseBindMatrices, 16*nBones*sizeof(float));
+  this->boneIndices = new float[MESH_BONE_INFLUENCES*nVertices];
+  memcpy(this->boneIndices, boneIndices,
+         MESH_BONE_INFLUENCES*nVertices*sizeof(float));
+  this->boneWeights = new float[MESH_BONE_INFLUENCES*nVertices];
+  memcpy(this->boneWeights, boneWeights,
+         MESH_BONE_INFLUENCES*nVertices*sizeof(float));
+  return true;
+}
+
+unsigned int
+MSVMesh::getBonesCount() const
+{
+  return nBones;
+}
+
+void
+MSVMesh::setAnimation(MSVAnimation *clip)
+{
+  delete animation;
+  animation = clip;
+}
+
+const MSVAnimation *
+MSVMesh::getAnimation() const
+{
+  return animation;
+}
+
+bool
+MSVMesh::isAnimated() const
+{
+  return nMorphs > 0 || nBones > 0;
+}
+
+void
+MSVMesh::getBounds(float min[3], float max[3]) const
+{
+  memcpy(min, boundsMin, sizeof(boundsMin));
+  memcpy(max, boundsMax, sizeof(boundsMax));
+}
+
+void
+MSVMesh::getBoundingSphere(float center[3], float *radius) const
+{
+  memcpy(center, sphereCenter, sizeof(sphereCenter));
+  *radius = sphereRadius;
+}
+
+bool
+MSVMesh::hasBounds() const
+{
+  return nBones == 0;
+}
+
+const MSVBVH *
+MSVMesh::getBVH()
+{
+  MSVBVH *tree = __atomic_load_n(&bvh, __ATOMIC_ACQUIRE);
+  if (tree) return tree;
+  pthread_mutex_lock(&bvhLock);
+  tree = bvh;
+  if (!tree) {
+    tree = new MSVBVH(vertices, nFaces, faces);
+    // Publish the tree once fully built
+    __atomic_store_n(&bvh, tree, __ATOMIC_RELEASE);
+  }
+  pthread_mutex_unlock(&bvhLock);
+  return tree;
+}
+
+void
+MSVMesh::buildLods()
+{
+  if (__atomic_load_n(&lodsBuilt, __ATOMIC_ACQUIRE)) return;
+  pthread_mutex_lock(&bvhLock);
+  if (!lodsBuilt) {
+    for (int lod = 1; lod < MESH_LODS; ++lod) lodIndices[lod] = buildLod(lod);
+    // Publish the levels once fully built
+    __atomic_store_n(&lodsBuilt, true, __ATOMIC_RELEASE);
+  }
+  pthread_mutex_unlock(&bvhLock);
+}
+
+/* Converts a bone pose into a 3x4 row-major affine matrix */
+static void
+poseToAffine(const float *pose, float m[12])
+{
+  const float *t = pose;
+  float x = pose[3], y = pose[4], z = pose[5], w = pose[6];
+  const float *s = pose + 7;
+  m[0]  = (1 - 2*(y*y + z*z))*s[0];
+  m[1]  = 2*(x*y - z*w)*s[1];
+  m[2]  = 2*(x*z + y*w)*s[2];
+  m[3]  = t[0];
+  m[4]  = 2*(x*y + z*w)*s[0];
+  m[5]  = (1 - 2*(x*x + z*z))*s[1];
+  m[6]  = 2*(y*z - x*w)*s[2];
+  m[7]  = t[1];
+  m[8]  = 2*(x*z - y*w)*s[0];
+  m[9]  = 2*(y*z + x*w)*s[1];
+  m[10] = (1 - 2*(x*x + y*y))*s[2];
+  m[11] = t[2];
+}
+
+/* c = a * b, for 3x4 row-major affine matrices. c must not alias b. */
+static void
+multiplyAffine(const float *a, const float *b, float *c)
+{
+  for (int r = 0; r < 3; ++r) {
+    float a0 = a[4*r], a1 = a[4*r+1], a2 = a[4*r+2], a3 = a[4*r+3];
+    c[4*r]   = a0*b[0] + a1*b[4] + a2*b[8];
+    c[4*r+1] = a0*b[1] + a1*b[5] + a2*b[9];
+    c[4*r+2] = a0*b[2] + a1*b[6] + a2*b[10];
+    c[4*r+3] = a0*b[3] + a1*b[7] + a2*b[11] + a3;
+  }
+}
+
+void
+MSVMesh::pose(float time,
+              float weights[MESH_MAX_MORPH_TARGETS],
+              float palette[12*MESH_MAX_BONES]) const
+{
+  if (!animation || !animation->sampleMorph(time, weights))
+    memset(weights, 0, MESH_MAX_MORPH_TARGETS*sizeof(float));
+  if (!nBones) {
+    static const float identity[12] = {1, 0, 0, 0,
+                                       0, 1, 0, 0,
+                                       0, 0, 1, 0};
+    memcpy(palette, identity, sizeof(identity));
+    return;
+  }
+  // Bone to mesh space transforms, parents being computed first
+  float global[12*MESH_MAX_BONES];
+  for (unsigned int b = 0; b < nBones; ++b) {
+    float bonePose[BONE_POSE_SIZE];
+    const float *p = restPose + BONE_POSE_SIZE*b;
+    if (animation && animation->sampleBone(b, time, bonePose)) p = bonePose;
+    float local[12];
+    poseToAffine(p, local);
+    if (boneParents[b] >= 0)
+      multiplyAffine(global + 12*boneParents[b], local, global + 12*b);
+    else
+      memcpy(global + 12*b, local, sizeof(local));
+  }
+  // Then from the bind pose
+  for (unsigned int b = 0; b < nBones; ++b) {
+    const float *ib = inverseBind + 16*b;
+    float bind[12] = {ib[0], ib[4], ib[8],  ib[12],
+                      ib[1], ib[5], ib[9],  ib[13],
+                      ib[2], ib[6], ib[10], ib[14]};
+    multiplyAffine(global + 12*b, bind, palette + 12*b);
+  }
 }
 
 MSVMesh *
 MSVMesh::getNormalizedPlane()
 {
+  pthread_once(&planeOnce, MSVMesh::createNormalizedPlane);
+  plane->retain();
+  return plane;
+}
+
+void
+MSVMesh::createNormalizedPlane()
+{
+  // Its first reference is never released
   MSVMesh *m = new MSVMesh();
   m->nVertices = NUM_PLANE_OBJECT_VERTEX;
   m->nFaces  = NUM_PLANE_OBJECT_FACES;
@@ -63,8 +381,65 @@ MSVMesh::getNormalizedPlane()
   m->texCoords = new float[2*m->nVertices];
   memcpy(m->texCoords, planeTexCoords, 2*m->nVertices*sizeof(float));
   m->faces     = new float[3*m->nFaces];
-  memcpy(m->faces, planeIndices, 3*m->nFaces*sizeof(float));
-  return m;
+  for (unsigned int i = 0; i < 3*m->nFaces; ++i)
+    m->faces[i] = planeIndices[i];
+  m->computeBounds();
+  plane = m;
+}
+
+uint64_t
+MSVMesh::contentHash() const
+{
+  unsigned int header[2] = {nVertices, nFaces};
+  uint64_t h = hash(header, sizeof(header));
+  h = hash(vertices, 3*nVertices*sizeof(float), h);
+  h = hash(normals, 3*nVertices*sizeof(float), h);
+  h = hash(texCoords, 2*nVertices*sizeof(float), h);
+  h = hash(faces, 3*nFaces*sizeof(float), h);
+  if (!isAnimated() && !animation) return h;
+  unsigned int animHeader[2] = {nMorphs, nBones};
+  h = hash(animHeader, sizeof(animHeader), h);
+  for (unsigned int i = 0; i < nMorphs; ++i)
+    h = hash(morphs[i], 3*nVertices*sizeof(float), h);
+  if (nBones) {
+    h = hash(boneParents, nBones*sizeof(int), h);
+    h = hash(restPose, BONE_POSE_SIZE*nBones*sizeof(float), h);
+    h = hash(inverseBind, 16*nBones*sizeof(float), h);
+    h = hash(boneIndices, MESH_BONE_INFLUENCES*nVertices*sizeof(float), h);
+    h = hash(boneWeights, MESH_BONE_INFLUENCES*nVertices*sizeof(float), h);
+  }
+  return animation ? animation->contentHash(h) : h;
+}
+
+bool
+MSVMesh::sameContent(const MSVAsset *other) const
+{
+  const MSVMesh *m = static_cast<const MSVMesh *>(other);
+  return nVertices == m->nVertices && nFaces == m->nFaces &&
+         !memcmp(vertices, m->vertices, 3*nVertices*sizeof(float)) &&
+         !memcmp(normals, m->normals, 3*nVertices*sizeof(float)) &&
+         !memcmp(texCoords, m->texCoords, 2*nVertices*sizeof(float)) &&
+         !memcmp(faces, m->faces, 3*nFaces*sizeof(float)) &&
+         sameAnimation(m);
+}
+
+bool
+MSVMesh::sameAnimation(const MSVMesh *m) const
+{
+  if (nMorphs != m->nMorphs || nBones != m->nBones) return false;
+  for (unsigned int i = 0; i < nMorphs; ++i)
+    if (memcmp(morphs[i], m->morphs[i], 3*nVertices*sizeof(float))) return false;
+  if (nBones &&
+      (memcmp(boneParents, m->boneParents, nBones*sizeof(int)) ||
+       memcmp(restPose, m->restPose, BONE_POSE_SIZE*nBones*sizeof(float)) ||
+       memcmp(inverseBind, m->inverseBind, 16*nBones*sizeof(float)) ||
+       memcmp(boneIndices, m->boneIndices,
+              MESH_BONE_INFLUENCES*nVertices*sizeof(float)) ||
+       memcmp(boneWeights, m->boneWeights,
+              MESH_BONE_INFLUENCES*nVertices*sizeof(float))))
+    return false;
+  if (!animation || !m->animation) return animation == m->animation;
+  return animation->sameContent(m->animation);
 }
 
 unsigned int
@@ -92,9 +467,11 @@ MSVMesh::getTexCoords() const
 }
 
 unsigned int
-MSVMesh::getFacesCount() const
+MSVMesh::getFacesCount(int lod) const
 {
-  return this->nFaces;
+  if (lod <= 0 || lod >= MESH_LODS || !__atomic_load_n(&lodsBuilt, __ATOMIC_ACQUIRE))
+    return this->nFaces;
+  return lodFaces[lod];
 }
 
 const float *
@@ -102,3 +479,169 @@ MSVMesh::getFaces() const
 {
   return this->faces;
 }
+
+GLuint
+MSVMesh::glVertexBuffer()
+{
+  if (!vbo) {
+    MSV_TRACE_SCOPE("uploadVertices");
+    size_t size = getVertexBufferSize();
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STATIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0,
+                    3*nVertices*sizeof(float), vertices);
+    glBufferSubData(GL_ARRAY_BUFFER, getNormalsOffset(),
+                    3*nVertices*sizeof(float), normals);
+    glBufferSubData(GL_ARRAY_BUFFER, getTexCoordsOffset(),
+                    2*nVertices*sizeof(float), texCoords);
+    for (unsigned int i = 0; i < nMorphs; ++i) {
+      glBufferSubData(GL_ARRAY_BUFFER, getMorphTargetOffset(i),
+                      3*nVertices*sizeof(float), morphs[i]);
+    }
+    if (nBones) {
+      glBufferSubData(GL_ARRAY_BUFFER, getBoneIndicesOffset(),
+                      MESH_BONE_INFLUENCES*nVertices*sizeof(float), boneIndices);
+      glBufferSubData(GL_ARRAY_BUFFER, getBoneWeightsOffset(),
+                      MESH_BONE_INFLUENCES*nVertices*sizeof(float), boneWeights);
+    }
+    MSVResourceManager::track(MSVResourceManager::BUFFER, vbo, size, this);
+  }
+  else {
+    MSVResourceManager::touch(MSVResourceManager::BUFFER, vbo);
+  }
+  return vbo;
+}
+
+size_t
+MSVMesh::getVertexBufferSize() const
+{
+  return getBoneIndicesOffset() +
+         (nBones ? 2*MESH_BONE_INFLUENCES*nVertices*sizeof(float) : 0);
+}
+
+size_t
+MSVMesh::getNormalsOffset() const
+{
+  return 3*nVertices*sizeof(float);
+}
+
+size_t
+MSVMesh::getTexCoordsOffset() const
+{
+  return 6*nVertices*sizeof(float);
+}
+
+size_t
+MSVMesh::getMorphTargetOffset(unsigned int target) const
+{
+  return (8 + 3*target)*nVertices*sizeof(float);
+}
+
+size_t
+MSVMesh::getBoneIndicesOffset() const
+{
+  return getMorphTargetOffset(nMorphs);
+}
+
+size_t
+MSVMesh::getBoneWeightsOffset() const
+{
+  return getBoneIndicesOffset() + MESH_BONE_INFLUENCES*nVertices*sizeof(float);
+}
+
+GLuint
+MSVMesh::glIndexBuffer(int lod)
+{
+  if (lod < 0) lod = 0;
+  if (lod >= MESH_LODS) lod = MESH_LODS - 1;
+  // Only built here for meshes drawn without a built MSVModel
+  if (lod) buildLods();
+  // Levels that could not be simplified are the full mesh
+  if (lod && !lodIndices[lod]) return glIndexBuffer(0);
+  if (!ibo[lod]) {
+    MSV_TRACE_SCOPE("uploadIndices");
+    GLushort *indices = lodIndices[lod];
+    if (!lod) {
+      indices = new GLushort[3*nFaces];
+      for (unsigned int i = 0; i < 3*nFaces; ++i)
+        indices[i] = (GLushort)faces[i];
+      lodFaces[0] = nFaces;
+    }
+    size_t size = 3*lodFaces[lod]*sizeof(GLushort);
+    glGenBuffers(1, &ibo[lod]);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo[lod]);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, indices, GL_STATIC_DRAW);
+    // The simplified levels are kept, to be uploaded again if evicted
+    if (!lod) delete [] indices;
+    MSVResourceManager::track(MSVResourceManager::BUFFER, ibo[lod], size, this);
+  }
+  else {
+    MSVResourceManager::touch(MSVResourceManager::BUFFER, ibo[lod]);
+  }
+  return ibo[lod];
+}
+
+GLushort *
+MSVMesh::buildLod(int lod)
+{
+  MSV_TRACE_SCOPE("buildMeshLod");
+  // Bounding box
+  float lo[3] = {0, 0, 0};
+  float hi[3] = {0, 0, 0};
+  for (unsigned int v = 0; v < nVertices; ++v) {
+    for (int k = 0; k < 3; ++k) {
+      float x = vertices[3*v+k];
+      if (!v || x < lo[k]) lo[k] = x;
+      if (!v || x > hi[k]) hi[k] = x;
+    }
+  }
+  // Vertex clustering: each vertex is replaced by the first vertex that
+  // fell in the same grid cell, and faces that collapse are dropped.
+  int res = MESH_LOD_GRID >> (lod - 1);
+  if (res < 1) res = 1;
+  int *cells = new int[res*res*res];
+  for (int i = 0; i < res*res*res; ++i) cells[i] = -1;
+  int *rep = new int[nVertices];
+  for (unsigned int v = 0; v < nVertices; ++v) {
+    int c = 0;
+    for (int k = 0; k < 3; ++k) {
+      float extent = hi[k] - lo[k];
+      int i = extent > 0 ? (int)((vertices[3*v+k] - lo[k])/extent*res) : 0;
+      if (i >= res) i = res - 1;
+      c = c*res + i;
+    }
+    if (cells[c] < 0) cells[c] = v;
+    rep[v] = cells[c];
+  }
+  GLushort *indices = new GLushort[3*nFaces];
+  unsigned int n = 0;
+  for (unsigned int f = 0; f < nFaces; ++f) {
+    int a = rep[(int)faces[3*f]];
+    int b = rep[(int)faces[3*f+1]];
+    int c = rep[(int)faces[3*f+2]];
+    if (a == b || b == c || a == c) continue;
+    indices[3*n]   = (GLushort)a;
+    indices[3*n+1] = (GLushort)b;
+    indices[3*n+2] = (GLushort)c;
+    n++;
+  }
+  delete [] rep;
+  delete [] cells;
+  // A level whose faces all collapse, or none, is the full mesh instead
+  if (!n || n == nFaces) {
+    delete [] indices;
+    lodFaces[lod] = nFaces;
+    return NULL;
+  }
+  lodFaces[lod] = n;
+  return indices;
+}
+
+void
+MSVMesh::resourceEvicted(GLuint name)
+{
+  if (name == vbo) vbo = 0;
+  for (int i = 0; i < MESH_LODS; ++i)
+    if (name == ibo[i]) ibo[i] = 0;
+}
@@ -1,12 +1,35 @@
 #ifndef MSV_MESH_H
 #define MSV_MESH_H
 
+#include "MSVAnimation.h"
+#include "MSVAsset.h"
+#include "MSVResourceManager.h"
+
+class MSVBVH;
+
+/** Number of levels of detail of a mesh, including the full mesh */
+#define MESH_LODS       3
+/** Resolution of the vertex clustering grid of the first simplified level,
+ * halved at each following level.
+ */
+#define MESH_LOD_GRID   32
+
 /** Class representing a 3D mesh.
  *
  * Currently, it is assumed that it will be rendered using the
  * GL_TRIANGLES mode.
+ *
+ * Meshes are reference-counted (see MSVAsset): use `release()` instead of
+ * deleting them.
+ *
+ * A mesh can be animated on the GPU, with morph targets (position offsets
+ * blended by weights) and/or a skin (each vertex following up to
+ * MESH_BONE_INFLUENCES bones), driven by an MSVAnimation clip. All the
+ * vertex data stays in the vertex buffer object: only the weights and the
+ * bone palette change from frame to frame. The animation data must be set
+ * before the mesh is given to the MSVController.
  */
-class MSVMesh {
+class MSVMesh : public MSVAsset, public MSVResourceManager::Owner {
 
   public:
     MSVMesh(unsigned int nVertices,
@@ -15,19 +38,128 @@ class MSVMesh {
             float *texCoords,
             unsigned int nFaces,
             float *faces);
-    virtual ~MSVMesh();
     unsigned int getVerticesCount() const;
     const float *getVertices() const;
     const float *getNormals() const;
     const float *getTexCoords() const;
-    unsigned int getFacesCount() const;
+    /** Returns the number of faces of the given level of detail. Simplified
+     * levels are only known once built by `buildLods`: until then, the full
+     * count is returned.
+     */
+    unsigned int getFacesCount(int lod = 0) const;
     const float *getFaces() const;
 
-    /** Returns a 2x2 plane */
+    /** Adds a morph target.
+     * @param deltas the offsets of the vertices positions, 3 per vertex.
+     * @return false if the mesh already has MESH_MAX_MORPH_TARGETS targets.
+     */
+    bool addMorphTarget(const float *deltas);
+    unsigned int getMorphTargetsCount() const;
+
+    /** Sets the skin of the mesh.
+     * @param nBones the number of bones, up to MESH_MAX_BONES.
+     * @param parents the parent of each bone, or -1 for roots. Parents must
+     * come before their children.
+     * @param restPose the pose of each bone relative to its parent when it
+     * is not animated, BONE_POSE_SIZE floats per bone.
+     * @param inverseBindMatrices one 4x4 column-major matrix per bone,
+     * from the mesh space to the space of the bone in the bind pose.
+     * @param boneIndices, boneWeights the bones each vertex is attached to,
+     * MESH_BONE_INFLUENCES per vertex. Weights should sum to 1.
+     * @return false if the skeleton is invalid.
+     */
+    bool setSkin(unsigned int nBones,
+                 const int *parents,
+                 const float *restPose,
+                 const float *inverseBindMatrices,
+                 const float *boneIndices,
+                 const float *boneWeights);
+    /** Returns the number of bones, 0 if the mesh is not skinned */
+    unsigned int getBonesCount() const;
+
+    /** Sets the animation clip played by the mesh, whose ownership is
+     * transferred.
+     */
+    void setAnimation(MSVAnimation *clip);
+    const MSVAnimation *getAnimation() const;
+
+    /** Returns true if the mesh has morph targets or a skin */
+    bool isAnimated() const;
+
+    /** Gets the axis-aligned bounding box of the mesh, in the mesh space.
+     * It encloses the morph targets too, for weights between 0 and 1.
+     */
+    void getBounds(float min[3], float max[3]) const;
+    /** Gets the bounding sphere of the mesh, in the mesh space */
+    void getBoundingSphere(float center[3], float *radius) const;
+    /** Returns false if the bounds do not hold once animated, i.e. the
+     * mesh is skinned: bones can take the vertices anywhere.
+     */
+    bool hasBounds() const;
+
+    /** Returns the bounding volume hierarchy of the faces, for ray casting.
+     * Built on first call, which MSVModel::build does when the model is
+     * loaded. Can be called from any thread. Animated meshes are tested in
+     * their rest pose.
+     */
+    const MSVBVH *getBVH();
+
+    /** Builds the indices of the simplified levels of detail, by clustering
+     * the vertices on a grid. Built once, which MSVModel::build does when
+     * the model is loaded, so that `glIndexBuffer` only uploads them. Can be
+     * called from any thread.
+     */
+    void buildLods();
+
+    /** Evaluates the animation at `time` seconds, into the uniforms of the
+     * animated vertex shader.
+     * @param weights the weights of the morph targets.
+     * @param palette the skinning matrices: 3 rows of 4 floats per bone,
+     * for max(1, getBonesCount()) bones. Unskinned meshes get the identity.
+     */
+    void pose(float time,
+              float weights[MESH_MAX_MORPH_TARGETS],
+              float palette[12*MESH_MAX_BONES]) const;
+
+    /** Returns the OpenGL buffer object holding the vertices, followed by
+     * the normals, the texture coordinates, and the animation data if any.
+     * Uploaded on first call, or again after an eviction. Must be called
+     * from GL thread.
+     */
+    GLuint glVertexBuffer();
+    /** Size of the vertex buffer object, in bytes */
+    size_t getVertexBufferSize() const;
+    /** Byte offsets of the normals and texture coordinates in the vertex
+     * buffer object.
+     */
+    size_t getNormalsOffset() const;
+    size_t getTexCoordsOffset() const;
+    /** Byte offsets of the animation data in the vertex buffer object: the
+     * offsets of each morph target, then the bone indices and weights.
+     */
+    size_t getMorphTargetOffset(unsigned int target) const;
+    size_t getBoneIndicesOffset() const;
+    size_t getBoneWeightsOffset() const;
+    /** Returns the OpenGL buffer object holding the faces as
+     * GL_UNSIGNED_SHORT indices. Must be called from GL thread.
+     * @param lod the level of detail, from 0 (full mesh) to MESH_LODS - 1.
+     * Simplified levels (see `buildLods`) index the same vertex buffer.
+     */
+    GLuint glIndexBuffer(int lod = 0);
+
+    /** Implementation of MSVResourceManager::Owner */
+    void resourceEvicted(GLuint name);
+
+    /** Returns a reference to the shared, immutable 2x2 plane */
     static MSVMesh *getNormalizedPlane();
 
   protected:
     MSVMesh();
+    virtual ~MSVMesh();
+
+    /** Implementation of MSVAsset */
+    uint64_t contentHash() const;
+    bool sameContent(const MSVAsset *other) const;
     void set(unsigned int nVertices,
              float *vertices,
              float *normals,
@@ -42,6 +174,39 @@ class MSVMesh {
       float *texCoords;
       unsigned int nFaces;
       float *faces;
+      unsigned int nMorphs;
+      float *morphs[MESH_MAX_MORPH_TARGETS];
+      unsigned int nBones;
+      int *boneParents;
+      float *restPose;
+      float *inverseBind;
+      float *boneIndices;
+      float *boneWeights;
+      MSVAnimation *animation;
+      float boundsMin[3];
+      float boundsMax[3];
+      float sphereCenter[3];
+      float sphereRadius;
+      MSVBVH * volatile bvh;
+      GLuint vbo;
+      GLuint ibo[MESH_LODS];
+      /** Faces count of each level, 0 until built */
+      unsigned int lodFaces[MESH_LODS];
+      /** Indices of the simplified levels, NULL for the levels that could
+       * not be simplified
+       */
+      GLushort *lodIndices[MESH_LODS];
+      volatile bool lodsBuilt;
+
+      GLushort *buildLod(int lod);
+      void computeBounds();
+      bool sameAnimation(const MSVMesh *m) const;
+
+      /** Serializes the BVH and LOD builds */
+      static pthread_mutex_t bvhLock;
+      static MSVMesh *plane;
+      static pthread_once_t planeOnce;
+      static void createNormalizedPlane();
 };
 
 #endif
@@ -0,0 +1,339 @@
+#include "MSVMesh.h"
+#include "MSVModel.h"
+#include "MSVTexture.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_PART_NUMBER 4
+
+static const float identity[16] = {1, 0, 0, 0,
+                                   0, 1, 0, 0,
+                                   0, 0, 1, 0,
+                                   0, 0, 0, 1};
+
+MSVModel::MSVModel() :
+MSVAsset(MODEL),
+parts(NULL),
+nParts(0),
+capacity(0),
+sources(NULL),
+firstSource(NULL),
+built(false),
+bounded(false)
+{
+  memset(boundsMin, 0, sizeof(boundsMin));
+  memset(boundsMax, 0, sizeof(boundsMax));
+}
+
+MSVModel::~MSVModel()
+{
+  for (unsigned int i = 0; i < nParts; ++i) {
+    parts[i].mesh->release();
+    parts[i].tex->release();
+  }
+  free(parts);
+  free(sources);
+  free(firstSource);
+}
+
+void
+MSVModel::addPart(MSVMesh *mesh, MSVTexture *tex, const float transform[16])
+{
+  if (nParts == capacity) {
+    capacity = capacity ? 2*capacity : INITIAL_PART_NUMBER;
+    parts = (Part *)realloc(parts, capacity*sizeof(Part));
+  }
+  Part *p = &parts[nParts++];
+  // Identical meshes and textures end up as the same objects, which makes
+  // the parts sharing a texture easy to find
+  p->mesh = mesh ? static_cast<MSVMesh *>(MSVAsset::intern(mesh)) :
+                   MSVMesh::getNormalizedPlane();
+  p->tex = tex ? static_cast<MSVTexture *>(MSVAsset::intern(tex)) :
+                 MSVTexture::getTransparentTexture();
+  memcpy(p->transform, transform ? transform : identity, 16*sizeof(float));
+  built = false;
+}
+
+void
+MSVModel::getSourceFace(unsigned int part,
+                        unsigned int face,
+                        unsigned int *sourcePart,
+                        unsigned int *sourceFace) const
+{
+  if (!sources) {
+    *sourcePart = part;
+    *sourceFace = face;
+    return;
+  }
+  // The last source starting at or before the face
+  unsigned int s = firstSource[part];
+  while (s + 1 < firstSource[part + 1] && sources[s + 1].firstFace <= face) s++;
+  *sourcePart = sources[s].part;
+  *sourceFace = face - sources[s].firstFace;
+}
+
+unsigned int
+MSVModel::getPartsCount() const
+{
+  return nParts;
+}
+
+const MSVModel::Part *
+MSVModel::getPart(unsigned int i) const
+{
+  return &parts[i];
+}
+
+int
+MSVModel::compareParts(const void *a, const void *b)
+{
+  const Part *x = (const Part *)a;
+  const Part *y = (const Part *)b;
+  // By program first, then by texture
+  int ax = x->mesh->isAnimated();
+  int ay = y->mesh->isAnimated();
+  if (ax != ay) return ax - ay;
+  uintptr_t tx = (uintptr_t)x->tex;
+  uintptr_t ty = (uintptr_t)y->tex;
+  return (tx > ty) - (tx < ty);
+}
+
+int
+MSVModel::compareSortedParts(const void *a, const void *b)
+{
+  const SortedPart *x = (const SortedPart *)a;
+  const SortedPart *y = (const SortedPart *)b;
+  int c = compareParts(&x->part, &y->part);
+  // qsort is not stable: keep the order of addition among equal parts
+  if (!c) c = (x->index > y->index) - (x->index < y->index);
+  return c;
+}
+
+void
+MSVModel::build()
+{
+  if (built) return;
+  built = true;
+  computeBounds();
+  if (nParts > 1) batch();
+  // Built now rather than on the first hit test, or the first frame drawn
+  // at a lower quality, which must stay fast
+  for (unsigned int i = 0; i < nParts; ++i) {
+    parts[i].mesh->getBVH();
+    parts[i].mesh->buildLods();
+  }
+}
+
+void
+MSVModel::batch()
+{
+  // Sorted along with their indices, so that faces can be traced back to
+  // the parts they come from (see getSourceFace)
+  SortedPart *sorted = (SortedPart *)malloc(nParts*sizeof(SortedPart));
+  if (!sorted) return;
+  for (unsigned int i = 0; i < nParts; ++i) {
+    sorted[i].part = parts[i];
+    sorted[i].index = i;
+  }
+  qsort(sorted, nParts, sizeof(SortedPart), MSVModel::compareSortedParts);
+  free(sources);
+  free(firstSource);
+  sources = (Source *)malloc(nParts*sizeof(Source));
+  firstSource = (unsigned int *)malloc((nParts + 1)*sizeof(unsigned int));
+  if (!sources || !firstSource) {
+    free(sources);
+    free(firstSource);
+    sources = NULL;
+    firstSource = NULL;
+    free(sorted);
+    return;
+  }
+  for (unsigned int i = 0; i < nParts; ++i) {
+    parts[i] = sorted[i].part;
+    sources[i].part = sorted[i].index;
+    sources[i].firstFace = 0;
+  }
+  free(sorted);
+
+  // Merge the runs of static parts sharing a texture, in batches that
+  // GL_UNSIGNED_SHORT indices can address
+  unsigned int out = 0;
+  unsigned int i = 0;
+  while (i < nParts) {
+    unsigned int end = i + 1;
+    unsigned int vertices = parts[i].mesh->getVerticesCount();
+    if (!parts[i].mesh->isAnimated()) {
+      while (end < nParts && parts[end].tex == parts[i].tex &&
+             !parts[end].mesh->isAnimated() &&
+             vertices + parts[end].mesh->getVerticesCount() <= MODEL_MAX_BATCH_VERTICES) {
+        vertices += parts[end].mesh->getVerticesCount();
+        end++;
+      }
+    }
+    firstSource[out] = i;
+    if (end - i > 1) {
+      // Faces are merged in the order of the parts
+      unsigned int faces = 0;
+      for (unsigned int j = i; j < end; ++j) {
+        sources[j].firstFace = faces;
+        faces += parts[j].mesh->getFacesCount();
+      }
+      MSVMesh *merged = merge(parts + i, end - i);
+      MSVTexture *tex = parts[i].tex;
+      tex->retain();
+      for (unsigned int j = i; j < end; ++j) {
+        parts[j].mesh->release();
+        parts[j].tex->release();
+      }
+      parts[out].mesh = static_cast<MSVMesh *>(MSVAsset::intern(merged));
+      parts[out].tex = tex;
+      memcpy(parts[out].transform, identity, sizeof(identity));
+    }
+    else {
+      parts[out] = parts[i];
+    }
+    out++;
+    i = end;
+  }
+  firstSource[out] = nParts;
+  nParts = out;
+}
+
+void
+MSVModel::getBounds(float min[3], float max[3]) const
+{
+  memcpy(min, boundsMin, sizeof(boundsMin));
+  memcpy(max, boundsMax, sizeof(boundsMax));
+}
+
+bool
+MSVModel::hasBounds() const
+{
+  return bounded;
+}
+
+void
+MSVModel::computeBounds()
+{
+  bounded = nParts > 0;
+  for (unsigned int i = 0; i < nParts; ++i) {
+    const MSVMesh *mesh = parts[i].mesh;
+    if (!mesh->hasBounds()) {
+      bounded = false;
+      return;
+    }
+    float lo[3], hi[3];
+    mesh->getBounds(lo, hi);
+    // Box of the 8 transformed corners
+    const float *m = parts[i].transform;
+    for (int k = 0; k < 8; ++k) {
+      float p[3] = {(k & 1) ? hi[0] : lo[0],
+                    (k & 2) ? hi[1] : lo[1],
+                    (k & 4) ? hi[2] : lo[2]};
+      for (int r = 0; r < 3; ++r) {
+        float v = m[r]*p[0] + m[4+r]*p[1] + m[8+r]*p[2] + m[12+r];
+        if ((i == 0 && k == 0) || v < boundsMin[r]) boundsMin[r] = v;
+        if ((i == 0 && k == 0) || v > boundsMax[r]) boundsMax[r] = v;
+      }
+    }
+  }
+}
+
+MSVMesh *
+MSVModel::merge(const Part *parts, unsigned int n)
+{
+  unsigned int nVertices = 0;
+  unsigned int nFaces = 0;
+  for (unsigned int i = 0; i < n; ++i) {
+    nVertices += parts[i].mesh->getVerticesCount();
+    nFaces += parts[i].mesh->getFacesCount();
+  }
+  float *vertices = new float[3*nVertices];
+  float *normals = new float[3*nVertices];
+  float *texCoords = new float[2*nVertices];
+  float *faces = new float[3*nFaces];
+
+  unsigned int v = 0;
+  unsigned int f = 0;
+  for (unsigned int i = 0; i < n; ++i) {
+    const MSVMesh *mesh = parts[i].mesh;
+    const float *m = parts[i].transform;
+    // Normals are transformed by the cofactor matrix (column-major), i.e.
+    // the inverse transpose up to the determinant
+    float c[9] = {m[5]*m[10] - m[6]*m[9], m[6]*m[8] - m[4]*m[10], m[4]*m[9] - m[5]*m[8],
+                  m[9]*m[2] - m[10]*m[1], m[10]*m[0] - m[8]*m[2], m[8]*m[1] - m[9]*m[0],
+                  m[1]*m[6] - m[2]*m[5], m[2]*m[4] - m[0]*m[6], m[0]*m[5] - m[1]*m[4]};
+    float det = m[0]*c[0] + m[4]*c[3] + m[8]*c[6];
+    float sign = det < 0 ? -1.0f : 1.0f;
+    unsigned int count = mesh->getVerticesCount();
+    const float *pv = mesh->getVertices();
+    const float *pn = mesh->getNormals();
+    for (unsigned int k = 0; k < count; ++k) {
+      const float *p = pv + 3*k;
+      const float *q = pn + 3*k;
+      float *dp = vertices + 3*(v + k);
+      float *dn = normals + 3*(v + k);
+      for (int r = 0; r < 3; ++r) {
+        dp[r] = m[r]*p[0] + m[4+r]*p[1] + m[8+r]*p[2] + m[12+r];
+        dn[r] = sign*(c[r]*q[0] + c[3+r]*q[1] + c[6+r]*q[2]);
+      }
+      float len = sqrtf(dn[0]*dn[0] + dn[1]*dn[1] + dn[2]*dn[2]);
+      if (len > 0) {
+        dn[0] /= len;
+        dn[1] /= len;
+        dn[2] /= len;
+      }
+    }
+    memcpy(texCoords + 2*v, mesh->getTexCoords(), 2*count*sizeof(float));
+    // Mirroring transforms reverse the winding, which face culling relies on
+    const float *pf = mesh->getFaces();
+    unsigned int faceCount = mesh->getFacesCount();
+    for (unsigned int k = 0; k < faceCount; ++k) {
+      float *df = faces + 3*(f + k);
+      df[0] = pf[3*k] + v;
+      df[1] = pf[3*k + (det < 0 ? 2 : 1)] + v;
+      df[2] = pf[3*k + (det < 0 ? 1 : 2)] + v;
+    }
+    v += count;
+    f += faceCount;
+  }
+
+  MSVMesh *merged = new MSVMesh(nVertices, vertices, normals, texCoords,
+                                nFaces, faces);
+  delete [] vertices;
+  delete [] normals;
+  delete [] texCoords;
+  delete [] faces;
+  return merged;
+}
+
+uint64_t
+MSVModel::contentHash() const
+{
+  // Parts are interned: their identity is their content
+  uint64_t h = hash(&nParts, sizeof(nParts));
+  for (unsigned int i = 0; i < nParts; ++i) {
+    const void *assets[2] = {parts[i].mesh, parts[i].tex};
+    h = hash(assets, sizeof(assets), h);
+    h = hash(parts[i].transform, 16*sizeof(float), h);
+  }
+  return h;
+}
+
+bool
+MSVModel::sameContent(const MSVAsset *other) const
+{
+  const MSVModel *m = static_cast<const MSVModel *>(other);
+  if (nParts != m->nParts) return false;
+  for (unsigned int i = 0; i < nParts; ++i) {
+    const Part *a = &parts[i];
+    const Part *b = &m->parts[i];
+    if (a->mesh != b->mesh || a->tex != b->tex ||
+        memcmp(a->transform, b->transform, 16*sizeof(float)))
+      return false;
+  }
+  return true;
+}
@@ -0,0 +1,125 @@
+#ifndef MSV_MODEL_H
+#define MSV_MODEL_H
+
+#include "MSVAsset.h"
+
+class MSVMesh;
+class MSVTexture;
+
+/** Maximal number of vertices of a merged part, as MSVMesh indexes them
+ * with GL_UNSIGNED_SHORT.
+ */
+#define MODEL_MAX_BATCH_VERTICES 65536
+
+/** Class representing a static model made of several parts, each one being
+ * a mesh with its own texture and transform (for example a label, a 3D
+ * badge and a price tag).
+ *
+ * Once all the parts are added, `build` prepares the model for rendering:
+ * static parts sharing a texture are merged into one mesh, their transforms
+ * being applied to the vertices, and the parts are sorted by shader program
+ * then texture, so that the renderer issues as few draw calls and state
+ * changes as possible. It also builds the BVH of each mesh, for hit
+ * testing.
+ *
+ * Models are reference-counted (see MSVAsset): use `release()` instead of
+ * deleting them.
+ */
+class MSVModel : public MSVAsset {
+  public:
+    /** Part of a model */
+    struct Part {
+      MSVMesh *mesh;
+      MSVTexture *tex;
+      /** Transform from the part to the model, 4x4 column-major */
+      float transform[16];
+    };
+
+    MSVModel();
+
+    /** Adds a part.
+     * @param mesh the mesh, or NULL to use a plane. Its reference is
+     * transferred to the model.
+     * @param tex the texture, or NULL for a transparent one. Its reference
+     * is transferred to the model.
+     * Both are deduplicated (see MSVAsset::intern).
+     * @param transform the transform of the part, 4x4 column-major, or NULL
+     * for the identity.
+     */
+    void addPart(MSVMesh *mesh, MSVTexture *tex, const float transform[16] = NULL);
+
+    /** Merges and sorts the parts. Must be called once all the parts are
+     * added, before the model is displayed. Does nothing if already built.
+     */
+    void build();
+
+    unsigned int getPartsCount() const;
+    const Part *getPart(unsigned int i) const;
+
+    /** Maps a face of a built part back to the part it comes from, as
+     * `build` sorts and merges the parts.
+     * @param part the index of the part, as passed to `getPart`.
+     * @param face the index of the face in the part mesh.
+     * @param sourcePart filled with the index of the part in the order of
+     * `addPart`.
+     * @param sourceFace filled with the index of the face in the mesh of
+     * that part.
+     */
+    void getSourceFace(unsigned int part,
+                       unsigned int face,
+                       unsigned int *sourcePart,
+                       unsigned int *sourceFace) const;
+
+    /** Gets the axis-aligned bounding box of all the parts, in the model
+     * space. Computed by `build`.
+     */
+    void getBounds(float min[3], float max[3]) const;
+    /** Returns false if a part has no bounds (see MSVMesh::hasBounds), in
+     * which case the model must never be culled.
+     */
+    bool hasBounds() const;
+
+  protected:
+    virtual ~MSVModel();
+
+    /** Implementation of MSVAsset */
+    uint64_t contentHash() const;
+    bool sameContent(const MSVAsset *other) const;
+
+  private:
+    /** Faces of a built part coming from an added part, from `firstFace`
+     * to the next Source of the same built part.
+     */
+    struct Source {
+      unsigned int part;
+      unsigned int firstFace;
+    };
+
+    /** A part being sorted, with its index in the order of `addPart` */
+    struct SortedPart {
+      Part part;
+      unsigned int index;
+    };
+
+    Part *parts;
+    unsigned int nParts;
+    unsigned int capacity;
+    /** Sources of the built parts, NULL until they are sorted. Those of
+     * part `i` are from `firstSource[i]` to `firstSource[i+1]`.
+     */
+    Source *sources;
+    unsigned int *firstSource;
+    bool built;
+    bool bounded;
+    float boundsMin[3];
+    float boundsMax[3];
+
+    void computeBounds();
+    /** Sorts the parts, and merges the static ones sharing a texture */
+    void batch();
+    static int compareParts(const void *a, const void *b);
+    static int compareSortedParts(const void *a, const void *b);
+    static MSVMesh *merge(const Part *parts, unsigned int n);
+};
+
+#endif
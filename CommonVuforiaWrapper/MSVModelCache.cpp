@@ -0,0 +1,205 @@
+#include "MSVBVH.h"
+#include "MSVMesh.h"
+#include "MSVModel.h"
+#include "MSVModelCache.h"
+#include "MSVTexture.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_ENTRY_NUMBER 8
+
+// Initialize static variables
+MSVModelCache::Entry *MSVModelCache::entries = NULL;
+int MSVModelCache::entry_nb = 0;
+int MSVModelCache::entry_capacity = 0;
+int MSVModelCache::pinned = -1;
+
+size_t MSVModelCache::budget = MODEL_CACHE_BUDGET;
+size_t MSVModelCache::usage = 0;
+unsigned int MSVModelCache::tick = 0;
+unsigned int MSVModelCache::hits = 0;
+unsigned int MSVModelCache::misses = 0;
+unsigned int MSVModelCache::evictions = 0;
+pthread_mutex_t MSVModelCache::lock = PTHREAD_MUTEX_INITIALIZER;
+
+void
+MSVModelCache::put(const char *name,
+                   const char *dataset,
+                   MSVModel *model,
+                   const float scale[3])
+{
+  pthread_mutex_lock(&lock);
+  int idx = find(name, dataset);
+  if (idx >= 0) evict(idx);
+  if (entry_nb == entry_capacity) {
+    entry_capacity = entry_capacity ? 2*entry_capacity : INITIAL_ENTRY_NUMBER;
+    entries = (Entry *)realloc(entries, entry_capacity*sizeof(Entry));
+  }
+  Entry *e = &entries[entry_nb];
+  e->name = strdup(name);
+  e->dataset = strdup(dataset);
+  e->model = model;
+  model->retain();
+  memcpy(e->scale, scale, 3*sizeof(float));
+  e->bytes = sizeOf(model);
+  e->lastUsed = ++tick;
+  usage += e->bytes;
+  pinned = entry_nb++;
+  enforceBudget();
+  pthread_mutex_unlock(&lock);
+}
+
+bool
+MSVModelCache::get(const char *name,
+                   const char *dataset,
+                   MSVModel **model,
+                   float scale[3])
+{
+  pthread_mutex_lock(&lock);
+  int idx = find(name, dataset);
+  if (idx >= 0) {
+    Entry *e = &entries[idx];
+    *model = e->model;
+    e->model->retain();
+    memcpy(scale, e->scale, 3*sizeof(float));
+    e->lastUsed = ++tick;
+    pinned = idx;
+    hits++;
+  }
+  else {
+    misses++;
+    pinned = -1;
+    enforceBudget();
+  }
+  pthread_mutex_unlock(&lock);
+  return idx >= 0;
+}
+
+void
+MSVModelCache::remove(const char *name, const char *dataset)
+{
+  pthread_mutex_lock(&lock);
+  int idx = find(name, dataset);
+  if (idx >= 0) evict(idx);
+  pthread_mutex_unlock(&lock);
+}
+
+void
+MSVModelCache::unpin()
+{
+  pthread_mutex_lock(&lock);
+  pinned = -1;
+  enforceBudget();
+  pthread_mutex_unlock(&lock);
+}
+
+void
+MSVModelCache::setBudget(size_t bytes)
+{
+  pthread_mutex_lock(&lock);
+  budget = bytes;
+  enforceBudget();
+  pthread_mutex_unlock(&lock);
+}
+
+size_t
+MSVModelCache::getBudget()
+{
+  return budget;
+}
+
+void
+MSVModelCache::getStats(Stats *stats)
+{
+  pthread_mutex_lock(&lock);
+  stats->hits = hits;
+  stats->misses = misses;
+  stats->evictions = evictions;
+  stats->models = entry_nb;
+  stats->bytes = usage;
+  pthread_mutex_unlock(&lock);
+}
+
+void
+MSVModelCache::clear()
+{
+  pthread_mutex_lock(&lock);
+  while (entry_nb > 0) evict(entry_nb - 1);
+  free(entries);
+  entries = NULL;
+  entry_capacity = 0;
+  pthread_mutex_unlock(&lock);
+}
+
+int
+MSVModelCache::find(const char *name, const char *dataset)
+{
+  for (int i = 0; i < entry_nb; ++i) {
+    if (!strcmp(entries[i].name, name) && !strcmp(entries[i].dataset, dataset))
+      return i;
+  }
+  return -1;
+}
+
+void
+MSVModelCache::evict(int idx)
+{
+  Entry *e = &entries[idx];
+  // Snapshots still displaying the model hold their own references
+  e->model->release();
+  free(e->name);
+  free(e->dataset);
+  usage -= e->bytes;
+  if (pinned == idx) pinned = -1;
+  entry_nb--;
+  if (idx != entry_nb) {
+    entries[idx] = entries[entry_nb];
+    if (pinned == entry_nb) pinned = idx;
+  }
+}
+
+void
+MSVModelCache::enforceBudget()
+{
+  while (usage > budget) {
+    int lru = -1;
+    for (int i = 0; i < entry_nb; ++i) {
+      if (i == pinned) continue;
+      if (lru < 0 || entries[i].lastUsed < entries[lru].lastUsed) lru = i;
+    }
+    if (lru < 0) break;
+    evict(lru);
+    evictions++;
+  }
+}
+
+size_t
+MSVModelCache::sizeOf(const MSVModel *model)
+{
+  size_t bytes = 0;
+  for (unsigned int i = 0; i < model->getPartsCount(); ++i) {
+    const MSVModel::Part *p = model->getPart(i);
+    // Assets shared by several parts are only counted once
+    bool meshSeen = false;
+    bool texSeen = false;
+    for (unsigned int j = 0; j < i; ++j) {
+      if (model->getPart(j)->mesh == p->mesh) meshSeen = true;
+      if (model->getPart(j)->tex == p->tex) texSeen = true;
+    }
+    if (!meshSeen) {
+      // Vertex data, in RAM and in the VBO
+      bytes += 2*p->mesh->getVertexBufferSize();
+      // Faces as floats in RAM, and as shorts in the IBO
+      bytes += p->mesh->getFacesCount()*3*(sizeof(float) + sizeof(GLushort));
+      // Hit testing tree
+      bytes += p->mesh->getBVH()->getSize();
+    }
+    if (!texSeen) {
+      const MSVTexture *tex = p->tex;
+      size_t size = tex->getWidth()*tex->getHeight()*tex->getChannelCount();
+      bytes += size + (tex->isMipmapped() ? size + size/3 : size);
+    }
+  }
+  return bytes;
+}
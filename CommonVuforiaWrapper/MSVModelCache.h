@@ -0,0 +1,104 @@
+#ifndef MSV_MODELCACHE_H
+#define MSV_MODELCACHE_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+class MSVModel;
+
+/** Default model cache budget, in bytes */
+#define MODEL_CACHE_BUDGET (16*1024*1024)
+
+/** Cache of the static models built for the targets, keyed by target name
+ * and dataset.
+ *
+ * In retail use the same few products are scanned over and over: instead of
+ * being released when tracking stops, the models stay referenced here, along with their GPU resources, so that tracking the
+ * target again restores them immediately.
+ *
+ * Its size, CPU and GPU copies included, is bounded by a byte budget. Least
+ * recently used models are evicted beyond the budget, except the most
+ * recently stored or restored one while its target is tracked, as it is
+ * likely displayed.
+ */
+class MSVModelCache {
+  public:
+    /** Cache statistics */
+    struct Stats {
+      unsigned int hits;
+      unsigned int misses;
+      unsigned int evictions;
+      /** Number of cached models */
+      int models;
+      /** Size of the cached models, in bytes */
+      size_t bytes;
+    };
+
+    /** Stores the model of a target, replacing the previous one if any.
+     * The cache keeps its own reference to `model`.
+     */
+    static void put(const char *name,
+                    const char *dataset,
+                    MSVModel *model,
+                    const float scale[3]);
+
+    /** Looks up the model of a target. A hit pins the model until `unpin`,
+     * a miss unpins the previous one.
+     * @param model filled with a new reference to the cached model.
+     * @param scale filled with the scale the model was set with.
+     * @return true on hit, false on miss.
+     */
+    static bool get(const char *name,
+                    const char *dataset,
+                    MSVModel **model,
+                    float scale[3]);
+
+    /** Evicts the model of a target, if any */
+    static void remove(const char *name, const char *dataset);
+
+    /** Makes the pinned model evictable again, once its target is no
+     * longer tracked, and enforces the budget.
+     */
+    static void unpin();
+
+    /** Sets the budget in bytes, 0 disabling the cache */
+    static void setBudget(size_t bytes);
+    static size_t getBudget();
+
+    /** Gets the statistics since startup */
+    static void getStats(Stats *stats);
+
+    /** Evicts all the models */
+    static void clear();
+
+  private:
+    struct Entry {
+      char *name;
+      char *dataset;
+      MSVModel *model;
+      float scale[3];
+      size_t bytes;
+      unsigned int lastUsed;
+    };
+
+    static Entry *entries;
+    static int entry_nb;
+    static int entry_capacity;
+    /** Index of the entry of the tracked target, never evicted, or -1 */
+    static int pinned;
+
+    static size_t budget;
+    static size_t usage;
+    static unsigned int tick;
+    static unsigned int hits;
+    static unsigned int misses;
+    static unsigned int evictions;
+    static pthread_mutex_t lock;
+
+    static int find(const char *name, const char *dataset);
+    static void evict(int idx);
+    static void enforceBudget();
+    static size_t sizeOf(const MSVModel *model);
+};
+
+#endif
@@ -0,0 +1,1086 @@
+#include "MSVMesh.h"
+#include "MSVModelLoader.h"
+#include "MSVTrace.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Maximal number of corners of an OBJ polygon */
+#define OBJ_MAX_CORNERS   64
+/* Bias of the OBJ indices relative to the chunk they were parsed in */
+#define OBJ_RELATIVE      (1 << 30)
+/* Marks an index missing from an OBJ face corner */
+#define OBJ_ABSENT        INT_MIN
+
+#define GLB_MAGIC         0x46546c67  /* "glTF" */
+#define GLB_VERSION       2
+#define GLB_CHUNK_JSON    0x4e4f534a  /* "JSON" */
+#define GLB_CHUNK_BIN     0x004e4942  /* "BIN\0" */
+#define GLTF_TRIANGLES    4
+#define GLTF_UBYTE        5121
+#define GLTF_USHORT       5123
+#define GLTF_UINT         5125
+#define GLTF_FLOAT        5126
+
+/* Maximal nesting of the glTF JSON */
+#define JSON_MAX_DEPTH    64
+
+int MSVModelLoader::threadCount = 0;
+
+/* Tools */
+
+static void *
+reserve(void *data, size_t *capacity, size_t needed, size_t elemSize)
+{
+  if (needed <= *capacity) return data;
+  size_t cap = *capacity ? *capacity : 1024;
+  while (cap < needed) cap *= 2;
+  *capacity = cap;
+  return realloc(data, cap*elemSize);
+}
+
+static bool
+mapFile(const char *path, const void **data, size_t *size)
+{
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  void *p = MAP_FAILED;
+  if (!fstat(fd, &st) && st.st_size > 0)
+    p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping stays valid once the file is closed
+  close(fd);
+  if (p == MAP_FAILED) return false;
+  *data = p;
+  *size = st.st_size;
+  return true;
+}
+
+/* Returns the directory of `path`, or NULL if it has none */
+static char *
+dirOf(const char *path)
+{
+  const char *slash = strrchr(path, '/');
+  if (!slash) return NULL;
+  size_t len = slash - path;
+  char *dir = (char *)malloc(len + 1);
+  memcpy(dir, path, len);
+  dir[len] = '\0';
+  return dir;
+}
+
+/* Resolves the `len` first characters of `name` against `dir` */
+static char *
+joinPath(const char *dir, const char *name, size_t len)
+{
+  size_t dirLen = (dir && name[0] != '/') ? strlen(dir) + 1 : 0;
+  char *path = (char *)malloc(dirLen + len + 1);
+  if (dirLen) {
+    memcpy(path, dir, dirLen - 1);
+    path[dirLen - 1] = '/';
+  }
+  memcpy(path + dirLen, name, len);
+  path[dirLen + len] = '\0';
+  return path;
+}
+
+/* Computes smooth normals for the vertices flagged as missing one */
+static void
+computeNormals(MSVModelLoader::Model *m, const bool *missing)
+{
+  for (unsigned int i = 0; i < m->nVertices; ++i) {
+    if (missing[i]) memset(&m->normals[3*i], 0, 3*sizeof(float));
+  }
+  for (unsigned int f = 0; f < m->nFaces; ++f) {
+    unsigned int idx[3];
+    for (int k = 0; k < 3; ++k) idx[k] = (unsigned int)m->faces[3*f+k];
+    const float *a = &m->vertices[3*idx[0]];
+    const float *b = &m->vertices[3*idx[1]];
+    const float *c = &m->vertices[3*idx[2]];
+    float u[3] = {b[0]-a[0], b[1]-a[1], b[2]-a[2]};
+    float v[3] = {c[0]-a[0], c[1]-a[1], c[2]-a[2]};
+    // Not normalized: larger faces weigh more
+    float n[3] = {u[1]*v[2] - u[2]*v[1],
+                  u[2]*v[0] - u[0]*v[2],
+                  u[0]*v[1] - u[1]*v[0]};
+    for (int k = 0; k < 3; ++k) {
+      if (!missing[idx[k]]) continue;
+      float *dst = &m->normals[3*idx[k]];
+      dst[0] += n[0];
+      dst[1] += n[1];
+      dst[2] += n[2];
+    }
+  }
+  for (unsigned int i = 0; i < m->nVertices; ++i) {
+    if (!missing[i]) continue;
+    float *n = &m->normals[3*i];
+    float len = sqrtf(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+    if (len > 0) {
+      n[0] /= len;
+      n[1] /= len;
+      n[2] /= len;
+    }
+    else {
+      n[2] = 1;
+    }
+  }
+}
+
+/* OBJ parsing */
+
+struct ObjChunk {
+  const char *begin;
+  const char *end;
+  float *pos;
+  size_t posSize;
+  size_t posCapacity;
+  float *uv;
+  size_t uvSize;
+  size_t uvCapacity;
+  float *nrm;
+  size_t nrmSize;
+  size_t nrmCapacity;
+  /* {position, texture coordinates, normal} indices of each corner */
+  int *corners;
+  size_t cornerSize;
+  size_t cornerCapacity;
+  /* First material library and material of the chunk, in the file data */
+  const char *mtllib;
+  size_t mtllibLen;
+  const char *material;
+  size_t materialLen;
+  bool failed;
+};
+
+static inline bool
+isBlank(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline const char *
+skipBlanks(const char *p, const char *end)
+{
+  while (p < end && isBlank(*p)) ++p;
+  return p;
+}
+
+static const double powersOf10[] = {
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/* Parses a decimal number, faster than strtof and independent of the
+ * locale. Returns the end of the number, or NULL if there is none.
+ */
+static const char *
+parseFloat(const char *p, const char *end, float *out)
+{
+  p = skipBlanks(p, end);
+  bool neg = false;
+  if (p < end && (*p == '-' || *p == '+')) neg = (*p++ == '-');
+  double mantissa = 0;
+  int exponent = 0;
+  bool digits = false;
+  for (; p < end && *p >= '0' && *p <= '9'; ++p, digits = true)
+    mantissa = 10*mantissa + (*p - '0');
+  if (p < end && *p == '.') {
+    for (++p; p < end && *p >= '0' && *p <= '9'; ++p, digits = true) {
+      mantissa = 10*mantissa + (*p - '0');
+      exponent--;
+    }
+  }
+  if (!digits) return NULL;
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    const char *q = p + 1;
+    bool expNeg = false;
+    if (q < end && (*q == '-' || *q == '+')) expNeg = (*q++ == '-');
+    int e = 0;
+    const char *first = q;
+    for (; q < end && *q >= '0' && *q <= '9'; ++q)
+      if (e < 1000) e = 10*e + (*q - '0');
+    if (q > first) {
+      exponent += expNeg ? -e : e;
+      p = q;
+    }
+  }
+  double value;
+  if (exponent >= 0)
+    value = mantissa * (exponent <= 22 ? powersOf10[exponent] : pow(10.0, exponent));
+  else
+    value = mantissa / (exponent >= -22 ? powersOf10[-exponent] : pow(10.0, -exponent));
+  *out = (float)(neg ? -value : value);
+  return p;
+}
+
+static const char *
+parseInt(const char *p, const char *end, int *out)
+{
+  bool neg = false;
+  if (p < end && *p == '-') {
+    neg = true;
+    ++p;
+  }
+  const char *first = p;
+  int v = 0;
+  // Saturates at OBJ_RELATIVE, which is out of range, without overflowing
+  for (; p < end && *p >= '0' && *p <= '9'; ++p)
+    v = v <= (OBJ_RELATIVE - 10)/10 ? 10*v + (*p - '0') : OBJ_RELATIVE;
+  if (p == first || v >= OBJ_RELATIVE) return NULL;
+  *out = neg ? -v : v;
+  return p;
+}
+
+/* Encodes a 1-based OBJ index, or an index relative to the `count` elements
+ * parsed so far by the chunk.
+ */
+static inline int
+encodeIndex(int idx, size_t count)
+{
+  return idx > 0 ? idx - 1 : (int)count + idx - OBJ_RELATIVE;
+}
+
+static inline bool
+isKeyword(const char *p, const char *end, const char *kw, size_t len)
+{
+  return p + len <= end && !memcmp(p, kw, len) && (p + len == end || isBlank(p[len]));
+}
+
+/* Returns the rest of the line, without surrounding blanks */
+static const char *
+lineArgument(const char *p, const char *end, size_t *len)
+{
+  p = skipBlanks(p, end);
+  const char *q = end;
+  while (q > p && isBlank(q[-1])) --q;
+  *len = q - p;
+  return p;
+}
+
+static void
+parseFace(ObjChunk *c, const char *p, const char *end)
+{
+  int idx[OBJ_MAX_CORNERS][3];
+  int n = 0;
+  for (;;) {
+    p = skipBlanks(p, end);
+    if (p >= end || *p == '#') break;
+    int v;
+    if (n == OBJ_MAX_CORNERS || !(p = parseInt(p, end, &v)) || !v) {
+      c->failed = true;
+      return;
+    }
+    idx[n][0] = encodeIndex(v, c->posSize/3);
+    idx[n][1] = OBJ_ABSENT;
+    idx[n][2] = OBJ_ABSENT;
+    if (p < end && *p == '/') {
+      ++p;
+      if (p < end && *p != '/') {
+        if (!(p = parseInt(p, end, &v)) || !v) {
+          c->failed = true;
+          return;
+        }
+        idx[n][1] = encodeIndex(v, c->uvSize/2);
+      }
+      if (p < end && *p == '/') {
+        if (!(p = parseInt(p + 1, end, &v)) || !v) {
+          c->failed = true;
+          return;
+        }
+        idx[n][2] = encodeIndex(v, c->nrmSize/3);
+      }
+    }
+    n++;
+  }
+  if (n < 3) return;
+  // Triangulate the polygon as a fan
+  c->corners = (int *)reserve(c->corners, &c->cornerCapacity,
+                              c->cornerSize + 9*(n - 2), sizeof(int));
+  int *dst = c->corners + c->cornerSize;
+  for (int i = 1; i < n - 1; ++i) {
+    memcpy(dst, idx[0], 3*sizeof(int));
+    memcpy(dst + 3, idx[i], 3*sizeof(int));
+    memcpy(dst + 6, idx[i+1], 3*sizeof(int));
+    dst += 9;
+  }
+  c->cornerSize += 9*(n - 2);
+}
+
+static bool
+parseFloats(const char *p, const char *end, int count, int required,
+            float **data, size_t *size, size_t *capacity)
+{
+  *data = (float *)reserve(*data, capacity, *size + count, sizeof(float));
+  float *dst = *data + *size;
+  for (int i = 0; i < count; ++i) {
+    const char *q = p ? parseFloat(p, end, &dst[i]) : NULL;
+    if (!q) {
+      if (i < required) return false;
+      dst[i] = 0;
+    }
+    p = q;
+  }
+  *size += count;
+  return true;
+}
+
+static void
+parseLine(ObjChunk *c, const char *p, const char *end)
+{
+  if (p >= end) return;
+  if (p[0] == 'v') {
+    bool ok = true;
+    if (p + 1 < end && isBlank(p[1]))
+      ok = parseFloats(p + 1, end, 3, 3, &c->pos, &c->posSize, &c->posCapacity);
+    else if (isKeyword(p, end, "vt", 2))
+      ok = parseFloats(p + 2, end, 2, 1, &c->uv, &c->uvSize, &c->uvCapacity);
+    else if (isKeyword(p, end, "vn", 2))
+      ok = parseFloats(p + 2, end, 3, 3, &c->nrm, &c->nrmSize, &c->nrmCapacity);
+    if (!ok) c->failed = true;
+  }
+  else if (p[0] == 'f' && p + 1 < end && isBlank(p[1])) {
+    parseFace(c, p + 1, end);
+  }
+  else if (!c->material && isKeyword(p, end, "usemtl", 6)) {
+    c->material = lineArgument(p + 6, end, &c->materialLen);
+  }
+  else if (!c->mtllib && isKeyword(p, end, "mtllib", 6)) {
+    c->mtllib = lineArgument(p + 6, end, &c->mtllibLen);
+  }
+}
+
+static void
+parseChunk(ObjChunk *c)
+{
+  const char *p = c->begin;
+  while (p < c->end && !c->failed) {
+    const char *eol = (const char *)memchr(p, '\n', c->end - p);
+    if (!eol) eol = c->end;
+    parseLine(c, skipBlanks(p, eol), eol);
+    p = eol + 1;
+  }
+}
+
+static void *
+parseChunkThread(void *chunk)
+{
+  parseChunk((ObjChunk *)chunk);
+  return NULL;
+}
+
+/* Looks for the diffuse texture of `material`, or of the first material if
+ * NULL, in a .mtl file.
+ */
+static char *
+findTexture(const char *dir, const char *mtllib, size_t mtllibLen,
+            const char *material, size_t materialLen)
+{
+  char *path = joinPath(dir, mtllib, mtllibLen);
+  const void *data;
+  size_t size;
+  bool mapped = mapFile(path, &data, &size);
+  free(path);
+  if (!mapped) return NULL;
+  char *tex = NULL;
+  const char *p = (const char *)data;
+  const char *end = p + size;
+  bool current = false;
+  while (p < end && !tex) {
+    const char *eol = (const char *)memchr(p, '\n', end - p);
+    if (!eol) eol = end;
+    const char *q = skipBlanks(p, eol);
+    size_t len;
+    if (isKeyword(q, eol, "newmtl", 6)) {
+      const char *name = lineArgument(q + 6, eol, &len);
+      current = !material || (len == materialLen && !memcmp(name, material, len));
+    }
+    else if (current && isKeyword(q, eol, "map_Kd", 6)) {
+      // The file name comes after the options, if any
+      const char *arg = lineArgument(q + 6, eol, &len);
+      const char *name = arg + len;
+      while (name > arg && !isBlank(name[-1])) --name;
+      if (name < arg + len) tex = joinPath(dir, name, arg + len - name);
+    }
+    p = eol + 1;
+  }
+  munmap((void *)data, size);
+  return tex;
+}
+
+/* Vertex deduplication table entry */
+struct VertexSlot {
+  int pos;
+  int uv;
+  int nrm;
+  int vertex;
+};
+
+static inline unsigned int
+hashCorner(int pos, int uv, int nrm)
+{
+  return (unsigned int)pos*73856093u ^ (unsigned int)uv*19349663u ^
+         (unsigned int)nrm*83492791u;
+}
+
+/* Resolves an encoded index, returns false if out of bounds */
+static inline bool
+resolveIndex(int idx, size_t offset, size_t count, int *out)
+{
+  if (idx == OBJ_ABSENT) {
+    *out = -1;
+    return true;
+  }
+  long v = idx >= 0 ? idx : (long)offset + idx + OBJ_RELATIVE;
+  if (v < 0 || (size_t)v >= count) return false;
+  *out = (int)v;
+  return true;
+}
+
+/* Merges the parsed chunks into `m` */
+static bool
+mergeChunks(const ObjChunk *chunks, int count, MSVModelLoader::Model *m)
+{
+  size_t posTotal = 0, uvTotal = 0, nrmTotal = 0, cornerTotal = 0;
+  for (int i = 0; i < count; ++i) {
+    posTotal += chunks[i].posSize/3;
+    uvTotal += chunks[i].uvSize/2;
+    nrmTotal += chunks[i].nrmSize/3;
+    cornerTotal += chunks[i].cornerSize/3;
+  }
+  if (!cornerTotal || cornerTotal > LOADER_MAX_INDICES) return false;
+
+  // Absolute indices may point to any chunk: gather the elements
+  // Corners always need positions
+  if (!posTotal) return false;
+  float *pos = (float *)malloc((3*posTotal + 2*uvTotal + 3*nrmTotal)*sizeof(float));
+  if (!pos) return false;
+  float *uv = pos + 3*posTotal;
+  float *nrm = uv + 2*uvTotal;
+  size_t posOffset = 0, uvOffset = 0, nrmOffset = 0;
+  for (int i = 0; i < count; ++i) {
+    // Chunks without some element have NULL arrays
+    if (chunks[i].posSize)
+      memcpy(pos + 3*posOffset, chunks[i].pos, chunks[i].posSize*sizeof(float));
+    if (chunks[i].uvSize)
+      memcpy(uv + 2*uvOffset, chunks[i].uv, chunks[i].uvSize*sizeof(float));
+    if (chunks[i].nrmSize)
+      memcpy(nrm + 3*nrmOffset, chunks[i].nrm, chunks[i].nrmSize*sizeof(float));
+    posOffset += chunks[i].posSize/3;
+    uvOffset += chunks[i].uvSize/2;
+    nrmOffset += chunks[i].nrmSize/3;
+  }
+
+  size_t maxVertices = cornerTotal < LOADER_MAX_VERTICES ? cornerTotal : LOADER_MAX_VERTICES;
+  size_t slotCount = 1;
+  while (slotCount < 2*maxVertices) slotCount *= 2;
+  VertexSlot *slots = (VertexSlot *)malloc(slotCount*sizeof(VertexSlot));
+  for (size_t i = 0; slots && i < slotCount; ++i) slots[i].vertex = -1;
+
+  m->vertices = (float *)malloc(3*maxVertices*sizeof(float));
+  m->normals = (float *)malloc(3*maxVertices*sizeof(float));
+  m->texCoords = (float *)malloc(2*maxVertices*sizeof(float));
+  m->nFaces = cornerTotal/3;
+  m->faces = (float *)malloc(cornerTotal*sizeof(float));
+  bool *missing = (bool *)malloc(maxVertices*sizeof(bool));
+  bool anyMissing = false;
+
+  bool ok = slots && m->vertices && m->normals && m->texCoords && m->faces && missing;
+  size_t corner = 0;
+  posOffset = uvOffset = nrmOffset = 0;
+  for (int i = 0; ok && i < count; ++i) {
+    const ObjChunk *c = &chunks[i];
+    for (size_t k = 0; ok && k < c->cornerSize; k += 3) {
+      int p, t, n;
+      if (!resolveIndex(c->corners[k], posOffset, posTotal, &p) || p < 0 ||
+          !resolveIndex(c->corners[k+1], uvOffset, uvTotal, &t) ||
+          !resolveIndex(c->corners[k+2], nrmOffset, nrmTotal, &n)) {
+        ok = false;
+        break;
+      }
+      size_t s = hashCorner(p, t, n) & (slotCount - 1);
+      while (slots[s].vertex >= 0 &&
+             (slots[s].pos != p || slots[s].uv != t || slots[s].nrm != n))
+        s = (s + 1) & (slotCount - 1);
+      if (slots[s].vertex < 0) {
+        if (m->nVertices == maxVertices) {
+          ok = false;
+          break;
+        }
+        int v = m->nVertices++;
+        slots[s].pos = p;
+        slots[s].uv = t;
+        slots[s].nrm = n;
+        slots[s].vertex = v;
+        memcpy(&m->vertices[3*v], &pos[3*p], 3*sizeof(float));
+        if (t >= 0) {
+          memcpy(&m->texCoords[2*v], &uv[2*t], 2*sizeof(float));
+        }
+        else {
+          m->texCoords[2*v] = 0;
+          m->texCoords[2*v+1] = 0;
+        }
+        if (n >= 0) memcpy(&m->normals[3*v], &nrm[3*n], 3*sizeof(float));
+        missing[v] = n < 0;
+        anyMissing |= n < 0;
+      }
+      m->faces[corner++] = slots[s].vertex;
+    }
+    posOffset += c->posSize/3;
+    uvOffset += c->uvSize/2;
+    nrmOffset += c->nrmSize/3;
+  }
+  if (ok && anyMissing) computeNormals(m, missing);
+  free(missing);
+  free(slots);
+  free(pos);
+  return ok;
+}
+
+/* glTF JSON parsing */
+
+enum JsonType {
+  JSON_OBJECT = 0,
+  JSON_ARRAY,
+  JSON_STRING,
+  JSON_PRIMITIVE
+};
+
+struct JsonToken {
+  int type;
+  /* Range of the value in the text, without the quotes of strings */
+  size_t start;
+  size_t end;
+  /* Number of members of objects, or of elements of arrays */
+  int size;
+  /* Index of the token following this value and its children */
+  int next;
+};
+
+struct Json {
+  const char *text;
+  size_t length;
+  JsonToken *tokens;
+  size_t count;
+  size_t capacity;
+};
+
+static void
+jsonSkip(const Json *js, size_t *pos)
+{
+  while (*pos < js->length && strchr(" \t\r\n", js->text[*pos]) && js->text[*pos])
+    ++*pos;
+}
+
+/* Parses a value into tokens, in depth-first order. Returns its index. */
+static int
+jsonValue(Json *js, size_t *pos, int depth)
+{
+  const char *s = js->text;
+  jsonSkip(js, pos);
+  if (*pos >= js->length || depth > JSON_MAX_DEPTH) return -1;
+  js->tokens = (JsonToken *)reserve(js->tokens, &js->capacity, js->count + 1,
+                                    sizeof(JsonToken));
+  int idx = js->count++;
+  js->tokens[idx].start = *pos;
+  js->tokens[idx].size = 0;
+  char c = s[*pos];
+  if (c == '{' || c == '[') {
+    bool object = (c == '{');
+    char close = object ? '}' : ']';
+    js->tokens[idx].type = object ? JSON_OBJECT : JSON_ARRAY;
+    ++*pos;
+    jsonSkip(js, pos);
+    if (*pos < js->length && s[*pos] == close) {
+      ++*pos;
+    }
+    else {
+      for (;;) {
+        if (object) {
+          int key = jsonValue(js, pos, depth + 1);
+          if (key < 0 || js->tokens[key].type != JSON_STRING) return -1;
+          jsonSkip(js, pos);
+          if (*pos >= js->length || s[*pos] != ':') return -1;
+          ++*pos;
+        }
+        if (jsonValue(js, pos, depth + 1) < 0) return -1;
+        js->tokens[idx].size++;
+        jsonSkip(js, pos);
+        if (*pos >= js->length) return -1;
+        if (s[*pos] == close) {
+          ++*pos;
+          break;
+        }
+        if (s[*pos] != ',') return -1;
+        ++*pos;
+      }
+    }
+  }
+  else if (c == '"') {
+    js->tokens[idx].type = JSON_STRING;
+    js->tokens[idx].start = ++*pos;
+    while (*pos < js->length && s[*pos] != '"') {
+      if (s[*pos] == '\\') ++*pos;
+      ++*pos;
+    }
+    if (*pos >= js->length) return -1;
+    js->tokens[idx].end = (*pos)++;
+    js->tokens[idx].next = js->count;
+    return idx;
+  }
+  else {
+    js->tokens[idx].type = JSON_PRIMITIVE;
+    while (*pos < js->length && !strchr(",]} \t\r\n", s[*pos]) && s[*pos])
+      ++*pos;
+    if (*pos == js->tokens[idx].start) return -1;
+  }
+  js->tokens[idx].end = *pos;
+  js->tokens[idx].next = js->count;
+  return idx;
+}
+
+static bool
+jsonEquals(const Json *js, int tok, const char *str)
+{
+  if (tok < 0 || js->tokens[tok].type != JSON_STRING) return false;
+  size_t len = js->tokens[tok].end - js->tokens[tok].start;
+  return len == strlen(str) && !memcmp(js->text + js->tokens[tok].start, str, len);
+}
+
+/* Returns the value of the member `key` of an object, or -1 */
+static int
+jsonGet(const Json *js, int obj, const char *key)
+{
+  if (obj < 0 || js->tokens[obj].type != JSON_OBJECT) return -1;
+  int tok = obj + 1;
+  for (int i = 0; i < js->tokens[obj].size; ++i) {
+    if (jsonEquals(js, tok, key)) return tok + 1;
+    tok = js->tokens[tok + 1].next;
+  }
+  return -1;
+}
+
+/* Returns the element `n` of an array, or -1 */
+static int
+jsonAt(const Json *js, int arr, long n)
+{
+  if (arr < 0 || js->tokens[arr].type != JSON_ARRAY) return -1;
+  if (n < 0 || n >= js->tokens[arr].size) return -1;
+  int tok = arr + 1;
+  for (long i = 0; i < n; ++i) tok = js->tokens[tok].next;
+  return tok;
+}
+
+static long
+jsonInt(const Json *js, int tok, long def)
+{
+  if (tok < 0 || js->tokens[tok].type != JSON_PRIMITIVE) return def;
+  char buf[24];
+  size_t len = js->tokens[tok].end - js->tokens[tok].start;
+  if (len >= sizeof(buf)) return def;
+  memcpy(buf, js->text + js->tokens[tok].start, len);
+  buf[len] = '\0';
+  char *end;
+  long v = strtol(buf, &end, 10);
+  return *end ? def : v;
+}
+
+/* glTF decoding */
+
+struct Gltf {
+  Json json;
+  int root;
+  const unsigned char *bin;
+  size_t binSize;
+};
+
+struct Accessor {
+  const unsigned char *data;
+  size_t stride;
+  unsigned int count;
+  int componentType;
+  int components;
+};
+
+static int
+componentSize(int type)
+{
+  switch (type) {
+    case GLTF_UBYTE:  return 1;
+    case GLTF_USHORT: return 2;
+    case GLTF_UINT:   return 4;
+    case GLTF_FLOAT:  return 4;
+    default:          return 0;
+  }
+}
+
+/* Gets an accessor, checking that its elements lie in the binary chunk.
+ * Indices must be tightly packed, as glTF requires.
+ */
+static bool
+getAccessor(const Gltf *g, long index, bool indices, Accessor *a)
+{
+  const Json *js = &g->json;
+  int acc = jsonAt(js, jsonGet(js, g->root, "accessors"), index);
+  if (acc < 0) return false;
+  int type = jsonGet(js, acc, "type");
+  if (jsonEquals(js, type, "SCALAR"))    a->components = 1;
+  else if (jsonEquals(js, type, "VEC2")) a->components = 2;
+  else if (jsonEquals(js, type, "VEC3")) a->components = 3;
+  else if (jsonEquals(js, type, "VEC4")) a->components = 4;
+  else return false;
+  a->componentType = jsonInt(js, jsonGet(js, acc, "componentType"), 0);
+  long count = jsonInt(js, jsonGet(js, acc, "count"), -1);
+  int bv = jsonAt(js, jsonGet(js, g->root, "bufferViews"),
+                  jsonInt(js, jsonGet(js, acc, "bufferView"), -1));
+  size_t elemSize = componentSize(a->componentType)*a->components;
+  // Only the binary chunk is supported as buffer
+  if (!elemSize || count <= 0 || bv < 0 ||
+      jsonInt(js, jsonGet(js, bv, "buffer"), 0) != 0)
+    return false;
+  if (indices && jsonGet(js, bv, "byteStride") >= 0) return false;
+  long offset = jsonInt(js, jsonGet(js, bv, "byteOffset"), 0);
+  long length = jsonInt(js, jsonGet(js, bv, "byteLength"), -1);
+  long stride = jsonInt(js, jsonGet(js, bv, "byteStride"), elemSize);
+  long accOffset = jsonInt(js, jsonGet(js, acc, "byteOffset"), 0);
+  if (offset < 0 || length < 0 || accOffset < 0 || stride < (long)elemSize ||
+      (unsigned long)count > UINT_MAX)
+    return false;
+  // In size_t, without overflowing: the last element must end in the view,
+  // and the view in the chunk
+  if ((size_t)offset > g->binSize || (size_t)length > g->binSize - offset ||
+      (size_t)accOffset > (size_t)length ||
+      elemSize > (size_t)length - accOffset ||
+      (size_t)(count - 1) > ((size_t)length - accOffset - elemSize)/stride)
+    return false;
+  a->data = g->bin + offset + accOffset;
+  a->stride = stride;
+  a->count = count;
+  return true;
+}
+
+/* Reads the elements of an accessor as floats, normalizing integers */
+static bool
+readFloats(const Accessor *a, float *out)
+{
+  for (unsigned int i = 0; i < a->count; ++i) {
+    const unsigned char *src = a->data + i*a->stride;
+    for (int k = 0; k < a->components; ++k) {
+      switch (a->componentType) {
+        case GLTF_FLOAT:
+          memcpy(out, src + 4*k, sizeof(float));
+          break;
+        case GLTF_UBYTE:
+          *out = src[k] / 255.0f;
+          break;
+        case GLTF_USHORT: {
+          uint16_t v;
+          memcpy(&v, src + 2*k, sizeof(v));
+          *out = v / 65535.0f;
+          break;
+        }
+        default:
+          return false;
+      }
+      out++;
+    }
+  }
+  return true;
+}
+
+static uint32_t
+readIndex(const Accessor *a, unsigned int i)
+{
+  const unsigned char *src = a->data + i*a->stride;
+  if (a->componentType == GLTF_UBYTE) return src[0];
+  if (a->componentType == GLTF_USHORT) {
+    uint16_t v;
+    memcpy(&v, src, sizeof(v));
+    return v;
+  }
+  uint32_t v;
+  memcpy(&v, src, sizeof(v));
+  return v;
+}
+
+/* Appends a triangles primitive to `m` */
+static bool
+readPrimitive(const Gltf *g, int prim, MSVModelLoader::Model *m,
+              bool **missing)
+{
+  const Json *js = &g->json;
+  int attrs = jsonGet(js, prim, "attributes");
+  Accessor pos;
+  if (!getAccessor(g, jsonInt(js, jsonGet(js, attrs, "POSITION"), -1), false, &pos) ||
+      pos.components != 3 || pos.componentType != GLTF_FLOAT)
+    return false;
+  unsigned int base = m->nVertices;
+  if (pos.count > LOADER_MAX_VERTICES - base) return false;
+  unsigned int nVertices = base + pos.count;
+  // Grown one by one: the arrays stay valid, to be freed, if one fails
+  float *vertices = (float *)realloc(m->vertices, 3*nVertices*sizeof(float));
+  if (vertices) m->vertices = vertices;
+  float *normals = (float *)realloc(m->normals, 3*nVertices*sizeof(float));
+  if (normals) m->normals = normals;
+  float *texCoords = (float *)realloc(m->texCoords, 2*nVertices*sizeof(float));
+  if (texCoords) m->texCoords = texCoords;
+  bool *flags = (bool *)realloc(*missing, nVertices*sizeof(bool));
+  if (flags) *missing = flags;
+  if (!vertices || !normals || !texCoords || !flags) return false;
+  m->nVertices = nVertices;
+  readFloats(&pos, &m->vertices[3*base]);
+
+  Accessor a;
+  bool hasNormals = getAccessor(g, jsonInt(js, jsonGet(js, attrs, "NORMAL"), -1), false, &a) &&
+                    a.components == 3 && a.count == pos.count &&
+                    readFloats(&a, &m->normals[3*base]);
+  for (unsigned int i = base; i < nVertices; ++i) (*missing)[i] = !hasNormals;
+  if (getAccessor(g, jsonInt(js, jsonGet(js, attrs, "TEXCOORD_0"), -1), false, &a) &&
+      a.components == 2 && a.count == pos.count &&
+      readFloats(&a, &m->texCoords[2*base])) {
+    // glTF coordinates start at the top of the image, unlike OBJ ones
+    for (unsigned int i = base; i < nVertices; ++i)
+      m->texCoords[2*i+1] = 1.0f - m->texCoords[2*i+1];
+  }
+  else {
+    memset(&m->texCoords[2*base], 0, 2*pos.count*sizeof(float));
+  }
+
+  int indices = jsonGet(js, prim, "indices");
+  Accessor idx;
+  unsigned int count = pos.count;
+  if (indices >= 0) {
+    if (!getAccessor(g, jsonInt(js, indices, -1), true, &idx) || idx.components != 1 ||
+        idx.componentType == GLTF_FLOAT)
+      return false;
+    count = idx.count;
+  }
+  if (count % 3 || count > LOADER_MAX_INDICES - 3*m->nFaces) return false;
+  float *faces = (float *)realloc(m->faces, (3*m->nFaces + count)*sizeof(float));
+  if (!faces) return false;
+  m->faces = faces;
+  float *dst = &m->faces[3*m->nFaces];
+  for (unsigned int i = 0; i < count; ++i) {
+    uint32_t v = (indices >= 0) ? readIndex(&idx, i) : i;
+    if (v >= pos.count) return false;
+    dst[i] = base + v;
+  }
+  m->nFaces += count/3;
+  return true;
+}
+
+/* Finds the base color texture of a material */
+static void
+readTexture(const Gltf *g, long material, const char *dir,
+            MSVModelLoader::Model *m)
+{
+  const Json *js = &g->json;
+  int mat = jsonAt(js, jsonGet(js, g->root, "materials"), material);
+  int pbr = jsonGet(js, mat, "pbrMetallicRoughness");
+  int info = jsonGet(js, pbr, "baseColorTexture");
+  int tex = jsonAt(js, jsonGet(js, g->root, "textures"),
+                   jsonInt(js, jsonGet(js, info, "index"), -1));
+  int img = jsonAt(js, jsonGet(js, g->root, "images"),
+                   jsonInt(js, jsonGet(js, tex, "source"), -1));
+  if (img < 0) return;
+  int bv = jsonAt(js, jsonGet(js, g->root, "bufferViews"),
+                  jsonInt(js, jsonGet(js, img, "bufferView"), -1));
+  int uri = jsonGet(js, img, "uri");
+  if (bv >= 0) {
+    long offset = jsonInt(js, jsonGet(js, bv, "byteOffset"), 0);
+    long length = jsonInt(js, jsonGet(js, bv, "byteLength"), -1);
+    if (offset < 0 || length <= 0 || (size_t)offset + length > g->binSize) return;
+    m->textureData = (unsigned char *)malloc(length);
+    if (!m->textureData) return;
+    memcpy(m->textureData, g->bin + offset, length);
+    m->textureSize = length;
+  }
+  else if (uri >= 0 && js->tokens[uri].type == JSON_STRING) {
+    const char *name = js->text + js->tokens[uri].start;
+    size_t len = js->tokens[uri].end - js->tokens[uri].start;
+    // Data URIs are not supported
+    if (len >= 5 && !memcmp(name, "data:", 5)) return;
+    m->texturePath = joinPath(dir, name, len);
+  }
+}
+
+/* Loader */
+
+bool
+MSVModelLoader::load(const char *path, Model *model)
+{
+  MSV_TRACE_SCOPE("loadModel");
+  memset(model, 0, sizeof(Model));
+  const void *data;
+  size_t size;
+  if (!mapFile(path, &data, &size)) return false;
+  char *dir = dirOf(path);
+  bool ok;
+  if (size >= 4 && !memcmp(data, "glTF", 4))
+    ok = loadGLB((const unsigned char *)data, size, dir, model);
+  else
+    ok = loadOBJ((const char *)data, size, dir, model);
+  free(dir);
+  munmap((void *)data, size);
+  return ok;
+}
+
+bool
+MSVModelLoader::loadOBJ(const char *data, size_t size, const char *dir,
+                        Model *model)
+{
+  memset(model, 0, sizeof(Model));
+  int count = getThreadCount(size);
+  ObjChunk chunks[LOADER_MAX_THREADS];
+  memset(chunks, 0, sizeof(chunks));
+  const char *end = data + size;
+  const char *p = data;
+  for (int i = 0; i < count; ++i) {
+    chunks[i].begin = p;
+    // Cut after the first line break past the even split
+    const char *cut = data + size*(i + 1)/count;
+    if (i + 1 < count && cut > p) {
+      const char *eol = (const char *)memchr(cut - 1, '\n', end - cut + 1);
+      p = eol ? eol + 1 : end;
+    }
+    else if (i + 1 == count) {
+      p = end;
+    }
+    chunks[i].end = p;
+  }
+
+  // The calling thread parses the first chunk
+  pthread_t threads[LOADER_MAX_THREADS];
+  bool started[LOADER_MAX_THREADS];
+  for (int i = 1; i < count; ++i)
+    started[i] = !pthread_create(&threads[i], NULL, parseChunkThread, &chunks[i]);
+  parseChunk(&chunks[0]);
+  for (int i = 1; i < count; ++i) {
+    if (started[i]) pthread_join(threads[i], NULL);
+    else parseChunk(&chunks[i]);
+  }
+
+  bool ok = true;
+  const ObjChunk *mtl = NULL;
+  const ObjChunk *mat = NULL;
+  for (int i = 0; i < count; ++i) {
+    ok &= !chunks[i].failed;
+    if (!mtl && chunks[i].mtllib) mtl = &chunks[i];
+    if (!mat && chunks[i].material) mat = &chunks[i];
+  }
+  ok = ok && mergeChunks(chunks, count, model);
+  if (ok && mtl) {
+    model->texturePath = findTexture(dir, mtl->mtllib, mtl->mtllibLen,
+                                     mat ? mat->material : NULL,
+                                     mat ? mat->materialLen : 0);
+  }
+  for (int i = 0; i < count; ++i) {
+    free(chunks[i].pos);
+    free(chunks[i].uv);
+    free(chunks[i].nrm);
+    free(chunks[i].corners);
+  }
+  if (!ok) freeModel(model);
+  return ok;
+}
+
+bool
+MSVModelLoader::loadGLB(const unsigned char *data, size_t size,
+                        const char *dir, Model *model)
+{
+  memset(model, 0, sizeof(Model));
+  // Little-endian header {magic, version, length}, then chunks of
+  // {length, type, data}: JSON first, then the optional binary buffer
+  uint32_t header[5];
+  if (size < sizeof(header)) return false;
+  memcpy(header, data, sizeof(header));
+  if (header[0] != GLB_MAGIC || header[1] != GLB_VERSION ||
+      header[2] < sizeof(header) || header[2] > size ||
+      header[4] != GLB_CHUNK_JSON || header[3] > header[2] - sizeof(header))
+    return false;
+  size = header[2];
+
+  Gltf g;
+  memset(&g, 0, sizeof(Gltf));
+  g.json.text = (const char *)data + sizeof(header);
+  g.json.length = header[3];
+  size_t binOffset = sizeof(header) + ((header[3] + 3) & ~3u);
+  if (binOffset + 8 <= size) {
+    uint32_t chunk[2];
+    memcpy(chunk, data + binOffset, sizeof(chunk));
+    if (chunk[1] == GLB_CHUNK_BIN && chunk[0] <= size - binOffset - 8) {
+      g.bin = data + binOffset + 8;
+      g.binSize = chunk[0];
+    }
+  }
+
+  size_t pos = 0;
+  g.root = jsonValue(&g.json, &pos, 0);
+  bool ok = g.root >= 0 && g.json.tokens[g.root].type == JSON_OBJECT;
+  const Json *js = &g.json;
+  int mesh = ok ? jsonAt(js, jsonGet(js, g.root, "meshes"), 0) : -1;
+  int prims = jsonGet(js, mesh, "primitives");
+  bool *missing = NULL;
+  long material = -1;
+  ok = prims >= 0 && js->tokens[prims].type == JSON_ARRAY;
+  for (int i = 0; ok && i < js->tokens[prims].size; ++i) {
+    int prim = jsonAt(js, prims, i);
+    if (jsonInt(js, jsonGet(js, prim, "mode"), GLTF_TRIANGLES) != GLTF_TRIANGLES)
+      continue;
+    ok = readPrimitive(&g, prim, model, &missing);
+    if (material < 0) material = jsonInt(js, jsonGet(js, prim, "material"), -1);
+  }
+  ok = ok && model->nFaces > 0;
+  if (ok) {
+    computeNormals(model, missing);
+    if (material >= 0) readTexture(&g, material, dir, model);
+  }
+  free(missing);
+  free(g.json.tokens);
+  if (!ok) freeModel(model);
+  return ok;
+}
+
+MSVMesh *
+MSVModelLoader::createMesh(const Model *model)
+{
+  return new MSVMesh(model->nVertices, model->vertices, model->normals,
+                     model->texCoords, model->nFaces, model->faces);
+}
+
+void
+MSVModelLoader::freeModel(Model *model)
+{
+  free(model->vertices);
+  free(model->normals);
+  free(model->texCoords);
+  free(model->faces);
+  free(model->texturePath);
+  free(model->textureData);
+  memset(model, 0, sizeof(Model));
+}
+
+void
+MSVModelLoader::setThreadCount(int count)
+{
+  threadCount = count < 0 ? 0 : count;
+}
+
+int
+MSVModelLoader::getThreadCount(size_t size)
+{
+  long count = threadCount;
+  if (!count) count = sysconf(_SC_NPROCESSORS_ONLN);
+  if (count > LOADER_MAX_THREADS) count = LOADER_MAX_THREADS;
+  // Small files are not worth the threads
+  long chunks = size / LOADER_MIN_CHUNK;
+  if (count > chunks) count = chunks;
+  return count < 1 ? 1 : count;
+}
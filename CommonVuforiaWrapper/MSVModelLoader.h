@@ -0,0 +1,89 @@
+#ifndef MSV_MODELLOADER_H
+#define MSV_MODELLOADER_H
+
+#include <stddef.h>
+
+class MSVMesh;
+
+/** Maximal number of threads parsing an OBJ file */
+#define LOADER_MAX_THREADS  8
+/** Minimal size of the part of an OBJ file parsed by each thread, in bytes */
+#define LOADER_MIN_CHUNK    (256*1024)
+/** Maximal number of vertices of a model, as MSVMesh indexes them with
+ * GL_UNSIGNED_SHORT.
+ */
+#define LOADER_MAX_VERTICES 65536
+/** Maximal number of face indices of a model, i.e. 4 triangles per vertex */
+#define LOADER_MAX_INDICES  (12*LOADER_MAX_VERTICES)
+
+/** Native loader of 3D models, from Wavefront OBJ or binary glTF 2.0 (.glb)
+ * files.
+ *
+ * Files are memory-mapped rather than read. Large OBJ files are split into
+ * chunks of lines parsed in parallel, then each distinct combination of
+ * position, texture coordinates and normal becomes one vertex, looked up in
+ * a hash table. Normals missing from the file are computed from the faces.
+ *
+ * Only the geometry is loaded: the base color texture referenced by the
+ * model, if any, is returned as a path, or as the encoded image embedded in
+ * a .glb file. Only the first mesh of a .glb file is loaded, without its node
+ * transforms.
+ */
+class MSVModelLoader {
+  public:
+    /** Loaded model, with the layout expected by MSVMesh */
+    struct Model {
+      unsigned int nVertices;
+      float *vertices;
+      float *normals;
+      float *texCoords;
+      unsigned int nFaces;
+      float *faces;
+      /** Path of the texture file, or NULL */
+      char *texturePath;
+      /** Encoded texture embedded in the model file, or NULL */
+      unsigned char *textureData;
+      size_t textureSize;
+    };
+
+    /** Loads a model, whose format is detected from its content.
+     * @param path the path of the .obj or .glb file. Relative texture paths
+     * are resolved against its directory.
+     * @param model filled with the model, to be freed with `freeModel`.
+     * @return false if the file could not be read or parsed, or if the
+     * model has more than LOADER_MAX_VERTICES vertices.
+     */
+    static bool load(const char *path, Model *model);
+
+    /** Loads a model from OBJ text.
+     * @param dir the directory of the .obj file, in which .mtl and texture
+     * files are looked for, or NULL.
+     */
+    static bool loadOBJ(const char *data, size_t size, const char *dir,
+                        Model *model);
+
+    /** Loads a model from .glb data.
+     * @param dir the directory of the .glb file, against which external
+     * image URIs are resolved, or NULL.
+     */
+    static bool loadGLB(const unsigned char *data, size_t size,
+                        const char *dir, Model *model);
+
+    /** Returns a new MSVMesh built from a loaded model */
+    static MSVMesh *createMesh(const Model *model);
+
+    /** Frees the content of a loaded model */
+    static void freeModel(Model *model);
+
+    /** Sets the number of threads parsing OBJ files, 0 (default) to use one
+     * per CPU, up to LOADER_MAX_THREADS.
+     */
+    static void setThreadCount(int count);
+
+  private:
+    static int threadCount;
+
+    static int getThreadCount(size_t size);
+};
+
+#endif
@@ -0,0 +1,82 @@
+#include "MSVController.h"
+#include "MSVMesh.h"
+#include "MSVModel.h"
+#include "MSVPendingModel.h"
+#include "MSVTexture.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_PENDING_PARTS 4
+
+MSVPendingModel::MSVPendingModel() :
+parts(NULL),
+count(0),
+capacity(0),
+remaining(1),
+ticket(0)
+{}
+
+MSVPendingModel::~MSVPendingModel()
+{
+  for (int i = 0; i < count; ++i) free(parts[i].path);
+  free(parts);
+}
+
+void
+MSVPendingModel::addPart(MSVMesh *mesh,
+                         MSVTexture *tex,
+                         const char *path,
+                         unsigned int maxSize,
+                         const float transform[16])
+{
+  if (count == capacity) {
+    capacity = capacity ? 2*capacity : INITIAL_PENDING_PARTS;
+    parts = (Part *)realloc(parts, capacity*sizeof(Part));
+  }
+  Part *p = &parts[count++];
+  p->owner = this;
+  p->mesh = mesh;
+  p->tex = tex;
+  p->path = path ? strdup(path) : NULL;
+  p->maxSize = maxSize;
+  p->hasTransform = transform != NULL;
+  if (transform) memcpy(p->transform, transform, 16*sizeof(float));
+}
+
+void
+MSVPendingModel::commit(const float scale[3])
+{
+  memcpy(this->scale, scale, 3*sizeof(float));
+  // Reserved first: a model set while decoding outdates this one
+  ticket = MSVController::reserveModel();
+  for (int i = 0; i < count; ++i) {
+    if (!parts[i].path) continue;
+    __sync_fetch_and_add(&remaining, 1);
+    MSVTexture::decodeAsync(parts[i].path, parts[i].maxSize, parts[i].maxSize,
+                            MSVPendingModel::decoded, &parts[i]);
+  }
+  done();
+}
+
+void
+MSVPendingModel::decoded(MSVTexture *tex, void *part)
+{
+  Part *p = (Part *)part;
+  p->tex = tex;
+  p->owner->done();
+}
+
+void
+MSVPendingModel::done()
+{
+  if (__sync_sub_and_fetch(&remaining, 1)) return;
+  MSVModel *model = new MSVModel();
+  for (int i = 0; i < count; ++i)
+    model->addPart(parts[i].mesh, parts[i].tex,
+                   parts[i].hasTransform ? parts[i].transform : NULL);
+  // A single empty part is the plane, which is not cached
+  bool cache = count != 1 || parts[0].mesh || parts[0].tex;
+  MSVController::setReservedModel(model, scale, ticket, cache);
+  delete this;
+}
@@ -0,0 +1,62 @@
+#ifndef MSV_PENDING_MODEL_H
+#define MSV_PENDING_MODEL_H
+
+class MSVMesh;
+class MSVTexture;
+
+/** A static model whose textures are decoded from image files on the
+ * MSVImageDecoder worker thread (see MSVTexture::decodeAsync), so that
+ * setting a model never blocks the caller on decoding.
+ *
+ * The model is set from the callback of its last decoded texture, or right
+ * away if it has none to decode. It is dropped if another model is set, or
+ * another target tracked, in the meantime (see
+ * MSVController::reserveModel).
+ */
+class MSVPendingModel {
+  public:
+    MSVPendingModel();
+
+    /** Adds a part, as MSVModel::addPart.
+     * @param tex the texture, NULL if `path` is given.
+     * @param path the image file to decode the texture from, downscaled to
+     * fit in `maxSize`, or NULL to use `tex`. The path is copied.
+     * References to `mesh` and `tex` are transferred to the pending model.
+     */
+    void addPart(MSVMesh *mesh,
+                 MSVTexture *tex,
+                 const char *path,
+                 unsigned int maxSize = 0,
+                 const float transform[16] = NULL);
+
+    /** Starts decoding the textures, then sets the model as
+     * MSVController::setModel would, or as MSVController::setStaticModel
+     * if it has a single part. The pending model deletes itself.
+     */
+    void commit(const float scale[3]);
+
+  private:
+    struct Part {
+      MSVPendingModel *owner;
+      MSVMesh *mesh;
+      MSVTexture *tex;
+      char *path;
+      unsigned int maxSize;
+      bool hasTransform;
+      float transform[16];
+    };
+
+    Part *parts;
+    int count;
+    int capacity;
+    /* Decodes not completed yet, plus one until `commit` returns */
+    volatile int remaining;
+    unsigned int ticket;
+    float scale[3];
+
+    ~MSVPendingModel();
+    void done();
+    static void decoded(MSVTexture *tex, void *part);
+};
+
+#endif
@@ -0,0 +1,125 @@
+#include "MSVFrame.h"
+#include "MSVRecorder.h"
+#include "MSVReplay.h"
+#include "MSVTrace.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+// Initialize static variables
+FILE * volatile MSVRecorder::file = NULL;
+bool MSVRecorder::compressed = false;
+unsigned char *MSVRecorder::buffer = NULL;
+unsigned long MSVRecorder::buffer_size = 0;
+pthread_mutex_t MSVRecorder::lock = PTHREAD_MUTEX_INITIALIZER;
+
+bool
+MSVRecorder::start(const char *path, bool compress)
+{
+  pthread_mutex_lock(&lock);
+  bool ok = false;
+  if (!file) {
+    FILE *f = fopen(path, "wb");
+    if (f) {
+      uint32_t header[3] = {RECORD_MAGIC, RECORD_VERSION,
+                            compress ? (uint32_t)RECORD_COMPRESSED : 0};
+      fwrite(header, sizeof(uint32_t), 3, f);
+      compressed = compress;
+      file = f;
+      ok = true;
+    }
+  }
+  pthread_mutex_unlock(&lock);
+  return ok;
+}
+
+void
+MSVRecorder::stop()
+{
+  pthread_mutex_lock(&lock);
+  if (file) fclose(file);
+  file = NULL;
+  free(buffer);
+  buffer = NULL;
+  buffer_size = 0;
+  pthread_mutex_unlock(&lock);
+}
+
+bool
+MSVRecorder::isRecording()
+{
+  return file != NULL;
+}
+
+void
+MSVRecorder::recordFrame(const MSVFrame &frame)
+{
+  if (!file) return;
+  MSV_TRACE_SCOPE("recordFrame");
+  pthread_mutex_lock(&lock);
+  if (file) {
+    writeHeader(file, MSVReplay::RECORD_FRAME, frame);
+    int32_t dims[2] = {0, 0};
+    uint32_t size = 0;
+    const unsigned char *data = NULL;
+    const QCAR::Image *img = frame.image;
+    if (img) {
+      dims[0] = img->getWidth();
+      dims[1] = img->getHeight();
+      // Pack the rows, dropping the stride padding
+      unsigned long raw = dims[0]*dims[1];
+      unsigned long needed = compressed ? raw + compressBound(raw) : raw;
+      if (needed > buffer_size) {
+        buffer = (unsigned char *)realloc(buffer, needed);
+        buffer_size = needed;
+      }
+      const unsigned char *src = (const unsigned char *)img->getPixels();
+      for (int r = 0; r < dims[1]; ++r) {
+        memcpy(buffer + r*dims[0], src + r*img->getStride(), dims[0]);
+      }
+      data = buffer;
+      size = raw;
+      if (compressed) {
+        uLongf len = needed - raw;
+        if (compress2(buffer + raw, &len, buffer, raw, Z_BEST_SPEED) == Z_OK) {
+          data = buffer + raw;
+          size = len;
+        }
+        else {
+          size = 0;
+        }
+      }
+    }
+    fwrite(dims, sizeof(int32_t), 2, file);
+    fwrite(&size, sizeof(uint32_t), 1, file);
+    if (size) fwrite(data, 1, size, file);
+  }
+  pthread_mutex_unlock(&lock);
+}
+
+void
+MSVRecorder::recordRender(const MSVFrame &frame)
+{
+  if (!file) return;
+  pthread_mutex_lock(&lock);
+  if (file) {
+    writeHeader(file, MSVReplay::RECORD_RENDER, frame);
+    fwrite(frame.projection, sizeof(float), 16, file);
+  }
+  pthread_mutex_unlock(&lock);
+}
+
+void
+MSVRecorder::writeHeader(FILE *f, int type, const MSVFrame &frame)
+{
+  uint32_t t = type;
+  int32_t index = frame.index;
+  int32_t count = frame.resultCount;
+  fwrite(&t, sizeof(uint32_t), 1, f);
+  fwrite(&frame.timestamp, sizeof(double), 1, f);
+  fwrite(&index, sizeof(int32_t), 1, f);
+  fwrite(&count, sizeof(int32_t), 1, f);
+  fwrite(frame.results, sizeof(MSVFrameResult), count, f);
+}
@@ -0,0 +1,64 @@
+#ifndef MSV_RECORDER_H
+#define MSV_RECORDER_H
+
+#include <pthread.h>
+#include <stdio.h>
+
+class MSVFrame;
+
+/** Stream format constants, shared with MSVReplay */
+#define RECORD_MAGIC      0x5256534d  /* "MSVR" */
+#define RECORD_VERSION    1
+#define RECORD_COMPRESSED 0x1
+/** Largest camera image side accepted when replaying */
+#define RECORD_MAX_IMAGE_SIDE 8192
+
+/** Class recording the frames processed by the wrapper, so that a session
+ * can be replayed later with MSVReplay, e.g. on a host for benchmarking.
+ *
+ * The stream starts with a header {magic, version, flags}, as 32-bit
+ * integers. It is followed by records, each starting with its type:
+ *
+ * - MSVReplay::RECORD_FRAME, written from MSVCallback::QCAR_onUpdate:
+ *   {f64 timestamp, i32 index, i32 resultCount, MSVFrameResult results[],
+ *    i32 width, i32 height, u32 size, u8 pixels[size]}
+ *   where pixels are the grayscale camera image rows, without padding,
+ *   zlib-compressed if the RECORD_COMPRESSED flag is set.
+ * - MSVReplay::RECORD_RENDER, written from MSVRenderer::renderFrame:
+ *   {f64 timestamp, i32 index, i32 resultCount, MSVFrameResult results[],
+ *    f32 projection[16]}
+ *
+ * Values are written in the native byte order.
+ */
+class MSVRecorder {
+  public:
+    /** Starts recording to a new file.
+     * @param path the path of the file to write.
+     * @param compress true to compress the camera images.
+     * @return true if recording started, false otherwise.
+     */
+    static bool start(const char *path, bool compress);
+
+    /** Stops recording and closes the file */
+    static void stop();
+
+    /** Returns true if a recording is in progress */
+    static bool isRecording();
+
+    /** Records a camera frame. Does nothing if not recording. */
+    static void recordFrame(const MSVFrame &frame);
+
+    /** Records a rendered frame. Does nothing if not recording. */
+    static void recordRender(const MSVFrame &frame);
+
+  private:
+    static FILE * volatile file;
+    static bool compressed;
+    static unsigned char *buffer;
+    static unsigned long buffer_size;
+    static pthread_mutex_t lock;
+
+    static void writeHeader(FILE *f, int type, const MSVFrame &frame);
+};
+
+#endif
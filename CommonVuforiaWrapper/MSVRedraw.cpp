@@ -0,0 +1,45 @@
+#include "MSVRedraw.h"
+
+#include <stdlib.h>
+
+MSVRedraw::Listener *MSVRedraw::listener = NULL;
+volatile unsigned int MSVRedraw::pending = 0;
+pthread_mutex_t MSVRedraw::lock = PTHREAD_MUTEX_INITIALIZER;
+
+MSVRedraw::Listener::~Listener() {}
+
+void
+MSVRedraw::setListener(Listener *l)
+{
+  pthread_mutex_lock(&lock);
+  Listener *old = listener;
+  listener = l;
+  // Start from a clean state: the first frame is always requested
+  __sync_lock_test_and_set(&pending, 0);
+  pthread_mutex_unlock(&lock);
+  delete old;
+  if (l) invalidate(SURFACE_CHANGED);
+}
+
+bool
+MSVRedraw::isOnDemand()
+{
+  return listener != NULL;
+}
+
+void
+MSVRedraw::invalidate(Reason reason)
+{
+  if (!listener) return;
+  // Only the first request since the last rendered frame is forwarded
+  if (__sync_fetch_and_or(&pending, (unsigned int)reason)) return;
+  pthread_mutex_lock(&lock);
+  if (listener) listener->requestRender();
+  pthread_mutex_unlock(&lock);
+}
+
+unsigned int
+MSVRedraw::beginFrame()
+{
+  return __sync_lock_test_and_set(&pending, 0);
+}
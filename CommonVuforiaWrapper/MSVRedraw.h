@@ -0,0 +1,63 @@
+#ifndef MSV_REDRAW_H
+#define MSV_REDRAW_H
+
+#include <pthread.h>
+
+/** On-demand rendering.
+ *
+ * By default the platform view renders continuously. Once a Listener is
+ * set, the view is expected to only render when asked to: the Listener is
+ * then notified whenever something visible changed, i.e. a new camera frame
+ * was delivered, the model or a dynamic texture was updated, the surface
+ * or the overlay resolution or stereo mode changed, or frames are being
+ * captured.
+ * Requests are coalesced until the next rendered frame.
+ */
+class MSVRedraw {
+  public:
+    /** Reasons for a new frame to be rendered */
+    enum Reason {
+      CAMERA_FRAME    = 1 << 0,
+      MODEL_CHANGED   = 1 << 1,
+      TEXTURE_UPDATED = 1 << 2,
+      SURFACE_CHANGED = 1 << 3,
+      FRAME_CAPTURE   = 1 << 4,
+      OVERLAY_SCALE   = 1 << 5,
+      STEREO_CHANGED  = 1 << 6
+    };
+
+    /** Abstract class asking the platform view to render a frame */
+    class Listener {
+      public:
+        virtual ~Listener();
+        /** Called from any thread when a frame should be rendered */
+        virtual void requestRender() = 0;
+    };
+
+    /** Enables on-demand rendering.
+     * @param listener the Listener to notify, or NULL to go back to
+     * continuous rendering. Its ownership is transferred to the MSVRedraw,
+     * which deletes the previous one.
+     */
+    static void setListener(Listener *listener);
+
+    /** Returns true if on-demand rendering is enabled */
+    static bool isOnDemand();
+
+    /** Signals that a new frame should be rendered. Can be called from any
+     * thread. Does nothing in continuous rendering mode.
+     */
+    static void invalidate(Reason reason);
+
+    /** Called by the renderer at the beginning of each frame.
+     * @return the reasons accumulated since the previous frame.
+     */
+    static unsigned int beginFrame();
+
+  private:
+    static Listener *listener;
+    static volatile unsigned int pending;
+    static pthread_mutex_t lock;
+};
+
+#endif
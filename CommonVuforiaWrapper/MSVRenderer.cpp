@@ -1,16 +1,31 @@
 #include "MSVShaders.h"
+#include "MSVBackend.h"
+#include "MSVBVH.h"
 #include "MSVController.h"
+#include "MSVEpoch.h"
+#include "MSVFrame.h"
+#include "MSVGovernor.h"
 #include "MSVMesh.h"
+#include "MSVModel.h"
+#include "MSVRecorder.h"
+#include "MSVRedraw.h"
 #include "MSVRenderer.h"
+#include "MSVResourceManager.h"
 #include "MSVState.h"
 #include "MSVTargetInfo.h"
 #include "MSVTexture.h"
 #include "MSVTextureCallback.h"
+#include "MSVTrace.h"
 
-#include <QCAR/CameraDevice.h>
-#include <QCAR/Renderer.h>
-#include <QCAR/TrackableResult.h>
-#include <QCAR/VideoBackgroundConfig.h>
+#include <math.h>
+#include <string.h>
+
+MSVRenderer::Stats MSVRenderer::stats = {0, 0, 0};
+pthread_mutex_t MSVRenderer::statsLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t MSVRenderer::hitLock = PTHREAD_MUTEX_INITIALIZER;
+volatile float MSVRenderer::overlayScale = 1;
+volatile bool MSVRenderer::stereo = false;
+volatile float MSVRenderer::stereoIPD = 0;
 
 // Contructor
 MSVRenderer::MSVRenderer() :
@@ -23,27 +38,53 @@ dynamicMvpMatrixHandle(0),
 dynamicTexCoordTransformHandle(0),
 dynamicTexSamplerOESHandle(0),
 #endif
-shaderProgramID(0),
-vertexHandle(0),
-normalHandle(0),
-textureCoordHandle(0),
-mvpMatrixHandle(0),
-texCoordTransformHandle(0),
-texSampler2DHandle(0),
+staticProgram(),
+animatedProgram(),
+nv12Program(),
+i420Program(),
+blitProgram(),
+captureIdx(0),
+captureStaging(0),
+captureWidth(0),
+captureHeight(0),
+captureOutWidth(0),
+captureOutHeight(0),
+overlayTexture(0),
+overlayDepth(0),
+overlayFramebuffer(0),
+overlayWidth(0),
+overlayHeight(0),
+videoWidth(0),
+videoHeight(0),
+videoStereo(false),
+stereoFrame(false),
+stereoBackground(0),
+stereoWidth(0),
+stereoHeight(0),
 nextTextureID(0)
 {
+  // A new GL context is being used: previous GL objects are gone
+  MSVResourceManager::invalidateAll();
+
   // Define clear color
-  glClearColor(0.0f, 0.0f, 0.0f, QCAR::requiresAlpha() ? 0.0f : 1.0f);
+  glClearColor(0.0f, 0.0f, 0.0f, MSVController::getBackend()->requiresAlpha() ? 0.0f : 1.0f);
 
   // Initialize OpenGL: shaders, attributes.
-  shaderProgramID = MSVRenderer::createProgramFromBuffer(vertexShader,
-                                                         fragmentShader);
-  vertexHandle = glGetAttribLocation(shaderProgramID, "vertexPosition");
-  normalHandle = glGetAttribLocation(shaderProgramID, "vertexNormal");
-  textureCoordHandle = glGetAttribLocation(shaderProgramID, "vertexTexCoord");
-  mvpMatrixHandle = glGetUniformLocation(shaderProgramID, "modelViewProjectionMatrix");
-  texCoordTransformHandle = glGetUniformLocation(shaderProgramID, "texCoordTransformMatrix");
-  texSampler2DHandle  = glGetUniformLocation(shaderProgramID, "texSampler2D");
+  MSVRenderer::initStaticProgram(&staticProgram, vertexShader);
+  MSVRenderer::initStaticProgram(&animatedProgram, animatedVertexShader);
+  static const char *const nv12Samplers[3] = {"texSamplerY", "texSamplerUV", NULL};
+  static const char *const i420Samplers[3] = {"texSamplerY", "texSamplerU", "texSamplerV"};
+  MSVRenderer::initYUVProgram(&nv12Program, nv12FragmentShader, nv12Samplers);
+  MSVRenderer::initYUVProgram(&i420Program, i420FragmentShader, i420Samplers);
+  unsigned int blitID = MSVRenderer::createProgramFromBuffer(blitVertexShader,
+                                                             blitFragmentShader);
+  blitProgram.programID = blitID;
+  blitProgram.vertexHandle = glGetAttribLocation(blitID, "vertexPosition");
+  blitProgram.texSampler2DHandle = glGetUniformLocation(blitID, "texSampler2D");
+  memset(captureSlots, 0, sizeof(captureSlots));
+  memset(&hitPose, 0, sizeof(hitPose));
+  memset(overlayBox, 0, sizeof(overlayBox));
+  memset(stereoViewport, 0, sizeof(stereoViewport));
 #if (!defined(__MSV_SYS_IOS__))
   dynamicShaderProgramID = MSVRenderer::createProgramFromBuffer(vertexShader,
                                                                 dynamicFragmentShader);
@@ -66,148 +107,1136 @@ MSVRenderer::obtainTextureID() {
 void
 MSVRenderer::renderFrame()
 {
+  MSV_TRACE_SCOPE("renderFrame");
+
+  beginRender();
+
+  // The camera may have been restarted with another video mode
+  MSVBackend *backend = MSVController::getBackend();
+  int w, h;
+  backend->getVideoSize(&w, &h);
+  if (w != videoWidth || h != videoHeight || stereoFrame != videoStereo) {
+    setProjectionMatrix();
+    configureVideoBackground();
+  }
+
+  // Get the state from the backend and mark the beginning of a rendering
+  // section. This also renders the video background.
+  MSVFrame frame;
+  {
+    MSV_TRACE_SCOPE("drawVideoBackground");
+    backend->beginRender(&frame);
+    if (stereoFrame) duplicateBackground();
+  }
+  memcpy(frame.projection, projectionMatrix.data, 16*sizeof(float));
+  MSVRecorder::recordRender(frame);
+
+  // Background only fast path: nothing to overlay without tracking results
+  if (frame.resultCount > 0 && MSVController::isTracking()) drawModel(frame);
+  else setHitPose(NULL, NULL, NULL, NULL);
+
+  backend->endRender();
+
+  copyCapture(frame.timestamp);
+  endRender();
+}
+
+void
+MSVRenderer::renderFrame(const MSVFrame &frame)
+{
+  MSV_TRACE_SCOPE("renderFrame");
+
+  beginRender();
+  // No background to copy: the eyes share the current viewport
+  if (stereoFrame) glGetIntegerv(GL_VIEWPORT, stereoViewport);
+  if (frame.resultCount > 0 && MSVController::isTracking()) drawModel(frame);
+  else setHitPose(NULL, NULL, NULL, NULL);
+  copyCapture(frame.timestamp);
+  endRender();
+}
+
+void
+MSVRenderer::beginRender()
+{
+  // Requests received from now on will trigger a new frame
+  MSVRedraw::beginFrame();
+  MSVGovernor::beginFrame();
+  readCapture();
+  stereoFrame = stereo;
+  if (!stereoFrame && stereoBackground) releaseStereo();
+  // Not used in stereo
+  if (stereoFrame && overlayFramebuffer) releaseOverlay();
+
   // Clear color and depth buffer
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+  MSVResourceManager::beginFrame();
+
   // If needed, generate a new texture ID
-  if (!nextTextureID) glGenTextures(1, &nextTextureID);
+  if (!nextTextureID) {
+    glGenTextures(1, &nextTextureID);
+    MSVResourceManager::track(MSVResourceManager::TEXTURE, nextTextureID, 0, NULL);
+  }
+}
+
+void
+MSVRenderer::endRender()
+{
+  // Free the models replaced during this frame or earlier, then their
+  // GL objects
+  MSV_TRACE_SCOPE("reclaim");
+  MSVEpoch::reclaim();
+  MSVResourceManager::collect();
+  MSVGovernor::endFrame();
+}
+
+void
+MSVRenderer::readCapture()
+{
+  CaptureSlot *oldest = &captureSlots[(captureIdx + 1) % (CAPTURE_LATENCY + 1)];
+  if (!oldest->pending) return;
+  oldest->pending = false;
+  MSV_TRACE_SCOPE("readCapture");
+  unsigned char *pixels = MSVFrameCapture::acquireBuffer(captureOutWidth,
+                                                         captureOutHeight);
+  if (!pixels) return;
+  GLint framebuffer = 0;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, oldest->framebuffer);
+  glReadPixels(0, 0, captureOutWidth, captureOutHeight,
+               GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  MSVFrameCapture::submit(pixels, oldest->timestamp);
+}
+
+void
+MSVRenderer::copyCapture(double timestamp)
+{
+  bool capturing = MSVFrameCapture::isCapturing();
+  if (!capturing) {
+    if (captureStaging) releaseCapture();
+    return;
+  }
+  MSV_TRACE_SCOPE("copyCapture");
+  GLint framebuffer = 0;
+  GLint viewport[4] = {0, 0, 0, 0};
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  // The whole surface: the viewport is the one of the video background,
+  // which may extend beyond it
+  int width, height;
+  MSVState::getGLViewSize(&width, &height);
+  float scale = MSVFrameCapture::getScale();
+  int outWidth = (int)(scale*width + 0.5f);
+  int outHeight = (int)(scale*height + 0.5f);
+  if (outWidth < 1 || outHeight < 1) return;
+  if (!captureStaging || width != captureWidth ||
+      height != captureHeight || outWidth != captureOutWidth ||
+      outHeight != captureOutHeight) {
+    // The view has been resized: the copies in flight are lost
+    releaseCapture();
+    if (!initCapture(width, height, outWidth, outHeight)) {
+      releaseCapture();
+      MSVFrameCapture::stop();
+      return;
+    }
+  }
+
+  CaptureSlot *slot = &captureSlots[captureIdx];
+  if (MSVFrameCapture::takeFrame()) {
+    // GPU work only: the readback waits until it is done
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, captureStaging);
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0,
+                        captureWidth, captureHeight);
+    glBindFramebuffer(GL_FRAMEBUFFER, slot->framebuffer);
+    glViewport(0, 0, captureOutWidth, captureOutHeight);
+    blit(captureStaging, false);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    slot->timestamp = timestamp;
+    slot->pending = true;
+  }
+  else {
+    bool pending = false;
+    for (int i = 0; i <= CAPTURE_LATENCY; ++i)
+      pending = pending || captureSlots[i].pending;
+    // All the requested frames have been read back
+    if (!pending) MSVFrameCapture::stop();
+  }
+  captureIdx = (captureIdx + 1) % (CAPTURE_LATENCY + 1);
+  // The copies are read back at the next frames, which must come even when
+  // rendering on demand
+  MSVRedraw::invalidate(MSVRedraw::FRAME_CAPTURE);
+}
 
-  // Get the state from QCAR and mark the beginning of a rendering section
-  QCAR::State state = QCAR::Renderer::getInstance().begin();
+bool
+MSVRenderer::initCapture(int width, int height, int outWidth, int outHeight)
+{
+  // The staging texture must have the components of the view, which may
+  // have no alpha channel
+  GLint alphaBits = 0;
+  glGetIntegerv(GL_ALPHA_BITS, &alphaBits);
+  GLenum format = alphaBits > 0 ? GL_RGBA : GL_RGB;
+  captureWidth = width;
+  captureHeight = height;
+  captureOutWidth = outWidth;
+  captureOutHeight = outHeight;
+  captureIdx = 0;
 
-  // Explicitly render the Video Background
-  QCAR::Renderer::getInstance().drawVideoBackground();
+  glActiveTexture(GL_TEXTURE0);
+  glGenTextures(1, &captureStaging);
+  glBindTexture(GL_TEXTURE_2D, captureStaging);
+  glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0,
+               format, GL_UNSIGNED_BYTE, NULL);
+  // Allow non-power-of-two textures
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  MSVResourceManager::track(MSVResourceManager::TEXTURE, captureStaging,
+                            (alphaBits > 0 ? 4 : 3)*width*height, NULL);
 
-  int tIdx = MSVController::currentTargetFound(state);
+  GLint framebuffer = 0;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+  bool complete = true;
+  for (int i = 0; i <= CAPTURE_LATENCY; ++i) {
+    CaptureSlot *slot = &captureSlots[i];
+    glGenTextures(1, &slot->texture);
+    glBindTexture(GL_TEXTURE_2D, slot->texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, outWidth, outHeight, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    MSVResourceManager::track(MSVResourceManager::TEXTURE, slot->texture,
+                              4*outWidth*outHeight, NULL);
+    glGenFramebuffers(1, &slot->framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, slot->framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_2D, slot->texture, 0);
+    MSVResourceManager::track(MSVResourceManager::FRAMEBUFFER,
+                              slot->framebuffer, 0, NULL);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+      complete = false;
+    slot->pending = false;
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  return complete;
+}
+
+void
+MSVRenderer::releaseCapture()
+{
+  if (captureStaging)
+    MSVResourceManager::release(MSVResourceManager::TEXTURE, captureStaging);
+  captureStaging = 0;
+  for (int i = 0; i <= CAPTURE_LATENCY; ++i) {
+    CaptureSlot *slot = &captureSlots[i];
+    if (slot->texture)
+      MSVResourceManager::release(MSVResourceManager::TEXTURE, slot->texture);
+    if (slot->framebuffer)
+      MSVResourceManager::release(MSVResourceManager::FRAMEBUFFER,
+                                  slot->framebuffer);
+    slot->texture = 0;
+    slot->framebuffer = 0;
+    slot->pending = false;
+  }
+}
+
+void
+MSVRenderer::blit(GLuint texture,
+                  bool composite,
+                  const GLint *viewports,
+                  int count)
+{
+  static const GLfloat quad[8] = {-1, -1,
+                                   1, -1,
+                                  -1,  1,
+                                   1,  1};
+  glDisable(GL_DEPTH_TEST);
+  glDisable(GL_CULL_FACE);
+  if (composite) {
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+  }
+  else {
+    glDisable(GL_BLEND);
+  }
+  glUseProgram(blitProgram.programID);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glUniform1i(blitProgram.texSampler2DHandle, 0);
+  glVertexAttribPointer(blitProgram.vertexHandle, 2, GL_FLOAT, GL_FALSE, 0, quad);
+  glEnableVertexAttribArray(blitProgram.vertexHandle);
+  for (int i = 0; i < count; ++i) {
+    if (viewports) {
+      const GLint *v = viewports + 4*i;
+      glViewport(v[0], v[1], v[2], v[3]);
+    }
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+  }
+  glDisableVertexAttribArray(blitProgram.vertexHandle);
+  if (composite) glDisable(GL_BLEND);
+}
+
+void
+MSVRenderer::setOverlayScale(float scale)
+{
+  if (scale < OVERLAY_MIN_SCALE) scale = OVERLAY_MIN_SCALE;
+  if (!(scale < 1)) scale = 1;
+  overlayScale = scale;
+  MSVRedraw::invalidate(MSVRedraw::OVERLAY_SCALE);
+}
+
+float
+MSVRenderer::getOverlayScale()
+{
+  return overlayScale;
+}
+
+void
+MSVRenderer::setStereo(bool enabled, float ipd)
+{
+  stereoIPD = ipd;
+  stereo = enabled;
+  MSVRedraw::invalidate(MSVRedraw::STEREO_CHANGED);
+}
+
+bool
+MSVRenderer::isStereo()
+{
+  return stereo;
+}
+
+void
+MSVRenderer::duplicateBackground()
+{
+  glGetIntegerv(GL_VIEWPORT, stereoViewport);
+  int glWidth, glHeight;
+  MSVState::getGLViewSize(&glWidth, &glHeight);
+  int eyeWidth = glWidth/2;
+  if (eyeWidth < 1 || glHeight < 1) return;
+  MSV_TRACE_SCOPE("duplicateBackground");
+  glActiveTexture(GL_TEXTURE0);
+  if (!stereoBackground || eyeWidth != stereoWidth || glHeight != stereoHeight) {
+    releaseStereo();
+    // Same components as the view, which may have no alpha channel
+    GLint alphaBits = 0;
+    glGetIntegerv(GL_ALPHA_BITS, &alphaBits);
+    GLenum format = alphaBits > 0 ? GL_RGBA : GL_RGB;
+    stereoWidth = eyeWidth;
+    stereoHeight = glHeight;
+    glGenTextures(1, &stereoBackground);
+    glBindTexture(GL_TEXTURE_2D, stereoBackground);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, stereoWidth, stereoHeight, 0,
+                 format, GL_UNSIGNED_BYTE, NULL);
+    // Allow non-power-of-two textures
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    MSVResourceManager::track(MSVResourceManager::TEXTURE, stereoBackground,
+                              (alphaBits > 0 ? 4 : 3)*stereoWidth*stereoHeight,
+                              NULL);
+  }
+  else {
+    glBindTexture(GL_TEXTURE_2D, stereoBackground);
+  }
+  glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, (glWidth - eyeWidth)/2, 0,
+                      eyeWidth, glHeight);
+  GLint eyes[8] = {0, 0, eyeWidth, glHeight,
+                   glWidth - eyeWidth, 0, eyeWidth, glHeight};
+  blit(stereoBackground, false, eyes, 2);
+  // The whole view, e.g. for frame capture
+  glViewport(0, 0, glWidth, glHeight);
+}
+
+void
+MSVRenderer::releaseStereo()
+{
+  if (stereoBackground)
+    MSVResourceManager::release(MSVResourceManager::TEXTURE, stereoBackground);
+  stereoBackground = 0;
+  stereoWidth = 0;
+  stereoHeight = 0;
+}
+
+int
+MSVRenderer::setupViews(const float *projection,
+                        const float *modelView,
+                        View *views)
+{
+  if (!stereoFrame) {
+    View *v = &views[0];
+    // The video background sets the viewport, which may exceed the view
+    glGetIntegerv(GL_VIEWPORT, v->viewport);
+    memcpy(v->bounds, v->viewport, sizeof(v->bounds));
+    memcpy(v->projection, projection, sizeof(v->projection));
+    MSVRenderer::multiplyMatrix((float *)projection, (float *)modelView,
+                                v->modelViewProjection);
+    return 1;
+  }
+  int glWidth, glHeight;
+  MSVState::getGLViewSize(&glWidth, &glHeight);
+  int eyeWidth = glWidth/2;
+  float ipd = stereoIPD;
+  for (int e = 0; e < 2; ++e) {
+    View *v = &views[e];
+    GLint eyeX = e ? glWidth - eyeWidth : 0;
+    // Each eye shows the background drawn at the center of the view
+    v->viewport[0] = stereoViewport[0] + eyeX - (glWidth - eyeWidth)/2;
+    v->viewport[1] = stereoViewport[1];
+    v->viewport[2] = stereoViewport[2];
+    v->viewport[3] = stereoViewport[3];
+    v->bounds[0] = eyeX;
+    v->bounds[1] = 0;
+    v->bounds[2] = eyeWidth;
+    v->bounds[3] = glHeight;
+    // The eye is half the IPD from the camera along its x axis: the
+    // projection times a translation of the other way
+    float shift = (e ? -0.5f : 0.5f)*ipd;
+    memcpy(v->projection, projection, sizeof(v->projection));
+    for (int r = 0; r < 4; ++r) v->projection[12+r] += shift*projection[r];
+    MSVRenderer::multiplyMatrix(v->projection, (float *)modelView,
+                                v->modelViewProjection);
+  }
+  return 2;
+}
+
+/** Bounds of a box in normalized device coordinates {xmin, ymin, xmax,
+ * ymax}, clamped to the view. Returns false if the box crosses the plane of
+ * the camera, where the projection is not bounded.
+ */
+static bool
+projectBox(const float *mvp, const float min[3], const float max[3], float box[4])
+{
+  box[0] = box[1] = 1;
+  box[2] = box[3] = -1;
+  for (int k = 0; k < 8; ++k) {
+    float p[3] = {(k & 1) ? max[0] : min[0],
+                  (k & 2) ? max[1] : min[1],
+                  (k & 4) ? max[2] : min[2]};
+    float clip[4];
+    for (int r = 0; r < 4; ++r)
+      clip[r] = mvp[r]*p[0] + mvp[4+r]*p[1] + mvp[8+r]*p[2] + mvp[12+r];
+    if (clip[3] <= 0) return false;
+    for (int r = 0; r < 2; ++r) {
+      float ndc = clip[r]/clip[3];
+      if (ndc < box[r]) box[r] = ndc;
+      if (ndc > box[2+r]) box[2+r] = ndc;
+    }
+  }
+  for (int r = 0; r < 4; ++r) {
+    if (box[r] < -1) box[r] = -1;
+    if (box[r] > 1) box[r] = 1;
+  }
+  return true;
+}
+
+/** Scissors a box in normalized device coordinates of a viewport, grown by
+ * `margin` pixels
+ */
+static void
+scissorBox(const float box[4], const GLint viewport[4], int margin)
+{
+  int x0 = (int)floorf(0.5f*(box[0] + 1)*viewport[2]) - margin;
+  int y0 = (int)floorf(0.5f*(box[1] + 1)*viewport[3]) - margin;
+  int x1 = (int)ceilf(0.5f*(box[2] + 1)*viewport[2]) + margin;
+  int y1 = (int)ceilf(0.5f*(box[3] + 1)*viewport[3]) + margin;
+  if (x0 < 0) x0 = 0;
+  if (y0 < 0) y0 = 0;
+  if (x1 > viewport[2]) x1 = viewport[2];
+  if (y1 > viewport[3]) y1 = viewport[3];
+  glScissor(viewport[0] + x0, viewport[1] + y0,
+            x1 > x0 ? x1 - x0 : 0, y1 > y0 ? y1 - y0 : 0);
+}
+
+bool
+MSVRenderer::beginOverlay(const MSVTargetInfo *info,
+                          const float *modelViewProjection,
+                          const MSVGovernor::Level *quality,
+                          GLint *framebuffer,
+                          GLint viewport[4])
+{
+  float scale = overlayScale;
+  if (quality->overlayScale < scale) scale = quality->overlayScale;
+  if (!(scale < 1)) {
+    if (overlayFramebuffer) releaseOverlay();
+    return false;
+  }
+  // The video background sets the viewport, which may exceed the view:
+  // the overlay covers the viewport, so that the projection is unchanged
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, framebuffer);
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  int width = (int)(scale*viewport[2] + 0.5f);
+  int height = (int)(scale*viewport[3] + 0.5f);
+  if (width < 1 || height < 1) return false;
+  if (!overlayFramebuffer || width != overlayWidth || height != overlayHeight) {
+    releaseOverlay();
+    if (!initOverlay(width, height)) {
+      releaseOverlay();
+      return false;
+    }
+  }
+
+  MSV_TRACE_SCOPE("beginOverlay");
+  // Most of the time the model only covers a part of the view
+  float min[3], max[3];
+  bool bounded;
+  if (info->isDynamicTarget()) {
+    bounded = info->getMesh()->hasBounds();
+    if (bounded) info->getMesh()->getBounds(min, max);
+  }
+  else {
+    bounded = info->getModel()->hasBounds();
+    if (bounded) info->getModel()->getBounds(min, max);
+  }
+  if (!bounded || !projectBox(modelViewProjection, min, max, overlayBox)) {
+    overlayBox[0] = overlayBox[1] = -1;
+    overlayBox[2] = overlayBox[3] = 1;
+  }
+
+  glBindFramebuffer(GL_FRAMEBUFFER, overlayFramebuffer);
+  GLint target[4] = {0, 0, overlayWidth, overlayHeight};
+  glViewport(0, 0, overlayWidth, overlayHeight);
+  // Transparent wherever nothing is drawn, whatever the view clear color.
+  // The margin covers the texels the bilinear upscale reads around the box.
+  GLfloat clearColor[4];
+  glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+  glClearColor(0, 0, 0, 0);
+  glEnable(GL_SCISSOR_TEST);
+  scissorBox(overlayBox, target, 1);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  glDisable(GL_SCISSOR_TEST);
+  glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+  // Colors end up premultiplied by the coverage, stored as alpha, so that
+  // the bilinear upscale does not bleed the transparent black into the
+  // edges, and the composite blends exactly as drawing into the view would
+  glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA,
+                      GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+  return true;
+}
+
+void
+MSVRenderer::endOverlay(GLint framebuffer, const GLint viewport[4], bool drawn)
+{
+  MSV_TRACE_SCOPE("compositeOverlay");
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+  if (!drawn) return;
+  glEnable(GL_SCISSOR_TEST);
+  scissorBox(overlayBox, viewport, 0);
+  blit(overlayTexture, true);
+  glDisable(GL_SCISSOR_TEST);
+}
+
+bool
+MSVRenderer::initOverlay(int width, int height)
+{
+  overlayWidth = width;
+  overlayHeight = height;
+
+  glActiveTexture(GL_TEXTURE0);
+  glGenTextures(1, &overlayTexture);
+  glBindTexture(GL_TEXTURE_2D, overlayTexture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0,
+               GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+  // Bilinear upscale, and non-power-of-two textures
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  MSVResourceManager::track(MSVResourceManager::TEXTURE, overlayTexture,
+                            4*width*height, NULL);
+
+  glGenRenderbuffers(1, &overlayDepth);
+  glBindRenderbuffer(GL_RENDERBUFFER, overlayDepth);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, width, height);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+  MSVResourceManager::track(MSVResourceManager::RENDERBUFFER, overlayDepth,
+                            2*width*height, NULL);
+
+  GLint framebuffer = 0;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+  glGenFramebuffers(1, &overlayFramebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, overlayFramebuffer);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                         GL_TEXTURE_2D, overlayTexture, 0);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                            GL_RENDERBUFFER, overlayDepth);
+  MSVResourceManager::track(MSVResourceManager::FRAMEBUFFER,
+                            overlayFramebuffer, 0, NULL);
+  bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  return complete;
+}
+
+void
+MSVRenderer::releaseOverlay()
+{
+  if (overlayTexture)
+    MSVResourceManager::release(MSVResourceManager::TEXTURE, overlayTexture);
+  if (overlayDepth)
+    MSVResourceManager::release(MSVResourceManager::RENDERBUFFER, overlayDepth);
+  if (overlayFramebuffer)
+    MSVResourceManager::release(MSVResourceManager::FRAMEBUFFER,
+                                overlayFramebuffer);
+  overlayTexture = 0;
+  overlayDepth = 0;
+  overlayFramebuffer = 0;
+  overlayWidth = 0;
+  overlayHeight = 0;
+}
+
+void
+MSVRenderer::drawModel(const MSVFrame &frame)
+{
+  // Get the target info snapshot, which stays valid until the end of the
+  // read section even if the model is changed meanwhile.
+  MSVEpoch::enter(MSVEpoch::READER_RENDER);
+  const MSVTargetInfo *info = MSVController::getCurrentTarget();
+
+  int tIdx = MSVController::currentTargetFound(frame, info);
   if (tIdx >= 0) {
+    MSV_TRACE_SCOPE("drawModel");
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_CULL_FACE);
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    // Get the trackable:
-    const QCAR::TrackableResult* trackableResult = state.getTrackableResult(tIdx);
-    QCAR::Matrix44F modelViewMatrix =
-      QCAR::Tool::convertPose2GLMatrix(trackableResult->getPose());
+    // Get the trackable pose:
+    QCAR::Matrix44F modelViewMatrix;
+    MSVRenderer::poseToGLMatrix(frame.results[tIdx].pose,
+                                &modelViewMatrix.data[0]);
 
-    // get the target info
-    const MSVTargetInfo *info = MSVController::getCurrentTarget();
-    MSVMesh *mesh = info->getMesh();
+    // get the target model, at the current quality level
+    const MSVGovernor::Level *quality = MSVGovernor::getSettings();
     float scale[3] = {0};
     info->getScale(scale);
 
-    // Dynamic/Static Model specific choices:
-    GLuint texID;
-    GLenum texTarget;
-    GLint vertexH, normalH, textureCoordH, mvpMatrixH, texCoordTransformH, texSamplerH;
-    float texCoordTransform[16] = {1, 0, 0, 0,
-                                   0, 1, 0, 0,
-                                   0, 0, 1, 0,
-                                   0, 0, 0, 1};
-    unsigned int programID;
+    MSVRenderer::scalePoseMatrix(scale[0],
+                                 scale[1],
+                                 scale[2],
+                                 &modelViewMatrix.data[0]);
+
+    View views[RENDER_MAX_VIEWS];
+    int nViews = setupViews(frame.projection, modelViewMatrix.data, views);
+    setHitPose(info, modelViewMatrix.data, views[0].projection,
+               views[0].viewport);
+
+    // The overlay target only covers a whole view
+    GLint framebuffer = 0;
+    GLint viewport[4];
+    bool offscreen = nViews == 1 &&
+                     beginOverlay(info, views[0].modelViewProjection, quality,
+                                  &framebuffer, viewport);
+    if (nViews > 1) {
+      glGetIntegerv(GL_VIEWPORT, viewport);
+      glEnable(GL_SCISSOR_TEST);
+    }
+
+    Stats counts = {0, 0, 0};
+    if (info->isDynamicTarget())
+      drawDynamic(info, views, nViews, quality, &counts);
+    else
+      drawStatic(info, views, nViews, quality, offscreen, &counts);
+
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    if (offscreen) endOverlay(framebuffer, viewport, counts.drawn > 0);
+    if (nViews > 1) {
+      glDisable(GL_SCISSOR_TEST);
+      glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    }
+
+    pthread_mutex_lock(&statsLock);
+    stats.drawn += counts.drawn;
+    stats.culled += counts.culled;
+    stats.modelsCulled += counts.modelsCulled;
+    pthread_mutex_unlock(&statsLock);
+  }
+  else {
+    setHitPose(NULL, NULL, NULL, NULL);
+  }
+  MSVEpoch::leave(MSVEpoch::READER_RENDER);
+}
+
+void
+MSVRenderer::setHitPose(const MSVTargetInfo *info,
+                        const float *modelView,
+                        const float *projection,
+                        const GLint *viewport)
+{
+  pthread_mutex_lock(&hitLock);
+  hitPose.info = info;
+  if (info) {
+    memcpy(hitPose.modelView, modelView, sizeof(hitPose.modelView));
+    memcpy(hitPose.projection, projection, sizeof(hitPose.projection));
+    memcpy(hitPose.viewport, viewport, sizeof(hitPose.viewport));
+  }
+  pthread_mutex_unlock(&hitLock);
+}
+
+/** Determinant of a 4x4 matrix */
+static float
+determinant(const float *m)
+{
+  float s0 = m[0]*m[5] - m[4]*m[1];
+  float s1 = m[0]*m[9] - m[8]*m[1];
+  float s2 = m[0]*m[13] - m[12]*m[1];
+  float s3 = m[4]*m[9] - m[8]*m[5];
+  float s4 = m[4]*m[13] - m[12]*m[5];
+  float s5 = m[8]*m[13] - m[12]*m[9];
+  float c5 = m[10]*m[15] - m[14]*m[11];
+  float c4 = m[6]*m[15] - m[14]*m[7];
+  float c3 = m[6]*m[11] - m[10]*m[7];
+  float c2 = m[2]*m[15] - m[14]*m[3];
+  float c1 = m[2]*m[11] - m[10]*m[3];
+  float c0 = m[2]*m[7] - m[6]*m[3];
+  return s0*c5 - s1*c4 + s2*c3 + s3*c2 - s4*c1 + s5*c0;
+}
+
+/** Intersects a ray, given in the model space, with a part of the model.
+ * `hit->t` is the distance of the nearest hit so far.
+ */
+static bool
+hitPart(MSVMesh *mesh,
+        const float *transform,
+        const float *mvp,
+        const float origin[3],
+        const float dir[3],
+        MSVBVH::Hit *hit)
+{
+  float partOrigin[3], partDir[3];
+  float m[16];
+  if (transform) {
+    float inverse[16];
+    if (!MSVRenderer::invertMatrix(transform, inverse)) return false;
+    for (int r = 0; r < 3; ++r) {
+      partOrigin[r] = inverse[r]*origin[0] + inverse[4+r]*origin[1] +
+                      inverse[8+r]*origin[2] + inverse[12+r];
+      partDir[r] = inverse[r]*dir[0] + inverse[4+r]*dir[1] + inverse[8+r]*dir[2];
+    }
+    MSVRenderer::multiplyMatrix((float *)mvp, (float *)transform, m);
+  }
+  else {
+    memcpy(partOrigin, origin, sizeof(partOrigin));
+    memcpy(partDir, dir, sizeof(partDir));
+    memcpy(m, mvp, sizeof(m));
+  }
+  // Front faces are counter-clockwise on screen. Normalized device
+  // coordinates being left-handed, and the sign of the orientation of a
+  // triangle around the ray being that of the determinant of the
+  // projection, a usual projection (negative determinant) keeps the faces
+  // counter-clockwise along the ray in the part space.
+  int cull = determinant(m) < 0 ? 1 : -1;
+  return mesh->getBVH()->intersect(partOrigin, partDir, cull, hit->t, hit);
+}
+
+bool
+MSVRenderer::hitTest(float x, float y, Hit *hit)
+{
+  MSV_TRACE_SCOPE("hitTest");
+  pthread_mutex_lock(&hitLock);
+  MSVEpoch::enter(MSVEpoch::READER_HIT_TEST);
+  // The pose only applies to the model it was rendered with
+  const MSVTargetInfo *info = MSVController::getCurrentTarget();
+  bool found = false;
+  float mvp[16], inverse[16];
+  MSVRenderer::multiplyMatrix(hitPose.projection, hitPose.modelView, mvp);
+  if (info && info == hitPose.info && hitPose.viewport[2] > 0 &&
+      hitPose.viewport[3] > 0 && MSVRenderer::invertMatrix(mvp, inverse)) {
+    // From the top-left view coordinates to normalized device coordinates
+    int glWidth, glHeight;
+    MSVState::getGLViewSize(&glWidth, &glHeight);
+    const GLint *vp = hitPose.viewport;
+    float ndcX = 2*(x - vp[0])/vp[2] - 1;
+    float ndcY = 2*(glHeight - y - vp[1])/vp[3] - 1;
+    // Points of the ray on the near and far planes, in the model space
+    float ends[2][3];
+    for (int e = 0; e < 2; ++e) {
+      float ndc[4] = {ndcX, ndcY, e ? 1.0f : -1.0f, 1};
+      float p[4];
+      for (int r = 0; r < 4; ++r)
+        p[r] = inverse[r]*ndc[0] + inverse[4+r]*ndc[1] +
+               inverse[8+r]*ndc[2] + inverse[12+r]*ndc[3];
+      for (int r = 0; r < 3; ++r) ends[e][r] = p[r]/p[3];
+    }
+    float dir[3] = {ends[1][0] - ends[0][0],
+                    ends[1][1] - ends[0][1],
+                    ends[1][2] - ends[0][2]};
+
+    MSVBVH::Hit best;
+    best.t = 1;
+    MSVMesh *mesh = NULL;
+    const float *partTransform = NULL;
+    const MSVModel *model = NULL;
     if (info->isDynamicTarget()) {
-      texID = info->getDynamicTextureCallback()->getTexture(texCoordTransform);
-#if (defined(__MSV_SYS_IOS__))
-      // on iOS, use GL_TEXTURE_2D
-      texTarget = GL_TEXTURE_2D;
-      programID = shaderProgramID;
-      vertexH = vertexHandle;
-      normalH = normalHandle;
-      textureCoordH = textureCoordHandle;
-      mvpMatrixH = mvpMatrixHandle;
-      texCoordTransformH = texCoordTransformHandle;
-      texSamplerH = texSampler2DHandle;
-#else
-      // on Android, use GL_TEXTURE_EXTERNAL_OES extension
-      texTarget = GL_TEXTURE_EXTERNAL_OES;
+      if (hitPart(info->getMesh(), NULL, mvp, ends[0], dir, &best)) {
+        mesh = info->getMesh();
+        hit->part = 0;
+      }
+    }
+    else {
+      model = info->getModel();
+      for (unsigned int i = 0; i < model->getPartsCount(); ++i) {
+        const MSVModel::Part *part = model->getPart(i);
+        if (hitPart(part->mesh, part->transform, mvp, ends[0], dir, &best)) {
+          mesh = part->mesh;
+          partTransform = part->transform;
+          hit->part = i;
+        }
+      }
+    }
+    if (mesh) {
+      found = true;
+      hit->face = best.face;
+      hit->barycentric[0] = 1 - best.u - best.v;
+      hit->barycentric[1] = best.u;
+      hit->barycentric[2] = best.v;
+      const float *faces = mesh->getFaces() + 3*best.face;
+      const float *texCoords = mesh->getTexCoords();
+      const float *vertices = mesh->getVertices();
+      float p[3] = {0, 0, 0};
+      hit->texCoords[0] = 0;
+      hit->texCoords[1] = 0;
+      for (int k = 0; k < 3; ++k) {
+        unsigned int v = (unsigned int)faces[k];
+        float w = hit->barycentric[k];
+        hit->texCoords[0] += w*texCoords[2*v];
+        hit->texCoords[1] += w*texCoords[2*v + 1];
+        for (int r = 0; r < 3; ++r) p[r] += w*vertices[3*v + r];
+      }
+      if (partTransform) {
+        const float *m = partTransform;
+        for (int r = 0; r < 3; ++r)
+          hit->position[r] = m[r]*p[0] + m[4+r]*p[1] + m[8+r]*p[2] + m[12+r];
+      }
+      else {
+        memcpy(hit->position, p, sizeof(p));
+      }
+      // Report the part and face as added, not as batched
+      if (model) model->getSourceFace(hit->part, hit->face, &hit->part, &hit->face);
+    }
+  }
+  MSVEpoch::leave(MSVEpoch::READER_HIT_TEST);
+  pthread_mutex_unlock(&hitLock);
+  return found;
+}
+
+void
+MSVRenderer::drawDynamic(const MSVTargetInfo *info,
+                         const View *views,
+                         int nViews,
+                         const MSVGovernor::Level *quality,
+                         Stats *counts)
+{
+  // Do not even fetch the frame of a plane out of the views
+  bool visible = false;
+  for (int i = 0; i < nViews && !visible; ++i)
+    visible = isMeshVisible(views[i].modelViewProjection, info->getMesh());
+  if (!visible) {
+    counts->culled++;
+    counts->modelsCulled++;
+    return;
+  }
+  // Textures are GL_TEXTURE_2D unless the dynamic texture callback says
+  // otherwise.
+  GLuint planes[3] = {0, 0, 0};
+  int planesCount = 1;
+  GLenum texTarget = GL_TEXTURE_2D;
+  unsigned int programID = staticProgram.programID;
+  GLint vertexH = staticProgram.vertexHandle;
+  GLint normalH = staticProgram.normalHandle;
+  GLint textureCoordH = staticProgram.textureCoordHandle;
+  GLint mvpMatrixH = staticProgram.mvpMatrixHandle;
+  GLint texCoordTransformH = staticProgram.texCoordTransformHandle;
+  GLint texSamplerH[3] = {staticProgram.texSampler2DHandle, -1, -1};
+  GLint yuvToRgbMatrixH = -1;
+  const float *yuvToRgb = NULL;
+  float texCoordTransform[16] = {1, 0, 0, 0,
+                                 0, 1, 0, 0,
+                                 0, 0, 1, 0,
+                                 0, 0, 0, 1};
+  MSVTextureCallback *cb = info->getDynamicTextureCallback();
+  MSVTextureCallback::Format format = cb->getTextureFormat();
+  {
+    MSV_TRACE_SCOPE("getDynamicTexture");
+    planes[0] = cb->getTexture(texCoordTransform);
+    if (format != MSVTextureCallback::FORMAT_RGBA)
+      cb->getChromaTextures(&planes[1]);
+  }
+  if (format != MSVTextureCallback::FORMAT_RGBA) {
+    // YUV planes, converted by the fragment shader
+    const YUVProgram *yuv;
+    if (format == MSVTextureCallback::FORMAT_NV12) {
+      yuv = &nv12Program;
+      planesCount = 2;
+    }
+    else {
+      yuv = &i420Program;
+      planesCount = 3;
+    }
+    programID = yuv->programID;
+    vertexH = yuv->vertexHandle;
+    normalH = yuv->normalHandle;
+    textureCoordH = yuv->textureCoordHandle;
+    mvpMatrixH = yuv->mvpMatrixHandle;
+    texCoordTransformH = yuv->texCoordTransformHandle;
+    memcpy(texSamplerH, yuv->texSamplerHandles, 3*sizeof(GLint));
+    yuvToRgbMatrixH = yuv->yuvToRgbMatrixHandle;
+    yuvToRgb = (cb->getColorMatrix() == MSVTextureCallback::COLOR_BT709) ?
+               yuvToRgbBT709 : yuvToRgbBT601;
+  }
+  else {
+    texTarget = cb->getTextureTarget();
+#if (!defined(__MSV_SYS_IOS__))
+    if (texTarget == GL_TEXTURE_EXTERNAL_OES) {
+      // on Android, SurfaceTexture frames use GL_TEXTURE_EXTERNAL_OES extension
       programID = dynamicShaderProgramID;
       vertexH = dynamicVertexHandle;
       normalH = dynamicNormalHandle;
       textureCoordH = dynamicTextureCoordHandle;
       mvpMatrixH = dynamicMvpMatrixHandle;
       texCoordTransformH = dynamicTexCoordTransformHandle;
-      texSamplerH = dynamicTexSamplerOESHandle;
-#endif
+      texSamplerH[0] = dynamicTexSamplerOESHandle;
     }
-    else {
-      // static texture: use GL_TEXTURE_2D
-      texID = info->getStaticTexture()->glTextureName();
-      texTarget = GL_TEXTURE_2D;
-      programID = shaderProgramID;
-      vertexH = vertexHandle;
-      normalH = normalHandle;
-      textureCoordH = textureCoordHandle;
-      mvpMatrixH = mvpMatrixHandle;
-      texCoordTransformH = texCoordTransformHandle;
-      texSamplerH = texSampler2DHandle;
-    }
-
-    MSVRenderer::scalePoseMatrix(scale[0],
-                                 scale[1],
-                                 scale[2],
-                                 &modelViewMatrix.data[0]);
+#endif
+  }
+  // The textures will be deleted along with the callback
+  for (int i = 0; i < planesCount; ++i)
+    MSVResourceManager::claim(MSVResourceManager::TEXTURE, planes[i], cb);
 
-    QCAR::Matrix44F modelViewProjection;
-
-    MSVRenderer::multiplyMatrix(&projectionMatrix.data[0],
-                               &modelViewMatrix.data[0] ,
-                               &modelViewProjection.data[0]);
-
-    glUseProgram(programID);
-
-    glVertexAttribPointer(vertexH,
-                          3,
-                          GL_FLOAT,
-                          GL_FALSE,
-                          0,
-                          mesh->getVertices());
-    glVertexAttribPointer(normalH,
-                          3,
-                          GL_FLOAT,
-                          GL_FALSE,
-                          0,
-                          mesh->getNormals());
-    glVertexAttribPointer(textureCoordH,
-                          2,
-                          GL_FLOAT,
-                          GL_FALSE,
-                          0,
-                          mesh->getTexCoords());
-
-    glEnableVertexAttribArray(vertexH);
-    glEnableVertexAttribArray(normalH);
-    glEnableVertexAttribArray(textureCoordH);
+  glUseProgram(programID);
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(texTarget, texID);
+  // Bind the planes last to first, so that GL_TEXTURE0 stays active
+  for (int i = planesCount - 1; i >= 0; --i) {
+    glActiveTexture(GL_TEXTURE0 + i);
+    glBindTexture(texTarget, planes[i]);
     // Allow non-power-of-two textures
     glTexParameteri(texTarget, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(texTarget, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(texTarget, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(texTarget, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glUniform1i(texSamplerH[i], i);
+  }
+  glUniformMatrix4fv(texCoordTransformH,
+                     1,
+                     GL_FALSE,
+                     (GLfloat *)texCoordTransform);
+  if (yuvToRgb) glUniformMatrix3fv(yuvToRgbMatrixH, 1, GL_FALSE, yuvToRgb);
+  if (programID == staticProgram.programID)
+    glUniform1f(staticProgram.lodBiasHandle, quality->textureLodBias);
+  drawMesh(info->getMesh(), vertexH, normalH, textureCoordH, quality->meshLod,
+           mvpMatrixH, views, nViews);
+  counts->drawn++;
+}
+
+void
+MSVRenderer::drawStatic(const MSVTargetInfo *info,
+                        const View *views,
+                        int nViews,
+                        const MSVGovernor::Level *quality,
+                        bool offscreen,
+                        Stats *counts)
+{
+  static const float identity[16] = {1, 0, 0, 0,
+                                     0, 1, 0, 0,
+                                     0, 0, 1, 0,
+                                     0, 0, 0, 1};
+  const MSVModel *model = info->getModel();
+  if (model->hasBounds()) {
+    float min[3], max[3];
+    model->getBounds(min, max);
+    bool visible = false;
+    for (int i = 0; i < nViews && !visible; ++i)
+      visible = isBoxVisible(views[i].modelViewProjection, min, max);
+    if (!visible) {
+      counts->culled += model->getPartsCount();
+      counts->modelsCulled++;
+      return;
+    }
+  }
+  const StaticProgram *bound = NULL;
+  GLuint boundTexture = 0;
+  for (unsigned int i = 0; i < model->getPartsCount(); ++i) {
+    const MSVModel::Part *part = model->getPart(i);
+    MSVMesh *mesh = part->mesh;
+    MSVTexture *tex = part->tex;
+
+    View partViews[RENDER_MAX_VIEWS];
+    bool visible = false;
+    for (int v = 0; v < nViews; ++v) {
+      partViews[v] = views[v];
+      MSVRenderer::multiplyMatrix((float *)views[v].modelViewProjection,
+                                  (float *)part->transform,
+                                  partViews[v].modelViewProjection);
+      visible = visible || isMeshVisible(partViews[v].modelViewProjection, mesh);
+    }
+    if (!visible) {
+      counts->culled++;
+      continue;
+    }
+
+    // Parts are sorted by program then texture: each one is bound once
+    const StaticProgram *program = mesh->isAnimated() ? &animatedProgram :
+                                                        &staticProgram;
+    if (program != bound) {
+      glUseProgram(program->programID);
+      glUniformMatrix4fv(program->texCoordTransformHandle,
+                         1,
+                         GL_FALSE,
+                         (GLfloat *)identity);
+      glUniform1i(program->texSampler2DHandle, 0);
+      glUniform1f(program->lodBiasHandle, quality->textureLodBias);
+      bound = program;
+    }
+    GLuint texName = tex->glTextureName();
+    if (!boundTexture || texName != boundTexture) {
+      glActiveTexture(GL_TEXTURE0);
+      glBindTexture(GL_TEXTURE_2D, texName);
+      // Allow non-power-of-two textures
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                      tex->isMipmapped() ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      GLenum src = tex->isPremultiplied() ? GL_ONE : GL_SRC_ALPHA;
+      // Offscreen, alpha must stay the coverage set up by beginOverlay
+      glBlendFuncSeparate(src, GL_ONE_MINUS_SRC_ALPHA,
+                          offscreen ? GL_ONE : src, GL_ONE_MINUS_SRC_ALPHA);
+      boundTexture = texName;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, mesh->glVertexBuffer());
+    if (program == &animatedProgram)
+      bindAnimation(mesh, info->getAnimationTime());
+    drawMesh(mesh,
+             program->vertexHandle,
+             program->normalHandle,
+             program->textureCoordHandle,
+             quality->meshLod,
+             program->mvpMatrixHandle,
+             partViews,
+             nViews);
+    if (program == &animatedProgram) unbindAnimation();
+    counts->drawn++;
+  }
+}
+
+void
+MSVRenderer::drawMesh(MSVMesh *mesh,
+                      GLint vertexH,
+                      GLint normalH,
+                      GLint textureCoordH,
+                      int lod,
+                      GLint mvpMatrixH,
+                      const View *views,
+                      int nViews)
+{
+  glBindBuffer(GL_ARRAY_BUFFER, mesh->glVertexBuffer());
+  glVertexAttribPointer(vertexH,
+                        3,
+                        GL_FLOAT,
+                        GL_FALSE,
+                        0,
+                        (const GLvoid *)0);
+  glVertexAttribPointer(normalH,
+                        3,
+                        GL_FLOAT,
+                        GL_FALSE,
+                        0,
+                        (const GLvoid *)mesh->getNormalsOffset());
+  glVertexAttribPointer(textureCoordH,
+                        2,
+                        GL_FLOAT,
+                        GL_FALSE,
+                        0,
+                        (const GLvoid *)mesh->getTexCoordsOffset());
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->glIndexBuffer(lod));
+
+  glEnableVertexAttribArray(vertexH);
+  glEnableVertexAttribArray(normalH);
+  glEnableVertexAttribArray(textureCoordH);
+
+  for (int i = 0; i < nViews; ++i) {
+    const View *v = &views[i];
+    if (nViews > 1) {
+      glViewport(v->viewport[0], v->viewport[1], v->viewport[2], v->viewport[3]);
+      glScissor(v->bounds[0], v->bounds[1], v->bounds[2], v->bounds[3]);
+    }
     glUniformMatrix4fv(mvpMatrixH,
                        1,
                        GL_FALSE,
-                       (GLfloat *)modelViewProjection.data);
-    glUniformMatrix4fv(texCoordTransformH,
-                       1,
-                       GL_FALSE,
-                       (GLfloat *)texCoordTransform);
-    glUniform1i(texSamplerH, 0);
+                       (GLfloat *)v->modelViewProjection);
     glDrawElements(GL_TRIANGLES,
-                   3*mesh->getFacesCount(),
+                   3*mesh->getFacesCount(lod),
                    GL_UNSIGNED_SHORT,
-                   mesh->getFaces());
+                   (const GLvoid *)0);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
-    glDisable(GL_DEPTH_TEST);
+  glDisableVertexAttribArray(vertexH);
+  glDisableVertexAttribArray(normalH);
+  glDisableVertexAttribArray(textureCoordH);
+}
 
-    glDisableVertexAttribArray(vertexH);
-    glDisableVertexAttribArray(normalH);
-    glDisableVertexAttribArray(textureCoordH);
+void
+MSVRenderer::bindAnimation(const MSVMesh *mesh, float time)
+{
+  const StaticProgram *anim = &animatedProgram;
+  // Missing streams are constant attributes, which leave the vertex as is
+  for (unsigned int i = 0; i < MESH_MAX_MORPH_TARGETS; ++i) {
+    GLint h = anim->morphTargetHandles[i];
+    if (i < mesh->getMorphTargetsCount()) {
+      glVertexAttribPointer(h, 3, GL_FLOAT, GL_FALSE, 0,
+                            (const GLvoid *)mesh->getMorphTargetOffset(i));
+      glEnableVertexAttribArray(h);
+    }
+    else {
+      glVertexAttrib3f(h, 0, 0, 0);
+    }
+  }
+  if (mesh->getBonesCount()) {
+    glVertexAttribPointer(anim->boneIndicesHandle, MESH_BONE_INFLUENCES,
+                          GL_FLOAT, GL_FALSE, 0,
+                          (const GLvoid *)mesh->getBoneIndicesOffset());
+    glVertexAttribPointer(anim->boneWeightsHandle, MESH_BONE_INFLUENCES,
+                          GL_FLOAT, GL_FALSE, 0,
+                          (const GLvoid *)mesh->getBoneWeightsOffset());
+    glEnableVertexAttribArray(anim->boneIndicesHandle);
+    glEnableVertexAttribArray(anim->boneWeightsHandle);
+  }
+  else {
+    glVertexAttrib4f(anim->boneIndicesHandle, 0, 0, 0, 0);
+    glVertexAttrib4f(anim->boneWeightsHandle, 1, 0, 0, 0);
+  }
 
-    glDisable(GL_BLEND);
+  // The only per-frame data
+  float weights[MESH_MAX_MORPH_TARGETS];
+  float palette[12*MESH_MAX_BONES];
+  {
+    MSV_TRACE_SCOPE("poseMesh");
+    mesh->pose(time, weights, palette);
   }
-  QCAR::Renderer::getInstance().end();
+  unsigned int bones = mesh->getBonesCount() ? mesh->getBonesCount() : 1;
+  glUniform3fv(anim->morphWeightsHandle, 1, weights);
+  glUniform4fv(anim->bonePaletteHandle, 3*bones, palette);
+}
+
+void
+MSVRenderer::unbindAnimation()
+{
+  const StaticProgram *anim = &animatedProgram;
+  for (int i = 0; i < MESH_MAX_MORPH_TARGETS; ++i)
+    glDisableVertexAttribArray(anim->morphTargetHandles[i]);
+  glDisableVertexAttribArray(anim->boneIndicesHandle);
+  glDisableVertexAttribArray(anim->boneWeightsHandle);
 }
 
 void
@@ -215,60 +1244,41 @@ MSVRenderer::updateState()
 {
   setProjectionMatrix();
   configureVideoBackground();
+  MSVRedraw::invalidate(MSVRedraw::SURFACE_CHANGED);
 }
 
 void
 MSVRenderer::setProjectionMatrix()
 {
   // Cache the projection matrix:
-  const QCAR::CameraCalibration& cameraCalibration =
-  QCAR::CameraDevice::getInstance().getCameraCalibration();
-  projectionMatrix = QCAR::Tool::getProjectionGL(cameraCalibration, 0.04f, 50.0f);
+  MSVController::getBackend()->getProjectionMatrix(0.04f, 50.0f,
+                                                   projectionMatrix.data);
 }
 
 void
 MSVRenderer::configureVideoBackground()
 {
-  // Get the default video mode:
-  QCAR::CameraDevice& cameraDevice = QCAR::CameraDevice::getInstance();
-  QCAR::VideoMode videoMode = cameraDevice.getVideoMode(CAM_QUALITY);
-
-  // Configure the video background
-  QCAR::VideoBackgroundConfig config;
-  config.mEnabled = true;
-  config.mSynchronous = true;
-  config.mPosition.data[0] = 0.0f;
-  config.mPosition.data[1] = 0.0f;
-
   int glWidth, glHeight;
   MSVState::getGLViewSize(&glWidth, &glHeight);
+  MSVController::getBackend()->getVideoSize(&videoWidth, &videoHeight);
+  // In stereo, the background is fitted to an eye, at the center of the
+  // view, then copied into both halves
+  videoStereo = stereoFrame;
+  MSVController::getBackend()->configureVideoBackground(videoStereo ? glWidth/2 : glWidth,
+                                                        glHeight,
+                                                        MSVState::isPortrait());
+}
 
-  if (MSVState::isPortrait())
-  {
-    config.mSize.data[0] = glHeight * (videoMode.mHeight / (float)videoMode.mWidth);
-    config.mSize.data[1] = glHeight;
-
-    if (config.mSize.data[0] < glWidth)
-    {
-      config.mSize.data[0] = glWidth;
-      config.mSize.data[1] = glWidth * (videoMode.mWidth  / (float)videoMode.mHeight);
-    }
-  }
-  else
-  {
-    config.mSize.data[0] = glWidth;
-    config.mSize.data[1] = glWidth * (videoMode.mHeight / (float)videoMode.mWidth);
-
-    if (config.mSize.data[1] < glHeight)
-    {
-      config.mSize.data[0] = glHeight * (videoMode.mWidth / (float)videoMode.mHeight);
-      config.mSize.data[1] = glHeight;
-    }
+void
+MSVRenderer::poseToGLMatrix(const float *pose, float *matrix)
+{
+  // Transpose the 3x4 row-major pose into a 4x4 column-major matrix
+  for (int c = 0; c < 4; ++c) {
+    matrix[4*c]   = pose[c];
+    matrix[4*c+1] = pose[4+c];
+    matrix[4*c+2] = pose[8+c];
+    matrix[4*c+3] = (c == 3) ? 1.0f : 0.0f;
   }
-
-  // Set the config:
-  QCAR::Renderer::getInstance().setVideoBackgroundConfig(config);
-
 }
 
 void
@@ -317,6 +1327,161 @@ MSVRenderer::multiplyMatrix(float *matrixA, float *matrixB, float *matrixC)
     matrixC[i] = aTmp[i];
 }
 
+bool
+MSVRenderer::invertMatrix(const float *m, float *inverse)
+{
+  // Adjugate over determinant, by cofactor expansion
+  float inv[16];
+  inv[0]  =  m[5]*m[10]*m[15] - m[5]*m[11]*m[14] - m[9]*m[6]*m[15] +
+             m[9]*m[7]*m[14] + m[13]*m[6]*m[11] - m[13]*m[7]*m[10];
+  inv[4]  = -m[4]*m[10]*m[15] + m[4]*m[11]*m[14] + m[8]*m[6]*m[15] -
+             m[8]*m[7]*m[14] - m[12]*m[6]*m[11] + m[12]*m[7]*m[10];
+  inv[8]  =  m[4]*m[9]*m[15] - m[4]*m[11]*m[13] - m[8]*m[5]*m[15] +
+             m[8]*m[7]*m[13] + m[12]*m[5]*m[11] - m[12]*m[7]*m[9];
+  inv[12] = -m[4]*m[9]*m[14] + m[4]*m[10]*m[13] + m[8]*m[5]*m[14] -
+             m[8]*m[6]*m[13] - m[12]*m[5]*m[10] + m[12]*m[6]*m[9];
+  inv[1]  = -m[1]*m[10]*m[15] + m[1]*m[11]*m[14] + m[9]*m[2]*m[15] -
+             m[9]*m[3]*m[14] - m[13]*m[2]*m[11] + m[13]*m[3]*m[10];
+  inv[5]  =  m[0]*m[10]*m[15] - m[0]*m[11]*m[14] - m[8]*m[2]*m[15] +
+             m[8]*m[3]*m[14] + m[12]*m[2]*m[11] - m[12]*m[3]*m[10];
+  inv[9]  = -m[0]*m[9]*m[15] + m[0]*m[11]*m[13] + m[8]*m[1]*m[15] -
+             m[8]*m[3]*m[13] - m[12]*m[1]*m[11] + m[12]*m[3]*m[9];
+  inv[13] =  m[0]*m[9]*m[14] - m[0]*m[10]*m[13] - m[8]*m[1]*m[14] +
+             m[8]*m[2]*m[13] + m[12]*m[1]*m[10] - m[12]*m[2]*m[9];
+  inv[2]  =  m[1]*m[6]*m[15] - m[1]*m[7]*m[14] - m[5]*m[2]*m[15] +
+             m[5]*m[3]*m[14] + m[13]*m[2]*m[7] - m[13]*m[3]*m[6];
+  inv[6]  = -m[0]*m[6]*m[15] + m[0]*m[7]*m[14] + m[4]*m[2]*m[15] -
+             m[4]*m[3]*m[14] - m[12]*m[2]*m[7] + m[12]*m[3]*m[6];
+  inv[10] =  m[0]*m[5]*m[15] - m[0]*m[7]*m[13] - m[4]*m[1]*m[15] +
+             m[4]*m[3]*m[13] + m[12]*m[1]*m[7] - m[12]*m[3]*m[5];
+  inv[14] = -m[0]*m[5]*m[14] + m[0]*m[6]*m[13] + m[4]*m[1]*m[14] -
+             m[4]*m[2]*m[13] - m[12]*m[1]*m[6] + m[12]*m[2]*m[5];
+  inv[3]  = -m[1]*m[6]*m[11] + m[1]*m[7]*m[10] + m[5]*m[2]*m[11] -
+             m[5]*m[3]*m[10] - m[9]*m[2]*m[7] + m[9]*m[3]*m[6];
+  inv[7]  =  m[0]*m[6]*m[11] - m[0]*m[7]*m[10] - m[4]*m[2]*m[11] +
+             m[4]*m[3]*m[10] + m[8]*m[2]*m[7] - m[8]*m[3]*m[6];
+  inv[11] = -m[0]*m[5]*m[11] + m[0]*m[7]*m[9] + m[4]*m[1]*m[11] -
+             m[4]*m[3]*m[9] - m[8]*m[1]*m[7] + m[8]*m[3]*m[5];
+  inv[15] =  m[0]*m[5]*m[10] - m[0]*m[6]*m[9] - m[4]*m[1]*m[10] +
+             m[4]*m[2]*m[9] + m[8]*m[1]*m[6] - m[8]*m[2]*m[5];
+  float det = m[0]*inv[0] + m[1]*inv[4] + m[2]*inv[8] + m[3]*inv[12];
+  if (det == 0) return false;
+  det = 1.0f/det;
+  for (int i = 0; i < 16; ++i)
+    inverse[i] = inv[i]*det;
+  return true;
+}
+
+/* Clip space plane i of the view volume, e.g. w + x >= 0, as a x + b y +
+ * c z + d >= 0 in the space `mvp` maps from (column-major)
+ */
+static void
+frustumPlane(const float *mvp, int i, float plane[4])
+{
+  int axis = i/2;
+  float sign = (i & 1) ? -1.0f : 1.0f;
+  for (int c = 0; c < 4; ++c)
+    plane[c] = mvp[4*c + 3] + sign*mvp[4*c + axis];
+}
+
+bool
+MSVRenderer::isBoxVisible(const float *mvp,
+                          const float min[3],
+                          const float max[3])
+{
+  for (int i = 0; i < 6; ++i) {
+    float p[4];
+    frustumPlane(mvp, i, p);
+    // Corner the farthest along the plane normal
+    float d = p[3];
+    for (int c = 0; c < 3; ++c)
+      d += p[c]*(p[c] >= 0 ? max[c] : min[c]);
+    if (d < 0) return false;
+  }
+  return true;
+}
+
+bool
+MSVRenderer::isSphereVisible(const float *mvp,
+                             const float center[3],
+                             float radius)
+{
+  for (int i = 0; i < 6; ++i) {
+    float p[4];
+    frustumPlane(mvp, i, p);
+    float d = p[0]*center[0] + p[1]*center[1] + p[2]*center[2] + p[3];
+    float n = sqrtf(p[0]*p[0] + p[1]*p[1] + p[2]*p[2]);
+    if (d < -radius*n) return false;
+  }
+  return true;
+}
+
+bool
+MSVRenderer::isMeshVisible(const float *mvp, const MSVMesh *mesh)
+{
+  if (!mesh->hasBounds()) return true;
+  // The sphere rejects most meshes out of the view, the box the remaining
+  // ones along the view edges
+  float center[3], radius;
+  mesh->getBoundingSphere(center, &radius);
+  if (!isSphereVisible(mvp, center, radius)) return false;
+  float min[3], max[3];
+  mesh->getBounds(min, max);
+  return isBoxVisible(mvp, min, max);
+}
+
+void
+MSVRenderer::getStats(Stats *s)
+{
+  pthread_mutex_lock(&statsLock);
+  *s = stats;
+  pthread_mutex_unlock(&statsLock);
+}
+
+void
+MSVRenderer::initYUVProgram(YUVProgram *program,
+                            const char *fragmentShaderBuffer,
+                            const char *const samplerNames[3])
+{
+  unsigned int id = MSVRenderer::createProgramFromBuffer(vertexShader,
+                                                         fragmentShaderBuffer);
+  program->programID = id;
+  program->vertexHandle = glGetAttribLocation(id, "vertexPosition");
+  program->normalHandle = glGetAttribLocation(id, "vertexNormal");
+  program->textureCoordHandle = glGetAttribLocation(id, "vertexTexCoord");
+  program->mvpMatrixHandle = glGetUniformLocation(id, "modelViewProjectionMatrix");
+  program->texCoordTransformHandle = glGetUniformLocation(id, "texCoordTransformMatrix");
+  program->yuvToRgbMatrixHandle = glGetUniformLocation(id, "yuvToRgbMatrix");
+  for (int i = 0; i < 3; ++i) {
+    program->texSamplerHandles[i] = samplerNames[i] ?
+                                    glGetUniformLocation(id, samplerNames[i]) : -1;
+  }
+}
+
+void
+MSVRenderer::initStaticProgram(StaticProgram *program,
+                               const char *vertexShaderBuffer)
+{
+  unsigned int id = MSVRenderer::createProgramFromBuffer(vertexShaderBuffer,
+                                                         fragmentShader);
+  program->programID = id;
+  program->vertexHandle = glGetAttribLocation(id, "vertexPosition");
+  program->normalHandle = glGetAttribLocation(id, "vertexNormal");
+  program->textureCoordHandle = glGetAttribLocation(id, "vertexTexCoord");
+  program->mvpMatrixHandle = glGetUniformLocation(id, "modelViewProjectionMatrix");
+  program->texCoordTransformHandle = glGetUniformLocation(id, "texCoordTransformMatrix");
+  program->texSampler2DHandle = glGetUniformLocation(id, "texSampler2D");
+  program->lodBiasHandle = glGetUniformLocation(id, "lodBias");
+  static const char *const morphNames[MESH_MAX_MORPH_TARGETS] =
+    {"morphTarget0", "morphTarget1", "morphTarget2"};
+  for (int i = 0; i < MESH_MAX_MORPH_TARGETS; ++i)
+    program->morphTargetHandles[i] = glGetAttribLocation(id, morphNames[i]);
+  program->boneIndicesHandle = glGetAttribLocation(id, "boneIndices");
+  program->boneWeightsHandle = glGetAttribLocation(id, "boneWeights");
+  program->morphWeightsHandle = glGetUniformLocation(id, "morphWeights");
+  program->bonePaletteHandle = glGetUniformLocation(id, "bonePalette");
+}
+
 unsigned int
 MSVRenderer::initShader(unsigned int shaderType, const char* source)
 {
@@ -11,7 +11,22 @@
   #include <GLES2/gl2ext.h>
 #endif
 
-#include <QCAR/Tool.h>
+#include <pthread.h>
+
+#include <QCAR/Matrices.h>
+
+#include "MSVAnimation.h"
+#include "MSVFrameCapture.h"
+#include "MSVGovernor.h"
+
+/** Lowest resolution of the overlay, relative to the view */
+#define OVERLAY_MIN_SCALE 0.25f
+/** Maximal number of views rendered per frame: the 2 eyes in stereo */
+#define RENDER_MAX_VIEWS  2
+
+class MSVFrame;
+class MSVMesh;
+class MSVTargetInfo;
 
 /** Class in charge of rendering the camera background and the potential
  * tracked targets.
@@ -19,6 +34,34 @@
 class MSVRenderer {
 
   public:
+    /** Culling statistics, since startup */
+    struct Stats {
+      /** Meshes drawn */
+      unsigned int drawn;
+      /** Meshes skipped because out of the view */
+      unsigned int culled;
+      /** Frames whose tracked model was entirely out of the view, e.g.
+       * because the target is at the frame edge: nothing was drawn.
+       */
+      unsigned int modelsCulled;
+    };
+
+    /** Face of the tracked model under a point of the view */
+    struct Hit {
+      /** Part of the model, in the order of MSVModel::addPart, 0 for
+       * dynamic models
+       */
+      unsigned int part;
+      /** Face of the mesh of that part */
+      unsigned int face;
+      /** Barycentric coordinates of the point in the face */
+      float barycentric[3];
+      /** Texture coordinates of the point */
+      float texCoords[2];
+      /** The point, in the model space */
+      float position[3];
+    };
+
     MSVRenderer();
     /** Tool method: get a new, valid, unused OpenGL texture ID.
      * @return an OpenGL texture ID obtained with `glGenTexture` if rendering
@@ -27,10 +70,138 @@ class MSVRenderer {
     GLuint obtainTextureID();
     /** Render */
     void renderFrame();
+    /** Render the given frame instead of the current QCAR state, without
+     * camera background. Used to replay recorded sessions.
+     */
+    void renderFrame(const MSVFrame &frame);
     /** Updates to latest changes in MSVState */
     void updateState();
+    /** Finds the face of the tracked model displayed under a point of the
+     * view, as of the latest frame, by casting a ray through the model
+     * BVHs. Back faces are ignored, as when rendering. Can be called from
+     * any thread.
+     * @param x, y the point, in pixels from the top-left corner of the GL
+     * view.
+     * @return false if the model is not hit, or was not displayed.
+     */
+    bool hitTest(float x, float y, Hit *hit);
+
+    /** Sets the resolution of the overlay, i.e. of the rendered model,
+     * relative to the view. Below 1, the overlay is rendered offscreen
+     * at this scale, then upscaled over the video background, which saves
+     * fill rate on high-density screens. The quality governor may lower it
+     * further. Can be called from any thread, takes effect at the next
+     * frame.
+     * @param scale the scale, in [OVERLAY_MIN_SCALE, 1]. 1 by default.
+     */
+    static void setOverlayScale(float scale);
+    static float getOverlayScale();
+
+    /** Enables or disables side-by-side stereo, for headset viewers. The
+     * left and right halves of the GL view each show the camera background
+     * fitted to them, and the model seen from an eye, i.e. through the
+     * projection matrix offset by half the interpupillary distance. Both
+     * eyes are drawn in one pass: each mesh is bound once, then drawn in
+     * each half with its own model view projection.
+     * In stereo, the overlay is always drawn at full resolution, and hit
+     * tests apply to the left eye. Can be called from any thread, takes
+     * effect at the next frame.
+     * @param ipd the interpupillary distance, in the units of the target
+     * poses, i.e. of the target size.
+     */
+    static void setStereo(bool enabled, float ipd);
+    static bool isStereo();
+
+    /** Matrix tool methods. All matrices are 4x4 column-major, as OpenGL
+     * expects them.
+     */
+    /** Converts a 3x4 row-major QCAR pose into a 4x4 modelview matrix */
+    static void poseToGLMatrix(const float *pose, float *matrix);
+    /** Scales a modelview matrix in place */
+    static void scalePoseMatrix(float x, float y, float z, float* nMatrix = NULL);
+    /** Computes matrixC = matrixA * matrixB. matrixC may alias an input. */
+    static void multiplyMatrix(float *matrixA, float *matrixB, float *matrixC);
+    /** Computes the inverse of a matrix.
+     * @return false if the matrix is singular.
+     */
+    static bool invertMatrix(const float *matrix, float *inverse);
+
+    /** Frustum tests: return false if the volume, in the space that `mvp`
+     * maps to clip space, is entirely out of the view.
+     */
+    static bool isBoxVisible(const float *mvp,
+                             const float min[3],
+                             const float max[3]);
+    static bool isSphereVisible(const float *mvp,
+                                const float center[3],
+                                float radius);
+
+    /** Gets the culling statistics. Can be called from any thread. */
+    static void getStats(Stats *stats);
 
   private:
+    /** OpenGL data of a YUV dynamic models program */
+    struct YUVProgram {
+      unsigned int programID;
+      GLint vertexHandle;
+      GLint normalHandle;
+      GLint textureCoordHandle;
+      GLint mvpMatrixHandle;
+      GLint texCoordTransformHandle;
+      GLint yuvToRgbMatrixHandle;
+      /** Luma sampler, then UV or U and V samplers */
+      GLint texSamplerHandles[3];
+    };
+    /** OpenGL data of a static models program. The animation handles are
+     * -1 in the program of unanimated meshes.
+     */
+    struct StaticProgram {
+      unsigned int programID;
+      GLint vertexHandle;
+      GLint normalHandle;
+      GLint textureCoordHandle;
+      GLint mvpMatrixHandle;
+      GLint texCoordTransformHandle;
+      GLint texSampler2DHandle;
+      GLint lodBiasHandle;
+      GLint morphTargetHandles[MESH_MAX_MORPH_TARGETS];
+      GLint boneIndicesHandle;
+      GLint boneWeightsHandle;
+      GLint morphWeightsHandle;
+      GLint bonePaletteHandle;
+    };
+    /** OpenGL data of the texture copy program */
+    struct BlitProgram {
+      unsigned int programID;
+      GLint vertexHandle;
+      GLint texSampler2DHandle;
+    };
+    /** Frame copied on the GPU for MSVFrameCapture, waiting to be read
+     * back
+     */
+    struct CaptureSlot {
+      GLuint texture;
+      GLuint framebuffer;
+      double timestamp;
+      bool pending;
+    };
+    /** A view of the model: the whole GL view, or an eye in stereo */
+    struct View {
+      /** Viewport the projection applies to */
+      GLint viewport[4];
+      /** Part of the GL view, scissored in stereo */
+      GLint bounds[4];
+      float projection[16];
+      float modelViewProjection[16];
+    };
+    /** Model placement of the latest frame, for hit testing */
+    struct HitPose {
+      /** Target displayed, only compared to the current one */
+      const MSVTargetInfo *info;
+      float modelView[16];
+      float projection[16];
+      GLint viewport[4];
+    };
 #if(!defined(__MSV_SYS_IOS__)) // Android specific OpenGL data for dynamic models
     unsigned int dynamicShaderProgramID;
     GLint dynamicVertexHandle;
@@ -40,19 +211,156 @@ class MSVRenderer {
     GLint dynamicTexCoordTransformHandle;
     GLint dynamicTexSamplerOESHandle;
 #endif
-    unsigned int shaderProgramID;
-    GLint vertexHandle;
-    GLint normalHandle;
-    GLint textureCoordHandle;
-    GLint mvpMatrixHandle;
-    GLint texCoordTransformHandle;
-    GLint texSampler2DHandle;
+    StaticProgram staticProgram;
+    StaticProgram animatedProgram;
+    YUVProgram nv12Program;
+    YUVProgram i420Program;
+    BlitProgram blitProgram;
+    /** Ring of copies: each frame, the oldest one is read back, then the
+     * view is copied into the next one.
+     */
+    CaptureSlot captureSlots[CAPTURE_LATENCY + 1];
+    int captureIdx;
+    /** Copy of the view, scaled into the slots */
+    GLuint captureStaging;
+    int captureWidth;
+    int captureHeight;
+    int captureOutWidth;
+    int captureOutHeight;
+    HitPose hitPose;
+    /** Reduced resolution render target of the overlay */
+    GLuint overlayTexture;
+    GLuint overlayDepth;
+    GLuint overlayFramebuffer;
+    int overlayWidth;
+    int overlayHeight;
+    /** Box of the view the model may cover, in normalized device
+     * coordinates {xmin, ymin, xmax, ymax}: only it is cleared and
+     * composited
+     */
+    float overlayBox[4];
     QCAR::Matrix44F projectionMatrix;
+    /** Camera frame size the video background is configured for */
+    int videoWidth;
+    int videoHeight;
+    /** True if the video background is configured for one eye */
+    bool videoStereo;
+    /** True if the current frame is rendered in stereo */
+    bool stereoFrame;
+    /** Viewport of the video background, drawn at the center of the view
+     * and copied into each eye
+     */
+    GLint stereoViewport[4];
+    GLuint stereoBackground;
+    int stereoWidth;
+    int stereoHeight;
     GLuint nextTextureID;
     void setProjectionMatrix();
     void configureVideoBackground();
-    static void scalePoseMatrix(float x, float y, float z, float* nMatrix = NULL);
-    static void multiplyMatrix(float *matrixA, float *matrixB, float *matrixC);
+    void beginRender();
+    void endRender();
+    /** Reads the oldest capture copy back, at the beginning of a frame so
+     * that the GPU has no pending work for it.
+     */
+    void readCapture();
+    /** Copies the rendered view into the capture ring */
+    void copyCapture(double timestamp);
+    bool initCapture(int width, int height, int outWidth, int outHeight);
+    void releaseCapture();
+    /** Draws a texture over the whole viewport, blended over it if
+     * `composite` is true, the texture colors being premultiplied by alpha.
+     * @param viewports if not NULL, `count` viewports {x, y, width, height}
+     * to draw the texture into, instead of the current one.
+     */
+    void blit(GLuint texture,
+              bool composite,
+              const GLint *viewports = NULL,
+              int count = 1);
+    /** Copies the video background, drawn for one eye at the center of the
+     * view, into both eyes
+     */
+    void duplicateBackground();
+    void releaseStereo();
+    /** Fills the views of the current frame.
+     * @return the number of views.
+     */
+    int setupViews(const float *projection, const float *modelView, View *views);
+    /** Redirects the rendering of the overlay to its reduced resolution
+     * target, if the overlay scale is below 1.
+     * @param framebuffer, viewport set to the view target and viewport.
+     * @return false if the overlay must be drawn straight into the view.
+     */
+    bool beginOverlay(const MSVTargetInfo *info,
+                      const float *modelViewProjection,
+                      const MSVGovernor::Level *quality,
+                      GLint *framebuffer,
+                      GLint viewport[4]);
+    /** Restores the view target, then composites the overlay over it if
+     * anything has been drawn
+     */
+    void endOverlay(GLint framebuffer, const GLint viewport[4], bool drawn);
+    bool initOverlay(int width, int height);
+    void releaseOverlay();
+    void drawModel(const MSVFrame &frame);
+    /** Records the placement of the displayed model, `info` being NULL if
+     * none is displayed.
+     */
+    void setHitPose(const MSVTargetInfo *info,
+                    const float *modelView,
+                    const float *projection,
+                    const GLint *viewport);
+    /** Draws the plane of a dynamic target, unless out of the views */
+    void drawDynamic(const MSVTargetInfo *info,
+                     const View *views,
+                     int nViews,
+                     const MSVGovernor::Level *quality,
+                     Stats *counts);
+    /** Draws the parts of a static model, in their sorted order, only
+     * changing the program and the texture when needed. The model, then
+     * each part, are skipped when out of the views.
+     * @param offscreen whether drawing into the overlay target, whose alpha
+     * accumulates the coverage (see beginOverlay).
+     */
+    void drawStatic(const MSVTargetInfo *info,
+                    const View *views,
+                    int nViews,
+                    const MSVGovernor::Level *quality,
+                    bool offscreen,
+                    Stats *counts);
+    /** Returns true if a mesh may be visible through `mvp` */
+    static bool isMeshVisible(const float *mvp, const MSVMesh *mesh);
+    /** Binds the vertex and index buffers of a mesh, then draws it in each
+     * view, only changing the viewport and the model view projection
+     * uniform
+     */
+    void drawMesh(MSVMesh *mesh,
+                  GLint vertexH,
+                  GLint normalH,
+                  GLint textureCoordH,
+                  int lod,
+                  GLint mvpMatrixH,
+                  const View *views,
+                  int nViews);
+    /** Sets the animation attributes and uniforms of an animated mesh,
+     * whose vertex buffer is bound.
+     */
+    void bindAnimation(const MSVMesh *mesh, float time);
+    void unbindAnimation();
+    static void initYUVProgram(YUVProgram *program,
+                               const char *fragmentShaderBuffer,
+                               const char *const samplerNames[3]);
+    static void initStaticProgram(StaticProgram *program,
+                                  const char *vertexShaderBuffer);
+    static Stats stats;
+    static pthread_mutex_t statsLock;
+    static volatile float overlayScale;
+    static volatile bool stereo;
+    static volatile float stereoIPD;
+    /** Guards `hitPose`, and serializes the hit tests, which share an
+     * MSVEpoch reader slot
+     */
+    static pthread_mutex_t hitLock;
+
     static unsigned int initShader(unsigned int shaderType, const char* source);
     static unsigned int createProgramFromBuffer(const char* vertexShaderBuffer,
                                                 const char* fragmentShaderBuffer);
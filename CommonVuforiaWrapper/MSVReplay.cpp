@@ -0,0 +1,171 @@
+#include "MSVCallback.h"
+#include "MSVRecorder.h"
+#include "MSVRenderer.h"
+#include "MSVReplay.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+
+MSVReplay::MSVReplay() :
+file(NULL),
+compressed(false),
+buffer(NULL),
+buffer_size(0)
+{}
+
+MSVReplay::~MSVReplay()
+{
+  close();
+  free(buffer);
+}
+
+bool
+MSVReplay::open(const char *path)
+{
+  close();
+  file = fopen(path, "rb");
+  if (!file) return false;
+  uint32_t header[3];
+  if (fread(header, sizeof(uint32_t), 3, file) != 3 ||
+      header[0] != RECORD_MAGIC ||
+      header[1] != RECORD_VERSION) {
+    close();
+    return false;
+  }
+  compressed = (header[2] & RECORD_COMPRESSED) != 0;
+  return true;
+}
+
+void
+MSVReplay::close()
+{
+  if (file) fclose(file);
+  file = NULL;
+}
+
+MSVReplay::Record
+MSVReplay::next()
+{
+  if (!file) return RECORD_NONE;
+  uint32_t type;
+  if (fread(&type, sizeof(uint32_t), 1, file) != 1) return RECORD_NONE;
+  if (!readResults()) return RECORD_NONE;
+  frame.image = NULL;
+  switch (type) {
+    case RECORD_FRAME:
+      if (!readImage()) return RECORD_NONE;
+      return RECORD_FRAME;
+    case RECORD_RENDER:
+      if (fread(frame.projection, sizeof(float), 16, file) != 16) return RECORD_NONE;
+      return RECORD_RENDER;
+    default:
+      return RECORD_NONE;
+  }
+}
+
+const MSVFrame &
+MSVReplay::getFrame() const
+{
+  return frame;
+}
+
+bool
+MSVReplay::run(MSVCallback *cb,
+               MSVRenderer *renderer,
+               bool realtime,
+               Stats *stats)
+{
+  if (!file) return false;
+  Stats s;
+  memset(&s, 0, sizeof(Stats));
+  double start = now();
+  double firstTimestamp = -1;
+  Record r;
+  while ((r = next()) != RECORD_NONE) {
+    if (realtime) {
+      // Wait until the recorded time of this record
+      if (firstTimestamp < 0) firstTimestamp = frame.timestamp;
+      double wait = (frame.timestamp - firstTimestamp) - (now() - start);
+      if (wait > 0) usleep((useconds_t)(wait * 1e6));
+    }
+    double t0 = now();
+    if (r == RECORD_FRAME && cb) {
+      cb->onFrame(frame);
+      double t = now() - t0;
+      s.frames++;
+      s.updateTime += t;
+      if (t > s.maxUpdateTime) s.maxUpdateTime = t;
+    }
+    else if (r == RECORD_RENDER && renderer) {
+      renderer->renderFrame(frame);
+      double t = now() - t0;
+      s.renders++;
+      s.renderTime += t;
+      if (t > s.maxRenderTime) s.maxRenderTime = t;
+    }
+  }
+  s.duration = now() - start;
+  if (stats) *stats = s;
+  return feof(file) != 0;
+}
+
+bool
+MSVReplay::readResults()
+{
+  int32_t index, count;
+  if (fread(&frame.timestamp, sizeof(double), 1, file) != 1) return false;
+  if (fread(&index, sizeof(int32_t), 1, file) != 1) return false;
+  if (fread(&count, sizeof(int32_t), 1, file) != 1) return false;
+  if (count < 0 || count > MAX_FRAME_RESULTS) return false;
+  frame.index = index;
+  frame.resultCount = count;
+  return fread(frame.results, sizeof(MSVFrameResult), count, file) == (size_t)count;
+}
+
+bool
+MSVReplay::readImage()
+{
+  int32_t dims[2];
+  uint32_t size;
+  if (fread(dims, sizeof(int32_t), 2, file) != 2) return false;
+  if (fread(&size, sizeof(uint32_t), 1, file) != 1) return false;
+  if (!size) return true;
+  // Never trust a possibly corrupt file with the size of the image buffer
+  if (dims[0] <= 0 || dims[0] > RECORD_MAX_IMAGE_SIDE ||
+      dims[1] <= 0 || dims[1] > RECORD_MAX_IMAGE_SIDE)
+    return false;
+  uLongf expected = (uLongf)dims[0]*dims[1];
+  uLongf raw = expected;
+  image.resize(dims[0], dims[1]);
+  if (compressed) {
+    if (size > compressBound(expected)) return false;
+    if (size > buffer_size) {
+      unsigned char *b = (unsigned char *)realloc(buffer, size);
+      if (!b) return false;
+      buffer = b;
+      buffer_size = size;
+    }
+    if (fread(buffer, 1, size, file) != size) return false;
+    if (uncompress(image.getData(), &raw, buffer, size) != Z_OK ||
+        raw != expected)
+      return false;
+  }
+  else {
+    if (size != expected) return false;
+    if (fread(image.getData(), 1, size, file) != size) return false;
+  }
+  frame.image = &image;
+  return true;
+}
+
+double
+MSVReplay::now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
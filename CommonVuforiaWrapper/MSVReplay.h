@@ -0,0 +1,85 @@
+#ifndef MSV_REPLAY_H
+#define MSV_REPLAY_H
+
+#include "MSVFrame.h"
+
+#include <stdio.h>
+
+class MSVCallback;
+class MSVRenderer;
+
+/** Class reading a session recorded by MSVRecorder, and feeding it back
+ * through MSVCallback and MSVRenderer. This allows deterministic, device-free
+ * latency and throughput measurements.
+ */
+class MSVReplay {
+  public:
+    enum Record {
+      RECORD_NONE = 0,
+      RECORD_FRAME,
+      RECORD_RENDER
+    };
+
+    /** Statistics gathered by `run()`. Times are in seconds. */
+    struct Stats {
+      unsigned int frames;
+      unsigned int renders;
+      double duration;
+      double updateTime;
+      double maxUpdateTime;
+      double renderTime;
+      double maxRenderTime;
+    };
+
+    MSVReplay();
+    ~MSVReplay();
+
+    /** Opens a recorded session.
+     * @return true if the file is a valid recording, false otherwise.
+     */
+    bool open(const char *path);
+
+    /** Closes the current session, if any */
+    void close();
+
+    /** Reads the next record.
+     * @return the type of the record, or RECORD_NONE at the end of the
+     * stream or on error.
+     */
+    Record next();
+
+    /** Returns the frame read by the last call to `next()`. Its image is
+     * only set for RECORD_FRAME records.
+     */
+    const MSVFrame &getFrame() const;
+
+    /** Replays the whole session.
+     * Frame records are sent to `MSVCallback::onFrame`, render records
+     * to `MSVRenderer::renderFrame`, which must then be called from a thread
+     * owning a GL context.
+     * @param cb the callback to feed, or NULL.
+     * @param renderer the renderer to feed, or NULL.
+     * @param realtime true to replay at the recorded speed, false to replay
+     * as fast as possible.
+     * @param stats if not NULL, filled with the replay statistics.
+     * @return true if the whole session was replayed, false on error.
+     */
+    bool run(MSVCallback *cb,
+             MSVRenderer *renderer,
+             bool realtime,
+             Stats *stats);
+
+  private:
+    FILE *file;
+    bool compressed;
+    MSVFrame frame;
+    MSVImage image;
+    unsigned char *buffer;
+    unsigned int buffer_size;
+
+    bool readResults();
+    bool readImage();
+    static double now();
+};
+
+#endif
@@ -0,0 +1,209 @@
+#include "MSVResourceManager.h"
+#include "MSVTrace.h"
+
+#include <stdlib.h>
+
+#define INITIAL_ENTRY_NUMBER 16
+
+// Initialize static variables
+MSVResourceManager::Entry *MSVResourceManager::entries = NULL;
+int MSVResourceManager::entry_nb = 0;
+int MSVResourceManager::entry_capacity = 0;
+MSVResourceManager::Pending *MSVResourceManager::pending = NULL;
+int MSVResourceManager::pending_nb = 0;
+int MSVResourceManager::pending_capacity = 0;
+
+unsigned int MSVResourceManager::frame = 0;
+size_t MSVResourceManager::budget = GPU_MEMORY_BUDGET;
+size_t MSVResourceManager::usage = 0;
+size_t MSVResourceManager::peak = 0;
+pthread_mutex_t MSVResourceManager::lock = PTHREAD_MUTEX_INITIALIZER;
+
+void
+MSVResourceManager::track(Kind kind, GLuint name, size_t bytes, Owner *owner)
+{
+  if (!name) return;
+  pthread_mutex_lock(&lock);
+  if (entry_nb == entry_capacity) {
+    entry_capacity = entry_capacity ? 2*entry_capacity : INITIAL_ENTRY_NUMBER;
+    entries = (Entry *)realloc(entries, entry_capacity*sizeof(Entry));
+  }
+  Entry *e = &entries[entry_nb++];
+  e->kind = kind;
+  e->name = name;
+  e->bytes = bytes;
+  e->lastUsed = frame;
+  e->owner = owner;
+  e->tag = NULL;
+  usage += bytes;
+  if (usage > peak) peak = usage;
+  pthread_mutex_unlock(&lock);
+}
+
+void
+MSVResourceManager::touch(Kind kind, GLuint name)
+{
+  pthread_mutex_lock(&lock);
+  int idx = find(kind, name);
+  if (idx >= 0) entries[idx].lastUsed = frame;
+  pthread_mutex_unlock(&lock);
+}
+
+void
+MSVResourceManager::claim(Kind kind, GLuint name, const void *tag)
+{
+  pthread_mutex_lock(&lock);
+  int idx = find(kind, name);
+  if (idx >= 0 && !entries[idx].tag) entries[idx].tag = tag;
+  pthread_mutex_unlock(&lock);
+}
+
+void
+MSVResourceManager::release(Kind kind, GLuint name)
+{
+  if (!name) return;
+  pthread_mutex_lock(&lock);
+  int idx = find(kind, name);
+  if (idx >= 0) {
+    remove(idx);
+    schedule(kind, name);
+  }
+  pthread_mutex_unlock(&lock);
+}
+
+void
+MSVResourceManager::releaseTagged(const void *tag)
+{
+  if (!tag) return;
+  pthread_mutex_lock(&lock);
+  for (int i = entry_nb - 1; i >= 0; --i) {
+    if (entries[i].tag == tag) {
+      Kind kind = entries[i].kind;
+      GLuint name = entries[i].name;
+      remove(i);
+      schedule(kind, name);
+    }
+  }
+  pthread_mutex_unlock(&lock);
+}
+
+void
+MSVResourceManager::beginFrame()
+{
+  pthread_mutex_lock(&lock);
+  frame++;
+  pthread_mutex_unlock(&lock);
+}
+
+void
+MSVResourceManager::collect()
+{
+  MSV_TRACE_SCOPE("collectResources");
+  pthread_mutex_lock(&lock);
+  // Delete released objects
+  for (int i = 0; i < pending_nb; ++i) {
+    destroy(pending[i].kind, pending[i].name);
+  }
+  pending_nb = 0;
+  // Evict least recently used objects until we fit in the budget
+  while (budget && usage > budget) {
+    int lru = -1;
+    for (int i = 0; i < entry_nb; ++i) {
+      const Entry &e = entries[i];
+      if (!e.owner || e.lastUsed == frame) continue;
+      if (lru < 0 || e.lastUsed < entries[lru].lastUsed) lru = i;
+    }
+    if (lru < 0) break;
+    Entry e = entries[lru];
+    remove(lru);
+    destroy(e.kind, e.name);
+    e.owner->resourceEvicted(e.name);
+  }
+  pthread_mutex_unlock(&lock);
+}
+
+void
+MSVResourceManager::invalidateAll()
+{
+  pthread_mutex_lock(&lock);
+  while (entry_nb) {
+    Entry e = entries[entry_nb-1];
+    remove(entry_nb-1);
+    if (e.owner) e.owner->resourceEvicted(e.name);
+  }
+  pending_nb = 0;
+  pthread_mutex_unlock(&lock);
+}
+
+void
+MSVResourceManager::setBudget(size_t bytes)
+{
+  pthread_mutex_lock(&lock);
+  budget = bytes;
+  pthread_mutex_unlock(&lock);
+}
+
+size_t
+MSVResourceManager::getBudget()
+{
+  return budget;
+}
+
+size_t
+MSVResourceManager::getUsage()
+{
+  return usage;
+}
+
+size_t
+MSVResourceManager::getPeakUsage()
+{
+  return peak;
+}
+
+int
+MSVResourceManager::find(Kind kind, GLuint name)
+{
+  for (int i = 0; i < entry_nb; ++i) {
+    if (entries[i].name == name && entries[i].kind == kind) return i;
+  }
+  return -1;
+}
+
+void
+MSVResourceManager::remove(int idx)
+{
+  usage -= entries[idx].bytes;
+  entries[idx] = entries[--entry_nb];
+}
+
+void
+MSVResourceManager::schedule(Kind kind, GLuint name)
+{
+  if (pending_nb == pending_capacity) {
+    pending_capacity = pending_capacity ? 2*pending_capacity : INITIAL_ENTRY_NUMBER;
+    pending = (Pending *)realloc(pending, pending_capacity*sizeof(Pending));
+  }
+  pending[pending_nb].kind = kind;
+  pending[pending_nb].name = name;
+  pending_nb++;
+}
+
+void
+MSVResourceManager::destroy(Kind kind, GLuint name)
+{
+  switch (kind) {
+    case TEXTURE:
+      glDeleteTextures(1, &name);
+      break;
+    case BUFFER:
+      glDeleteBuffers(1, &name);
+      break;
+    case FRAMEBUFFER:
+      glDeleteFramebuffers(1, &name);
+      break;
+    case RENDERBUFFER:
+      glDeleteRenderbuffers(1, &name);
+      break;
+  }
+}
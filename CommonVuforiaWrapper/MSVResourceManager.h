@@ -0,0 +1,132 @@
+#ifndef MSV_RESOURCEMANAGER_H
+#define MSV_RESOURCEMANAGER_H
+
+#include "MSVWhichOS.h"
+
+#if (defined(__MSV_SYS_IOS__))
+  #include <OpenGLES/ES2/gl.h>
+  #include <OpenGLES/ES2/glext.h>
+#else
+  #include <GLES2/gl2.h>
+  #include <GLES2/gl2ext.h>
+#endif
+
+#include <pthread.h>
+#include <stddef.h>
+
+/** Default GPU memory budget, in bytes */
+#define GPU_MEMORY_BUDGET (32*1024*1024)
+
+/** Class keeping track of all the OpenGL textures, buffer, framebuffer and
+ * renderbuffer objects.
+ *
+ * Every GL object created by the wrapper is registered here with its size.
+ * Objects are never deleted directly: `release()` can be called from any
+ * thread, and the actual deletion happens on the GL thread in `collect()`.
+ *
+ * When the total size exceeds the budget, `collect()` evicts the least
+ * recently used objects that have an Owner and that were not used during
+ * the current frame. Their owner is notified, and can upload them again
+ * the next time they are needed.
+ */
+class MSVResourceManager {
+  public:
+    enum Kind {
+      TEXTURE = 0,
+      BUFFER,
+      FRAMEBUFFER,
+      RENDERBUFFER
+    };
+
+    /** Interface implemented by objects able to rebuild an evicted resource */
+    class Owner {
+      public:
+        virtual ~Owner() {}
+        /** Called on the GL thread when `name` has been evicted and deleted.
+         * It is called with the manager lock held: implementations must not
+         * call back into the MSVResourceManager.
+         */
+        virtual void resourceEvicted(GLuint name) = 0;
+    };
+
+    /** Registers a freshly created GL object. Must be called from GL thread.
+     * @param kind the kind of the object.
+     * @param name the OpenGL name of the object.
+     * @param bytes the GPU memory used by the object, if known.
+     * @param owner the object to notify on eviction, or NULL if the object
+     * must never be evicted.
+     */
+    static void track(Kind kind, GLuint name, size_t bytes, Owner *owner);
+
+    /** Marks an object as used during the current frame */
+    static void touch(Kind kind, GLuint name);
+
+    /** Associates an untagged object with a tag, so that it can later be
+     * released with `releaseTagged()`.
+     */
+    static void claim(Kind kind, GLuint name, const void *tag);
+
+    /** Schedules the deletion of an object. Can be called from any thread. */
+    static void release(Kind kind, GLuint name);
+
+    /** Schedules the deletion of all the objects claimed with `tag` */
+    static void releaseTagged(const void *tag);
+
+    /** Marks the beginning of a new frame. Must be called from GL thread. */
+    static void beginFrame();
+
+    /** Deletes released objects and enforces the budget.
+     * Must be called from GL thread.
+     */
+    static void collect();
+
+    /** Forgets all objects without deleting them, e.g. after the GL context
+     * has been lost. Owners are notified as if their objects were evicted.
+     */
+    static void invalidateAll();
+
+    /** Sets the GPU memory budget in bytes, 0 meaning unlimited */
+    static void setBudget(size_t bytes);
+    static size_t getBudget();
+
+    /** Returns the GPU memory currently used by tracked objects, in bytes */
+    static size_t getUsage();
+
+    /** Returns the highest GPU memory usage observed, in bytes */
+    static size_t getPeakUsage();
+
+  private:
+    struct Entry {
+      Kind kind;
+      GLuint name;
+      size_t bytes;
+      unsigned int lastUsed;
+      Owner *owner;
+      const void *tag;
+    };
+
+    struct Pending {
+      Kind kind;
+      GLuint name;
+    };
+
+    static Entry *entries;
+    static int entry_nb;
+    static int entry_capacity;
+    static Pending *pending;
+    static int pending_nb;
+    static int pending_capacity;
+
+    static unsigned int frame;
+    static size_t budget;
+    static size_t usage;
+    static size_t peak;
+    static pthread_mutex_t lock;
+
+    static int find(Kind kind, GLuint name);
+    static void remove(int idx);
+    static void schedule(Kind kind, GLuint name);
+    static void destroy(Kind kind, GLuint name);
+};
+
+#endif
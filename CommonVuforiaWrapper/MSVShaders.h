@@ -26,6 +26,49 @@ void main() \n\
 ";
 
 
+/** Vertex shader of animated meshes (see MSVMesh): morph targets blending,
+ * then linear blend skinning with a palette of 3x4 row-major matrices
+ * (3*MESH_MAX_BONES vectors).
+ */
+static const char* animatedVertexShader = "\
+\
+attribute vec4 vertexPosition; \n\
+attribute vec4 vertexNormal; \n\
+attribute vec4 vertexTexCoord; \n\
+attribute vec3 morphTarget0; \n\
+attribute vec3 morphTarget1; \n\
+attribute vec3 morphTarget2; \n\
+attribute vec4 boneIndices; \n\
+attribute vec4 boneWeights; \n\
+\n\
+varying vec4 texCoord; \n\
+varying vec4 normal; \n\
+\n\
+uniform mat4 modelViewProjectionMatrix; \n\
+uniform mat4 texCoordTransformMatrix; \n\
+uniform vec3 morphWeights; \n\
+uniform vec4 bonePalette[96]; \n\
+\n\
+void main() \n\
+{ \n\
+   vec4 position = vertexPosition + vec4(morphWeights.x * morphTarget0 + \n\
+                                         morphWeights.y * morphTarget1 + \n\
+                                         morphWeights.z * morphTarget2, 0.0); \n\
+   ivec4 b = 3 * ivec4(boneIndices); \n\
+   vec4 r0 = boneWeights.x * bonePalette[b.x] + boneWeights.y * bonePalette[b.y] + \n\
+             boneWeights.z * bonePalette[b.z] + boneWeights.w * bonePalette[b.w]; \n\
+   vec4 r1 = boneWeights.x * bonePalette[b.x + 1] + boneWeights.y * bonePalette[b.y + 1] + \n\
+             boneWeights.z * bonePalette[b.z + 1] + boneWeights.w * bonePalette[b.w + 1]; \n\
+   vec4 r2 = boneWeights.x * bonePalette[b.x + 2] + boneWeights.y * bonePalette[b.y + 2] + \n\
+             boneWeights.z * bonePalette[b.z + 2] + boneWeights.w * bonePalette[b.w + 2]; \n\
+   gl_Position = modelViewProjectionMatrix * \n\
+                 vec4(dot(r0, position), dot(r1, position), dot(r2, position), 1.0); \n\
+   vec4 n = vec4(vertexNormal.xyz, 0.0); \n\
+   normal = vec4(dot(r0, n), dot(r1, n), dot(r2, n), 0.0); \n\
+   texCoord = texCoordTransformMatrix * vertexTexCoord; \n\
+} \
+";
+
 static const char* fragmentShader = "\
 \
 precision mediump float; \n\
@@ -34,13 +77,94 @@ varying vec4 texCoord; \n\
 varying vec4 normal; \n\
 \n\
 uniform sampler2D texSampler2D; \n\
+uniform float lodBias; \n\
 \n\
 void main() \n\
 { \n\
-   gl_FragColor = texture2DProj(texSampler2D, texCoord); \n\
+   gl_FragColor = texture2DProj(texSampler2D, texCoord, lodBias); \n\
 } \n\
 ";
 
+/** YUV fragment shaders: video range YUV to RGB, with the BT.601 or BT.709
+ * matrix given as uniform.
+ */
+
+static const char* nv12FragmentShader = "\
+\
+precision mediump float; \n\
+\n\
+varying vec4 texCoord; \n\
+\n\
+uniform sampler2D texSamplerY; \n\
+uniform sampler2D texSamplerUV; \n\
+uniform mat3 yuvToRgbMatrix; \n\
+\n\
+void main() \n\
+{ \n\
+   vec3 yuv = vec3(texture2DProj(texSamplerY, texCoord).r - 0.0625, \n\
+                   texture2DProj(texSamplerUV, texCoord).ra - 0.5); \n\
+   gl_FragColor = vec4(yuvToRgbMatrix * yuv, 1.0); \n\
+} \
+";
+
+static const char* i420FragmentShader = "\
+\
+precision mediump float; \n\
+\n\
+varying vec4 texCoord; \n\
+\n\
+uniform sampler2D texSamplerY; \n\
+uniform sampler2D texSamplerU; \n\
+uniform sampler2D texSamplerV; \n\
+uniform mat3 yuvToRgbMatrix; \n\
+\n\
+void main() \n\
+{ \n\
+   vec3 yuv = vec3(texture2DProj(texSamplerY, texCoord).r - 0.0625, \n\
+                   texture2DProj(texSamplerU, texCoord).r - 0.5, \n\
+                   texture2DProj(texSamplerV, texCoord).r - 0.5); \n\
+   gl_FragColor = vec4(yuvToRgbMatrix * yuv, 1.0); \n\
+} \
+";
+
+/** Copy of a texture onto the whole viewport, e.g. to scale it */
+
+static const char* blitVertexShader = "\
+\
+attribute vec2 vertexPosition; \n\
+\n\
+varying vec2 texCoord; \n\
+\n\
+void main() \n\
+{ \n\
+   gl_Position = vec4(vertexPosition, 0.0, 1.0); \n\
+   texCoord = 0.5 * vertexPosition + 0.5; \n\
+} \
+";
+
+static const char* blitFragmentShader = "\
+\
+precision mediump float; \n\
+\n\
+varying vec2 texCoord; \n\
+\n\
+uniform sampler2D texSampler2D; \n\
+\n\
+void main() \n\
+{ \n\
+   gl_FragColor = texture2D(texSampler2D, texCoord); \n\
+} \
+";
+
+/** Column-major video range YUV to RGB matrices */
+static const float yuvToRgbBT601[9] = {1.164f,  1.164f, 1.164f,
+                                       0.0f,   -0.392f, 2.017f,
+                                       1.596f, -0.813f, 0.0f};
+
+static const float yuvToRgbBT709[9] = {1.164f,  1.164f, 1.164f,
+                                       0.0f,   -0.213f, 2.112f,
+                                       1.793f, -0.533f, 0.0f};
+
 #if (!defined(__MSV_SYS_IOS__))
 
 static const char* dynamicFragmentShader = "\
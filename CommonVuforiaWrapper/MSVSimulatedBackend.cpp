@@ -0,0 +1,258 @@
+#include "MSVCallback.h"
+#include "MSVSimulatedBackend.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SIM_TARGET_PREFIX "target"
+
+static double
+now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+MSVSimulatedBackend::MSVSimulatedBackend(int width,
+                                         int height,
+                                         float fps,
+                                         int targetCount) :
+width(width),
+height(height),
+fps(fps > 0 ? fps : 30),
+targetCount(targetCount < MAX_FRAME_RESULTS ? targetCount : MAX_FRAME_RESULTS),
+callback(NULL),
+running(false),
+tracking(false),
+frameCount(0)
+{
+  // Focal length of a camera with a ~60 degrees horizontal field of view
+  focal = 0.87f * (width > height ? width : height);
+  pthread_mutex_init(&lock, NULL);
+  image.resize(width, height);
+}
+
+MSVSimulatedBackend::~MSVSimulatedBackend()
+{
+  stopCamera();
+  pthread_mutex_destroy(&lock);
+}
+
+void
+MSVSimulatedBackend::getGroundTruth(int target, double t, float pose[12]) const
+{
+  // Each target moves along an ellipse in front of the camera while rolling
+  // slightly around its normal. Axes follow the Vuforia convention: x right,
+  // y down, z forward, with the target facing the camera.
+  double a = 2*M_PI*(0.05*t + target/(double)targetCount);
+  double r = 0.3*sin(0.7*t + target);
+  float c = cos(r);
+  float s = sin(r);
+  float p[12] = {c,  s,  0, (float)(1.5*cos(a)),
+                 s, -c,  0, (float)(1.0*sin(a)),
+                 0,  0, -1, (float)(8.0 + 2.0*target)};
+  memcpy(pose, p, 12*sizeof(float));
+}
+
+unsigned int
+MSVSimulatedBackend::getFrameCount() const
+{
+  return frameCount;
+}
+
+bool
+MSVSimulatedBackend::initCamera()
+{
+  return true;
+}
+
+int
+MSVSimulatedBackend::getVideoModeCount()
+{
+  return 1;
+}
+
+void
+MSVSimulatedBackend::getVideoMode(int, VideoMode *mode)
+{
+  mode->width = width;
+  mode->height = height;
+  mode->frameRate = fps;
+}
+
+bool
+MSVSimulatedBackend::startCamera(int)
+{
+  if (running) return true;
+  running = true;
+  frameCount = 0;
+  if (pthread_create(&thread, NULL, MSVSimulatedBackend::run, this)) {
+    running = false;
+    return false;
+  }
+  return true;
+}
+
+void
+MSVSimulatedBackend::stopCamera()
+{
+  if (!running) return;
+  running = false;
+  pthread_join(thread, NULL);
+}
+
+void
+MSVSimulatedBackend::getVideoSize(int *width, int *height)
+{
+  *width = this->width;
+  *height = this->height;
+}
+
+void
+MSVSimulatedBackend::getProjectionMatrix(float nearPlane,
+                                         float farPlane,
+                                         float matrix[16])
+{
+  memset(matrix, 0, 16*sizeof(float));
+  matrix[0]  = 2.0f*focal/width;
+  matrix[5]  = -2.0f*focal/height;
+  matrix[10] = (farPlane + nearPlane)/(farPlane - nearPlane);
+  matrix[11] = 1.0f;
+  matrix[14] = -2.0f*farPlane*nearPlane/(farPlane - nearPlane);
+}
+
+void
+MSVSimulatedBackend::initTracker() {}
+
+void
+MSVSimulatedBackend::deinitTracker()
+{
+  tracking = false;
+}
+
+void
+MSVSimulatedBackend::addDataset(const char *) {}
+
+bool
+MSVSimulatedBackend::hasTarget(const char *name,
+                               const char *)
+{
+  size_t len = strlen(SIM_TARGET_PREFIX);
+  if (strncmp(name, SIM_TARGET_PREFIX, len)) return false;
+  int idx = -1;
+  if (sscanf(name + len, "%d", &idx) != 1) return false;
+  return idx >= 0 && idx < targetCount;
+}
+
+void
+MSVSimulatedBackend::startTracker(const char *)
+{
+  tracking = true;
+}
+
+void
+MSVSimulatedBackend::stopTracker()
+{
+  tracking = false;
+}
+
+bool
+MSVSimulatedBackend::requiresAlpha()
+{
+  return false;
+}
+
+void
+MSVSimulatedBackend::setCallback(MSVCallback *cb)
+{
+  callback = cb;
+}
+
+void
+MSVSimulatedBackend::configureVideoBackground(int, int, bool) {}
+
+void
+MSVSimulatedBackend::beginRender(MSVFrame *frame)
+{
+  // There is no camera background to draw: only copy the latest state
+  pthread_mutex_lock(&lock);
+  frame->timestamp = latest.timestamp;
+  frame->index = latest.index;
+  frame->image = NULL;
+  frame->resultCount = latest.resultCount;
+  memcpy(frame->results, latest.results, latest.resultCount*sizeof(MSVFrameResult));
+  pthread_mutex_unlock(&lock);
+}
+
+void
+MSVSimulatedBackend::endRender() {}
+
+void *
+MSVSimulatedBackend::run(void *self)
+{
+  MSVSimulatedBackend *b = (MSVSimulatedBackend *)self;
+  double period = 1.0/b->fps;
+  double start = now();
+  MSVFrame frame;
+  for (unsigned int n = 0; b->running; ++n) {
+    double t = n*period;
+    b->generate(t, &frame);
+    frame.index = n;
+    pthread_mutex_lock(&b->lock);
+    b->latest = frame;
+    b->latest.image = NULL;
+    pthread_mutex_unlock(&b->lock);
+    MSVCallback *cb = b->callback;
+    if (cb) cb->onFrame(frame);
+    b->frameCount = n + 1;
+    // Keep the configured frame rate
+    double wait = start + (n + 1)*period - now();
+    if (wait > 0) usleep((useconds_t)(wait*1e6));
+  }
+  return NULL;
+}
+
+void
+MSVSimulatedBackend::generate(double t, MSVFrame *frame)
+{
+  unsigned char *px = image.getData();
+
+  // Scrolling checkerboard background, with some deterministic noise so
+  // that the frame is not trivially compressible.
+  int shift = (int)(t*40);
+  for (int y = 0; y < height; ++y) {
+    unsigned char *row = px + y*width;
+    for (int x = 0; x < width; ++x) {
+      unsigned int h = (x*73856093u) ^ (y*19349663u) ^ (shift*83492791u);
+      row[x] = ((((x + shift) >> 5) ^ (y >> 5)) & 1 ? 80 : 140) + (h >> 28);
+    }
+  }
+
+  frame->timestamp = t;
+  frame->image = &image;
+  frame->resultCount = 0;
+  for (int i = 0; i < targetCount; ++i) {
+    float pose[12];
+    getGroundTruth(i, t, pose);
+    // Draw the target as a fine checkerboard square around its projection
+    float z = pose[11];
+    int cx = (int)(focal*pose[3]/z + width/2);
+    int cy = (int)(focal*pose[7]/z + height/2);
+    int half = (int)(focal/z);
+    for (int y = cy - half; y < cy + half; ++y) {
+      if (y < 0 || y >= height) continue;
+      for (int x = cx - half; x < cx + half; ++x) {
+        if (x < 0 || x >= width) continue;
+        px[y*width + x] = (((x - cx) >> 3) ^ ((y - cy) >> 3)) & 1 ? 20 : 235;
+      }
+    }
+    if (!tracking) continue;
+    MSVFrameResult *r = &frame->results[frame->resultCount++];
+    snprintf(r->name, MAX_TRACKABLE_NAME, SIM_TARGET_PREFIX "%d", i);
+    memcpy(r->pose, pose, 12*sizeof(float));
+  }
+}
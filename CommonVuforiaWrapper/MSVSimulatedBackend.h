@@ -0,0 +1,90 @@
+#ifndef MSV_SIMULATEDBACKEND_H
+#define MSV_SIMULATEDBACKEND_H
+
+#include "MSVBackend.h"
+#include "MSVFrame.h"
+
+#include <pthread.h>
+
+/** MSVBackend implementation generating synthetic frames.
+ *
+ * Once the camera is started, a thread produces textured grayscale frames at
+ * the configured rate, and sends them to the callback. While tracking, each
+ * frame contains one result per simulated target, moving along a known
+ * trajectory. The targets are named "target0", "target1", ... and belong to
+ * every dataset.
+ *
+ * This allows exercising the whole pipeline, including load tests and
+ * profiling, on hosts without a camera nor the Vuforia SDK.
+ */
+class MSVSimulatedBackend : public MSVBackend {
+  public:
+    /** Constructor.
+     * @param width the camera frame width.
+     * @param height the camera frame height.
+     * @param fps the number of frames generated per second.
+     * @param targetCount the number of simulated targets, up to
+     * MAX_FRAME_RESULTS.
+     */
+    MSVSimulatedBackend(int width = 640,
+                        int height = 480,
+                        float fps = 30,
+                        int targetCount = 1);
+    ~MSVSimulatedBackend();
+
+    /** Computes the ground truth pose of a target.
+     * @param target the target index.
+     * @param t the time since the camera started, in seconds.
+     * @param pose filled with the 3x4 row-major pose matrix.
+     */
+    void getGroundTruth(int target, double t, float pose[12]) const;
+
+    /** Returns the number of frames generated since the camera started */
+    unsigned int getFrameCount() const;
+
+    /** Implementation of MSVBackend */
+    bool initCamera();
+    int getVideoModeCount();
+    void getVideoMode(int index, VideoMode *mode);
+    bool startCamera(int mode);
+    void stopCamera();
+    void getVideoSize(int *width, int *height);
+    void getProjectionMatrix(float nearPlane,
+                             float farPlane,
+                             float matrix[16]);
+    void initTracker();
+    void deinitTracker();
+    void addDataset(const char *dataset);
+    bool hasTarget(const char *name,
+                   const char *dataset);
+    void startTracker(const char *dataset);
+    void stopTracker();
+    bool requiresAlpha();
+    void setCallback(MSVCallback *cb);
+    void configureVideoBackground(int glWidth,
+                                  int glHeight,
+                                  bool portrait);
+    void beginRender(MSVFrame *frame);
+    void endRender();
+
+  private:
+    int width;
+    int height;
+    float fps;
+    int targetCount;
+    float focal;
+
+    MSVCallback * volatile callback;
+    volatile bool running;
+    volatile bool tracking;
+    volatile unsigned int frameCount;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    MSVFrame latest;
+    MSVImage image;
+
+    static void *run(void *self);
+    void generate(double t, MSVFrame *frame);
+};
+
+#endif
@@ -2,7 +2,6 @@
 #define MSV_STATE_H
 
 #define MODEL_SIZE      2.0
-#define CAM_QUALITY     QCAR::CameraDevice::MODE_OPTIMIZE_QUALITY
 #define HOMOG_THRES     0.1
 
 /** Class storing application state values */
@@ -1,26 +1,31 @@
 #include "MSVMesh.h"
+#include "MSVModel.h"
+#include "MSVResourceManager.h"
 #include "MSVTargetInfo.h"
-#include "MSVTexture.h"
 
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 static const float noScale[3] = {1, 1, 1};
 
 MSVTargetInfo::MSVTargetInfo(const char *n,
                              const int *d) :
 dynamicTarget(false),
-cb(NULL)
+mesh(NULL),
+cb(NULL),
+startTime(now())
 {
   name = strdup(n);
 
   dims = new int[2];
   memcpy(dims, d, 2*sizeof(int));
 
-  tex = MSVTexture::getTransparentTexture();
-
-  mesh = MSVMesh::getNormalizedPlane();
+  // Transparent plane until a model is set
+  model = new MSVModel();
+  model->addPart(NULL, NULL);
+  model->build();
 
   scale = new float[3];
   memcpy(scale, noScale, 3*sizeof(float));
@@ -31,9 +36,12 @@ MSVTargetInfo::~MSVTargetInfo()
   if (name) free(name);
   if (dims) delete dims;
   if (scale) delete scale;
-  if (tex) delete tex;
-  if (mesh) delete mesh;
-  if (cb) delete cb;
+  if (model) model->release();
+  if (mesh) mesh->release();
+  if (cb) {
+    MSVResourceManager::releaseTagged(cb);
+    delete cb;
+  }
 }
 
 const char *
@@ -67,58 +75,62 @@ MSVTargetInfo::changeScale(const float s[3])
   memcpy(scale, s, 3*sizeof(float));
 }
 
-MSVMesh *
-MSVTargetInfo::getMesh() const
-{
-  return mesh;
-}
-
 bool
 MSVTargetInfo::isDynamicTarget() const {
   return dynamicTarget;
 }
 
 void
-MSVTargetInfo::setStatic(MSVMesh *m, MSVTexture *t)
+MSVTargetInfo::setStatic(MSVModel *m)
 {
   if (cb)
     cb = NULL;
-  if (mesh)
-    delete mesh;
-  if (m)
-    mesh = m;
-  else
-    mesh = MSVMesh::getNormalizedPlane();
-  if (tex)
-    delete tex;
-  if (t)
-    tex = t;
-  else
-    tex = MSVTexture::getTransparentTexture();
+  if (model)
+    model->release();
+  model = m;
   dynamicTarget = false;
 }
 
-MSVTexture *
-MSVTargetInfo::getStaticTexture() const
+MSVModel *
+MSVTargetInfo::getModel() const
 {
-  return tex;
+  return model;
 }
 
 void
 MSVTargetInfo::setDynamic(MSVTextureCallback *callback)
 {
   cb = callback;
-  if (mesh)
-    delete mesh;
-  mesh = MSVMesh::getNormalizedPlane();
-  if (tex)
-    delete tex;
-  tex = NULL;
+  if (model)
+    model->release();
+  model = NULL;
+  if (!mesh)
+    mesh = MSVMesh::getNormalizedPlane();
   dynamicTarget = true;
 }
 
+MSVMesh *
+MSVTargetInfo::getMesh() const
+{
+  return mesh;
+}
+
 MSVTextureCallback *
 MSVTargetInfo::getDynamicTextureCallback() const
 {
   return cb;
 }
+
+float
+MSVTargetInfo::getAnimationTime() const
+{
+  return (float)(now() - startTime);
+}
+
+double
+MSVTargetInfo::now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
@@ -3,10 +3,15 @@
 
 #include "MSVTextureCallback.h"
 
-class MSVTexture;
 class MSVMesh;
+class MSVModel;
 
-/** Class in charge of handling all the necessary information about a target. */
+/** Class in charge of handling all the necessary information about a target.
+ *
+ * Once published by the MSVController, an instance is never modified: changing
+ * the model creates a new instance, and the previous one is retired through
+ * MSVEpoch so that it is freed on the GL thread.
+ */
 class MSVTargetInfo {
   public:
     MSVTargetInfo(const char *n,
@@ -18,24 +23,31 @@ class MSVTargetInfo {
     int getHeight() const;
     void getScale(float s[3]) const;
     void changeScale(const float s[3]);
-    MSVMesh *getMesh() const;
     bool isDynamicTarget() const;
-    // Static target: displays mesh + texture
-    void setStatic(MSVMesh *m, MSVTexture *t);
-    MSVTexture *getStaticTexture() const;
+    // Static target: displays a built model, adopting a reference to it
+    void setStatic(MSVModel *m);
+    MSVModel *getModel() const;
     // Dynamic target: displays plane + dynamic texture
     void setDynamic(MSVTextureCallback *callback);
+    MSVMesh *getMesh() const;
     MSVTextureCallback *getDynamicTextureCallback() const;
+    /** Returns the time elapsed since the model was set, in seconds, which
+     * animated meshes are played at.
+     */
+    float getAnimationTime() const;
 
   private:
     /* members */
     char *name;
     int *dims;
     float *scale;
-    MSVMesh *mesh;
+    MSVModel *model;
     bool dynamicTarget;
-    MSVTexture *tex;
+    MSVMesh *mesh;
     MSVTextureCallback *cb;
+    double startTime;
+
+    static double now();
 };
 
 #endif
@@ -1,12 +1,31 @@
+#include "MSVImageDecoder.h"
 #include "MSVTexture.h"
+#include "MSVTrace.h"
 
+#include <stdlib.h>
 #include <string.h>
 
+/* Decoding request run by MSVImageDecoder */
+struct DecodeJob {
+  char *path;
+  unsigned char *data;
+  size_t size;
+  unsigned int maxWidth;
+  unsigned int maxHeight;
+  MSVTexture::DecodeCallback callback;
+  void *userData;
+};
+
+MSVTexture *MSVTexture::transparent = NULL;
+pthread_once_t MSVTexture::transparentOnce = PTHREAD_ONCE_INIT;
+
 MSVTexture::MSVTexture() :
+MSVAsset(TEXTURE),
 width(0),
 height(0),
 channelCount(0),
 pixels(NULL),
+premultiplied(false),
 glName(0),
 hasGlName(false)
 {}
@@ -15,6 +34,8 @@ MSVTexture::MSVTexture(unsigned char *pixels,
                      unsigned int width,
                      unsigned int height,
                      unsigned int channelCount /* 4 */) :
+MSVAsset(TEXTURE),
+premultiplied(false),
 glName(0),
 hasGlName(false)
 {
@@ -40,6 +61,7 @@ MSVTexture::set(unsigned char *pixels,
 
 MSVTexture::~MSVTexture()
 {
+  if (hasGlName) MSVResourceManager::release(MSVResourceManager::TEXTURE, glName);
   if (pixels) delete [] pixels;
 }
 
@@ -67,30 +89,170 @@ MSVTexture::getPixels() const
   return pixels;
 }
 
+bool
+MSVTexture::isPremultiplied() const
+{
+  return premultiplied;
+}
+
+MSVTexture *
+MSVTexture::decode(const unsigned char *data,
+                   size_t size,
+                   unsigned int maxWidth,
+                   unsigned int maxHeight)
+{
+  MSVImageDecoder::Image img;
+  if (!MSVImageDecoder::decode(data, size, maxWidth, maxHeight, &img)) return NULL;
+  return adopt(img.width, img.height, img.pixels);
+}
+
+MSVTexture *
+MSVTexture::decodeFile(const char *path,
+                       unsigned int maxWidth,
+                       unsigned int maxHeight)
+{
+  MSVImageDecoder::Image img;
+  if (!MSVImageDecoder::decodeFile(path, maxWidth, maxHeight, &img)) return NULL;
+  return adopt(img.width, img.height, img.pixels);
+}
+
+MSVTexture *
+MSVTexture::adopt(unsigned int width, unsigned int height, unsigned char *pixels)
+{
+  // The decoded rows are already bottom-up: no flip copy
+  MSVTexture *tex = new MSVTexture();
+  tex->width = width;
+  tex->height = height;
+  tex->channelCount = 4;
+  tex->pixels = pixels;
+  tex->premultiplied = true;
+  return tex;
+}
+
+void
+MSVTexture::decodeAsync(const char *path,
+                        unsigned int maxWidth,
+                        unsigned int maxHeight,
+                        DecodeCallback callback,
+                        void *userData)
+{
+  DecodeJob *job = (DecodeJob *)malloc(sizeof(DecodeJob));
+  job->path = strdup(path);
+  job->data = NULL;
+  job->size = 0;
+  job->maxWidth = maxWidth;
+  job->maxHeight = maxHeight;
+  job->callback = callback;
+  job->userData = userData;
+  MSVImageDecoder::post(MSVTexture::runDecode, job);
+}
+
+void
+MSVTexture::decodeAsync(const unsigned char *data,
+                        size_t size,
+                        unsigned int maxWidth,
+                        unsigned int maxHeight,
+                        DecodeCallback callback,
+                        void *userData)
+{
+  DecodeJob *job = (DecodeJob *)malloc(sizeof(DecodeJob));
+  job->path = NULL;
+  job->data = (unsigned char *)malloc(size);
+  memcpy(job->data, data, size);
+  job->size = size;
+  job->maxWidth = maxWidth;
+  job->maxHeight = maxHeight;
+  job->callback = callback;
+  job->userData = userData;
+  MSVImageDecoder::post(MSVTexture::runDecode, job);
+}
+
+void
+MSVTexture::runDecode(void *arg)
+{
+  DecodeJob *job = (DecodeJob *)arg;
+  MSVTexture *tex = job->path ?
+                    decodeFile(job->path, job->maxWidth, job->maxHeight) :
+                    decode(job->data, job->size, job->maxWidth, job->maxHeight);
+  job->callback(tex, job->userData);
+  free(job->path);
+  free(job->data);
+  free(job);
+}
+
 MSVTexture *
 MSVTexture::getTransparentTexture()
 {
+  pthread_once(&transparentOnce, MSVTexture::createTransparentTexture);
+  transparent->retain();
+  return transparent;
+}
+
+void
+MSVTexture::createTransparentTexture()
+{
+  // Its first reference is never released
   MSVTexture *tex = new MSVTexture();
   tex->width = 64;
   tex->height = 64;
   tex->channelCount = 4;
   tex->pixels = new unsigned char[64*64*4]();
-  return tex;
+  transparent = tex;
+}
+
+uint64_t
+MSVTexture::contentHash() const
+{
+  unsigned int header[3] = {width, height, channelCount};
+  uint64_t h = hash(header, sizeof(header));
+  return hash(pixels, width*height*channelCount, h);
+}
+
+bool
+MSVTexture::sameContent(const MSVAsset *other) const
+{
+  const MSVTexture *t = static_cast<const MSVTexture *>(other);
+  return width == t->width && height == t->height &&
+         channelCount == t->channelCount && premultiplied == t->premultiplied &&
+         !memcmp(pixels, t->pixels, width*height*channelCount);
 }
 
 GLuint
 MSVTexture::glTextureName()
 {
   if (!hasGlName) {
+    MSV_TRACE_SCOPE("uploadTexture");
     glGenTextures(1, &glName);
     glBindTexture(GL_TEXTURE_2D, glName);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width,
                  height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
                  (GLvoid*) pixels);
+    size_t size = width*height*channelCount;
+    if (isMipmapped()) {
+      glGenerateMipmap(GL_TEXTURE_2D);
+      size += size/3;
+    }
     hasGlName = true;
+    MSVResourceManager::track(MSVResourceManager::TEXTURE, glName,
+                              size, this);
+  }
+  else {
+    MSVResourceManager::touch(MSVResourceManager::TEXTURE, glName);
   }
   return glName;
 }
 
+bool
+MSVTexture::isMipmapped() const
+{
+  return width && height && !(width & (width - 1)) && !(height & (height - 1));
+}
 
-
+void
+MSVTexture::resourceEvicted(GLuint name)
+{
+  if (hasGlName && name == glName) {
+    glName = 0;
+    hasGlName = false;
+  }
+}
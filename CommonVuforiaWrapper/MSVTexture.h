@@ -11,30 +11,99 @@
   #include <GLES2/gl2ext.h>
 #endif
 
-/** Class representing a texture */
-class MSVTexture
+#include "MSVAsset.h"
+#include "MSVResourceManager.h"
+
+/** Size decoded textures are downscaled to fit in by default */
+#define TEXTURE_MAX_SIZE 2048
+
+/** Class representing a texture.
+ *
+ * Textures are reference-counted (see MSVAsset): use `release()` instead of
+ * deleting them.
+ */
+class MSVTexture : public MSVAsset, public MSVResourceManager::Owner
 {
   public:
     MSVTexture(unsigned char *pixels,
               unsigned int width,
               unsigned int height,
               unsigned int channelCount = 4 /* only supported value for now! */);
-    virtual ~MSVTexture();
     unsigned int getWidth() const;
     unsigned int getHeight() const;
     unsigned int getChannelCount() const;
     const unsigned char *getPixels() const;
 
+    /** Returns true if the color channels are premultiplied by alpha, as
+     * they are in decoded textures.
+     */
+    bool isPremultiplied() const;
+
+    /** Decodes a PNG or JPEG image into a new texture (see MSVImageDecoder),
+     * without any intermediate copy.
+     * @param maxWidth, maxHeight the size JPEG images are downscaled to fit
+     * in while decoding, 0 for none.
+     * @return the texture, or NULL if the image could not be decoded.
+     */
+    static MSVTexture *decode(const unsigned char *data,
+                              size_t size,
+                              unsigned int maxWidth = 0,
+                              unsigned int maxHeight = 0);
+
+    /** Same as above, from a file */
+    static MSVTexture *decodeFile(const char *path,
+                                  unsigned int maxWidth = 0,
+                                  unsigned int maxHeight = 0);
+
+    /** Called with the texture decoded by `decodeAsync`, or NULL. Its
+     * reference is transferred to the callback.
+     */
+    typedef void (*DecodeCallback)(MSVTexture *tex, void *userData);
+
+    /** Decodes a file on the MSVImageDecoder worker thread, then calls
+     * `callback` from that thread.
+     */
+    static void decodeAsync(const char *path,
+                            unsigned int maxWidth,
+                            unsigned int maxHeight,
+                            DecodeCallback callback,
+                            void *userData);
+
+    /** Same as above, from memory. The data is copied. */
+    static void decodeAsync(const unsigned char *data,
+                            size_t size,
+                            unsigned int maxWidth,
+                            unsigned int maxHeight,
+                            DecodeCallback callback,
+                            void *userData);
+
     /** Attaches the texture to an OpenGL texture name
      * that can be reused to bind the texture to GL_TEXTURE_2D.
+     * The texture is uploaded on first call, or again if it has been evicted
+     * by the MSVResourceManager. Must be called from GL thread.
      */
     GLuint glTextureName();
 
-    /** Generates a 64x64 transparent texture */
+    /** Returns true if the texture has mipmaps, i.e. if its dimensions are
+     * powers of two (OpenGL ES 2 does not support mipmaps otherwise).
+     */
+    bool isMipmapped() const;
+
+    /** Implementation of MSVResourceManager::Owner */
+    void resourceEvicted(GLuint name);
+
+    /** Returns a reference to the shared, immutable 64x64 transparent
+     * texture.
+     */
     static MSVTexture *getTransparentTexture();
 
   protected:
     MSVTexture();
+    virtual ~MSVTexture();
+
+    /** Implementation of MSVAsset */
+    uint64_t contentHash() const;
+    bool sameContent(const MSVAsset *other) const;
     void set(unsigned char *pixels,
              unsigned int width,
              unsigned int height,
@@ -45,8 +114,17 @@ class MSVTexture
     unsigned int height;
     unsigned int channelCount;
     unsigned char *pixels;
+    bool premultiplied;
     GLuint glName;
     bool hasGlName;
+
+    static MSVTexture *transparent;
+    static pthread_once_t transparentOnce;
+    static void createTransparentTexture();
+    static MSVTexture *adopt(unsigned int width,
+                             unsigned int height,
+                             unsigned char *pixels);
+    static void runDecode(void *job);
 };
 
 
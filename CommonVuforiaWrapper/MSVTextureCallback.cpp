@@ -3,3 +3,31 @@
 MSVTextureCallback::MSVTextureCallback() {}
 
 MSVTextureCallback::~MSVTextureCallback() {}
+
+GLenum
+MSVTextureCallback::getTextureTarget() const
+{
+#if (defined(__MSV_SYS_IOS__))
+  return GL_TEXTURE_2D;
+#else
+  return GL_TEXTURE_EXTERNAL_OES;
+#endif
+}
+
+MSVTextureCallback::Format
+MSVTextureCallback::getTextureFormat() const
+{
+  return FORMAT_RGBA;
+}
+
+MSVTextureCallback::ColorMatrix
+MSVTextureCallback::getColorMatrix() const
+{
+  return COLOR_BT601;
+}
+
+void
+MSVTextureCallback::getChromaTextures(GLuint chroma[2])
+{
+  chroma[0] = chroma[1] = 0;
+}
@@ -14,6 +14,25 @@
 /** Abstract class allowing to get a new texture at each rendering frame */
 class MSVTextureCallback {
   public:
+    /** Layout of the frames returned by `getTexture` */
+    enum Format {
+      /** A single color texture */
+      FORMAT_RGBA = 0,
+      /** A GL_LUMINANCE luma texture and a half size GL_LUMINANCE_ALPHA
+       * texture of interleaved U and V, e.g. biplanar camera or decoder
+       * buffers.
+       */
+      FORMAT_NV12,
+      /** GL_LUMINANCE luma, U and V textures, chroma at half size */
+      FORMAT_I420
+    };
+
+    /** YUV to RGB conversion matrix of video range YUV formats */
+    enum ColorMatrix {
+      COLOR_BT601 = 0,
+      COLOR_BT709
+    };
+
     MSVTextureCallback();
     virtual ~MSVTextureCallback();
     /** Will be called at each rendering frame to get the OpenGL texture ID
@@ -30,6 +49,24 @@ class MSVTextureCallback {
      * used to build the `SurfaceTexture` object displaying the video.
      */
     virtual GLuint getTexture(float mtx[16]) = 0;
+    /** Returns the target the texture returned by `getTexture` must be
+     * bound to: GL_TEXTURE_2D on iOS, GL_TEXTURE_EXTERNAL_OES on Android by
+     * default. Override it to render GL_TEXTURE_2D textures on Android.
+     */
+    virtual GLenum getTextureTarget() const;
+    /** Returns the layout of the frames: FORMAT_RGBA by default. For YUV
+     * formats, `getTexture` returns the luma texture, the chroma textures
+     * are obtained with `getChromaTextures`, all are GL_TEXTURE_2D, and the
+     * conversion to RGB is done by the fragment shader.
+     */
+    virtual Format getTextureFormat() const;
+    /** Returns the conversion matrix of YUV formats: COLOR_BT601 by default */
+    virtual ColorMatrix getColorMatrix() const;
+    /** Called right after `getTexture` for YUV formats.
+     * @param chroma filled with the interleaved UV texture (FORMAT_NV12), or
+     * the U and V textures (FORMAT_I420).
+     */
+    virtual void getChromaTextures(GLuint chroma[2]);
     /** Will be called when tracking stops. Note that the destructor will be
      * called soon after this call.
      */
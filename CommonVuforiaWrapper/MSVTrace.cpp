@@ -0,0 +1,123 @@
+#include "MSVTrace.h"
+
+#ifdef MSV_TRACE
+
+#include "MSVWhichOS.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if (defined(__MSV_SYS_IOS__))
+  #include <mach/mach_time.h>
+#else
+  #include <time.h>
+#endif
+
+// Initialize static variables
+MSVTrace::Buffer *MSVTrace::buffers[TRACE_MAX_THREADS] = {0};
+volatile int MSVTrace::buffer_nb = 0;
+pthread_key_t MSVTrace::key;
+pthread_once_t MSVTrace::once = PTHREAD_ONCE_INIT;
+
+uint64_t
+MSVTrace::now()
+{
+#if (defined(__MSV_SYS_IOS__))
+  static mach_timebase_info_data_t timebase = {0, 0};
+  if (!timebase.denom) mach_timebase_info(&timebase);
+  return mach_absolute_time() * timebase.numer / timebase.denom;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+void
+MSVTrace::record(const char *name, uint64_t start, uint64_t end)
+{
+  Buffer *b = getBuffer();
+  if (!b) return;
+  // Only the owner thread writes to its buffer: no need for atomics, just
+  // make sure the event is written before it is published.
+  Event *e = &b->events[b->head & (TRACE_EVENTS_PER_THREAD - 1)];
+  e->name = name;
+  e->start = start;
+  e->end = end;
+  __sync_synchronize();
+  b->head = b->head + 1;
+}
+
+bool
+MSVTrace::dump(const char *path)
+{
+  Event *copy = (Event *)malloc(TRACE_EVENTS_PER_THREAD*sizeof(Event));
+  if (!copy) return false;
+  FILE *f = fopen(path, "w");
+  if (!f) {
+    free(copy);
+    return false;
+  }
+  fprintf(f, "{\"traceEvents\":[");
+  bool first = true;
+  int n = buffer_nb;
+  if (n > TRACE_MAX_THREADS) n = TRACE_MAX_THREADS;
+  for (int i = 0; i < n; ++i) {
+    Buffer *b = buffers[i];
+    if (!b) continue;
+    unsigned int head = b->head;
+    __sync_synchronize();
+    unsigned int count = head < TRACE_EVENTS_PER_THREAD ? head : TRACE_EVENTS_PER_THREAD;
+    unsigned int from = head - count;
+    for (unsigned int j = 0; j < count; ++j) {
+      copy[j] = b->events[(from + j) & (TRACE_EVENTS_PER_THREAD - 1)];
+    }
+    // Drop the events whose slot the owner thread has reused meanwhile,
+    // including the one it may be writing, not published yet
+    __sync_synchronize();
+    unsigned int written = b->head - head + 1;
+    unsigned int unused = TRACE_EVENTS_PER_THREAD - count;
+    unsigned int skipped = written > unused ? written - unused : 0;
+    if (skipped > count) skipped = count;
+    for (unsigned int j = skipped; j < count; ++j) {
+      const Event &e = copy[j];
+      fprintf(f, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                 "\"ts\":%llu.%03u,\"dur\":%llu.%03u}",
+              first ? "" : ",", e.name, b->tid,
+              (unsigned long long)(e.start / 1000), (unsigned int)(e.start % 1000),
+              (unsigned long long)((e.end - e.start) / 1000),
+              (unsigned int)((e.end - e.start) % 1000));
+      first = false;
+    }
+  }
+  free(copy);
+  fprintf(f, "\n],\"displayTimeUnit\":\"ns\"}\n");
+  return fclose(f) == 0;
+}
+
+void
+MSVTrace::initKey()
+{
+  pthread_key_create(&key, NULL);
+}
+
+MSVTrace::Buffer *
+MSVTrace::getBuffer()
+{
+  pthread_once(&once, MSVTrace::initKey);
+  Buffer *b = (Buffer *)pthread_getspecific(key);
+  if (b) return b;
+  int idx = __sync_fetch_and_add(&buffer_nb, 1);
+  if (idx >= TRACE_MAX_THREADS) return NULL;
+  // Buffers are never freed, so that they can be dumped after their thread
+  // has exited.
+  b = (Buffer *)calloc(1, sizeof(Buffer));
+  b->tid = idx;
+  pthread_setspecific(key, b);
+  __sync_synchronize();
+  buffers[idx] = b;
+  return b;
+}
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef MSV_TRACE_H
+#define MSV_TRACE_H
+
+/** Lightweight per-frame tracing.
+ *
+ * Scoped zones are recorded with nanosecond timestamps into a ring buffer
+ * owned by the calling thread, without any locking. The recorded zones can
+ * be written at any time in the Chrome trace event JSON format, which can
+ * be opened in chrome://tracing or Perfetto.
+ *
+ * Tracing is only compiled in when `MSV_TRACE` is defined. Otherwise, all
+ * the macros below expand to nothing.
+ *
+ * Usage:
+ *   void MSVRenderer::renderFrame() {
+ *     MSV_TRACE_SCOPE("renderFrame");
+ *     ...
+ *   }
+ */
+
+/** Maximum number of threads that can record zones */
+#define TRACE_MAX_THREADS 16
+/** Number of zones kept per thread. Must be a power of two. */
+#define TRACE_EVENTS_PER_THREAD 4096
+
+#ifdef MSV_TRACE
+
+#include <pthread.h>
+#include <stdint.h>
+
+#define MSV_TRACE_CONCAT_(a, b) a ## b
+#define MSV_TRACE_CONCAT(a, b) MSV_TRACE_CONCAT_(a, b)
+/** Records a zone named `name` (a string literal) until the end of scope */
+#define MSV_TRACE_SCOPE(name) \
+  MSVTraceScope MSV_TRACE_CONCAT(msvTraceScope, __LINE__)(name)
+/** Writes all recorded zones to the file at `path` */
+#define MSV_TRACE_DUMP(path) MSVTrace::dump(path)
+
+class MSVTrace {
+  public:
+    /** Returns the current timestamp, in nanoseconds */
+    static uint64_t now();
+
+    /** Records a complete zone for the calling thread.
+     * @param name a string that must stay valid for the process lifetime.
+     * @param start the zone start time, in nanoseconds.
+     * @param end the zone end time, in nanoseconds.
+     */
+    static void record(const char *name, uint64_t start, uint64_t end);
+
+    /** Writes all the recorded zones as Chrome trace event JSON.
+     * Can be called from any thread while zones are being recorded.
+     * @return true if the file could be written, false otherwise.
+     */
+    static bool dump(const char *path);
+
+  private:
+    struct Event {
+      const char *name;
+      uint64_t start;
+      uint64_t end;
+    };
+
+    struct Buffer {
+      int tid;
+      volatile unsigned int head;
+      Event events[TRACE_EVENTS_PER_THREAD];
+    };
+
+    static Buffer *buffers[TRACE_MAX_THREADS];
+    static volatile int buffer_nb;
+    static pthread_key_t key;
+    static pthread_once_t once;
+
+    static void initKey();
+    static Buffer *getBuffer();
+};
+
+/** Helper recording a zone for its whole lifetime */
+class MSVTraceScope {
+  public:
+    MSVTraceScope(const char *n) : name(n), start(MSVTrace::now()) {}
+    ~MSVTraceScope() { MSVTrace::record(name, start, MSVTrace::now()); }
+  private:
+    const char *name;
+    uint64_t start;
+};
+
+#else
+
+#define MSV_TRACE_SCOPE(name)
+#define MSV_TRACE_DUMP(path) (false)
+
+#endif
+
+#endif
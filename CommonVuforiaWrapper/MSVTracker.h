@@ -1,17 +1,13 @@
 #ifndef MSV_TRACKER_H
 #define MSV_TRACKER_H
 
-#include <QCAR/ImageTracker.h>
+class MSVBackend;
 
-#define INITIAL_DATASET_NUMBER 1
-
-class MSVTargetInfo;
-
-/** Helper class around QCAR::ImageTracker */
+/** Helper class around the tracker of the current MSVBackend */
 class MSVTracker {
 
   public:
-    MSVTracker();
+    MSVTracker(MSVBackend *backend);
     ~MSVTracker();
 
     /** Adds a bundled dataset produced with the Vuforia Target Manager to
@@ -37,17 +33,6 @@ class MSVTracker {
     void stop() const;
 
   private:
-    QCAR::DataSet **datasets;
-    char **names;
-    int dataset_nb;
-    int dataset_capacity;
-
-    /** Rescales all targets so that they fit the convention used for
-     * targets: greatest dimensions = 2.
-     */
-    static void datasetInit(QCAR::DataSet *dataset);
-    static void datasetDestroy(QCAR::DataSet *dataset);
-    static void datasetDeactivate(QCAR::DataSet *dataset);
-    static QCAR::ImageTracker *getTracker();
+    MSVBackend *backend;
 };
 #endif
@@ -0,0 +1,315 @@
+#include "MSVVideoSource.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define Y4M_SIGNATURE    "YUV4MPEG2"
+#define Y4M_MAX_HEADER   256
+#define IVF_SIGNATURE    "DKIF"
+#define IVF_HEADER_SIZE  32
+#define IVF_FRAME_HEADER 12
+#define DEFAULT_FPS      30
+
+static unsigned int
+le16(const unsigned char *p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+static uint32_t
+le32(const unsigned char *p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t
+le64(const unsigned char *p)
+{
+  return le32(p) | ((uint64_t)le32(p + 4) << 32);
+}
+
+static inline unsigned char
+clamp(int v)
+{
+  return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+/* YUV4MPEG2 stream of 4:2:0 or mono frames */
+class Y4MSource : public MSVVideoSource {
+  public:
+    Y4MSource(FILE *file) : MSVVideoSource(file), planes(NULL), mono(false) {}
+    ~Y4MSource() { free(planes); }
+    bool parseHeader();
+    bool read(unsigned char *rgba, double *pts);
+    bool isI420() const { return true; }
+    bool readI420(unsigned char *planes, double *pts);
+  private:
+    unsigned char *planes;
+    bool mono;
+};
+
+bool
+Y4MSource::parseHeader()
+{
+  char line[Y4M_MAX_HEADER];
+  if (!fgets(line, Y4M_MAX_HEADER, file)) return false;
+  if (strncmp(line, Y4M_SIGNATURE, strlen(Y4M_SIGNATURE))) return false;
+  int num = DEFAULT_FPS, den = 1;
+  char *save = NULL;
+  for (char *tok = strtok_r(line, " \n", &save); tok; tok = strtok_r(NULL, " \n", &save)) {
+    switch (tok[0]) {
+      case 'W': width = atoi(tok + 1); break;
+      case 'H': height = atoi(tok + 1); break;
+      case 'F': sscanf(tok + 1, "%d:%d", &num, &den); break;
+      case 'C':
+        // Only 8 bits 4:2:0 and mono are supported
+        if (!strcmp(tok + 1, "mono")) mono = true;
+        else if (strncmp(tok + 1, "420", 3) || !strncmp(tok + 1, "420p1", 5)) return false;
+        break;
+      default: break;
+    }
+  }
+  if (width <= 0 || height <= 0 || num <= 0 || den <= 0) return false;
+  frameDuration = den / (double)num;
+  dataOffset = ftell(file);
+  planes = (unsigned char *)malloc(width*height + 2*((width + 1)/2)*((height + 1)/2));
+  return planes != NULL;
+}
+
+bool
+Y4MSource::readI420(unsigned char *out, double *pts)
+{
+  // Frame header: "FRAME" followed by optional parameters
+  char line[Y4M_MAX_HEADER];
+  if (!fgets(line, Y4M_MAX_HEADER, file)) return false;
+  if (strncmp(line, "FRAME", 5)) return false;
+  size_t luma = width*height;
+  size_t chroma = ((width + 1)/2)*((height + 1)/2);
+  if (fread(out, 1, luma, file) != luma) return false;
+  // Grayscale frames get neutral chroma
+  if (mono) memset(out + luma, 128, 2*chroma);
+  else if (fread(out + luma, 1, 2*chroma, file) != 2*chroma) return false;
+  *pts = frameIndex++ * frameDuration;
+  return true;
+}
+
+bool
+Y4MSource::read(unsigned char *rgba, double *pts)
+{
+  if (!readI420(planes, pts)) return false;
+  size_t luma = width*height;
+  size_t chroma = ((width + 1)/2)*((height + 1)/2);
+  convertI420(planes,
+              mono ? NULL : planes + luma,
+              mono ? NULL : planes + luma + chroma,
+              width, height, rgba);
+  return true;
+}
+
+/* IVF stream of raw I420 or RGBA frames */
+class IVFSource : public MSVVideoSource {
+  public:
+    IVFSource(FILE *file) : MSVVideoSource(file), planes(NULL), rgbaPayload(false) {}
+    ~IVFSource() { free(planes); }
+    bool parseHeader();
+    bool read(unsigned char *rgba, double *pts);
+    bool isI420() const { return !rgbaPayload; }
+    bool readI420(unsigned char *planes, double *pts);
+  private:
+    unsigned char *planes;
+    bool rgbaPayload;
+    double timebase;
+};
+
+bool
+IVFSource::parseHeader()
+{
+  unsigned char h[IVF_HEADER_SIZE];
+  if (fread(h, 1, IVF_HEADER_SIZE, file) != IVF_HEADER_SIZE) return false;
+  if (memcmp(h, IVF_SIGNATURE, 4)) return false;
+  if (!memcmp(h + 8, "RGBA", 4)) rgbaPayload = true;
+  else if (memcmp(h + 8, "I420", 4)) return false;
+  width = le16(h + 12);
+  height = le16(h + 14);
+  uint32_t rate = le32(h + 16);
+  uint32_t scale = le32(h + 20);
+  if (!width || !height || !rate || !scale) return false;
+  timebase = scale / (double)rate;
+  frameDuration = timebase;
+  dataOffset = le16(h + 6);
+  if (fseek(file, dataOffset, SEEK_SET)) return false;
+  if (!rgbaPayload) {
+    planes = (unsigned char *)malloc(width*height + 2*((width + 1)/2)*((height + 1)/2));
+    if (!planes) return false;
+  }
+  return true;
+}
+
+bool
+IVFSource::readI420(unsigned char *out, double *pts)
+{
+  if (rgbaPayload) return false;
+  unsigned char h[IVF_FRAME_HEADER];
+  if (fread(h, 1, IVF_FRAME_HEADER, file) != IVF_FRAME_HEADER) return false;
+  size_t size = le32(h);
+  size_t chroma = ((width + 1)/2)*((height + 1)/2);
+  if (size != width*height + 2*chroma) return false;
+  if (fread(out, 1, size, file) != size) return false;
+  *pts = le64(h + 4) * timebase;
+  frameIndex++;
+  return true;
+}
+
+bool
+IVFSource::read(unsigned char *rgba, double *pts)
+{
+  size_t luma = width*height;
+  size_t chroma = ((width + 1)/2)*((height + 1)/2);
+  if (!rgbaPayload) {
+    if (!readI420(planes, pts)) return false;
+    convertI420(planes, planes + luma, planes + luma + chroma, width, height, rgba);
+    return true;
+  }
+  unsigned char h[IVF_FRAME_HEADER];
+  if (fread(h, 1, IVF_FRAME_HEADER, file) != IVF_FRAME_HEADER) return false;
+  size_t size = le32(h);
+  if (size != 4*luma) return false;
+  if (fread(rgba, 1, size, file) != size) return false;
+  *pts = le64(h + 4) * timebase;
+  frameIndex++;
+  return true;
+}
+
+/* Headerless RGBA frames */
+class RawSource : public MSVVideoSource {
+  public:
+    RawSource(FILE *file) : MSVVideoSource(file) {}
+    bool read(unsigned char *rgba, double *pts);
+};
+
+bool
+RawSource::read(unsigned char *rgba, double *pts)
+{
+  size_t size = 4*width*height;
+  if (fread(rgba, 1, size, file) != size) return false;
+  *pts = frameIndex++ * frameDuration;
+  return true;
+}
+
+MSVVideoSource::MSVVideoSource(FILE *file) :
+file(file),
+width(0),
+height(0),
+frameDuration(1.0/DEFAULT_FPS),
+dataOffset(0),
+frameIndex(0)
+{}
+
+MSVVideoSource::~MSVVideoSource()
+{
+  if (file) fclose(file);
+}
+
+MSVVideoSource *
+MSVVideoSource::open(const char *path)
+{
+  FILE *f = fopen(path, "rb");
+  if (!f) return NULL;
+  char sig[4];
+  size_t got = fread(sig, 1, 4, f);
+  fseek(f, 0, SEEK_SET);
+  if (got == 4 && !memcmp(sig, IVF_SIGNATURE, 4)) {
+    IVFSource *s = new IVFSource(f);
+    if (s->parseHeader()) return s;
+    delete s;
+  }
+  else if (got == 4 && !memcmp(sig, Y4M_SIGNATURE, 4)) {
+    Y4MSource *s = new Y4MSource(f);
+    if (s->parseHeader()) return s;
+    delete s;
+  }
+  else {
+    fclose(f);
+  }
+  return NULL;
+}
+
+MSVVideoSource *
+MSVVideoSource::openRaw(const char *path,
+                        int width,
+                        int height,
+                        float fps)
+{
+  if (width <= 0 || height <= 0 || fps <= 0) return NULL;
+  FILE *f = fopen(path, "rb");
+  if (!f) return NULL;
+  RawSource *s = new RawSource(f);
+  s->width = width;
+  s->height = height;
+  s->frameDuration = 1.0/fps;
+  return s;
+}
+
+int
+MSVVideoSource::getWidth() const
+{
+  return width;
+}
+
+int
+MSVVideoSource::getHeight() const
+{
+  return height;
+}
+
+double
+MSVVideoSource::getFrameDuration() const
+{
+  return frameDuration;
+}
+
+bool
+MSVVideoSource::isI420() const
+{
+  return false;
+}
+
+bool
+MSVVideoSource::readI420(unsigned char *, double *)
+{
+  return false;
+}
+
+bool
+MSVVideoSource::rewind()
+{
+  frameIndex = 0;
+  return fseek(file, dataOffset, SEEK_SET) == 0;
+}
+
+void
+MSVVideoSource::convertI420(const unsigned char *y,
+                            const unsigned char *u,
+                            const unsigned char *v,
+                            int width,
+                            int height,
+                            unsigned char *rgba)
+{
+  int cw = (width + 1)/2;
+  for (int r = 0; r < height; ++r) {
+    const unsigned char *yr = y + r*width;
+    const unsigned char *ur = u ? u + (r/2)*cw : NULL;
+    const unsigned char *vr = v ? v + (r/2)*cw : NULL;
+    unsigned char *out = rgba + 4*r*width;
+    for (int c = 0; c < width; ++c) {
+      int l = 298*(yr[c] - 16) + 128;
+      int d = ur ? ur[c/2] - 128 : 0;
+      int e = vr ? vr[c/2] - 128 : 0;
+      out[4*c]   = clamp((l + 409*e) >> 8);
+      out[4*c+1] = clamp((l - 100*d - 208*e) >> 8);
+      out[4*c+2] = clamp((l + 516*d) >> 8);
+      out[4*c+3] = 255;
+    }
+  }
+}
@@ -0,0 +1,84 @@
+#ifndef MSV_VIDEOSOURCE_H
+#define MSV_VIDEOSOURCE_H
+
+#include <stdio.h>
+
+/** Abstract sequential reader of uncompressed video frames, decoded to
+ * RGBA, rows top to bottom.
+ *
+ * Supported containers are:
+ * - YUV4MPEG2 (`.y4m`) with 4:2:0 or mono planes,
+ * - IVF (`.ivf`) holding raw `I420` or `RGBA` frames. Compressed payloads
+ *   (VP8, VP9, ...) are rejected, as no codec is bundled.
+ * - headerless RGBA frames, through `openRaw`.
+ */
+class MSVVideoSource {
+  public:
+    virtual ~MSVVideoSource();
+
+    /** Opens a Y4M or IVF file, depending on its signature.
+     * @return the source, or NULL if the file can't be read or decoded.
+     */
+    static MSVVideoSource *open(const char *path);
+
+    /** Opens a file of concatenated `width*height*4` bytes RGBA frames */
+    static MSVVideoSource *openRaw(const char *path,
+                                   int width,
+                                   int height,
+                                   float fps);
+
+    int getWidth() const;
+    int getHeight() const;
+    /** Nominal duration of a frame, in seconds */
+    double getFrameDuration() const;
+
+    /** Decodes the next frame.
+     * @param rgba filled with the `width*height*4` bytes of the frame.
+     * @param pts filled with the presentation time of the frame, in seconds
+     * since the beginning of the stream.
+     * @return false at the end of the stream, or on error.
+     */
+    virtual bool read(unsigned char *rgba, double *pts) = 0;
+
+    /** Whether frames are stored as 4:2:0 planes, which `readI420` returns
+     * without any conversion.
+     */
+    virtual bool isI420() const;
+
+    /** Reads the next frame as 4:2:0 planes, for sources where `isI420` is
+     * true.
+     * @param planes filled with the Y plane, then the U and V planes of
+     * `((width+1)/2)*((height+1)/2)` bytes each.
+     * @param pts as in `read`.
+     * @return false at the end of the stream, on error, or if the source is
+     * not I420.
+     */
+    virtual bool readI420(unsigned char *planes, double *pts);
+
+    /** Goes back to the first frame */
+    virtual bool rewind();
+
+    /** Converts 4:2:0 planes (BT.601, video range) to RGBA. `u` and `v`
+     * may be NULL for grayscale frames.
+     */
+    static void convertI420(const unsigned char *y,
+                            const unsigned char *u,
+                            const unsigned char *v,
+                            int width,
+                            int height,
+                            unsigned char *rgba);
+
+  protected:
+    MSVVideoSource(FILE *file);
+
+    FILE *file;
+    int width;
+    int height;
+    double frameDuration;
+    /** Offset of the first frame in the file */
+    long dataOffset;
+    /** Number of frames read since the beginning of the stream */
+    unsigned int frameIndex;
+};
+
+#endif
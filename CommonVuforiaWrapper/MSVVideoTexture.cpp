@@ -0,0 +1,244 @@
+#include "MSVRedraw.h"
+#include "MSVTrace.h"
+#include "MSVVideoSource.h"
+#include "MSVVideoTexture.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+MSVVideoTexture::MSVVideoTexture(MSVVideoSource *source,
+                                 bool loop) :
+source(source),
+loop(loop),
+width(source->getWidth()),
+height(source->getHeight()),
+planar(source->isI420()),
+writeIdx(0),
+readIdx(0),
+running(true),
+threaded(false),
+current(-1),
+started(false),
+startTime(0)
+{
+  memset(&stats, 0, sizeof(Stats));
+  memset(textures, 0, sizeof(textures));
+  size_t size = planar ? width*height + 2*((width + 1)/2)*((height + 1)/2) :
+                         4*width*height;
+  for (int i = 0; i < VIDEO_RING_SIZE; ++i) {
+    slots[i].pixels = (unsigned char *)malloc(size);
+    slots[i].pts = 0;
+    slots[i].state = SLOT_FREE;
+  }
+  pthread_mutex_init(&lock, NULL);
+  pthread_cond_init(&cond, NULL);
+  threaded = pthread_create(&thread, NULL, MSVVideoTexture::run, this) == 0;
+}
+
+MSVVideoTexture::~MSVVideoTexture()
+{
+  stop();
+  if (threaded) pthread_join(thread, NULL);
+  for (int i = 0; i < VIDEO_RING_SIZE; ++i) {
+    for (int p = 0; p < 3; ++p)
+      MSVResourceManager::release(MSVResourceManager::TEXTURE, textures[i][p]);
+    free(slots[i].pixels);
+  }
+  pthread_cond_destroy(&cond);
+  pthread_mutex_destroy(&lock);
+  delete source;
+}
+
+GLuint
+MSVVideoTexture::getTexture(float mtx[16])
+{
+  double t = now();
+  if (!started) {
+    started = true;
+    startTime = t;
+  }
+  t -= startTime;
+
+  // Take the newest frame that is due, dropping the older ones
+  int pick = -1;
+  pthread_mutex_lock(&lock);
+  while (slots[readIdx].state == SLOT_READY && slots[readIdx].pts <= t) {
+    if (pick >= 0) {
+      slots[pick].state = SLOT_FREE;
+      stats.dropped++;
+    }
+    pick = readIdx;
+    readIdx = (readIdx + 1) % VIDEO_RING_SIZE;
+  }
+  pthread_mutex_unlock(&lock);
+
+  if (pick >= 0) {
+    // The slot belongs to the GL thread until it is marked free again
+    upload(&slots[pick]);
+    pthread_mutex_lock(&lock);
+    stats.presented++;
+    if (t - slots[pick].pts > source->getFrameDuration()) stats.late++;
+    slots[pick].state = SLOT_FREE;
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&lock);
+  }
+  else if (current >= 0) {
+    for (int p = 0; p < planesCount(); ++p)
+      MSVResourceManager::touch(MSVResourceManager::TEXTURE, textures[current][p]);
+  }
+
+  // Frames are stored top to bottom: flip the t coordinate
+  static const float flip[16] = {1,  0, 0, 0,
+                                 0, -1, 0, 0,
+                                 0,  0, 1, 0,
+                                 0,  1, 0, 1};
+  memcpy(mtx, flip, 16*sizeof(float));
+  return current >= 0 ? textures[current][0] : 0;
+}
+
+GLenum
+MSVVideoTexture::getTextureTarget() const
+{
+  return GL_TEXTURE_2D;
+}
+
+MSVTextureCallback::Format
+MSVVideoTexture::getTextureFormat() const
+{
+  return planar ? FORMAT_I420 : FORMAT_RGBA;
+}
+
+void
+MSVVideoTexture::getChromaTextures(GLuint chroma[2])
+{
+  chroma[0] = current >= 0 ? textures[current][1] : 0;
+  chroma[1] = current >= 0 ? textures[current][2] : 0;
+}
+
+void
+MSVVideoTexture::stop()
+{
+  pthread_mutex_lock(&lock);
+  running = false;
+  pthread_cond_broadcast(&cond);
+  pthread_mutex_unlock(&lock);
+}
+
+void
+MSVVideoTexture::resourceEvicted(GLuint name)
+{
+  for (int i = 0; i < VIDEO_RING_SIZE; ++i) {
+    for (int p = 0; p < 3; ++p)
+      if (textures[i][p] == name) textures[i][p] = 0;
+  }
+  if (current >= 0) {
+    for (int p = 0; p < planesCount(); ++p)
+      if (!textures[current][p]) current = -1;
+  }
+}
+
+void
+MSVVideoTexture::getStats(Stats *s)
+{
+  pthread_mutex_lock(&lock);
+  *s = stats;
+  pthread_mutex_unlock(&lock);
+}
+
+void *
+MSVVideoTexture::run(void *self)
+{
+  ((MSVVideoTexture *)self)->decode();
+  return NULL;
+}
+
+void
+MSVVideoTexture::decode()
+{
+  // Presentation times keep increasing across loops
+  double offset = 0;
+  double lastPts = 0;
+  for (;;) {
+    pthread_mutex_lock(&lock);
+    while (running && slots[writeIdx].state != SLOT_FREE)
+      pthread_cond_wait(&cond, &lock);
+    bool stopped = !running;
+    pthread_mutex_unlock(&lock);
+    if (stopped) break;
+
+    Slot *slot = &slots[writeIdx];
+    double pts;
+    bool ok;
+    {
+      MSV_TRACE_SCOPE("decodeVideoFrame");
+      ok = planar ? source->readI420(slot->pixels, &pts) :
+                    source->read(slot->pixels, &pts);
+      if (!ok && loop && lastPts + offset > 0 && source->rewind()) {
+        offset += lastPts + source->getFrameDuration();
+        ok = planar ? source->readI420(slot->pixels, &pts) :
+                      source->read(slot->pixels, &pts);
+      }
+    }
+    if (!ok) break;  // end of stream: the last frame stays displayed
+    lastPts = pts;
+
+    pthread_mutex_lock(&lock);
+    slot->pts = pts + offset;
+    slot->state = SLOT_READY;
+    stats.decoded++;
+    pthread_mutex_unlock(&lock);
+    MSVRedraw::invalidate(MSVRedraw::TEXTURE_UPDATED);
+    writeIdx = (writeIdx + 1) % VIDEO_RING_SIZE;
+  }
+}
+
+void
+MSVVideoTexture::upload(const Slot *slot)
+{
+  MSV_TRACE_SCOPE("uploadVideoFrame");
+  int next = (current + 1) % VIDEO_RING_SIZE;
+  int cw = (width + 1)/2;
+  int ch = (height + 1)/2;
+  const int w[3] = {width, cw, cw};
+  const int h[3] = {height, ch, ch};
+  const unsigned char *data[3] = {slot->pixels,
+                                  slot->pixels + width*height,
+                                  slot->pixels + width*height + cw*ch};
+  GLenum format = planar ? GL_LUMINANCE : GL_RGBA;
+  // Planes rows are not 4 bytes aligned
+  if (planar) glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  for (int p = 0; p < planesCount(); ++p) {
+    GLuint *tex = &textures[next][p];
+    if (!*tex) {
+      glGenTextures(1, tex);
+      glBindTexture(GL_TEXTURE_2D, *tex);
+      glTexImage2D(GL_TEXTURE_2D, 0, format, w[p], h[p], 0,
+                   format, GL_UNSIGNED_BYTE, (GLvoid *)data[p]);
+      MSVResourceManager::track(MSVResourceManager::TEXTURE, *tex,
+                                (planar ? 1 : 4)*w[p]*h[p], this);
+    }
+    else {
+      glBindTexture(GL_TEXTURE_2D, *tex);
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w[p], h[p],
+                      format, GL_UNSIGNED_BYTE, (GLvoid *)data[p]);
+      MSVResourceManager::touch(MSVResourceManager::TEXTURE, *tex);
+    }
+  }
+  if (planar) glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  current = next;
+}
+
+int
+MSVVideoTexture::planesCount() const
+{
+  return planar ? 3 : 1;
+}
+
+double
+MSVVideoTexture::now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
@@ -0,0 +1,115 @@
+#ifndef MSV_VIDEOTEXTURE_H
+#define MSV_VIDEOTEXTURE_H
+
+#include "MSVResourceManager.h"
+#include "MSVTextureCallback.h"
+
+#include <pthread.h>
+
+class MSVVideoSource;
+
+/** Number of decoded frames buffered between the decode and GL threads,
+ * which is also the number of textures frames are uploaded to.
+ */
+#define VIDEO_RING_SIZE 3
+
+/** MSVTextureCallback playing a MSVVideoSource, without any platform player.
+ *
+ * A background thread decodes frames ahead into a ring of VIDEO_RING_SIZE
+ * pixel buffers. At each rendered frame, the newest decoded frame whose
+ * presentation time has been reached is uploaded, and the older ones are
+ * dropped. Uploads go round-robin to VIDEO_RING_SIZE textures, so that a
+ * texture is never overwritten while the GPU may still be sampling it from
+ * a previous frame: OpenGL ES 2 has no fences, so the ring depth plays that
+ * role.
+ *
+ * Sources stored as 4:2:0 planes are uploaded as is to three luma and
+ * chroma textures, converted to RGB by the fragment shader: no CPU
+ * conversion, and 1.5 instead of 4 bytes per pixel to upload.
+ *
+ * The playback clock starts at the first rendered frame.
+ */
+class MSVVideoTexture : public MSVTextureCallback,
+                        public MSVResourceManager::Owner {
+  public:
+    /** Playback statistics */
+    struct Stats {
+      /** Frames decoded by the background thread */
+      unsigned int decoded;
+      /** Frames uploaded and displayed */
+      unsigned int presented;
+      /** Frames decoded but skipped because a newer one was due */
+      unsigned int dropped;
+      /** Frames displayed more than one frame duration after their
+       * presentation time, i.e. the decoder could not keep up.
+       */
+      unsigned int late;
+    };
+
+    /** Constructor. Starts decoding right away.
+     * @param source the video to play. Its ownership is transferred to the
+     * MSVVideoTexture.
+     * @param loop whether to restart from the beginning at end of stream.
+     */
+    MSVVideoTexture(MSVVideoSource *source, bool loop = true);
+    ~MSVVideoTexture();
+
+    /** Implementation of MSVTextureCallback */
+    GLuint getTexture(float mtx[16]);
+    GLenum getTextureTarget() const;
+    Format getTextureFormat() const;
+    void getChromaTextures(GLuint chroma[2]);
+    void stop();
+
+    /** Implementation of MSVResourceManager::Owner */
+    void resourceEvicted(GLuint name);
+
+    /** Returns the playback statistics. Can be called from any thread. */
+    void getStats(Stats *stats);
+
+  private:
+    enum SlotState {
+      SLOT_FREE = 0,
+      SLOT_READY
+    };
+
+    struct Slot {
+      unsigned char *pixels;
+      double pts;
+      SlotState state;
+    };
+
+    MSVVideoSource *source;
+    bool loop;
+    int width;
+    int height;
+    /** Whether frames are I420 planes rather than RGBA */
+    bool planar;
+
+    Slot slots[VIDEO_RING_SIZE];
+    /** Next slot to be filled by the decoder, and to be read by GL thread */
+    int writeIdx;
+    int readIdx;
+    bool running;
+    bool threaded;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+
+    /* GL thread only */
+    /** RGBA texture, or Y, U and V textures */
+    GLuint textures[VIDEO_RING_SIZE][3];
+    int current;
+    bool started;
+    double startTime;
+
+    Stats stats;
+
+    static void *run(void *self);
+    void decode();
+    void upload(const Slot *slot);
+    int planesCount() const;
+    static double now();
+};
+
+#endif
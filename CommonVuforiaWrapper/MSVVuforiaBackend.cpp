@@ -0,0 +1,319 @@
+#include "MSVCallback.h"
+#include "MSVFrame.h"
+#include "MSVVuforiaBackend.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <QCAR/CameraDevice.h>
+#include <QCAR/DataSet.h>
+#include <QCAR/ImageTarget.h>
+#include <QCAR/QCAR.h>
+#include <QCAR/Renderer.h>
+#include <QCAR/Tool.h>
+#include <QCAR/TrackerManager.h>
+#include <QCAR/VideoBackgroundConfig.h>
+
+MSVVuforiaBackend::MSVVuforiaBackend() :
+datasets(NULL),
+names(NULL),
+dataset_nb(0),
+dataset_capacity(0),
+videoWidth(0),
+videoHeight(0)
+{}
+
+MSVVuforiaBackend::~MSVVuforiaBackend()
+{
+  deinitTracker();
+}
+
+bool
+MSVVuforiaBackend::initCamera()
+{
+  return QCAR::CameraDevice::getInstance().init();
+}
+
+int
+MSVVuforiaBackend::getVideoModeCount()
+{
+  return QCAR::CameraDevice::getInstance().getNumVideoModes();
+}
+
+void
+MSVVuforiaBackend::getVideoMode(int index, VideoMode *mode)
+{
+  QCAR::VideoMode m = QCAR::CameraDevice::getInstance().getVideoMode(index);
+  mode->width = m.mWidth;
+  mode->height = m.mHeight;
+  mode->frameRate = m.mFramerate;
+}
+
+bool
+MSVVuforiaBackend::startCamera(int mode)
+{
+  QCAR::CameraDevice& cameraDevice = QCAR::CameraDevice::getInstance();
+  // Set video mode
+  if (!cameraDevice.selectVideoMode(mode)) return false;
+  QCAR::VideoMode m = cameraDevice.getVideoMode(mode);
+  videoWidth = m.mWidth;
+  videoHeight = m.mHeight;
+  // Start the camera:
+  if (!cameraDevice.start()) return false;
+  if (!cameraDevice.setFocusMode(QCAR::CameraDevice::FOCUS_MODE_CONTINUOUSAUTO)) {
+    cameraDevice.setFocusMode(QCAR::CameraDevice::FOCUS_MODE_NORMAL);
+  }
+  return true;
+}
+
+void
+MSVVuforiaBackend::stopCamera()
+{
+  QCAR::CameraDevice::getInstance().stop();
+  QCAR::CameraDevice::getInstance().deinit();
+}
+
+void
+MSVVuforiaBackend::getVideoSize(int *width, int *height)
+{
+  *width = videoWidth;
+  *height = videoHeight;
+}
+
+void
+MSVVuforiaBackend::getProjectionMatrix(float nearPlane,
+                                       float farPlane,
+                                       float matrix[16])
+{
+  const QCAR::CameraCalibration& cameraCalibration =
+  QCAR::CameraDevice::getInstance().getCameraCalibration();
+  QCAR::Matrix44F m = QCAR::Tool::getProjectionGL(cameraCalibration, nearPlane, farPlane);
+  memcpy(matrix, m.data, 16*sizeof(float));
+}
+
+void
+MSVVuforiaBackend::initTracker()
+{
+  QCAR::TrackerManager& trackerManager = QCAR::TrackerManager::getInstance();
+  trackerManager.initTracker(QCAR::ImageTracker::getClassType());
+  dataset_nb = 0;
+  dataset_capacity = INITIAL_DATASET_NUMBER;
+  datasets = (QCAR::DataSet **)calloc(INITIAL_DATASET_NUMBER, sizeof(QCAR::DataSet *));
+  names = (char **)calloc(INITIAL_DATASET_NUMBER, sizeof(char *));
+}
+
+void
+MSVVuforiaBackend::deinitTracker()
+{
+  if (!datasets) return;
+  for (int i = 0; i < dataset_nb; ++i) {
+    datasetDestroy(this->datasets[i]);
+    this->datasets[i] = NULL;
+    free(this->names[i]);
+    this->names[i] = NULL;
+  }
+  free(datasets);
+  datasets = NULL;
+  free(names);
+  names = NULL;
+  dataset_nb = 0;
+  dataset_capacity = 0;
+  QCAR::TrackerManager& trackerManager = QCAR::TrackerManager::getInstance();
+  trackerManager.deinitTracker(QCAR::ImageTracker::getClassType());
+}
+
+void
+MSVVuforiaBackend::addDataset(const char *dataset)
+{
+  QCAR::ImageTracker* imageTracker = getTracker();
+  int len = strlen(dataset);
+  char *filename = (char *)malloc(len+5);
+  memcpy(filename, dataset, len);
+  memcpy(filename+len, ".xml\0", 5);
+  if (QCAR::DataSet::exists(filename, QCAR::DataSet::STORAGE_APPRESOURCE)) {
+    if (dataset_nb == dataset_capacity) {
+      dataset_capacity *= 2;
+      datasets = (QCAR::DataSet **)realloc(datasets, dataset_capacity*sizeof(QCAR::DataSet *));
+      names = (char **)realloc(names, dataset_capacity*sizeof(char *));
+    }
+    datasets[dataset_nb] = imageTracker->createDataSet();
+    datasets[dataset_nb]->load(filename, QCAR::DataSet::STORAGE_APPRESOURCE);
+    datasetInit(datasets[dataset_nb]);
+    names[dataset_nb] = strdup(dataset);
+    dataset_nb++;
+  }
+  free(filename);
+}
+
+bool
+MSVVuforiaBackend::hasTarget(const char *name,
+                             const char *dataset)
+{
+  int d_idx = findDataset(dataset);
+  if (d_idx < 0) return false;
+  int t_idx = -1;
+  QCAR::DataSet *d = datasets[d_idx];
+  for (int i = 0; i < d->getNumTrackables(); ++i) {
+    if (!strcmp(name, d->getTrackable(i)->getName())) {
+      t_idx = i;
+      break;
+    }
+  }
+  if (t_idx < 0) return false;
+  return true;
+}
+
+void
+MSVVuforiaBackend::startTracker(const char *dataset)
+{
+  QCAR::ImageTracker* imageTracker = getTracker();
+  if (imageTracker != 0) {
+    int d_idx = findDataset(dataset);
+    if (d_idx < 0) return;
+    imageTracker->activateDataSet(datasets[d_idx]);
+    imageTracker->start();
+  }
+}
+
+void
+MSVVuforiaBackend::stopTracker()
+{
+    QCAR::ImageTracker *imageTracker = getTracker();
+    if (imageTracker) {
+      QCAR::DataSet *active = imageTracker->getActiveDataSet();
+      if (active) datasetDeactivate(active);
+      imageTracker->stop();
+    }
+}
+
+bool
+MSVVuforiaBackend::requiresAlpha()
+{
+  return QCAR::requiresAlpha();
+}
+
+void
+MSVVuforiaBackend::setCallback(MSVCallback *cb)
+{
+  QCAR::registerCallback(cb);
+}
+
+void
+MSVVuforiaBackend::configureVideoBackground(int glWidth,
+                                            int glHeight,
+                                            bool portrait)
+{
+  // Get the selected video mode:
+  QCAR::VideoMode videoMode;
+  getVideoSize(&videoMode.mWidth, &videoMode.mHeight);
+  if (!videoMode.mWidth || !videoMode.mHeight) return;
+
+  // Configure the video background
+  QCAR::VideoBackgroundConfig config;
+  config.mEnabled = true;
+  config.mSynchronous = true;
+  config.mPosition.data[0] = 0.0f;
+  config.mPosition.data[1] = 0.0f;
+
+  if (portrait)
+  {
+    config.mSize.data[0] = glHeight * (videoMode.mHeight / (float)videoMode.mWidth);
+    config.mSize.data[1] = glHeight;
+
+    if (config.mSize.data[0] < glWidth)
+    {
+      config.mSize.data[0] = glWidth;
+      config.mSize.data[1] = glWidth * (videoMode.mWidth  / (float)videoMode.mHeight);
+    }
+  }
+  else
+  {
+    config.mSize.data[0] = glWidth;
+    config.mSize.data[1] = glWidth * (videoMode.mHeight / (float)videoMode.mWidth);
+
+    if (config.mSize.data[1] < glHeight)
+    {
+      config.mSize.data[0] = glHeight * (videoMode.mWidth / (float)videoMode.mHeight);
+      config.mSize.data[1] = glHeight;
+    }
+  }
+
+  // Set the config:
+  QCAR::Renderer::getInstance().setVideoBackgroundConfig(config);
+}
+
+void
+MSVVuforiaBackend::beginRender(MSVFrame *frame)
+{
+  // Get the state from QCAR and mark the beginning of a rendering section.
+  // The state is kept until `endRender` so that the frame stays valid.
+  state = QCAR::Renderer::getInstance().begin();
+
+  // Explicitly render the Video Background
+  QCAR::Renderer::getInstance().drawVideoBackground();
+
+  frame->set(state);
+}
+
+void
+MSVVuforiaBackend::endRender()
+{
+  QCAR::Renderer::getInstance().end();
+}
+
+int
+MSVVuforiaBackend::findDataset(const char *dataset) const
+{
+  for (int i = 0; i < dataset_nb; ++i) {
+    if (!strcmp(dataset, names[i])) return i;
+  }
+  return -1;
+}
+
+void
+MSVVuforiaBackend::datasetInit(QCAR::DataSet *dataset)
+{
+  for (int i = 0; i < dataset->getNumTrackables(); ++i) {
+    QCAR::ImageTarget *t = static_cast<QCAR::ImageTarget *>(
+      dataset->getTrackable(i)
+    );
+    QCAR::Vec2F s = t->getSize();
+    float w = s.data[0];
+    float h = s.data[1];
+    if (w > h) {
+      w *= 2.0/h;
+      h = 2.0;
+    }
+    else {
+      h *= 2.0/w;
+      w = 2.0;
+    }
+    t->setSize(QCAR::Vec2F(w,h));
+  }
+}
+
+void
+MSVVuforiaBackend::datasetDeactivate(QCAR::DataSet *dataset)
+{
+  QCAR::ImageTracker *imageTracker = getTracker();
+  if (dataset->isActive()) {
+    imageTracker->deactivateDataSet(dataset);
+  }
+}
+
+void
+MSVVuforiaBackend::datasetDestroy(QCAR::DataSet *dataset)
+{
+  QCAR::ImageTracker* imageTracker = getTracker();
+  datasetDeactivate(dataset);
+  imageTracker->destroyDataSet(dataset);
+}
+
+QCAR::ImageTracker *
+MSVVuforiaBackend::getTracker()
+{
+  QCAR::TrackerManager& trackerManager = QCAR::TrackerManager::getInstance();
+  return static_cast<QCAR::ImageTracker*> (
+    trackerManager.getTracker(QCAR::ImageTracker::getClassType())
+  );
+}
@@ -0,0 +1,62 @@
+#ifndef MSV_VUFORIABACKEND_H
+#define MSV_VUFORIABACKEND_H
+
+#include "MSVBackend.h"
+
+#include <QCAR/ImageTracker.h>
+#include <QCAR/State.h>
+
+#define INITIAL_DATASET_NUMBER 1
+
+/** MSVBackend implementation using the Vuforia SDK */
+class MSVVuforiaBackend : public MSVBackend {
+  public:
+    MSVVuforiaBackend();
+    ~MSVVuforiaBackend();
+
+    /** Implementation of MSVBackend */
+    bool initCamera();
+    int getVideoModeCount();
+    void getVideoMode(int index, VideoMode *mode);
+    bool startCamera(int mode);
+    void stopCamera();
+    void getVideoSize(int *width, int *height);
+    void getProjectionMatrix(float nearPlane,
+                             float farPlane,
+                             float matrix[16]);
+    void initTracker();
+    void deinitTracker();
+    void addDataset(const char *dataset);
+    bool hasTarget(const char *name,
+                   const char *dataset);
+    void startTracker(const char *dataset);
+    void stopTracker();
+    bool requiresAlpha();
+    void setCallback(MSVCallback *cb);
+    void configureVideoBackground(int glWidth,
+                                  int glHeight,
+                                  bool portrait);
+    void beginRender(MSVFrame *frame);
+    void endRender();
+
+  private:
+    QCAR::DataSet **datasets;
+    char **names;
+    int dataset_nb;
+    int dataset_capacity;
+    QCAR::State state;
+    int videoWidth;
+    int videoHeight;
+
+    int findDataset(const char *dataset) const;
+
+    /** Rescales all targets so that they fit the convention used for
+     * targets: greatest dimensions = 2.
+     */
+    static void datasetInit(QCAR::DataSet *dataset);
+    static void datasetDestroy(QCAR::DataSet *dataset);
+    static void datasetDeactivate(QCAR::DataSet *dataset);
+    static QCAR::ImageTracker *getTracker();
+};
+
+#endif
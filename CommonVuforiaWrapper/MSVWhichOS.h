@@ -8,4 +8,9 @@
   #endif
 #endif
 
+/* Linux host build, without camera nor Vuforia SDK (see Host/CMakeLists.txt) */
+#if (defined(MSV_HOST))
+  #define __MSV_SYS_HOST__
+#endif
+
 #endif
@@ -0,0 +1,1149 @@
+/* Micro-benchmarks of the CommonVuforiaWrapper hot paths.
+ *
+ * Usage: msvbench [--filter SUBSTRING] [--min-time SECONDS]
+ *                 [--json PATH] [--compare BASELINE.json] [--threshold PCT]
+ *        msvbench --replay RECORDING [--track TARGET] [--realtime] [--json PATH]
+ *
+ * Each benchmark is calibrated to run for at least `--min-time` seconds, then
+ * timed BENCH_RUNS times; the median time per operation is reported.
+ * `--json` writes the results (use `-` for stdout), which can later be given
+ * to `--compare`: any benchmark slower than the baseline by more than
+ * `--threshold` percent is flagged, and the exit status is then 1.
+ *
+ * `--replay` instead feeds a session recorded with MSVRecorder through the
+ * callback and the renderer (see MSVReplay), as fast as possible unless
+ * `--realtime` is given, and reports the end-to-end update and render
+ * times. With `--track`, one of the simulated targets ("target0", ...) is
+ * tracked with a plane model, so that recorded results are drawn.
+ */
+#include "MSVAnimation.h"
+#include "MSVAsset.h"
+#include "MSVBVH.h"
+#include "MSVCallback.h"
+#include "MSVController.h"
+#include "MSVEpoch.h"
+#include "MSVFrame.h"
+#include "MSVFrameCapture.h"
+#include "MSVImageDecoder.h"
+#include "MSVMesh.h"
+#include "MSVModel.h"
+#include "MSVModelLoader.h"
+#include "MSVRenderer.h"
+#include "MSVReplay.h"
+#include "MSVSimulatedBackend.h"
+#include "MSVState.h"
+#include "MSVTexture.h"
+#include "MSVTracker.h"
+#include "MSVVideoSource.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#define BENCH_RUNS              5
+#define BENCH_DEFAULT_MIN_TIME  0.2
+#define BENCH_DEFAULT_THRESHOLD 10.0
+#define BENCH_MAX_ITERATIONS    (1u << 30)
+
+typedef void (*BenchFn)(unsigned int n);
+
+struct Bench {
+  const char *name;
+  BenchFn run;
+};
+
+struct BenchResult {
+  const char *name;
+  unsigned int iterations;
+  double median;
+  double min;
+  double max;
+};
+
+/* Keeps the compiler from discarding the benchmarked work */
+static volatile float sink;
+
+static double
+now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Fixtures */
+
+struct Grid {
+  unsigned int nVertices;
+  float *vertices;
+  float *normals;
+  float *texCoords;
+  unsigned int nFaces;
+  float *faces;
+};
+
+static Grid smallGrid;
+static Grid largeGrid;
+static Grid modelGrid;
+static Grid hitGrid;
+static char objPath[] = "/tmp/msvbench-objXXXXXX";
+static char glbPath[] = "/tmp/msvbench-glbXXXXXX";
+static unsigned char *smallPixels;
+static unsigned char *largePixels;
+static unsigned char *videoPixels;
+#define FILL_WIDTH  1280
+#define FILL_HEIGHT 720
+/* Model layers shaded per pixel of the overlay, i.e. depth complexity */
+#define FILL_LAYERS 2
+static unsigned char *fillView;
+static unsigned char *fillOverlay;
+static unsigned char *png;
+static size_t pngSize;
+static MSVMesh *animatedMesh;
+static float *animatedVertices;
+static float *animatedNormals;
+static MSVMesh *hitMesh;
+#define HIT_RAYS 256
+/** Origins then directions of the hit test rays */
+static float hitRays[HIT_RAYS][2][3];
+
+/** Animation streams of animatedMesh */
+struct AnimatedStreams {
+  float *deltas;
+  float *indices;
+  float *weights;
+};
+static AnimatedStreams animatedStreams;
+static float matA[16];
+static float matB[16];
+static float matC[16];
+static float pose[12];
+static MSVTracker *tracker;
+static MSVFrame foundFrame;
+static MSVFrame emptyFrame;
+
+/** Builds a n*n quads plane, as a typical textured model would be */
+static void
+makeGrid(Grid *g, unsigned int n)
+{
+  g->nVertices = (n+1)*(n+1);
+  g->vertices = (float *)malloc(3*g->nVertices*sizeof(float));
+  g->normals = (float *)malloc(3*g->nVertices*sizeof(float));
+  g->texCoords = (float *)malloc(2*g->nVertices*sizeof(float));
+  for (unsigned int y = 0; y <= n; ++y) {
+    for (unsigned int x = 0; x <= n; ++x) {
+      unsigned int i = y*(n+1) + x;
+      g->vertices[3*i]   = 2.0f*x/n - 1.0f;
+      g->vertices[3*i+1] = 2.0f*y/n - 1.0f;
+      g->vertices[3*i+2] = 0;
+      g->normals[3*i]    = 0;
+      g->normals[3*i+1]  = 0;
+      g->normals[3*i+2]  = 1;
+      g->texCoords[2*i]   = (float)x/n;
+      g->texCoords[2*i+1] = (float)y/n;
+    }
+  }
+  g->nFaces = 2*n*n;
+  g->faces = (float *)malloc(3*g->nFaces*sizeof(float));
+  float *f = g->faces;
+  for (unsigned int y = 0; y < n; ++y) {
+    for (unsigned int x = 0; x < n; ++x) {
+      unsigned int i = y*(n+1) + x;
+      *f++ = i; *f++ = i+1;   *f++ = i+n+1;
+      *f++ = i+1; *f++ = i+n+2; *f++ = i+n+1;
+    }
+  }
+}
+
+static void
+freeGrid(Grid *g)
+{
+  free(g->vertices);
+  free(g->normals);
+  free(g->texCoords);
+  free(g->faces);
+}
+
+/** Writes a grid as an OBJ file, a few megabytes large */
+static bool
+writeOBJ(const Grid *g, int fd)
+{
+  FILE *f = fdopen(fd, "w");
+  if (!f) return false;
+  for (unsigned int i = 0; i < g->nVertices; ++i) {
+    const float *v = &g->vertices[3*i];
+    fprintf(f, "v %f %f %f\n", v[0], v[1], v[2]);
+  }
+  for (unsigned int i = 0; i < g->nVertices; ++i)
+    fprintf(f, "vt %f %f\n", g->texCoords[2*i], g->texCoords[2*i+1]);
+  for (unsigned int i = 0; i < g->nVertices; ++i) {
+    const float *n = &g->normals[3*i];
+    fprintf(f, "vn %f %f %f\n", n[0], n[1], n[2]);
+  }
+  for (unsigned int i = 0; i < g->nFaces; ++i) {
+    unsigned int a = g->faces[3*i] + 1;
+    unsigned int b = g->faces[3*i+1] + 1;
+    unsigned int c = g->faces[3*i+2] + 1;
+    fprintf(f, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, c, c, c);
+  }
+  return !fclose(f);
+}
+
+/** Writes a grid as a .glb file, with 16-bit indices */
+static bool
+writeGLB(const Grid *g, int fd)
+{
+  FILE *f = fdopen(fd, "wb");
+  if (!f) return false;
+  unsigned int posSize = 3*g->nVertices*sizeof(float);
+  unsigned int uvSize = 2*g->nVertices*sizeof(float);
+  unsigned int idxSize = (3*g->nFaces*sizeof(unsigned short) + 3) & ~3u;
+  char json[1024];
+  int len = snprintf(json, sizeof(json),
+    "{\"asset\":{\"version\":\"2.0\"},\"buffers\":[{\"byteLength\":%u}],"
+    "\"bufferViews\":[{\"buffer\":0,\"byteLength\":%u},"
+    "{\"buffer\":0,\"byteOffset\":%u,\"byteLength\":%u},"
+    "{\"buffer\":0,\"byteOffset\":%u,\"byteLength\":%u},"
+    "{\"buffer\":0,\"byteOffset\":%u,\"byteLength\":%u}],"
+    "\"accessors\":[{\"bufferView\":0,\"componentType\":5126,\"count\":%u,\"type\":\"VEC3\"},"
+    "{\"bufferView\":1,\"componentType\":5126,\"count\":%u,\"type\":\"VEC3\"},"
+    "{\"bufferView\":2,\"componentType\":5126,\"count\":%u,\"type\":\"VEC2\"},"
+    "{\"bufferView\":3,\"componentType\":5123,\"count\":%u,\"type\":\"SCALAR\"}],"
+    "\"meshes\":[{\"primitives\":[{\"attributes\":"
+    "{\"POSITION\":0,\"NORMAL\":1,\"TEXCOORD_0\":2},\"indices\":3}]}]}",
+    2*posSize + uvSize + idxSize, posSize, posSize, posSize, 2*posSize, uvSize,
+    2*posSize + uvSize, 3*g->nFaces*(unsigned int)sizeof(unsigned short),
+    g->nVertices, g->nVertices, g->nVertices, 3*g->nFaces);
+  while (len % 4) json[len++] = ' ';
+  unsigned int binSize = 2*posSize + uvSize + idxSize;
+  unsigned int header[5] = {0x46546c67, 2, 28 + len + binSize, (unsigned int)len,
+                            0x4e4f534a};
+  unsigned int binHeader[2] = {binSize, 0x004e4942};
+  fwrite(header, sizeof(header), 1, f);
+  fwrite(json, len, 1, f);
+  fwrite(binHeader, sizeof(binHeader), 1, f);
+  fwrite(g->vertices, posSize, 1, f);
+  fwrite(g->normals, posSize, 1, f);
+  fwrite(g->texCoords, uvSize, 1, f);
+  unsigned short *indices = (unsigned short *)calloc(idxSize, 1);
+  for (unsigned int i = 0; i < 3*g->nFaces; ++i) indices[i] = g->faces[i];
+  fwrite(indices, idxSize, 1, f);
+  free(indices);
+  return !fclose(f);
+}
+
+/** Builds the grid as a mesh with MESH_MAX_MORPH_TARGETS morph targets
+ * and a skin of MESH_MAX_BONES bones chained along y, playing a 2s clip.
+ * The animation streams are kept in animatedStreams.
+ */
+static MSVMesh *
+makeAnimatedMesh(const Grid *g)
+{
+  MSVMesh *m = new MSVMesh(g->nVertices, g->vertices, g->normals,
+                           g->texCoords, g->nFaces, g->faces);
+  unsigned int nv = g->nVertices;
+  AnimatedStreams *a = &animatedStreams;
+  a->deltas = (float *)calloc(MESH_MAX_MORPH_TARGETS*3*nv, sizeof(float));
+  for (int k = 0; k < MESH_MAX_MORPH_TARGETS; ++k) {
+    float *d = a->deltas + 3*nv*k;
+    for (unsigned int i = 0; i < nv; ++i)
+      d[3*i+2] = 0.1f*(k+1)*g->vertices[3*i];
+    m->addMorphTarget(d);
+  }
+
+  int parents[MESH_MAX_BONES];
+  float rest[BONE_POSE_SIZE*MESH_MAX_BONES];
+  float inverseBind[16*MESH_MAX_BONES];
+  float step = 2.0f/MESH_MAX_BONES;
+  for (int b = 0; b < MESH_MAX_BONES; ++b) {
+    parents[b] = b - 1;
+    float pose[BONE_POSE_SIZE] = {0, b ? step : -1.0f, 0, 0, 0, 0, 1, 1, 1, 1};
+    memcpy(rest + BONE_POSE_SIZE*b, pose, sizeof(pose));
+    float ib[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 1.0f - b*step, 0, 1};
+    memcpy(inverseBind + 16*b, ib, sizeof(ib));
+  }
+  a->indices = (float *)calloc(MESH_BONE_INFLUENCES*nv, sizeof(float));
+  a->weights = (float *)calloc(MESH_BONE_INFLUENCES*nv, sizeof(float));
+  for (unsigned int i = 0; i < nv; ++i) {
+    int b = (int)((g->vertices[3*i+1] + 1.0f)/step);
+    if (b >= MESH_MAX_BONES) b = MESH_MAX_BONES - 1;
+    float *bi = a->indices + MESH_BONE_INFLUENCES*i;
+    float *bw = a->weights + MESH_BONE_INFLUENCES*i;
+    bi[0] = b;
+    bi[1] = (b + 1 < MESH_MAX_BONES) ? b + 1 : b;
+    bw[0] = bw[1] = 0.5f;
+  }
+  m->setSkin(MESH_MAX_BONES, parents, rest, inverseBind, a->indices, a->weights);
+
+  MSVAnimation *clip = new MSVAnimation(2.0f);
+  float times[3] = {0, 1, 2};
+  float morphWeights[3*MESH_MAX_MORPH_TARGETS] = {0, 0, 0, 1, 0.5f, 0.25f, 0, 0, 0};
+  clip->setMorphTrack(3, times, morphWeights);
+  float s = sinf(0.05f), c = cosf(0.05f);
+  for (int b = 0; b < MESH_MAX_BONES; ++b) {
+    float poses[3*BONE_POSE_SIZE];
+    for (int k = 0; k < 3; ++k) {
+      float sign = (k == 1) ? 1.0f : -1.0f;
+      float pose[BONE_POSE_SIZE] = {0, b ? step : -1.0f, 0, 0, 0, sign*s, c, 1, 1, 1};
+      memcpy(poses + BONE_POSE_SIZE*k, pose, sizeof(pose));
+    }
+    clip->setBoneTrack(b, 3, times, poses);
+  }
+  m->setAnimation(clip);
+  return m;
+}
+
+/** Appends a PNG chunk to `out`, returning its end */
+static unsigned char *
+writeChunk(unsigned char *out, const char *type,
+           const unsigned char *data, unsigned int len)
+{
+  unsigned char *start = out;
+  *out++ = len >> 24; *out++ = len >> 16; *out++ = len >> 8; *out++ = len;
+  memcpy(out, type, 4);
+  if (len) memcpy(out + 4, data, len);
+  out += 4 + len;
+  unsigned long crc = crc32(0, start + 4, 4 + len);
+  *out++ = crc >> 24; *out++ = crc >> 16; *out++ = crc >> 8; *out++ = crc;
+  return out;
+}
+
+/** Encodes RGBA pixels as a PNG image, without row filters */
+static unsigned char *
+makePNG(const unsigned char *pixels, unsigned int size, size_t *pngSize)
+{
+  size_t rawSize = (4*size + 1)*size;
+  unsigned char *raw = (unsigned char *)malloc(rawSize);
+  for (unsigned int y = 0; y < size; ++y) {
+    raw[y*(4*size + 1)] = 0;
+    memcpy(raw + y*(4*size + 1) + 1, pixels + 4*size*y, 4*size);
+  }
+  uLongf zSize = compressBound(rawSize);
+  unsigned char *z = (unsigned char *)malloc(zSize);
+  compress2(z, &zSize, raw, rawSize, 6);
+  free(raw);
+
+  static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+  unsigned char ihdr[13] = {0, 0, (unsigned char)(size >> 8), (unsigned char)size,
+                            0, 0, (unsigned char)(size >> 8), (unsigned char)size,
+                            8, 6, 0, 0, 0};
+  unsigned char *out = (unsigned char *)malloc(8 + 3*12 + sizeof(ihdr) + zSize);
+  memcpy(out, signature, 8);
+  unsigned char *end = writeChunk(out + 8, "IHDR", ihdr, sizeof(ihdr));
+  end = writeChunk(end, "IDAT", z, zSize);
+  end = writeChunk(end, "IEND", NULL, 0);
+  free(z);
+  *pngSize = end - out;
+  return out;
+}
+
+/** Callback counting the state transitions, always asking for the next
+ * frame as the JNI/iOS callbacks do while tracking.
+ */
+class BenchCallback : public MSVCallback {
+  public:
+    BenchCallback() : newTargets(0), lostTargets(0) {}
+    unsigned int newTargets;
+    unsigned int lostTargets;
+
+  protected:
+    void onStatusUpdate() {
+      if (isNewTarget()) newTargets++;
+      if (isTargetLost()) lostTargets++;
+      requireUpdate();
+    }
+    void getFrame(const QCAR::Image *) const {}
+};
+
+static BenchCallback callback;
+
+static void
+setUp()
+{
+  makeGrid(&smallGrid, 16);
+  makeGrid(&largeGrid, 128);
+  // The largest grid MSVMesh can index, as a ~4MB OBJ file
+  makeGrid(&modelGrid, 180);
+  if (!writeOBJ(&modelGrid, mkstemp(objPath))) objPath[0] = '\0';
+  if (!writeGLB(&modelGrid, mkstemp(glbPath))) glbPath[0] = '\0';
+  smallPixels = (unsigned char *)malloc(256*256*4);
+  largePixels = (unsigned char *)malloc(1024*1024*4);
+  for (int i = 0; i < 256*256*4; ++i) smallPixels[i] = i;
+  for (int i = 0; i < 1024*1024*4; ++i) largePixels[i] = i;
+  videoPixels = (unsigned char *)malloc(640*480*4);
+  fillView = (unsigned char *)calloc(FILL_WIDTH*FILL_HEIGHT, 4);
+  fillOverlay = (unsigned char *)malloc(FILL_WIDTH*FILL_HEIGHT*4);
+  png = makePNG(largePixels, 1024, &pngSize);
+  animatedMesh = makeAnimatedMesh(&largeGrid);
+  animatedVertices = (float *)malloc(3*largeGrid.nVertices*sizeof(float));
+  animatedNormals = (float *)malloc(3*largeGrid.nVertices*sizeof(float));
+  // ~100k faces, made wavy so that the tree is not flat
+  makeGrid(&hitGrid, 224);
+  for (unsigned int i = 0; i < hitGrid.nVertices; ++i) {
+    float *v = hitGrid.vertices + 3*i;
+    v[2] = 0.2f*sinf(8*v[0])*cosf(6*v[1]);
+  }
+  hitMesh = new MSVMesh(hitGrid.nVertices, hitGrid.vertices, hitGrid.normals,
+                        hitGrid.texCoords, hitGrid.nFaces, hitGrid.faces);
+  hitMesh->getBVH();
+  srand(1);
+  for (int i = 0; i < HIT_RAYS; ++i) {
+    float *o = hitRays[i][0];
+    float *d = hitRays[i][1];
+    o[0] = 2.0f*rand()/RAND_MAX - 1;
+    o[1] = 2.0f*rand()/RAND_MAX - 1;
+    o[2] = 2;
+    d[0] = 0.4f*rand()/RAND_MAX - 0.2f;
+    d[1] = 0.4f*rand()/RAND_MAX - 0.2f;
+    d[2] = -1;
+  }
+
+  for (int i = 0; i < 16; ++i) {
+    matA[i] = 0.5f + i;
+    matB[i] = 1.0f/(1 + i);
+  }
+
+  MSVSimulatedBackend *backend =
+    new MSVSimulatedBackend(640, 480, 30, MAX_FRAME_RESULTS);
+  backend->getGroundTruth(0, 0, pose);
+  MSVController::setBackend(backend);
+  MSVController::init();
+  MSVController::registerCallback(&callback);
+  tracker = MSVController::getTracker();
+
+  // Worst case lookup: the tracked target is the last result
+  foundFrame.resultCount = MAX_FRAME_RESULTS;
+  for (int i = 0; i < MAX_FRAME_RESULTS; ++i) {
+    snprintf(foundFrame.results[i].name, MAX_TRACKABLE_NAME, "target%d", i);
+    memcpy(foundFrame.results[i].pose, pose, 12*sizeof(float));
+  }
+}
+
+static void
+tearDown()
+{
+  MSVController::stopTracking();
+  MSVController::unregisterCallback();
+  MSVController::deInit();
+  free(smallPixels);
+  free(largePixels);
+  free(videoPixels);
+  free(fillView);
+  free(fillOverlay);
+  free(png);
+  animatedMesh->release();
+  free(animatedVertices);
+  free(animatedNormals);
+  free(animatedStreams.deltas);
+  free(animatedStreams.indices);
+  free(animatedStreams.weights);
+  freeGrid(&smallGrid);
+  freeGrid(&largeGrid);
+  freeGrid(&modelGrid);
+  freeGrid(&hitGrid);
+  hitMesh->release();
+  if (objPath[0]) unlink(objPath);
+  if (glbPath[0]) unlink(glbPath);
+}
+
+/* Benchmarks */
+
+static void
+meshSet(const Grid *g, unsigned int n)
+{
+  for (unsigned int i = 0; i < n; ++i) {
+    MSVMesh *m = new MSVMesh(g->nVertices, g->vertices, g->normals,
+                             g->texCoords, g->nFaces, g->faces);
+    sink = m->getVertices()[0];
+    m->release();
+  }
+}
+
+static void benchMeshSetSmall(unsigned int n) { meshSet(&smallGrid, n); }
+static void benchMeshSetLarge(unsigned int n) { meshSet(&largeGrid, n); }
+
+static void
+textureSet(unsigned char *pixels, unsigned int size, unsigned int n)
+{
+  for (unsigned int i = 0; i < n; ++i) {
+    MSVTexture *t = new MSVTexture(pixels, size, size, 4);
+    sink = t->getPixels()[0];
+    t->release();
+  }
+}
+
+static void benchTextureSet256(unsigned int n) { textureSet(smallPixels, 256, n); }
+static void benchTextureSet1024(unsigned int n) { textureSet(largePixels, 1024, n); }
+
+static void
+benchTexturePremultiply640x480(unsigned int n)
+{
+  for (unsigned int i = 0; i < n; ++i)
+    MSVImageDecoder::premultiply(videoPixels, 640*480);
+  sink = videoPixels[0];
+}
+
+static void
+benchTextureDecodePNG1024(unsigned int n)
+{
+  for (unsigned int i = 0; i < n; ++i) {
+    MSVTexture *t = MSVTexture::decode(png, pngSize);
+    sink = t->getPixels()[0];
+    t->release();
+  }
+}
+
+/** Per frame CPU work of an animated mesh: the clip is sampled into the
+ * shader uniforms.
+ */
+static void
+benchAnimationPose(unsigned int n)
+{
+  float weights[MESH_MAX_MORPH_TARGETS];
+  float palette[12*MESH_MAX_BONES];
+  for (unsigned int i = 0; i < n; ++i) {
+    animatedMesh->pose(0.016f*i, weights, palette);
+    sink = palette[0];
+  }
+}
+
+/** Same animation without GPU support: the vertices are blended and skinned
+ * on the CPU, and a new mesh is built and interned as setStaticModel does.
+ */
+static void
+benchAnimationRebuild(unsigned int n)
+{
+  const Grid *g = &largeGrid;
+  const AnimatedStreams *a = &animatedStreams;
+  size_t nv = g->nVertices;
+  float weights[MESH_MAX_MORPH_TARGETS];
+  float palette[12*MESH_MAX_BONES];
+  for (unsigned int f = 0; f < n; ++f) {
+    animatedMesh->pose(0.016f*f, weights, palette);
+    for (size_t i = 0; i < nv; ++i) {
+      float p[4] = {g->vertices[3*i], g->vertices[3*i+1], g->vertices[3*i+2], 1};
+      for (int k = 0; k < MESH_MAX_MORPH_TARGETS; ++k)
+        for (int c = 0; c < 3; ++c) p[c] += weights[k]*a->deltas[3*(nv*k + i) + c];
+      float r[12] = {0};
+      for (int j = 0; j < MESH_BONE_INFLUENCES; ++j) {
+        const float *m = palette + 12*(int)a->indices[MESH_BONE_INFLUENCES*i+j];
+        float w = a->weights[MESH_BONE_INFLUENCES*i+j];
+        for (int c = 0; c < 12; ++c) r[c] += w*m[c];
+      }
+      const float *nrm = g->normals + 3*i;
+      for (int c = 0; c < 3; ++c) {
+        animatedVertices[3*i+c] = r[4*c]*p[0] + r[4*c+1]*p[1] + r[4*c+2]*p[2] + r[4*c+3];
+        animatedNormals[3*i+c] = r[4*c]*nrm[0] + r[4*c+1]*nrm[1] + r[4*c+2]*nrm[2];
+      }
+    }
+    MSVMesh *m = new MSVMesh(g->nVertices, animatedVertices, animatedNormals,
+                             g->texCoords, g->nFaces, g->faces);
+    m = static_cast<MSVMesh *>(MSVAsset::intern(m));
+    sink = m->getVertices()[0];
+    m->release();
+  }
+}
+
+static void
+modelLoad(const char *path, int threads, unsigned int n)
+{
+  MSVModelLoader::setThreadCount(threads);
+  for (unsigned int i = 0; i < n; ++i) {
+    MSVModelLoader::Model m;
+    if (!MSVModelLoader::load(path, &m)) continue;
+    sink = m.vertices[0];
+    MSVModelLoader::freeModel(&m);
+  }
+  MSVModelLoader::setThreadCount(0);
+}
+
+static void benchModelLoadOBJ(unsigned int n) { modelLoad(objPath, 0, n); }
+static void benchModelLoadOBJSerial(unsigned int n) { modelLoad(objPath, 1, n); }
+static void benchModelLoadGLB(unsigned int n) { modelLoad(glbPath, 0, n); }
+
+/** A 64 parts model using 4 textures, as setModel builds it: the parts are
+ * merged into 4 batches.
+ */
+static void
+benchModelBuild64Parts(unsigned int n)
+{
+  const Grid *g = &smallGrid;
+  for (unsigned int i = 0; i < n; ++i) {
+    MSVModel *model = new MSVModel();
+    for (int p = 0; p < 64; ++p) {
+      MSVMesh *mesh = new MSVMesh(g->nVertices, g->vertices, g->normals,
+                                  g->texCoords, g->nFaces, g->faces);
+      MSVTexture *tex = new MSVTexture(smallPixels + 64*(p % 4), 4, 4, 4);
+      float transform[16] = {1, 0, 0, 0,
+                             0, 1, 0, 0,
+                             0, 0, 1, 0,
+                             (float)(p % 8), (float)(p / 8), 0, 1};
+      model->addPart(mesh, tex, transform);
+    }
+    model->build();
+    sink = model->getPartsCount();
+    model->release();
+  }
+}
+
+static void
+benchBVHBuild100k(unsigned int n)
+{
+  const Grid *g = &hitGrid;
+  for (unsigned int i = 0; i < n; ++i) {
+    MSVBVH bvh(g->vertices, g->nFaces, g->faces);
+    sink = bvh.getNodesCount();
+  }
+}
+
+/** Ray cast through a ~100k faces mesh, about half of the rays hitting */
+static void
+benchBVHHitTest100k(unsigned int n)
+{
+  const MSVBVH *bvh = hitMesh->getBVH();
+  unsigned int hits = 0;
+  for (unsigned int i = 0; i < n; ++i) {
+    const float (*ray)[3] = hitRays[i % HIT_RAYS];
+    MSVBVH::Hit hit;
+    hits += bvh->intersect(ray[0], ray[1], 1, FLT_MAX, &hit);
+  }
+  sink = hits;
+}
+
+/** Converts a 640x480 I420 frame, whose planes are read from largePixels */
+static void
+benchVideoConvertI420(unsigned int n)
+{
+  const unsigned char *y = largePixels;
+  const unsigned char *u = y + 640*480;
+  const unsigned char *v = u + 320*240;
+  for (unsigned int i = 0; i < n; ++i)
+    MSVVideoSource::convertI420(y, u, v, 640, 480, videoPixels);
+  sink = videoPixels[0];
+}
+
+static void
+benchMultiplyMatrix(unsigned int n)
+{
+  for (unsigned int i = 0; i < n; ++i)
+    MSVRenderer::multiplyMatrix(matA, matB, matC);
+  sink = matC[0];
+}
+
+static void
+benchScalePoseMatrix(unsigned int n)
+{
+  // Alternate the scales to keep the values bounded
+  for (unsigned int i = 0; i < n; ++i)
+    MSVRenderer::scalePoseMatrix((i & 1) ? 2.0f : 0.5f, 1.0f, 1.0f, matC);
+  sink = matC[0];
+}
+
+static void
+benchPoseToGLMatrix(unsigned int n)
+{
+  for (unsigned int i = 0; i < n; ++i)
+    MSVRenderer::poseToGLMatrix(pose, matC);
+  sink = matC[0];
+}
+
+/** Per part culling cost: sphere and box tests of a visible mesh */
+static void
+benchCullMesh(unsigned int n)
+{
+  float center[3], radius, min[3], max[3];
+  animatedMesh->getBoundingSphere(center, &radius);
+  animatedMesh->getBounds(min, max);
+  unsigned int visible = 0;
+  for (unsigned int i = 0; i < n; ++i) {
+    visible += MSVRenderer::isSphereVisible(matA, center, radius) &&
+               MSVRenderer::isBoxVisible(matA, min, max);
+  }
+  sink = visible;
+}
+
+/* Fill rate model of the overlay: OpenGL calls are stubbed out on the host,
+ * so the fragments are processed on the CPU instead. Each fragment of the
+ * model fetches its mipmapped texture trilinearly and is blended into the
+ * target; the upscale composite then fetches the overlay bilinearly for each
+ * pixel of the view. The model covers the whole view, the worst case for
+ * the composite. Only the relative costs are meaningful.
+ */
+
+/** Bilinear fetch in an RGBA image, at 16.16 fixed-point coordinates */
+static inline void
+fetchBilinear(const unsigned char *image,
+              int width,
+              int height,
+              unsigned int fx,
+              unsigned int fy,
+              unsigned int rgba[4])
+{
+  int x0 = fx >> 16;
+  int y0 = fy >> 16;
+  int x1 = x0 + 1 < width ? x0 + 1 : x0;
+  int y1 = y0 + 1 < height ? y0 + 1 : y0;
+  unsigned int ax = (fx >> 8) & 0xff;
+  unsigned int ay = (fy >> 8) & 0xff;
+  const unsigned char *p00 = image + 4*(y0*width + x0);
+  const unsigned char *p10 = image + 4*(y0*width + x1);
+  const unsigned char *p01 = image + 4*(y1*width + x0);
+  const unsigned char *p11 = image + 4*(y1*width + x1);
+  for (int c = 0; c < 4; ++c) {
+    unsigned int top = p00[c]*(256 - ax) + p10[c]*ax;
+    unsigned int bottom = p01[c]*(256 - ax) + p11[c]*ax;
+    rgba[c] = (top*(256 - ay) + bottom*ay) >> 16;
+  }
+}
+
+/** Shades FILL_LAYERS layers of a model textured with largePixels into a
+ * `width` x `height` RGBA target
+ */
+static void
+shadeOverlay(unsigned char *target, int width, int height)
+{
+  unsigned int dx = (1023u << 16)/width;
+  unsigned int dy = (1023u << 16)/height;
+  for (int layer = 0; layer < FILL_LAYERS; ++layer) {
+    unsigned char *dst = target;
+    for (int y = 0; y < height; ++y) {
+      for (int x = 0; x < width; ++x, dst += 4) {
+        // GL_LINEAR_MIPMAP_LINEAR, between 2 levels
+        unsigned int src[4], next[4];
+        fetchBilinear(largePixels, 1024, 1024, x*dx, y*dy, src);
+        fetchBilinear(largePixels, 512, 512, x*dx >> 1, y*dy >> 1, next);
+        for (int c = 0; c < 4; ++c) src[c] = (src[c] + next[c]) >> 1;
+        // GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, and GL_ONE for alpha
+        unsigned int a = src[3];
+        for (int c = 0; c < 3; ++c)
+          dst[c] = (src[c]*a + dst[c]*(255 - a)) >> 8;
+        dst[3] = a + ((dst[3]*(255 - a)) >> 8);
+      }
+    }
+  }
+}
+
+/** Bilinear upscale of the overlay over the view, with premultiplied
+ * alpha
+ */
+static void
+compositeOverlay(int width, int height)
+{
+  unsigned int dx = ((width - 1) << 16)/FILL_WIDTH;
+  unsigned int dy = ((height - 1) << 16)/FILL_HEIGHT;
+  unsigned char *dst = fillView;
+  for (int y = 0; y < FILL_HEIGHT; ++y) {
+    for (int x = 0; x < FILL_WIDTH; ++x, dst += 4) {
+      unsigned int src[4];
+      fetchBilinear(fillOverlay, width, height, x*dx, y*dy, src);
+      // GL_ONE, GL_ONE_MINUS_SRC_ALPHA
+      for (int c = 0; c < 4; ++c)
+        dst[c] = src[c] + ((dst[c]*(255 - src[3])) >> 8);
+    }
+  }
+}
+
+/** Fills a 1280x720 view with the model, straight or through an overlay at
+ * `scale`
+ */
+static void
+overlayFill(float scale, unsigned int n)
+{
+  int width = (int)(scale*FILL_WIDTH + 0.5f);
+  int height = (int)(scale*FILL_HEIGHT + 0.5f);
+  for (unsigned int i = 0; i < n; ++i) {
+    if (scale < 1) {
+      memset(fillOverlay, 0, 4*width*height);
+      shadeOverlay(fillOverlay, width, height);
+      compositeOverlay(width, height);
+    }
+    else {
+      shadeOverlay(fillView, FILL_WIDTH, FILL_HEIGHT);
+    }
+  }
+  sink = fillView[0];
+}
+
+static void benchOverlayFill(unsigned int n) { overlayFill(1, n); }
+static void benchOverlayFill075(unsigned int n) { overlayFill(0.75f, n); }
+static void benchOverlayFill050(unsigned int n) { overlayFill(0.5f, n); }
+
+class BenchConsumer : public MSVFrameCapture::Consumer {
+  public:
+    void frameCaptured(const unsigned char *pixels, int, int, double) {
+      sink = pixels[0];
+    }
+};
+
+/** GL thread side of a captured 640x480 frame: buffer handoff to the
+ * consumer thread, the readback itself being stubbed out
+ */
+static void
+benchCaptureHandoff640x480(unsigned int n)
+{
+  MSVFrameCapture::start(new BenchConsumer());
+  for (unsigned int i = 0; i < n; ++i) {
+    MSVFrameCapture::takeFrame();
+    unsigned char *pixels = MSVFrameCapture::acquireBuffer(640, 480);
+    if (!pixels) continue;
+    pixels[0] = (unsigned char)i;
+    MSVFrameCapture::submit(pixels, i);
+  }
+  MSVFrameCapture::stop();
+}
+
+static void
+benchTrackerHasHit(unsigned int n)
+{
+  unsigned int found = 0;
+  for (unsigned int i = 0; i < n; ++i)
+    found += tracker->has("target4", "bench");
+  sink = found;
+}
+
+static void
+benchTrackerHasMiss(unsigned int n)
+{
+  unsigned int found = 0;
+  for (unsigned int i = 0; i < n; ++i)
+    found += tracker->has("unknown", "bench");
+  sink = found;
+}
+
+static void
+benchFrameFind(unsigned int n)
+{
+  int found = 0;
+  for (unsigned int i = 0; i < n; ++i)
+    found += foundFrame.find("target4");
+  sink = found;
+}
+
+static void
+benchCallbackTracked(unsigned int n)
+{
+  static const int dims[2] = {2, 2};
+  MSVController::startTracking("target4", dims, "bench");
+  for (unsigned int i = 0; i < n; ++i)
+    callback.onFrame(foundFrame);
+  MSVController::stopTracking();
+  MSVEpoch::reclaim();
+}
+
+/** One operation is a full cycle: start tracking, find the target, lose it
+ * after LOST_FRAMES_TOL frames, stop tracking.
+ */
+static void
+benchCallbackCycle(unsigned int n)
+{
+  static const int dims[2] = {2, 2};
+  for (unsigned int i = 0; i < n; ++i) {
+    MSVController::startTracking("target4", dims, "bench");
+    callback.onFrame(foundFrame);
+    callback.onFrame(foundFrame);
+    for (int j = 0; j <= LOST_FRAMES_TOL + 1; ++j)
+      callback.onFrame(emptyFrame);
+    MSVController::stopTracking();
+    callback.onFrame(emptyFrame);
+    MSVEpoch::reclaim();
+  }
+}
+
+static const Bench benches[] = {
+  {"mesh_set_16x16", benchMeshSetSmall},
+  {"mesh_set_128x128", benchMeshSetLarge},
+  {"texture_set_256", benchTextureSet256},
+  {"texture_set_1024", benchTextureSet1024},
+  {"texture_premultiply_640x480", benchTexturePremultiply640x480},
+  {"texture_decode_png_1024", benchTextureDecodePNG1024},
+  {"animation_pose_128x128", benchAnimationPose},
+  {"animation_rebuild_128x128", benchAnimationRebuild},
+  {"model_load_obj_180x180", benchModelLoadOBJ},
+  {"model_load_obj_180x180_serial", benchModelLoadOBJSerial},
+  {"model_load_glb_180x180", benchModelLoadGLB},
+  {"model_build_64_parts", benchModelBuild64Parts},
+  {"mesh_bvh_build_100k", benchBVHBuild100k},
+  {"mesh_hit_test_100k", benchBVHHitTest100k},
+  {"video_convert_i420_640x480", benchVideoConvertI420},
+  {"renderer_multiply_matrix", benchMultiplyMatrix},
+  {"renderer_scale_pose_matrix", benchScalePoseMatrix},
+  {"renderer_pose_to_gl_matrix", benchPoseToGLMatrix},
+  {"renderer_cull_mesh", benchCullMesh},
+  {"overlay_fill_1280x720", benchOverlayFill},
+  {"overlay_fill_1280x720_0.75x", benchOverlayFill075},
+  {"overlay_fill_1280x720_0.5x", benchOverlayFill050},
+  {"capture_handoff_640x480", benchCaptureHandoff640x480},
+  {"tracker_has_hit", benchTrackerHasHit},
+  {"tracker_has_miss", benchTrackerHasMiss},
+  {"frame_find", benchFrameFind},
+  {"callback_tracked_frame", benchCallbackTracked},
+  {"callback_state_cycle", benchCallbackCycle}
+};
+
+#define BENCH_COUNT (int)(sizeof(benches)/sizeof(benches[0]))
+
+/* Runner */
+
+static int
+compareDoubles(const void *a, const void *b)
+{
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+static void
+runBench(const Bench *b, double minTime, BenchResult *res)
+{
+  // Calibrate the number of iterations
+  unsigned int n = 1;
+  double t;
+  for (;;) {
+    double t0 = now();
+    b->run(n);
+    t = now() - t0;
+    if (t >= minTime || n >= BENCH_MAX_ITERATIONS) break;
+    double scale = (t > 0) ? 1.2*minTime/t : 100;
+    if (scale > 100) scale = 100;
+    if (scale < 2) scale = 2;
+    double next = n*scale;
+    n = (next > BENCH_MAX_ITERATIONS) ? BENCH_MAX_ITERATIONS : (unsigned int)next;
+  }
+  double times[BENCH_RUNS];
+  for (int r = 0; r < BENCH_RUNS; ++r) {
+    double t0 = now();
+    b->run(n);
+    times[r] = (now() - t0)*1e9/n;
+  }
+  qsort(times, BENCH_RUNS, sizeof(double), compareDoubles);
+  res->name = b->name;
+  res->iterations = n;
+  res->median = times[BENCH_RUNS/2];
+  res->min = times[0];
+  res->max = times[BENCH_RUNS-1];
+}
+
+static bool
+writeJSON(const char *path, const BenchResult *results, int count)
+{
+  FILE *f = strcmp(path, "-") ? fopen(path, "w") : stdout;
+  if (!f) return false;
+  fprintf(f, "{\n  \"benchmarks\": [\n");
+  for (int i = 0; i < count; ++i) {
+    const BenchResult *r = &results[i];
+    fprintf(f, "    {\"name\": \"%s\", \"iterations\": %u, "
+               "\"ns_per_op\": %.3f, \"min_ns\": %.3f, \"max_ns\": %.3f}%s\n",
+            r->name, r->iterations, r->median, r->min, r->max,
+            (i + 1 < count) ? "," : "");
+  }
+  fprintf(f, "  ]\n}\n");
+  if (f != stdout) fclose(f);
+  return true;
+}
+
+static char *
+readFile(const char *path)
+{
+  FILE *f = fopen(path, "rb");
+  if (!f) return NULL;
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  char *buf = (char *)malloc(size + 1);
+  size_t got = fread(buf, 1, size, f);
+  buf[got] = '\0';
+  fclose(f);
+  return buf;
+}
+
+/** Finds the `ns_per_op` value of a benchmark in a JSON file written by
+ * `writeJSON`. Returns a negative value if not found.
+ */
+static double
+findBaseline(const char *json, const char *name)
+{
+  size_t len = strlen(name);
+  const char *p = json;
+  while ((p = strstr(p, "\"name\"")) != NULL) {
+    p = strchr(p + 6, '"');
+    if (!p) break;
+    ++p;
+    if (!strncmp(p, name, len) && p[len] == '"') {
+      const char *end = strchr(p, '}');
+      const char *v = strstr(p, "\"ns_per_op\"");
+      if (!v || (end && v > end)) return -1;
+      v = strchr(v, ':');
+      return v ? strtod(v + 1, NULL) : -1;
+    }
+  }
+  return -1;
+}
+
+static int
+compare(FILE *out, const char *path,
+        const BenchResult *results, int count, double threshold)
+{
+  char *json = readFile(path);
+  if (!json) {
+    fprintf(stderr, "msvbench: cannot read baseline %s\n", path);
+    return -1;
+  }
+  int regressions = 0;
+  fprintf(out, "\n%-28s %14s %14s %9s\n", "benchmark", "baseline ns", "current ns", "delta");
+  for (int i = 0; i < count; ++i) {
+    const BenchResult *r = &results[i];
+    double base = findBaseline(json, r->name);
+    if (base <= 0) {
+      fprintf(out, "%-28s %14s %14.1f %9s  new\n", r->name, "-", r->median, "-");
+      continue;
+    }
+    double delta = 100.0*(r->median - base)/base;
+    bool regressed = delta > threshold;
+    if (regressed) regressions++;
+    fprintf(out, "%-28s %14.1f %14.1f %+8.1f%%%s\n", r->name, base, r->median,
+           delta, regressed ? "  REGRESSION" : "");
+  }
+  free(json);
+  fprintf(out, "\n%d regression(s) above %.1f%%\n", regressions, threshold);
+  return regressions;
+}
+
+/* Replay */
+
+static bool
+writeReplayJSON(const char *path, const MSVReplay::Stats *s)
+{
+  FILE *f = strcmp(path, "-") ? fopen(path, "w") : stdout;
+  if (!f) return false;
+  fprintf(f, "{\n  \"replay\": {\"frames\": %u, \"renders\": %u, "
+             "\"duration_s\": %.6f, \"update_ms\": %.4f, \"max_update_ms\": %.4f, "
+             "\"render_ms\": %.4f, \"max_render_ms\": %.4f}\n}\n",
+          s->frames, s->renders, s->duration,
+          s->frames ? 1e3*s->updateTime/s->frames : 0, 1e3*s->maxUpdateTime,
+          s->renders ? 1e3*s->renderTime/s->renders : 0, 1e3*s->maxRenderTime);
+  if (f != stdout) fclose(f);
+  return true;
+}
+
+static int
+replaySession(const char *path,
+              const char *track,
+              bool realtime,
+              const char *jsonPath)
+{
+  MSVReplay replay;
+  if (!replay.open(path)) {
+    fprintf(stderr, "msvbench: cannot read recording %s\n", path);
+    return 2;
+  }
+  MSVController::setBackend(new MSVSimulatedBackend(640, 480, 30, MAX_FRAME_RESULTS));
+  MSVController::init();
+  MSVController::registerCallback(&callback);
+  MSVController::initRenderer();
+  MSVState::setGLViewSize(640, 480);
+  int status = 0;
+  if (track) {
+    int dims[2] = {1, 1};
+    float scale[3] = {1, 1, 1};
+    MSVController::startTracking(track, dims, "replay");
+    MSVController::setStaticModel(NULL, NULL, scale);
+    if (!MSVController::isTracking()) {
+      fprintf(stderr, "msvbench: unknown target %s\n", track);
+      status = 2;
+    }
+  }
+  MSVReplay::Stats s;
+  if (!status && !replay.run(&callback, MSVController::getRenderer(), realtime, &s)) {
+    fprintf(stderr, "msvbench: corrupt recording %s\n", path);
+    status = 2;
+  }
+  MSVController::stopTracking();
+  MSVController::unregisterCallback();
+  MSVController::deInit();
+  if (status) return status;
+
+  FILE *out = (jsonPath && !strcmp(jsonPath, "-")) ? stderr : stdout;
+  fprintf(out, "%u frames, %u renders in %.3f s (%.1f frames/s)\n",
+          s.frames, s.renders, s.duration,
+          s.duration > 0 ? s.frames/s.duration : 0);
+  fprintf(out, "update: %.3f ms mean, %.3f ms max\n",
+          s.frames ? 1e3*s.updateTime/s.frames : 0, 1e3*s.maxUpdateTime);
+  fprintf(out, "render: %.3f ms mean, %.3f ms max\n",
+          s.renders ? 1e3*s.renderTime/s.renders : 0, 1e3*s.maxRenderTime);
+  if (jsonPath && !writeReplayJSON(jsonPath, &s)) {
+    fprintf(stderr, "msvbench: cannot write %s\n", jsonPath);
+    return 2;
+  }
+  return 0;
+}
+
+static void
+usage()
+{
+  fprintf(stderr,
+          "usage: msvbench [--filter SUBSTRING] [--min-time SECONDS]\n"
+          "                [--json PATH] [--compare BASELINE.json] [--threshold PCT]\n"
+          "       msvbench --replay RECORDING [--track TARGET] [--realtime] [--json PATH]\n");
+}
+
+int
+main(int argc, char **argv)
+{
+  const char *filter = NULL;
+  const char *jsonPath = NULL;
+  const char *baselinePath = NULL;
+  double minTime = BENCH_DEFAULT_MIN_TIME;
+  double threshold = BENCH_DEFAULT_THRESHOLD;
+  const char *replayPath = NULL;
+  const char *track = NULL;
+  bool realtime = false;
+  for (int i = 1; i < argc; ++i) {
+    bool hasValue = i + 1 < argc;
+    if (!strcmp(argv[i], "--filter") && hasValue) filter = argv[++i];
+    else if (!strcmp(argv[i], "--min-time") && hasValue) minTime = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--json") && hasValue) jsonPath = argv[++i];
+    else if (!strcmp(argv[i], "--compare") && hasValue) baselinePath = argv[++i];
+    else if (!strcmp(argv[i], "--threshold") && hasValue) threshold = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--replay") && hasValue) replayPath = argv[++i];
+    else if (!strcmp(argv[i], "--track") && hasValue) track = argv[++i];
+    else if (!strcmp(argv[i], "--realtime")) realtime = true;
+    else {
+      usage();
+      return 2;
+    }
+  }
+
+  if (replayPath) return replaySession(replayPath, track, realtime, jsonPath);
+
+  setUp();
+  BenchResult results[BENCH_COUNT];
+  int count = 0;
+  // Keep stdout clean when it receives the JSON
+  FILE *out = (jsonPath && !strcmp(jsonPath, "-")) ? stderr : stdout;
+  fprintf(out, "%-28s %12s %14s %14s %14s\n",
+          "benchmark", "iterations", "ns/op", "min ns", "max ns");
+  for (int i = 0; i < BENCH_COUNT; ++i) {
+    if (filter && !strstr(benches[i].name, filter)) continue;
+    BenchResult *r = &results[count++];
+    runBench(&benches[i], minTime, r);
+    fprintf(out, "%-28s %12u %14.1f %14.1f %14.1f\n",
+            r->name, r->iterations, r->median, r->min, r->max);
+  }
+  tearDown();
+
+  if (jsonPath && !writeJSON(jsonPath, results, count)) {
+    fprintf(stderr, "msvbench: cannot write %s\n", jsonPath);
+    return 2;
+  }
+  if (baselinePath) {
+    int regressions = compare(out, baselinePath, results, count, threshold);
+    if (regressions < 0) return 2;
+    if (regressions > 0) return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,8 @@
+/* Host build stub of the OpenGL ES 2.0 extensions header */
+#ifndef __gl2ext_h_
+#define __gl2ext_h_
+
+/* GL_OES_EGL_image_external */
+#define GL_TEXTURE_EXTERNAL_OES           0x8D65
+
+#endif
@@ -0,0 +1,8 @@
+/* Host build stub of the Khronos header */
+#ifndef __gl2platform_h_
+#define __gl2platform_h_
+
+#define GL_APICALL
+#define GL_APIENTRY
+
+#endif
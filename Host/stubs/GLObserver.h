@@ -0,0 +1,35 @@
+/* Observation of the stubbed OpenGL ES calls, for the host tests.
+ *
+ * The stubs of GLStubs.cpp forward the calls below to the installed
+ * observer, if any, on top of their no-op implementation.
+ */
+#ifndef MSV_GLOBSERVER_H
+#define MSV_GLOBSERVER_H
+
+#include <GLES2/gl2.h>
+
+class GLObserver {
+  public:
+    virtual ~GLObserver() {}
+
+    /** glTexImage2D and glTexSubImage2D, with the size of the updated area */
+    virtual void texImage(GLenum target, GLsizei width, GLsizei height,
+                          GLenum format, const GLvoid *pixels) {}
+    /** glCopyTexSubImage2D, with the framebuffer area copied */
+    virtual void copyTexImage(GLint x, GLint y, GLsizei width, GLsizei height) {}
+    /** glBlendFuncSeparate, and glBlendFunc with the same alpha factors */
+    virtual void blendFunc(GLenum srcRGB, GLenum dstRGB,
+                           GLenum srcAlpha, GLenum dstAlpha) {}
+    /** glDrawElements */
+    virtual void drawElements(GLenum mode, GLsizei count) {}
+    virtual void bindBuffer(GLenum target, GLuint buffer) {}
+    virtual void viewport(GLint x, GLint y, GLsizei width, GLsizei height) {}
+    virtual void scissor(GLint x, GLint y, GLsizei width, GLsizei height) {}
+    /** glUniformMatrix4fv, for a single matrix */
+    virtual void uniformMatrix4(GLint location, const GLfloat *matrix) {}
+
+    /** Installs `observer`, or removes the current one if NULL */
+    static void set(GLObserver *observer);
+};
+
+#endif
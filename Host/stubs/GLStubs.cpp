@@ -0,0 +1,187 @@
+/* No-op implementation of the stubbed OpenGL ES 2.0 API. Object names are
+ * handed out from a counter so that the wrapper's bookkeeping (e.g.
+ * MSVResourceManager) sees valid, distinct names. Some calls are also
+ * forwarded to the GLObserver of the tests.
+ */
+#include "GLObserver.h"
+
+static GLuint nextName = 1;
+static GLObserver *observer = NULL;
+static GLint viewport[4] = {0, 0, 0, 0};
+static GLfloat clearColor[4] = {0, 0, 0, 0};
+
+static void
+genNames(GLsizei n, GLuint *names)
+{
+  for (GLsizei i = 0; i < n; ++i) names[i] = __sync_fetch_and_add(&nextName, 1);
+}
+
+void
+GLObserver::set(GLObserver *o)
+{
+  observer = o;
+}
+
+extern "C" {
+
+void glActiveTexture(GLenum) {}
+void glAttachShader(GLuint, GLuint) {}
+void glBindFramebuffer(GLenum, GLuint) {}
+void glBindRenderbuffer(GLenum, GLuint) {}
+void glBindTexture(GLenum, GLuint) {}
+void glBufferData(GLenum, GLsizeiptr, const GLvoid *, GLenum) {}
+void glBufferSubData(GLenum, GLintptr, GLsizeiptr, const GLvoid *) {}
+GLenum glCheckFramebufferStatus(GLenum) { return GL_FRAMEBUFFER_COMPLETE; }
+void glClear(GLbitfield) {}
+void glCompileShader(GLuint) {}
+GLuint glCreateProgram() { GLuint n; genNames(1, &n); return n; }
+GLuint glCreateShader(GLenum) { GLuint n; genNames(1, &n); return n; }
+void glDeleteBuffers(GLsizei, const GLuint *) {}
+void glDeleteFramebuffers(GLsizei, const GLuint *) {}
+void glDeleteProgram(GLuint) {}
+void glDeleteRenderbuffers(GLsizei, const GLuint *) {}
+void glDeleteShader(GLuint) {}
+void glDeleteTextures(GLsizei, const GLuint *) {}
+void glDisable(GLenum) {}
+void glDisableVertexAttribArray(GLuint) {}
+void glDrawArrays(GLenum, GLint, GLsizei) {}
+void glEnable(GLenum) {}
+void glEnableVertexAttribArray(GLuint) {}
+void glFramebufferRenderbuffer(GLenum, GLenum, GLenum, GLuint) {}
+void glFramebufferTexture2D(GLenum, GLenum, GLenum, GLuint, GLint) {}
+void glGenBuffers(GLsizei n, GLuint *buffers) { genNames(n, buffers); }
+void glGenerateMipmap(GLenum) {}
+void glGenFramebuffers(GLsizei n, GLuint *framebuffers) { genNames(n, framebuffers); }
+void glGenRenderbuffers(GLsizei n, GLuint *renderbuffers) { genNames(n, renderbuffers); }
+void glGenTextures(GLsizei n, GLuint *textures) { genNames(n, textures); }
+int glGetAttribLocation(GLuint, const GLchar *) { return 0; }
+void glGetShaderInfoLog(GLuint, GLsizei, GLsizei *length, GLchar *) { if (length) *length = 0; }
+void glGetProgramInfoLog(GLuint, GLsizei, GLsizei *length, GLchar *) { if (length) *length = 0; }
+int glGetUniformLocation(GLuint, const GLchar *) { return 0; }
+void glLinkProgram(GLuint) {}
+void glPixelStorei(GLenum, GLint) {}
+void glReadPixels(GLint, GLint, GLsizei, GLsizei, GLenum, GLenum, GLvoid *) {}
+void glRenderbufferStorage(GLenum, GLenum, GLsizei, GLsizei) {}
+void glShaderSource(GLuint, GLsizei, const GLchar * const *, const GLint *) {}
+void glTexParameteri(GLenum, GLenum, GLint) {}
+void glUniform1f(GLint, GLfloat) {}
+void glUniform1i(GLint, GLint) {}
+void glUniform3fv(GLint, GLsizei, const GLfloat *) {}
+void glUniform4fv(GLint, GLsizei, const GLfloat *) {}
+void glUniformMatrix3fv(GLint, GLsizei, GLboolean, const GLfloat *) {}
+void glUseProgram(GLuint) {}
+void glVertexAttrib3f(GLuint, GLfloat, GLfloat, GLfloat) {}
+void glVertexAttrib4f(GLuint, GLfloat, GLfloat, GLfloat, GLfloat) {}
+void glVertexAttribPointer(GLuint, GLint, GLenum, GLboolean, GLsizei, const GLvoid *) {}
+
+void
+glTexImage2D(GLenum target, GLint, GLint, GLsizei width, GLsizei height,
+             GLint, GLenum format, GLenum, const GLvoid *pixels)
+{
+  if (observer) observer->texImage(target, width, height, format, pixels);
+}
+
+void
+glTexSubImage2D(GLenum target, GLint, GLint, GLint, GLsizei width,
+                GLsizei height, GLenum format, GLenum, const GLvoid *pixels)
+{
+  if (observer) observer->texImage(target, width, height, format, pixels);
+}
+
+void
+glBindBuffer(GLenum target, GLuint buffer)
+{
+  if (observer) observer->bindBuffer(target, buffer);
+}
+
+void
+glBlendFunc(GLenum src, GLenum dst)
+{
+  if (observer) observer->blendFunc(src, dst, src, dst);
+}
+
+void
+glBlendFuncSeparate(GLenum srcRGB, GLenum dstRGB, GLenum srcAlpha, GLenum dstAlpha)
+{
+  if (observer) observer->blendFunc(srcRGB, dstRGB, srcAlpha, dstAlpha);
+}
+
+void
+glDrawElements(GLenum mode, GLsizei count, GLenum, const GLvoid *)
+{
+  if (observer) observer->drawElements(mode, count);
+}
+
+void
+glCopyTexSubImage2D(GLenum, GLint, GLint, GLint, GLint x, GLint y,
+                    GLsizei width, GLsizei height)
+{
+  if (observer) observer->copyTexImage(x, y, width, height);
+}
+
+void
+glScissor(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+  if (observer) observer->scissor(x, y, width, height);
+}
+
+void
+glUniformMatrix4fv(GLint location, GLsizei count, GLboolean, const GLfloat *value)
+{
+  if (observer && count == 1) observer->uniformMatrix4(location, value);
+}
+
+void
+glViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+  viewport[0] = x;
+  viewport[1] = y;
+  viewport[2] = width;
+  viewport[3] = height;
+  if (observer) observer->viewport(x, y, width, height);
+}
+
+void
+glClearColor(GLclampf red, GLclampf green, GLclampf blue, GLclampf alpha)
+{
+  clearColor[0] = red;
+  clearColor[1] = green;
+  clearColor[2] = blue;
+  clearColor[3] = alpha;
+}
+
+void
+glGetFloatv(GLenum pname, GLfloat *params)
+{
+  if (pname == GL_COLOR_CLEAR_VALUE) {
+    for (int i = 0; i < 4; ++i) params[i] = clearColor[i];
+  }
+  else {
+    *params = 0;
+  }
+}
+
+void
+glGetIntegerv(GLenum pname, GLint *params)
+{
+  if (pname == GL_VIEWPORT) {
+    for (int i = 0; i < 4; ++i) params[i] = viewport[i];
+  }
+  else {
+    *params = 0;
+  }
+}
+
+void
+glGetShaderiv(GLuint, GLenum pname, GLint *params)
+{
+  *params = (pname == GL_COMPILE_STATUS) ? GL_TRUE : 0;
+}
+
+void
+glGetProgramiv(GLuint, GLenum pname, GLint *params)
+{
+  *params = (pname == GL_LINK_STATUS) ? GL_TRUE : 0;
+}
+
+}
@@ -0,0 +1,23 @@
+/* Host build stub of the Vuforia SDK header. A host frame never holds any
+ * image: frames are produced by MSVBackend implementations instead.
+ */
+#ifndef _QCAR_FRAME_H_
+#define _QCAR_FRAME_H_
+
+#include <QCAR/Image.h>
+
+namespace QCAR
+{
+
+class Frame
+{
+  public:
+    double getTimeStamp() const;
+    int getIndex() const;
+    int getNumImages() const;
+    const Image* getImage(int idx) const;
+};
+
+} // namespace QCAR
+
+#endif
@@ -0,0 +1,34 @@
+/* Host build stub of the Vuforia SDK header */
+#ifndef _QCAR_IMAGE_H_
+#define _QCAR_IMAGE_H_
+
+namespace QCAR
+{
+
+enum PIXEL_FORMAT
+{
+  UNKNOWN_FORMAT = 0,
+  RGB565 = 1,
+  RGB888 = 2,
+  GRAYSCALE = 4,
+  YUV = 8,
+  RGBA8888 = 16,
+  INDEXED = 32
+};
+
+class Image
+{
+  public:
+    virtual ~Image() {}
+    virtual int getWidth() const = 0;
+    virtual int getHeight() const = 0;
+    virtual int getBufferWidth() const = 0;
+    virtual int getBufferHeight() const = 0;
+    virtual int getStride() const = 0;
+    virtual PIXEL_FORMAT getFormat() const = 0;
+    virtual const void* getPixels() const = 0;
+};
+
+} // namespace QCAR
+
+#endif
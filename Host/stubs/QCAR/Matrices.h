@@ -0,0 +1,22 @@
+/* Host build stub of the Vuforia SDK header */
+#ifndef _QCAR_MATRIX_H_
+#define _QCAR_MATRIX_H_
+
+namespace QCAR
+{
+
+/** 3x4 row-major matrix */
+struct Matrix34F
+{
+  float data[3*4];
+};
+
+/** 4x4 matrix */
+struct Matrix44F
+{
+  float data[4*4];
+};
+
+} // namespace QCAR
+
+#endif
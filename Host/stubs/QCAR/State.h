@@ -0,0 +1,25 @@
+/* Host build stub of the Vuforia SDK header. A host state is always empty. */
+#ifndef _QCAR_STATE_H_
+#define _QCAR_STATE_H_
+
+#include <QCAR/Frame.h>
+
+namespace QCAR
+{
+
+class Trackable;
+class TrackableResult;
+
+class State
+{
+  public:
+    Frame getFrame() const;
+    int getNumTrackables() const;
+    const Trackable* getTrackable(int idx) const;
+    int getNumTrackableResults() const;
+    const TrackableResult* getTrackableResult(int idx) const;
+};
+
+} // namespace QCAR
+
+#endif
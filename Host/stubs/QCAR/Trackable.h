@@ -0,0 +1,18 @@
+/* Host build stub of the Vuforia SDK header */
+#ifndef _QCAR_TRACKABLE_H_
+#define _QCAR_TRACKABLE_H_
+
+namespace QCAR
+{
+
+class Trackable
+{
+  public:
+    virtual ~Trackable() {}
+    virtual int getId() const = 0;
+    virtual const char* getName() const = 0;
+};
+
+} // namespace QCAR
+
+#endif
@@ -0,0 +1,31 @@
+/* Host build stub of the Vuforia SDK header */
+#ifndef _QCAR_TRACKABLERESULT_H_
+#define _QCAR_TRACKABLERESULT_H_
+
+#include <QCAR/Matrices.h>
+#include <QCAR/Trackable.h>
+
+namespace QCAR
+{
+
+class TrackableResult
+{
+  public:
+    enum STATUS
+    {
+      UNKNOWN,
+      UNDEFINED,
+      DETECTED,
+      TRACKED,
+      EXTENDED_TRACKED
+    };
+
+    virtual ~TrackableResult() {}
+    virtual STATUS getStatus() const = 0;
+    virtual const Trackable& getTrackable() const = 0;
+    virtual const Matrix34F& getPose() const = 0;
+};
+
+} // namespace QCAR
+
+#endif
@@ -0,0 +1,19 @@
+/* Host build stub of the Vuforia SDK header */
+#ifndef _QCAR_UPDATECALLBACK_H_
+#define _QCAR_UPDATECALLBACK_H_
+
+namespace QCAR
+{
+
+class State;
+
+class UpdateCallback
+{
+  public:
+    virtual ~UpdateCallback() {}
+    virtual void QCAR_onUpdate(State& state) = 0;
+};
+
+} // namespace QCAR
+
+#endif
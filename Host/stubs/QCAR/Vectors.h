@@ -0,0 +1,26 @@
+/* Host build stub of the Vuforia SDK header: only the subset of the API
+ * used by CommonVuforiaWrapper outside of MSVVuforiaBackend.
+ */
+#ifndef _QCAR_VECTORS_H_
+#define _QCAR_VECTORS_H_
+
+namespace QCAR
+{
+
+struct Vec2F
+{
+  Vec2F() { data[0] = data[1] = 0; }
+  Vec2F(float v0, float v1) { data[0] = v0; data[1] = v1; }
+  float data[2];
+};
+
+struct Vec3F
+{
+  Vec3F() { data[0] = data[1] = data[2] = 0; }
+  Vec3F(float v0, float v1, float v2) { data[0] = v0; data[1] = v1; data[2] = v2; }
+  float data[3];
+};
+
+} // namespace QCAR
+
+#endif
@@ -0,0 +1,22 @@
+/* Implementation of the stubbed QCAR API: states are always empty, since
+ * host frames come from MSVBackend implementations.
+ */
+#include <stddef.h>
+
+#include <QCAR/State.h>
+
+namespace QCAR
+{
+
+double Frame::getTimeStamp() const { return 0; }
+int Frame::getIndex() const { return -1; }
+int Frame::getNumImages() const { return 0; }
+const Image* Frame::getImage(int) const { return NULL; }
+
+Frame State::getFrame() const { return Frame(); }
+int State::getNumTrackables() const { return 0; }
+const Trackable* State::getTrackable(int) const { return NULL; }
+int State::getNumTrackableResults() const { return 0; }
+const TrackableResult* State::getTrackableResult(int) const { return NULL; }
+
+} // namespace QCAR
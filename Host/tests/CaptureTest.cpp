@@ -0,0 +1,91 @@
+/* Frame capture when the video background viewport extends beyond the
+ * surface, as it does in mono when the camera aspect ratio differs from the
+ * view's.
+ *
+ * The whole surface must be captured, and the viewport left as it was.
+ */
+#include "GLObserver.h"
+#include "MSVController.h"
+#include "MSVFrame.h"
+#include "MSVFrameCapture.h"
+#include "MSVRenderer.h"
+#include "MSVSimulatedBackend.h"
+#include "MSVState.h"
+#include "MSVTest.h"
+
+#include <unistd.h>
+
+#define WIDTH   640
+#define HEIGHT  480
+#define FRAMES  2
+
+static volatile int captured = 0;
+static volatile int capturedWidth = 0;
+static volatile int capturedHeight = 0;
+static volatile bool finished = false;
+
+class SizeConsumer : public MSVFrameCapture::Consumer {
+  public:
+    void frameCaptured(const unsigned char *, int width, int height, double) {
+      capturedWidth = width;
+      capturedHeight = height;
+      __sync_fetch_and_add(&captured, 1);
+    }
+    void captureFinished() {
+      finished = true;
+    }
+};
+
+class CopyObserver : public GLObserver {
+  public:
+    GLint rect[4];
+    int copies;
+
+    CopyObserver() : copies(0) {}
+
+    void copyTexImage(GLint x, GLint y, GLsizei width, GLsizei height) {
+      rect[0] = x;
+      rect[1] = y;
+      rect[2] = width;
+      rect[3] = height;
+      copies++;
+    }
+};
+
+int
+main()
+{
+  MSVController::setBackend(new MSVSimulatedBackend(WIDTH, HEIGHT, 30, 1));
+  MSVController::init();
+  MSVController::initRenderer();
+  MSVState::setGLViewSize(WIDTH, HEIGHT);
+  // A 4:3 background fitted to a 4:3 view, then cropped by 25%
+  const GLint background[4] = {-80, -60, WIDTH + 160, HEIGHT + 120};
+  glViewport(background[0], background[1], background[2], background[3]);
+
+  CopyObserver copies;
+  GLObserver::set(&copies);
+  CHECK(MSVFrameCapture::start(new SizeConsumer(), 1, FRAMES));
+  MSVFrame frame;
+  for (int i = 0; i < FRAMES + CAPTURE_LATENCY + 1; ++i) {
+    frame.timestamp = i/30.0;
+    frame.index = i;
+    MSVController::getRenderer()->renderFrame(frame);
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    CHECK(viewport[0] == background[0] && viewport[1] == background[1] &&
+          viewport[2] == background[2] && viewport[3] == background[3]);
+  }
+  GLObserver::set(NULL);
+  for (int i = 0; i < 1000 && !finished; ++i) usleep(1000);
+
+  CHECK(copies.copies == FRAMES);
+  CHECK(copies.rect[0] == 0 && copies.rect[1] == 0 &&
+        copies.rect[2] == WIDTH && copies.rect[3] == HEIGHT);
+  CHECK(finished);
+  CHECK(captured == FRAMES);
+  CHECK(capturedWidth == WIDTH && capturedHeight == HEIGHT);
+
+  MSVController::deInit();
+  return TEST_RESULT();
+}
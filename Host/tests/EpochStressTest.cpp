@@ -0,0 +1,109 @@
+/* Stress test of the target snapshots publication (see MSVEpoch), meant to
+ * run under ThreadSanitizer.
+ *
+ * Writers start and stop tracking and change the model while readers, in
+ * each MSVEpoch slot, dereference the current snapshot, and the render
+ * reader reclaims the retired ones. Any race or use after free is reported
+ * by ThreadSanitizer, which then makes the test fail.
+ */
+#include "MSVController.h"
+#include "MSVEpoch.h"
+#include "MSVMesh.h"
+#include "MSVModel.h"
+#include "MSVSimulatedBackend.h"
+#include "MSVTargetInfo.h"
+#include "MSVTest.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#define WRITER_ITERATIONS 2000
+
+static const int dims[2] = {2, 3};
+static volatile int writersLeft = 2;
+
+struct Reader {
+  MSVEpoch::Reader slot;
+  bool reclaims;
+  unsigned int seen;
+  unsigned int invalid;
+};
+
+static void *
+trackLoop(void *)
+{
+  float scale[3] = {1, 1, 1};
+  for (int i = 0; i < WRITER_ITERATIONS; ++i) {
+    MSVController::startTracking("target0", dims, "bench");
+    MSVController::setStaticModel(NULL, NULL, scale);
+    MSVController::stopTracking();
+  }
+  __sync_fetch_and_sub(&writersLeft, 1);
+  return NULL;
+}
+
+static void *
+modelLoop(void *)
+{
+  for (int i = 0; i < WRITER_ITERATIONS; ++i) {
+    float scale[3] = {1.0f + i, 1, 1};
+    MSVController::setStaticModel(NULL, NULL, scale);
+  }
+  __sync_fetch_and_sub(&writersLeft, 1);
+  return NULL;
+}
+
+static void *
+readLoop(void *arg)
+{
+  Reader *r = (Reader *)arg;
+  while (__sync_fetch_and_add(&writersLeft, 0) > 0) {
+    MSVEpoch::enter(r->slot);
+    const MSVTargetInfo *info = MSVController::getCurrentTarget();
+    if (info) {
+      r->seen++;
+      // Touch everything a reader uses: a freed snapshot would be caught
+      float scale[3];
+      info->getScale(scale);
+      MSVModel *model = info->getModel();
+      if (strcmp(info->getName(), "target0") ||
+          info->getWidth() != dims[0] || info->getHeight() != dims[1] ||
+          !(scale[0] >= 1) ||
+          (model && model->getPartsCount() > 0 &&
+           !model->getPart(0)->mesh->getVerticesCount()))
+        r->invalid++;
+    }
+    MSVEpoch::leave(r->slot);
+    if (r->reclaims) MSVEpoch::reclaim();
+  }
+  return NULL;
+}
+
+int
+main()
+{
+  MSVController::setBackend(new MSVSimulatedBackend(320, 240, 30, 1));
+  MSVController::init();
+
+  Reader readers[3] = {{MSVEpoch::READER_RENDER, true, 0, 0},
+                       {MSVEpoch::READER_UPDATE, false, 0, 0},
+                       {MSVEpoch::READER_HIT_TEST, false, 0, 0}};
+  pthread_t threads[5];
+  for (int i = 0; i < 3; ++i)
+    pthread_create(&threads[i], NULL, readLoop, &readers[i]);
+  pthread_create(&threads[3], NULL, trackLoop, NULL);
+  pthread_create(&threads[4], NULL, modelLoop, NULL);
+  for (int i = 0; i < 5; ++i)
+    pthread_join(threads[i], NULL);
+
+  unsigned int seen = 0;
+  for (int i = 0; i < 3; ++i) {
+    CHECK(readers[i].invalid == 0);
+    seen += readers[i].seen;
+  }
+  // Otherwise nothing was tested
+  CHECK(seen > 0);
+  CHECK(MSVController::getCurrentTarget() == NULL);
+  MSVController::deInit();
+  return TEST_RESULT();
+}
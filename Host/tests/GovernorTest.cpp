@@ -0,0 +1,74 @@
+/* MSVGovernor with camera-paced, on-demand rendering.
+ *
+ * Frames take 2 ms to render and are requested by a 25 fps camera, i.e.
+ * rendered every 40 ms, with the default 1/30 s budget. In on-demand mode
+ * the period is not a GPU stall and the quality must stay at full; in
+ * continuous mode the same period means the swap blocked, and the quality
+ * is stepped down.
+ */
+#include "MSVGovernor.h"
+#include "MSVRedraw.h"
+#include "MSVTest.h"
+
+#include <time.h>
+#include <unistd.h>
+
+class NullListener : public MSVRedraw::Listener {
+  public:
+    void requestRender() {}
+};
+
+static double
+now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/** Renders `frames` frames of `work` seconds of CPU time, one every
+ * `period` seconds.
+ */
+static void
+render(int frames, double work, double period)
+{
+  for (int i = 0; i < frames; ++i) {
+    double start = now();
+    MSVGovernor::beginFrame();
+    while (now() - start < work) {}
+    MSVGovernor::endFrame();
+    double left = period - (now() - start);
+    if (left > 0) usleep((useconds_t)(left*1e6));
+  }
+}
+
+int
+main()
+{
+  MSVGovernor::Change changes[QUALITY_HISTORY];
+
+  MSVRedraw::setListener(new NullListener());
+  MSVGovernor::setEnabled(true);
+  render(40, 0.002, 0.040);
+  CHECK(MSVGovernor::getLevel() == 0);
+  CHECK(MSVGovernor::copyChanges(changes, QUALITY_HISTORY) == 0);
+
+  // Once lowered, the quality comes back up. Scaled down to a 1/120 s
+  // budget, so that the headroom delay is reached sooner.
+  MSVGovernor::setEnabled(true, 1.0f/120);
+  MSVGovernor::setLevel(1);
+  render(150, 0.0005, 0.010);
+  CHECK(MSVGovernor::getLevel() == 0);
+  unsigned int n = MSVGovernor::copyChanges(changes, QUALITY_HISTORY);
+  CHECK(n == 2 && changes[n - 1].reason == MSVGovernor::HEADROOM);
+
+  MSVRedraw::setListener(NULL);
+  MSVGovernor::setEnabled(true);
+  render(20, 0.002, 0.040);
+  CHECK(MSVGovernor::getLevel() > 0);
+  n = MSVGovernor::copyChanges(changes, QUALITY_HISTORY);
+  CHECK(n > 0 && changes[n - 1].reason == MSVGovernor::BUDGET_MISSED);
+
+  MSVGovernor::setEnabled(false);
+  return TEST_RESULT();
+}
@@ -0,0 +1,98 @@
+/* Hit testing a model whose parts are merged by MSVModel::build.
+ *
+ * Three planes side by side, the outer ones sharing a texture and thus
+ * merged into one mesh: hits must still report the parts in the order they
+ * were added, and faces relative to their own mesh.
+ */
+#include "MSVController.h"
+#include "MSVFrame.h"
+#include "MSVMesh.h"
+#include "MSVModel.h"
+#include "MSVRenderer.h"
+#include "MSVSimulatedBackend.h"
+#include "MSVState.h"
+#include "MSVTargetInfo.h"
+#include "MSVTest.h"
+#include "MSVTexture.h"
+
+#include <string.h>
+
+#define WIDTH  640
+#define HEIGHT 480
+#define PARTS  3
+/** Distance between the centers of the 2x2 planes */
+#define SPACING 3.0f
+/** Scale bringing the model within the normalized device coordinates */
+#define SCALE  0.2f
+
+static MSVModel *
+makeModel()
+{
+  static unsigned char shared[4*4*4];
+  static unsigned char own[4*4*4];
+  memset(shared, 0x40, sizeof(shared));
+  memset(own, 0xc0, sizeof(own));
+  MSVModel *model = new MSVModel();
+  for (int i = 0; i < PARTS; ++i) {
+    float transform[16] = {1, 0, 0, 0,
+                           0, 1, 0, 0,
+                           0, 0, 1, 0,
+                           SPACING*(i - 1), 0, 0, 1};
+    model->addPart(NULL, new MSVTexture(i == 1 ? own : shared, 4, 4), transform);
+  }
+  return model;
+}
+
+int
+main()
+{
+  MSVController::setBackend(new MSVSimulatedBackend(WIDTH, HEIGHT, 30, 1));
+  MSVController::init();
+  MSVController::initRenderer();
+  MSVState::setGLViewSize(WIDTH, HEIGHT);
+  glViewport(0, 0, WIDTH, HEIGHT);
+
+  const int dims[2] = {1, 1};
+  const float scale[3] = {SCALE, SCALE, 1};
+  MSVController::startTracking("target0", dims, "hit");
+  MSVModel *model = makeModel();
+  MSVController::setModel(model, scale);
+  const MSVTargetInfo *info = MSVController::getCurrentTarget();
+  CHECK(info && info->getModel()->getPartsCount() == PARTS - 1);
+  unsigned int planeFaces = MSVMesh::getNormalizedPlane()->getFacesCount();
+
+  // Identity pose and projection: the model is seen along -z, scaled
+  MSVFrame frame;
+  frame.resultCount = 1;
+  strcpy(frame.results[0].name, "target0");
+  const float pose[12] = {1, 0, 0, 0,
+                          0, 1, 0, 0,
+                          0, 0, 1, 0};
+  memcpy(frame.results[0].pose, pose, sizeof(pose));
+  for (int k = 0; k < 16; ++k) frame.projection[k] = (k % 5) ? 0 : 1;
+  MSVController::getRenderer()->renderFrame(frame);
+
+  unsigned int hits[PARTS] = {0, 0, 0};
+  for (int x = 0; x < WIDTH; x += 4) {
+    MSVRenderer::Hit hit;
+    if (!MSVController::hitTest(x, HEIGHT/2, &hit)) continue;
+    CHECK(hit.part < PARTS);
+    CHECK(hit.face < planeFaces);
+    if (hit.part >= PARTS) continue;
+    hits[hit.part]++;
+    // The part under the point, and the face of its own plane
+    CHECK(hit.position[0] >= SPACING*((int)hit.part - 1) - 1.01f &&
+          hit.position[0] <= SPACING*((int)hit.part - 1) + 1.01f);
+    const float *faces = MSVMesh::getNormalizedPlane()->getFaces() + 3*hit.face;
+    const float *vertices = MSVMesh::getNormalizedPlane()->getVertices();
+    float u = hit.position[0] - SPACING*((int)hit.part - 1);
+    float p = 0;
+    for (int k = 0; k < 3; ++k) p += hit.barycentric[k]*vertices[3*(int)faces[k]];
+    CHECK(p > u - 1e-3f && p < u + 1e-3f);
+  }
+  for (int i = 0; i < PARTS; ++i) CHECK(hits[i] > 0);
+
+  MSVController::stopTracking();
+  MSVController::deInit();
+  return TEST_RESULT();
+}
@@ -0,0 +1,653 @@
+/* Decoding of PNG and JPEG images generated by the test.
+ *
+ * PNG images cover every color type and bit depth, with and without tRNS.
+ * JPEG images are baseline, in 4:4:4, 4:2:0 or grayscale, with or without
+ * restart intervals: their blocks are flat but for an optional first AC
+ * coefficient, so that the expected pixels are known at any downscaling.
+ * Interlaced PNG, progressive JPEG, and truncated or corrupt images of both
+ * formats must be rejected.
+ */
+#include "MSVImageDecoder.h"
+#include "MSVTest.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#define JPEG_SOF0 0xc0
+#define JPEG_SOF2 0xc2
+#define JPEG_DHT  0xc4
+#define JPEG_SOS  0xda
+/* First AC coefficient of the blocks which have one, and its quantization */
+#define JPEG_AC       31
+#define JPEG_AC_QUANT 8
+
+typedef MSVImageDecoder::Image Image;
+
+/** Returns the pixel (x, y) of a decoded image, from its top left corner */
+static const unsigned char *
+pixel(const Image *img, unsigned int x, unsigned int y)
+{
+  return img->pixels + 4*((size_t)(img->height - 1 - y)*img->width + x);
+}
+
+static bool
+decode(const unsigned char *data, size_t size,
+       unsigned int maxWidth, unsigned int maxHeight, Image *img)
+{
+  return MSVImageDecoder::decode(data, size, maxWidth, maxHeight, img);
+}
+
+/* PNG */
+
+struct PngSpec {
+  unsigned int width;
+  unsigned int height;
+  int depth;
+  int colorType;
+  bool interlaced;
+  /** Filter type of every row, whose samples are left unfiltered */
+  int filter;
+  const unsigned char *plte;
+  unsigned int plteSize;
+  const unsigned char *trns;
+  unsigned int trnsSize;
+};
+
+static const int pngChannels[7] = {1, 0, 3, 1, 2, 0, 4};
+
+/** Appends a PNG chunk to `out`, returning its end */
+static unsigned char *
+writeChunk(unsigned char *out, const char *type,
+           const unsigned char *data, unsigned int len)
+{
+  unsigned char *start = out;
+  *out++ = len >> 24; *out++ = len >> 16; *out++ = len >> 8; *out++ = len;
+  memcpy(out, type, 4);
+  if (len) memcpy(out + 4, data, len);
+  out += 4 + len;
+  unsigned long crc = crc32(0, start + 4, 4 + len);
+  *out++ = crc >> 24; *out++ = crc >> 16; *out++ = crc >> 8; *out++ = crc;
+  return out;
+}
+
+/** Encodes `samples`, `channels` per pixel, as a PNG image */
+static unsigned char *
+makePNG(const PngSpec *spec, const unsigned int *samples, size_t *size)
+{
+  int channels = pngChannels[spec->colorType];
+  size_t rowBytes = ((size_t)spec->width*channels*spec->depth + 7)/8;
+  size_t rawSize = (rowBytes + 1)*spec->height;
+  unsigned char *raw = (unsigned char *)calloc(rawSize, 1);
+  for (unsigned int y = 0; y < spec->height; ++y) {
+    unsigned char *row = raw + y*(rowBytes + 1);
+    row[0] = spec->filter;
+    for (unsigned int i = 0; i < spec->width*channels; ++i) {
+      unsigned int s = samples[y*spec->width*channels + i];
+      if (spec->depth == 16) {
+        row[1 + 2*i] = s >> 8;
+        row[2 + 2*i] = s;
+      }
+      else {
+        unsigned int bit = i*spec->depth;
+        row[1 + bit/8] |= s << (8 - spec->depth - bit % 8);
+      }
+    }
+  }
+  uLongf zSize = compressBound(rawSize);
+  unsigned char *z = (unsigned char *)malloc(zSize);
+  compress2(z, &zSize, raw, rawSize, 6);
+  free(raw);
+
+  static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+  unsigned char ihdr[13] = {0, 0, (unsigned char)(spec->width >> 8), (unsigned char)spec->width,
+                            0, 0, (unsigned char)(spec->height >> 8), (unsigned char)spec->height,
+                            (unsigned char)spec->depth, (unsigned char)spec->colorType,
+                            0, 0, spec->interlaced};
+  unsigned char *out = (unsigned char *)malloc(8 + 5*12 + sizeof(ihdr) + spec->plteSize +
+                                               spec->trnsSize + zSize);
+  memcpy(out, signature, 8);
+  unsigned char *end = writeChunk(out + 8, "IHDR", ihdr, sizeof(ihdr));
+  if (spec->plte) end = writeChunk(end, "PLTE", spec->plte, spec->plteSize);
+  if (spec->trns) end = writeChunk(end, "tRNS", spec->trns, spec->trnsSize);
+  end = writeChunk(end, "IDAT", z, zSize);
+  end = writeChunk(end, "IEND", NULL, 0);
+  free(z);
+  *size = end - out;
+  return out;
+}
+
+/** Decodes `samples` and compares the result to the `expected` RGBA
+ * pixels, premultiplied, top row first
+ */
+static bool
+checkPNG(const PngSpec *spec, const unsigned int *samples, const unsigned char *expected)
+{
+  size_t size;
+  unsigned char *png = makePNG(spec, samples, &size);
+  Image img;
+  bool ok = decode(png, size, 0, 0, &img) &&
+            img.width == spec->width && img.height == spec->height;
+  for (unsigned int y = 0; ok && y < spec->height; ++y) {
+    for (unsigned int x = 0; ok && x < spec->width; ++x)
+      ok = !memcmp(pixel(&img, x, y), expected + 4*(y*spec->width + x), 4);
+  }
+  delete[] img.pixels;
+  free(png);
+  return ok;
+}
+
+static unsigned char
+premultiplied(unsigned int c, unsigned int a)
+{
+  return (c*a + 127)/255;
+}
+
+/* Images of 4x2 pixels: `value` gives the 8-bit sample `c` of the pixel `i`,
+ * which is widened to 16 bits with a low byte the decoder must drop.
+ */
+
+static unsigned int
+widen(unsigned int v, int depth)
+{
+  return depth == 16 ? 256*v + 7 : v;
+}
+
+static unsigned int
+colorValue(int i, int c)
+{
+  return (40*i + 90*c) % 256;
+}
+
+static unsigned int
+alphaValue(int i)
+{
+  return 255 - 30*i;
+}
+
+static bool
+checkGray(int depth, bool transparent)
+{
+  PngSpec spec = {4, 2, depth, 0, false, 0, NULL, 0, NULL, 0};
+  unsigned int samples[8];
+  unsigned char expected[32];
+  unsigned int maxValue = (1u << depth) - 1;
+  for (int i = 0; i < 8; ++i) {
+    samples[i] = depth == 16 ? widen(colorValue(i, 0), 16) : i*maxValue/7;
+    unsigned char g = depth == 16 ? colorValue(i, 0) : samples[i]*255/maxValue;
+    memset(expected + 4*i, g, 3);
+    expected[4*i + 3] = 255;
+  }
+  // The key is compared at full precision
+  unsigned char trns[2] = {(unsigned char)(samples[1] >> 8), (unsigned char)samples[1]};
+  if (transparent) {
+    spec.trns = trns;
+    spec.trnsSize = 2;
+    memset(expected + 4, 0, 4);
+  }
+  return checkPNG(&spec, samples, expected);
+}
+
+static bool
+checkRGB(int depth, bool transparent)
+{
+  PngSpec spec = {4, 2, depth, 2, false, 0, NULL, 0, NULL, 0};
+  unsigned int samples[24];
+  unsigned char expected[32];
+  for (int i = 0; i < 8; ++i) {
+    for (int c = 0; c < 3; ++c) {
+      samples[3*i + c] = widen(colorValue(i, c), depth);
+      expected[4*i + c] = colorValue(i, c);
+    }
+    expected[4*i + 3] = 255;
+  }
+  unsigned char trns[6];
+  for (int c = 0; c < 3; ++c) {
+    trns[2*c] = samples[6 + c] >> 8;
+    trns[2*c + 1] = samples[6 + c];
+  }
+  if (transparent) {
+    spec.trns = trns;
+    spec.trnsSize = 6;
+    memset(expected + 8, 0, 4);
+  }
+  return checkPNG(&spec, samples, expected);
+}
+
+static bool
+checkPalette(int depth)
+{
+  unsigned char plte[3*256];
+  for (int i = 0; i < 256; ++i) {
+    plte[3*i] = 16*i;
+    plte[3*i + 1] = 255 - 16*i;
+    plte[3*i + 2] = 8*i;
+  }
+  static const unsigned char trns[2] = {0, 128};
+  PngSpec spec = {4, 2, depth, 3, false, 0, plte, sizeof(plte), trns, sizeof(trns)};
+  unsigned int samples[8];
+  unsigned char expected[32];
+  for (int i = 0; i < 8; ++i) {
+    samples[i] = i % (1 << depth);
+    unsigned int a = samples[i] < 2 ? trns[samples[i]] : 255;
+    for (int c = 0; c < 3; ++c) expected[4*i + c] = premultiplied(plte[3*samples[i] + c], a);
+    expected[4*i + 3] = a;
+  }
+  return checkPNG(&spec, samples, expected);
+}
+
+static bool
+checkAlpha(int depth, bool color)
+{
+  int channels = color ? 4 : 2;
+  PngSpec spec = {4, 2, depth, color ? 6 : 4, false, 0, NULL, 0, NULL, 0};
+  unsigned int samples[32];
+  unsigned char expected[32];
+  for (int i = 0; i < 8; ++i) {
+    for (int c = 0; c < channels - 1; ++c)
+      samples[channels*i + c] = widen(colorValue(i, c), depth);
+    samples[channels*i + channels - 1] = widen(alphaValue(i), depth);
+    for (int c = 0; c < 3; ++c)
+      expected[4*i + c] = premultiplied(colorValue(i, color ? c : 0), alphaValue(i));
+    expected[4*i + 3] = alphaValue(i);
+  }
+  return checkPNG(&spec, samples, expected);
+}
+
+/** An opaque RGBA image of `size`*`size` pixels */
+static unsigned char *
+makeRGBA(unsigned int size, bool interlaced, int filter, size_t *pngSize)
+{
+  PngSpec spec = {size, size, 8, 6, interlaced, filter, NULL, 0, NULL, 0};
+  unsigned int *samples = (unsigned int *)malloc(4*size*size*sizeof(unsigned int));
+  for (unsigned int i = 0; i < size*size; ++i) {
+    for (int c = 0; c < 3; ++c) samples[4*i + c] = colorValue(i, c);
+    samples[4*i + 3] = 255;
+  }
+  unsigned char *png = makePNG(&spec, samples, pngSize);
+  free(samples);
+  return png;
+}
+
+static bool
+decodes(const unsigned char *data, size_t size)
+{
+  Image img;
+  bool ok = decode(data, size, 0, 0, &img);
+  delete[] img.pixels;
+  return ok;
+}
+
+/* JPEG */
+
+struct JpegSpec {
+  unsigned int width;
+  unsigned int height;
+  /** 1 or 3 */
+  int comps;
+  /** Sampling factors of the luma, the chroma being 1x1 */
+  int h;
+  int v;
+  int restart;
+  int sof;
+  /** Quantization table of the components, only table 0 being defined */
+  int quant;
+  /** Sign of the first AC coefficient of the luma blocks, 0 for none */
+  int ac;
+  /** Value of the block (bx, by) of the component `c` */
+  int (*value)(int c, int bx, int by);
+};
+
+struct BitWriter {
+  unsigned char *p;
+  unsigned int bits;
+  int count;
+};
+
+/* Luminance DC table of the JPEG specification, and an AC table of EOB and
+ * (run 0, size 5) only
+ */
+static const unsigned char dcCounts[16] = {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0};
+static const unsigned char dcValues[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+static const unsigned char acCounts[16] = {0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+static const unsigned char acValues[2] = {0x00, 0x05};
+
+/** Canonical codes of a table whose values are in the order of the codes */
+static void
+makeCodes(const unsigned char *counts, unsigned int *codes, int *sizes)
+{
+  int code = 0, k = 0;
+  for (int len = 1; len <= 16; ++len, code <<= 1) {
+    for (int i = 0; i < counts[len - 1]; ++i, ++k, ++code) {
+      codes[k] = code;
+      sizes[k] = len;
+    }
+  }
+}
+
+static void
+putBits(BitWriter *w, unsigned int v, int n)
+{
+  for (int i = n - 1; i >= 0; --i) {
+    w->bits = (w->bits << 1) | ((v >> i) & 1);
+    if (++w->count == 8) {
+      *w->p++ = w->bits;
+      // Byte stuffing
+      if (w->bits == 0xff) *w->p++ = 0;
+      w->bits = 0;
+      w->count = 0;
+    }
+  }
+}
+
+static void
+flushBits(BitWriter *w)
+{
+  while (w->count) putBits(w, 1, 1);
+}
+
+static void
+putBlock(BitWriter *w, int *pred, int value, int ac)
+{
+  unsigned int dcCodes[12], acCodes[2];
+  int dcSizes[12], acSizes[2];
+  makeCodes(dcCounts, dcCodes, dcSizes);
+  makeCodes(acCounts, acCodes, acSizes);
+  // A flat block of `value`, with unit quantization
+  int dc = 8*(value - 128);
+  int diff = dc - *pred;
+  *pred = dc;
+  int s = 0;
+  while (abs(diff) >> s) s++;
+  putBits(w, dcCodes[s], dcSizes[s]);
+  if (s) putBits(w, diff < 0 ? diff + (1 << s) - 1 : diff, s);
+  if (ac) {
+    putBits(w, acCodes[1], acSizes[1]);
+    putBits(w, ac > 0 ? JPEG_AC : 0, 5);
+  }
+  putBits(w, acCodes[0], acSizes[0]);
+}
+
+static unsigned char *
+putSegment(unsigned char *p, int marker, const unsigned char *data, unsigned int len)
+{
+  *p++ = 0xff;
+  *p++ = marker;
+  *p++ = (len + 2) >> 8;
+  *p++ = len + 2;
+  memcpy(p, data, len);
+  return p + len;
+}
+
+static unsigned char *
+makeJPEG(const JpegSpec *spec, size_t *size)
+{
+  int hMax = spec->comps == 3 ? spec->h : 1;
+  int vMax = spec->comps == 3 ? spec->v : 1;
+  int mcusX = (spec->width + 8*hMax - 1)/(8*hMax);
+  int mcusY = (spec->height + 8*vMax - 1)/(8*vMax);
+  // At most 4 bytes a block, doubled by stuffing, and a restart marker
+  unsigned char *out = (unsigned char *)malloc(1024 + (size_t)mcusX*mcusY*
+                                               (8*(hMax*vMax + 2) + 3));
+  unsigned char *p = out;
+  *p++ = 0xff;
+  *p++ = 0xd8;
+
+  unsigned char dqt[65];
+  dqt[0] = 0;
+  for (int k = 0; k < 64; ++k) dqt[1 + k] = k == 1 ? JPEG_AC_QUANT : 1;
+  p = putSegment(p, 0xdb, dqt, sizeof(dqt));
+
+  unsigned char sof[15] = {8, (unsigned char)(spec->height >> 8), (unsigned char)spec->height,
+                           (unsigned char)(spec->width >> 8), (unsigned char)spec->width,
+                           (unsigned char)spec->comps};
+  for (int c = 0; c < spec->comps; ++c) {
+    sof[6 + 3*c] = c + 1;
+    sof[7 + 3*c] = c ? 0x11 : (hMax << 4) | vMax;
+    sof[8 + 3*c] = spec->quant;
+  }
+  p = putSegment(p, spec->sof, sof, 6 + 3*spec->comps);
+
+  unsigned char dht[17 + 12 + 17 + 2];
+  dht[0] = 0x00;
+  memcpy(dht + 1, dcCounts, 16);
+  memcpy(dht + 17, dcValues, 12);
+  dht[29] = 0x10;
+  memcpy(dht + 30, acCounts, 16);
+  memcpy(dht + 46, acValues, 2);
+  p = putSegment(p, JPEG_DHT, dht, sizeof(dht));
+
+  if (spec->restart) {
+    unsigned char dri[2] = {(unsigned char)(spec->restart >> 8), (unsigned char)spec->restart};
+    p = putSegment(p, 0xdd, dri, 2);
+  }
+
+  unsigned char sos[10] = {(unsigned char)spec->comps};
+  for (int c = 0; c < spec->comps; ++c) {
+    sos[1 + 2*c] = c + 1;
+    sos[2 + 2*c] = 0x00;
+  }
+  sos[1 + 2*spec->comps] = 0;
+  sos[2 + 2*spec->comps] = 63;
+  sos[3 + 2*spec->comps] = 0;
+  p = putSegment(p, JPEG_SOS, sos, 4 + 2*spec->comps);
+
+  BitWriter w = {p, 0, 0};
+  int preds[3] = {0, 0, 0};
+  int mcus = 0;
+  for (int my = 0; my < mcusY; ++my) {
+    for (int mx = 0; mx < mcusX; ++mx, ++mcus) {
+      if (spec->restart && mcus && !(mcus % spec->restart)) {
+        flushBits(&w);
+        *w.p++ = 0xff;
+        *w.p++ = 0xd0 + (mcus/spec->restart - 1) % 8;
+        preds[0] = preds[1] = preds[2] = 0;
+      }
+      for (int c = 0; c < spec->comps; ++c) {
+        int h = c ? 1 : hMax;
+        int v = c ? 1 : vMax;
+        for (int by = 0; by < v; ++by) {
+          for (int bx = 0; bx < h; ++bx)
+            putBlock(&w, &preds[c], spec->value(c, mx*h + bx, my*v + by), c ? 0 : spec->ac);
+        }
+      }
+    }
+  }
+  flushBits(&w);
+  p = w.p;
+  *p++ = 0xff;
+  *p++ = 0xd9;
+  *size = p - out;
+  return out;
+}
+
+/** Returns the offset of the first `marker` of a JPEG image */
+static size_t
+findMarker(const unsigned char *data, size_t size, int marker)
+{
+  for (size_t i = 2; i + 1 < size; ++i) {
+    if (data[i] == 0xff && data[i + 1] == marker) return i;
+  }
+  return 0;
+}
+
+/** Returns the offset of the entropy-coded data of a JPEG image */
+static size_t
+scanStart(const unsigned char *data, size_t size)
+{
+  size_t sos = findMarker(data, size, JPEG_SOS);
+  return sos + 2 + ((data[sos + 2] << 8) | data[sos + 3]);
+}
+
+static int
+gradient(int c, int bx, int by)
+{
+  if (c == 1) return 128 - 30*((bx + by) % 3);
+  if (c == 2) return 128 + 35*((bx + 2*by) % 3);
+  return (20 + 23*bx + 37*by) % 256;
+}
+
+static int
+flat(int, int, int)
+{
+  return 128;
+}
+
+/** Decodes an image of flat blocks, which must be `outWidth`*`outHeight`
+ * pixels, and compares it to the BT.601 conversion of its blocks
+ */
+static bool
+checkJPEG(const JpegSpec *spec, unsigned int maxWidth, unsigned int maxHeight,
+          unsigned int outWidth, unsigned int outHeight)
+{
+  size_t size;
+  unsigned char *jpeg = makeJPEG(spec, &size);
+  Image img;
+  bool ok = decode(jpeg, size, maxWidth, maxHeight, &img) &&
+            img.width == outWidth && img.height == outHeight;
+  // Pixels of a block
+  unsigned int n = 8*outWidth/spec->width;
+  for (unsigned int y = 0; ok && y < outHeight; ++y) {
+    for (unsigned int x = 0; ok && x < outWidth; ++x) {
+      double l = spec->value(0, x/n, y/n);
+      double b = 0, r = 0;
+      if (spec->comps == 3) {
+        b = spec->value(1, x/(n*spec->h), y/(n*spec->v)) - 128;
+        r = spec->value(2, x/(n*spec->h), y/(n*spec->v)) - 128;
+      }
+      double rgb[3] = {l + 1.402*r, l - 0.344136*b - 0.714136*r, l + 1.772*b};
+      const unsigned char *px = pixel(&img, x, y);
+      for (int c = 0; c < 3; ++c) {
+        double e = rgb[c] < 0 ? 0 : (rgb[c] > 255 ? 255 : rgb[c]);
+        ok = ok && fabs(px[c] - e) <= 1;
+      }
+      ok = ok && px[3] == 255;
+    }
+  }
+  delete[] img.pixels;
+  free(jpeg);
+  return ok;
+}
+
+int
+main()
+{
+  for (int depth = 1; depth <= 16; depth *= 2) CHECK(checkGray(depth, false));
+  CHECK(checkGray(8, true));
+  CHECK(checkGray(16, true));
+  for (int depth = 8; depth <= 16; depth *= 2) {
+    CHECK(checkRGB(depth, false));
+    CHECK(checkRGB(depth, true));
+    CHECK(checkAlpha(depth, false));
+    CHECK(checkAlpha(depth, true));
+  }
+  for (int depth = 1; depth <= 8; depth *= 2) CHECK(checkPalette(depth));
+
+  size_t size;
+  unsigned char *png = makeRGBA(16, false, 0, &size);
+  CHECK(decodes(png, size));
+  int accepted = 0;
+  // Cut before IEND
+  for (size_t cut = 8; cut < size - 12; ++cut) accepted += decodes(png, cut);
+  CHECK(!accepted);
+  // Corrupt zlib header of the IDAT, after the signature and IHDR
+  png[8 + 25 + 8] ^= 0xff;
+  CHECK(!decodes(png, size));
+  free(png);
+  png = makeRGBA(16, true, 0, &size);
+  CHECK(!decodes(png, size));
+  free(png);
+  png = makeRGBA(16, false, 5, &size);
+  CHECK(!decodes(png, size));
+  free(png);
+
+  JpegSpec gray = {16, 16, 1, 1, 1, 0, JPEG_SOF0, 0, 0, gradient};
+  JpegSpec color444 = {32, 16, 3, 1, 1, 0, JPEG_SOF0, 0, 0, gradient};
+  JpegSpec color420 = {32, 32, 3, 2, 2, 0, JPEG_SOF0, 0, 0, gradient};
+  CHECK(checkJPEG(&gray, 0, 0, 16, 16));
+  CHECK(checkJPEG(&color444, 0, 0, 32, 16));
+  CHECK(checkJPEG(&color420, 0, 0, 32, 32));
+  gray.restart = 3;
+  color444.restart = 2;
+  color420.restart = 1;
+  CHECK(checkJPEG(&gray, 0, 0, 16, 16));
+  CHECK(checkJPEG(&color444, 0, 0, 32, 16));
+  CHECK(checkJPEG(&color420, 0, 0, 32, 32));
+
+  // Downscaled by the smallest factor that fits, up to 8
+  JpegSpec large = {64, 32, 3, 2, 2, 3, JPEG_SOF0, 0, 0, gradient};
+  CHECK(checkJPEG(&large, 64, 64, 64, 32));
+  CHECK(checkJPEG(&large, 32, 0, 32, 16));
+  CHECK(checkJPEG(&large, 20, 0, 16, 8));
+  CHECK(checkJPEG(&large, 0, 8, 16, 8));
+  CHECK(checkJPEG(&large, 8, 8, 8, 4));
+  CHECK(checkJPEG(&large, 1, 1, 8, 4));
+
+  // A horizontal cosine, kept by the reduced inverse DCTs but for the 1x1
+  JpegSpec ramp = {8, 8, 1, 1, 1, 0, JPEG_SOF0, 0, 1, flat};
+  unsigned char *jpeg = makeJPEG(&ramp, &size);
+  Image img;
+  CHECK(decode(jpeg, size, 0, 0, &img));
+  for (unsigned int y = 0; img.pixels && y < 8; ++y) {
+    CHECK(abs(pixel(&img, 0, y)[0] - 171) <= 1 && abs(pixel(&img, 7, y)[0] - 85) <= 1);
+    CHECK(pixel(&img, 0, y)[0] == pixel(&img, 0, y)[2]);
+  }
+  delete[] img.pixels;
+  CHECK(decode(jpeg, size, 4, 4, &img) && img.width == 4);
+  CHECK(img.pixels && pixel(&img, 0, 0)[0] > 158 && pixel(&img, 3, 3)[0] < 98);
+  delete[] img.pixels;
+  CHECK(decode(jpeg, size, 1, 1, &img) && img.width == 1);
+  CHECK(img.pixels && pixel(&img, 0, 0)[0] == 128);
+  delete[] img.pixels;
+  free(jpeg);
+
+  JpegSpec progressive = {16, 16, 1, 1, 1, 0, JPEG_SOF2, 0, 0, gradient};
+  jpeg = makeJPEG(&progressive, &size);
+  CHECK(!decodes(jpeg, size));
+  free(jpeg);
+  JpegSpec undefined = {16, 16, 1, 1, 1, 0, JPEG_SOF0, 1, 0, gradient};
+  jpeg = makeJPEG(&undefined, &size);
+  CHECK(!decodes(jpeg, size));
+  free(jpeg);
+  JpegSpec wide = {16384, 8, 1, 1, 1, 0, JPEG_SOF0, 0, 0, gradient};
+  jpeg = makeJPEG(&wide, &size);
+  CHECK(decodes(jpeg, size));
+  // Which would be 16384 pixels high, of zeros past the end of the data or
+  // from the EOI marker
+  size_t sof = findMarker(jpeg, size, JPEG_SOF0);
+  jpeg[sof + 5] = 16384 >> 8;
+  jpeg[sof + 6] = 0;
+  CHECK(!decodes(jpeg, size - 2));
+  CHECK(!decodes(jpeg, size));
+  free(jpeg);
+  wide.width = 20000;
+  jpeg = makeJPEG(&wide, &size);
+  CHECK(!decodes(jpeg, size));
+  free(jpeg);
+
+  JpegSpec truncated = {256, 256, 1, 1, 1, 0, JPEG_SOF0, 0, 0, gradient};
+  jpeg = makeJPEG(&truncated, &size);
+  CHECK(decodes(jpeg, size));
+  size_t start = scanStart(jpeg, size);
+  accepted = 0;
+  for (size_t cut = 2; cut < start + (size - 2 - start)/2; ++cut)
+    accepted += decodes(jpeg, cut);
+  CHECK(!accepted);
+  free(jpeg);
+
+  // Entropy-coded data of ones only, which is no code
+  jpeg = makeJPEG(&gray, &size);
+  start = scanStart(jpeg, size);
+  for (size_t i = start; i < size - 2; ++i) jpeg[i] = (i - start) % 2 ? 0 : 0xff;
+  CHECK(!decodes(jpeg, size));
+  free(jpeg);
+  // More codes of 1 bit than there are
+  jpeg = makeJPEG(&gray, &size);
+  jpeg[findMarker(jpeg, size, JPEG_DHT) + 5] = 3;
+  CHECK(!decodes(jpeg, size));
+  free(jpeg);
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,23 @@
+/* Minimal assertions shared by the host tests.
+ *
+ * Each test is an executable registered with `add_test`: failed checks are
+ * reported on stderr, and the exit status is 1 if any check failed.
+ */
+#ifndef MSV_TEST_H
+#define MSV_TEST_H
+
+#include <stdio.h>
+
+static int testFailures = 0;
+
+#define CHECK(cond)                                                        \
+  do {                                                                     \
+    if (!(cond)) {                                                         \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      testFailures++;                                                      \
+    }                                                                      \
+  } while (0)
+
+#define TEST_RESULT() (testFailures ? 1 : 0)
+
+#endif
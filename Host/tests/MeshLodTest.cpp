@@ -0,0 +1,80 @@
+/* Levels of detail of the meshes of a built MSVModel.
+ *
+ * They must be built with the model, off the GL thread, which then only
+ * uploads them, again once evicted. A level that cannot be simplified is
+ * drawn from the full mesh.
+ */
+#include "MSVMesh.h"
+#include "MSVModel.h"
+#include "MSVTest.h"
+
+/** Vertices per side of the grid mesh, finer than MESH_LOD_GRID */
+#define GRID 64
+
+/** A flat grid of `n`*`n` vertices */
+static MSVMesh *
+makeGrid(unsigned int n)
+{
+  float *vertices = new float[3*n*n];
+  float *normals = new float[3*n*n];
+  float *texCoords = new float[2*n*n];
+  for (unsigned int i = 0; i < n*n; ++i) {
+    float x = (float)(i % n)/(n - 1);
+    float y = (float)(i / n)/(n - 1);
+    float v[3] = {2*x - 1, 2*y - 1, 0};
+    for (int k = 0; k < 3; ++k) vertices[3*i + k] = v[k];
+    normals[3*i] = normals[3*i + 1] = 0;
+    normals[3*i + 2] = 1;
+    texCoords[2*i] = x;
+    texCoords[2*i + 1] = y;
+  }
+  unsigned int nFaces = 2*(n - 1)*(n - 1);
+  float *faces = new float[3*nFaces];
+  float *f = faces;
+  for (unsigned int y = 0; y + 1 < n; ++y) {
+    for (unsigned int x = 0; x + 1 < n; ++x) {
+      unsigned int i = y*n + x;
+      f[0] = i; f[1] = i + 1; f[2] = i + n;
+      f[3] = i + 1; f[4] = i + n + 1; f[5] = i + n;
+      f += 6;
+    }
+  }
+  return new MSVMesh(n*n, vertices, normals, texCoords, nFaces, faces);
+}
+
+static MSVMesh *
+buildPart(MSVModel *model, MSVMesh *mesh)
+{
+  model->addPart(mesh, NULL);
+  model->build();
+  return model->getPart(0)->mesh;
+}
+
+int
+main()
+{
+  MSVModel *model = new MSVModel();
+  MSVMesh *mesh = buildPart(model, makeGrid(GRID));
+  unsigned int full = mesh->getFacesCount(0);
+  CHECK(full == 2*(GRID - 1)*(GRID - 1));
+  // Known before any upload
+  CHECK(mesh->getFacesCount(1) > 0 && mesh->getFacesCount(1) < full);
+  CHECK(mesh->getFacesCount(2) > 0 && mesh->getFacesCount(2) < mesh->getFacesCount(1));
+
+  GLuint lod1 = mesh->glIndexBuffer(1);
+  CHECK(lod1 && lod1 != mesh->glIndexBuffer(0));
+  CHECK(mesh->glIndexBuffer(1) == lod1);
+  unsigned int faces1 = mesh->getFacesCount(1);
+  mesh->resourceEvicted(lod1);
+  CHECK(mesh->glIndexBuffer(1) != 0 && mesh->getFacesCount(1) == faces1);
+  model->release();
+
+  // Too coarse to be simplified: the full mesh is drawn at every level
+  model = new MSVModel();
+  mesh = buildPart(model, makeGrid(2));
+  CHECK(mesh->getFacesCount(1) == 2 && mesh->getFacesCount(2) == 2);
+  CHECK(mesh->glIndexBuffer(2) == mesh->glIndexBuffer(0));
+  model->release();
+
+  return TEST_RESULT();
+}
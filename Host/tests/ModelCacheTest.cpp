@@ -0,0 +1,64 @@
+/* Budget of MSVModelCache across tracking sessions.
+ *
+ * The model of the tracked target is kept even beyond the budget, as it is
+ * displayed, but must become evictable once tracking stops.
+ */
+#include "MSVController.h"
+#include "MSVMesh.h"
+#include "MSVModelCache.h"
+#include "MSVSimulatedBackend.h"
+#include "MSVTest.h"
+#include "MSVTexture.h"
+
+#include <string.h>
+
+#define TEXTURE_SIZE 64
+/** Smaller than a single model */
+#define BUDGET       (8*1024)
+
+static const int dims[2] = {1, 1};
+static const float scale[3] = {1, 1, 1};
+
+static void
+trackWithModel(const char *target)
+{
+  static unsigned char pixels[TEXTURE_SIZE*TEXTURE_SIZE*4];
+  memset(pixels, 0xff, sizeof(pixels));
+  MSVController::startTracking(target, dims, "cache");
+  CHECK(MSVController::isTracking());
+  MSVController::setStaticModel(NULL, new MSVTexture(pixels, TEXTURE_SIZE, TEXTURE_SIZE),
+                                scale);
+}
+
+int
+main()
+{
+  MSVController::setBackend(new MSVSimulatedBackend(320, 240, 30, 1));
+  MSVController::init();
+  MSVController::setModelCacheBudget(BUDGET);
+
+  MSVModelCache::Stats stats;
+  trackWithModel("target0");
+  // Displayed: kept even though over budget
+  MSVController::getModelCacheStats(&stats);
+  CHECK(stats.models == 1 && stats.bytes > BUDGET);
+  MSVController::stopTracking();
+  MSVController::getModelCacheStats(&stats);
+  CHECK(stats.models == 0 && stats.bytes <= BUDGET);
+
+  // Same for a model restored from the cache
+  MSVController::setModelCacheBudget(MODEL_CACHE_BUDGET);
+  trackWithModel("target0");
+  MSVController::stopTracking();
+  MSVController::startTracking("target0", dims, "cache");
+  CHECK(MSVController::isModelRestored());
+  MSVController::setModelCacheBudget(BUDGET);
+  MSVController::getModelCacheStats(&stats);
+  CHECK(stats.models == 1);
+  MSVController::stopTracking();
+  MSVController::getModelCacheStats(&stats);
+  CHECK(stats.models == 0 && stats.bytes <= BUDGET);
+
+  MSVController::deInit();
+  return TEST_RESULT();
+}
@@ -0,0 +1,120 @@
+/* Parallel loading of an OBJ file whose chunks lack some elements, and
+ * rejection of out of range OBJ indices and glTF accessors.
+ *
+ * Positions all come first and faces last, without texture coordinates nor
+ * normals: once split between threads, some chunks have no positions, and
+ * none has texture coordinates or normals.
+ */
+#include "MSVModelLoader.h"
+#include "MSVTest.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FACES 20000
+
+static char *
+makeOBJ(size_t *size)
+{
+  char *text = (char *)malloc(64*4*FACES);
+  char *p = text;
+  for (int i = 0; i < 3*FACES; ++i)
+    p += sprintf(p, "v %d.5 %d.25 0.0\n", i % 97, i / 97);
+  for (int i = 0; i < FACES; ++i)
+    p += sprintf(p, "f %d %d %d\n", 3*i + 1, 3*i + 2, 3*i + 3);
+  *size = p - text;
+  return text;
+}
+
+static void
+checkLoad(const char *text, size_t size, int threads)
+{
+  MSVModelLoader::setThreadCount(threads);
+  MSVModelLoader::Model m;
+  CHECK(MSVModelLoader::loadOBJ(text, size, NULL, &m));
+  CHECK(m.nVertices == 3*FACES);
+  CHECK(m.nFaces == FACES);
+  if (m.nVertices == 3*FACES && m.nFaces == FACES) {
+    CHECK(m.vertices[3*(3*FACES - 1)] == (3*FACES - 1) % 97 + 0.5f);
+    CHECK(m.faces[3*FACES - 1] == 3*FACES - 1);
+    // Missing texture coordinates are zeroed, missing normals computed
+    CHECK(m.texCoords[0] == 0 && m.texCoords[1] == 0);
+    CHECK(m.normals[2] == 1 || m.normals[2] == -1);
+  }
+  MSVModelLoader::freeModel(&m);
+}
+
+static bool
+loadOBJ(const char *text)
+{
+  MSVModelLoader::Model m;
+  bool ok = MSVModelLoader::loadOBJ(text, strlen(text), NULL, &m);
+  if (ok) MSVModelLoader::freeModel(&m);
+  return ok;
+}
+
+/** Loads a .glb of one triangle: 3 float positions then 3 ushort indices.
+ * @param count the count of the indices accessor.
+ * @param view the extra members of the indices bufferView.
+ */
+static bool
+loadGLB(const char *count, const char *view)
+{
+  char json[1024];
+  int len = snprintf(json, sizeof(json),
+    "{\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0},\"indices\":1}]}],"
+    "\"accessors\":[{\"bufferView\":0,\"componentType\":5126,\"count\":3,\"type\":\"VEC3\"},"
+    "{\"bufferView\":1,\"componentType\":5123,\"type\":\"SCALAR\",\"count\":%s}],"
+    "\"bufferViews\":[{\"buffer\":0,\"byteLength\":36},"
+    "{\"buffer\":0,\"byteOffset\":36,\"byteLength\":8%s}],"
+    "\"buffers\":[{\"byteLength\":44}]}",
+    count, view);
+  while (len % 4) json[len++] = ' ';
+  const float positions[9] = {0, 0, 0, 1, 0, 0, 0, 1, 0};
+  const uint16_t faces[4] = {0, 1, 2, 0};
+  unsigned char glb[2048];
+  uint32_t header[5] = {0x46546c67, 2, (uint32_t)(20 + len + 8 + 44),
+                        (uint32_t)len, 0x4e4f534a};
+  uint32_t bin[2] = {44, 0x004e4942};
+  size_t size = 0;
+  memcpy(glb, header, sizeof(header)); size += sizeof(header);
+  memcpy(glb + size, json, len); size += len;
+  memcpy(glb + size, bin, sizeof(bin)); size += sizeof(bin);
+  memcpy(glb + size, positions, sizeof(positions)); size += sizeof(positions);
+  memcpy(glb + size, faces, sizeof(faces)); size += sizeof(faces);
+  MSVModelLoader::Model m;
+  bool ok = MSVModelLoader::loadGLB(glb, size, NULL, &m);
+  if (ok) {
+    CHECK(m.nVertices == 3 && m.nFaces == 1);
+    MSVModelLoader::freeModel(&m);
+  }
+  return ok;
+}
+
+int
+main()
+{
+  CHECK(loadOBJ("v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n"));
+  CHECK(!loadOBJ("v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 9999999999\n"));
+  CHECK(!loadOBJ("v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 -9999999999\n"));
+
+  CHECK(loadGLB("3", ""));
+  // Elements beyond the buffer, through an overflowing size
+  CHECK(!loadGLB("1537228672809129303", ""));
+  CHECK(!loadGLB("4294967299", ""));
+  CHECK(!loadGLB("6", ""));
+  // Indices must be tightly packed
+  CHECK(!loadGLB("3", ",\"byteStride\":12"));
+
+  size_t size;
+  char *text = makeOBJ(&size);
+  // Otherwise the file is not split
+  CHECK(size >= 4*LOADER_MIN_CHUNK);
+  checkLoad(text, size, 1);
+  checkLoad(text, size, 4);
+  free(text);
+  MSVModelLoader::setThreadCount(0);
+  return TEST_RESULT();
+}
@@ -0,0 +1,101 @@
+/* Blending of the model parts into the reduced resolution overlay.
+ *
+ * The overlay alpha accumulates the coverage, composited as premultiplied
+ * (see MSVRenderer::beginOverlay): the parts must keep its alpha factors
+ * when binding their textures, or the coverage ends up squared.
+ */
+#include "GLObserver.h"
+#include "MSVController.h"
+#include "MSVFrame.h"
+#include "MSVRenderer.h"
+#include "MSVSimulatedBackend.h"
+#include "MSVState.h"
+#include "MSVTest.h"
+#include "MSVTexture.h"
+
+#include <string.h>
+
+#define WIDTH  640
+#define HEIGHT 480
+
+/** Records the blend factors of each draw call */
+class BlendObserver : public GLObserver {
+  public:
+    GLenum current[4];
+    GLenum drawn[4];
+    int draws;
+
+    BlendObserver() : draws(0) {
+      memset(current, 0, sizeof(current));
+      memset(drawn, 0, sizeof(drawn));
+    }
+
+    void blendFunc(GLenum srcRGB, GLenum dstRGB, GLenum srcAlpha, GLenum dstAlpha) {
+      current[0] = srcRGB;
+      current[1] = dstRGB;
+      current[2] = srcAlpha;
+      current[3] = dstAlpha;
+    }
+
+    void drawElements(GLenum, GLsizei) {
+      memcpy(drawn, current, sizeof(current));
+      draws++;
+    }
+};
+
+static void
+render(BlendObserver *observer)
+{
+  MSVFrame frame;
+  frame.resultCount = 1;
+  strcpy(frame.results[0].name, "target0");
+  const float pose[12] = {1, 0, 0, 0,
+                          0, 1, 0, 0,
+                          0, 0, 1, 0};
+  memcpy(frame.results[0].pose, pose, sizeof(pose));
+  for (int k = 0; k < 16; ++k) frame.projection[k] = (k % 5) ? 0 : 1;
+  GLObserver::set(observer);
+  MSVController::getRenderer()->renderFrame(frame);
+  GLObserver::set(NULL);
+}
+
+int
+main()
+{
+  MSVController::setBackend(new MSVSimulatedBackend(WIDTH, HEIGHT, 30, 1));
+  MSVController::init();
+  MSVController::initRenderer();
+  MSVState::setGLViewSize(WIDTH, HEIGHT);
+  glViewport(0, 0, WIDTH, HEIGHT);
+
+  const int dims[2] = {1, 1};
+  const float scale[3] = {0.5f, 0.5f, 1};
+  unsigned char pixels[4*4*4];
+  memset(pixels, 0x80, sizeof(pixels));
+  MSVController::startTracking("target0", dims, "blend");
+  MSVController::setStaticModel(NULL, new MSVTexture(pixels, 4, 4), scale);
+
+  // Offscreen: colors blended by alpha, alpha accumulated as coverage
+  MSVController::setOverlayScale(0.5f);
+  BlendObserver offscreen;
+  render(&offscreen);
+  CHECK(offscreen.draws > 0);
+  CHECK(offscreen.drawn[0] == GL_SRC_ALPHA &&
+        offscreen.drawn[1] == GL_ONE_MINUS_SRC_ALPHA);
+  CHECK(offscreen.drawn[2] == GL_ONE &&
+        offscreen.drawn[3] == GL_ONE_MINUS_SRC_ALPHA);
+
+  // Into the view: unchanged
+  MSVController::setOverlayScale(1);
+  BlendObserver onscreen;
+  render(&onscreen);
+  CHECK(onscreen.draws > 0);
+  CHECK(onscreen.drawn[0] == GL_SRC_ALPHA &&
+        onscreen.drawn[1] == GL_ONE_MINUS_SRC_ALPHA);
+  CHECK(onscreen.drawn[2] == GL_SRC_ALPHA &&
+        onscreen.drawn[3] == GL_ONE_MINUS_SRC_ALPHA);
+
+  MSVController::stopTracking();
+  MSVController::deInit();
+  return TEST_RESULT();
+}
@@ -0,0 +1,172 @@
+/* Static models whose texture is decoded on the MSVImageDecoder worker.
+ *
+ * The worker is held by a blocking job, so that the pending model is
+ * committed before its texture is decoded: it must only be set once it is,
+ * and be dropped if another model was set, or another tracking session
+ * started, in the meantime.
+ */
+#include "MSVController.h"
+#include "MSVEpoch.h"
+#include "MSVImageDecoder.h"
+#include "MSVModel.h"
+#include "MSVPendingModel.h"
+#include "MSVSimulatedBackend.h"
+#include "MSVTargetInfo.h"
+#include "MSVTest.h"
+#include "MSVTexture.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#define DECODED_SIZE 8
+#define DIRECT_SIZE  4
+
+static const int dims[2] = {1, 1};
+static const float scale[3] = {1, 1, 1};
+static volatile int workerOpen = 0;
+
+static void
+put32(FILE *f, uint32_t v)
+{
+  unsigned char b[4] = {(unsigned char)(v >> 24), (unsigned char)(v >> 16),
+                        (unsigned char)(v >> 8), (unsigned char)v};
+  fwrite(b, 1, 4, f);
+}
+
+static void
+putChunk(FILE *f, const char *type, const unsigned char *data, unsigned int len)
+{
+  put32(f, len);
+  fwrite(type, 1, 4, f);
+  if (len) fwrite(data, 1, len, f);
+  unsigned long crc = crc32(crc32(0, (const Bytef *)type, 4), data, len);
+  put32(f, crc);
+}
+
+/** Writes an opaque white RGBA image of `size`*`size` pixels */
+static bool
+writePNG(const char *path, unsigned int size)
+{
+  FILE *f = fopen(path, "wb");
+  if (!f) return false;
+  size_t rawSize = (4*size + 1)*size;
+  unsigned char *raw = (unsigned char *)malloc(rawSize);
+  memset(raw, 0xff, rawSize);
+  for (unsigned int y = 0; y < size; ++y) raw[y*(4*size + 1)] = 0;
+  uLongf zSize = compressBound(rawSize);
+  unsigned char *z = (unsigned char *)malloc(zSize);
+  compress2(z, &zSize, raw, rawSize, 6);
+  unsigned char ihdr[13] = {0, 0, 0, (unsigned char)size, 0, 0, 0, (unsigned char)size,
+                            8, 6, 0, 0, 0};
+  fwrite("\x89PNG\r\n\x1a\n", 1, 8, f);
+  putChunk(f, "IHDR", ihdr, sizeof(ihdr));
+  putChunk(f, "IDAT", z, zSize);
+  putChunk(f, "IEND", NULL, 0);
+  free(raw);
+  free(z);
+  return !fclose(f);
+}
+
+static void
+waitOpen(void *)
+{
+  while (!__sync_fetch_and_add(&workerOpen, 0)) usleep(1000);
+}
+
+static void
+mark(void *ran)
+{
+  __sync_fetch_and_add((volatile int *)ran, 1);
+}
+
+/** Holds the worker until `release` */
+static void
+hold()
+{
+  workerOpen = 0;
+  MSVImageDecoder::post(waitOpen, NULL);
+}
+
+/** Releases the worker, and waits for the jobs posted so far to run */
+static void
+release()
+{
+  volatile int ran = 0;
+  MSVImageDecoder::post(mark, (void *)&ran);
+  __sync_fetch_and_add(&workerOpen, 1);
+  while (!__sync_fetch_and_add(&ran, 0)) usleep(1000);
+}
+
+static void
+commitFile(const char *path)
+{
+  MSVPendingModel *model = new MSVPendingModel();
+  model->addPart(NULL, NULL, path, TEXTURE_MAX_SIZE);
+  model->commit(scale);
+}
+
+/** Returns the width of the texture of the current model, 0 for the
+ * transparent plane of a target without model
+ */
+static unsigned int
+textureWidth()
+{
+  MSVEpoch::enter(MSVEpoch::READER_HIT_TEST);
+  const MSVTargetInfo *info = MSVController::getCurrentTarget();
+  MSVModel *model = info ? info->getModel() : NULL;
+  unsigned int width = 0;
+  if (model && model->getPartsCount() > 0 &&
+      model->getPart(0)->tex != MSVTexture::getTransparentTexture())
+    width = model->getPart(0)->tex->getWidth();
+  MSVEpoch::leave(MSVEpoch::READER_HIT_TEST);
+  return width;
+}
+
+int
+main()
+{
+  char path[] = "/tmp/msv-pending-XXXXXX";
+  int fd = mkstemp(path);
+  CHECK(fd >= 0);
+  if (fd < 0) return TEST_RESULT();
+  close(fd);
+  CHECK(writePNG(path, DECODED_SIZE));
+
+  MSVController::setBackend(new MSVSimulatedBackend(320, 240, 30, 1));
+  MSVController::init();
+  // No model restored across sessions
+  MSVController::setModelCacheBudget(0);
+  MSVController::startTracking("target0", dims, "pending");
+  CHECK(MSVController::isTracking());
+
+  hold();
+  commitFile(path);
+  CHECK(textureWidth() == 0);
+  release();
+  CHECK(textureWidth() == DECODED_SIZE);
+
+  // Outdated by a model set while decoding
+  static unsigned char pixels[DIRECT_SIZE*DIRECT_SIZE*4];
+  hold();
+  commitFile(path);
+  MSVController::setStaticModel(NULL, new MSVTexture(pixels, DIRECT_SIZE, DIRECT_SIZE),
+                                scale);
+  release();
+  CHECK(textureWidth() == DIRECT_SIZE);
+
+  // Or by another tracking session
+  hold();
+  commitFile(path);
+  MSVController::stopTracking();
+  MSVController::startTracking("target0", dims, "pending");
+  release();
+  CHECK(textureWidth() == 0);
+
+  MSVController::deInit();
+  unlink(path);
+  return TEST_RESULT();
+}
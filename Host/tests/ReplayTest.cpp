@@ -0,0 +1,158 @@
+/* Round trip of a session through MSVRecorder and MSVReplay, and rejection
+ * of corrupt recordings.
+ *
+ * Usage: ReplayTest [PATH]
+ * The recording is left at PATH if given, for `msvbench --replay`.
+ */
+#include "MSVFrame.h"
+#include "MSVRecorder.h"
+#include "MSVReplay.h"
+#include "MSVTest.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define FRAMES 60
+#define WIDTH  160
+#define HEIGHT 120
+
+static void
+makeFrame(int i, MSVImage *image, MSVFrame *frame)
+{
+  image->resize(WIDTH, HEIGHT);
+  unsigned char *p = image->getData();
+  for (int k = 0; k < WIDTH*HEIGHT; ++k) p[k] = (unsigned char)(k*7 + i);
+  frame->timestamp = i/30.0;
+  frame->index = i;
+  frame->image = image;
+  // The target is found in every other frame
+  frame->resultCount = i % 2 ? 0 : 1;
+  strcpy(frame->results[0].name, "target0");
+  float pose[12] = {1, 0, 0, 0.01f*i,
+                    0, -1, 0, 0,
+                    0, 0, -1, 8};
+  memcpy(frame->results[0].pose, pose, sizeof(pose));
+  for (int k = 0; k < 16; ++k) frame->projection[k] = (k % 5) ? 0 : 1;
+}
+
+static bool
+record(const char *path, bool compress)
+{
+  if (!MSVRecorder::start(path, compress)) return false;
+  MSVImage image;
+  MSVFrame frame;
+  for (int i = 0; i < FRAMES; ++i) {
+    makeFrame(i, &image, &frame);
+    MSVRecorder::recordFrame(frame);
+    MSVRecorder::recordRender(frame);
+  }
+  MSVRecorder::stop();
+  return true;
+}
+
+static void
+checkReplay(const char *path)
+{
+  MSVReplay replay;
+  CHECK(replay.open(path));
+  MSVImage image;
+  MSVFrame expected;
+  int frames = 0;
+  int renders = 0;
+  MSVReplay::Record r;
+  while ((r = replay.next()) != MSVReplay::RECORD_NONE) {
+    const MSVFrame &frame = replay.getFrame();
+    makeFrame(frame.index, &image, &expected);
+    CHECK(frame.timestamp == expected.timestamp);
+    CHECK(frame.resultCount == expected.resultCount);
+    if (frame.resultCount)
+      CHECK(!memcmp(frame.results[0].pose, expected.results[0].pose,
+                    sizeof(expected.results[0].pose)));
+    if (r == MSVReplay::RECORD_FRAME) {
+      CHECK(frame.image && frame.image->getWidth() == WIDTH &&
+            frame.image->getHeight() == HEIGHT);
+      if (frame.image)
+        CHECK(!memcmp(frame.image->getPixels(), image.getData(), WIDTH*HEIGHT));
+      CHECK(frame.index == frames);
+      frames++;
+    }
+    else {
+      CHECK(!memcmp(frame.projection, expected.projection, sizeof(expected.projection)));
+      renders++;
+    }
+  }
+  CHECK(frames == FRAMES);
+  CHECK(renders == FRAMES);
+}
+
+/** Writes a single frame record with the given image dimensions and size */
+static void
+writeCorrupt(const char *path, bool compress, int32_t width, int32_t height,
+             uint32_t size)
+{
+  FILE *f = fopen(path, "wb");
+  uint32_t header[3] = {RECORD_MAGIC, RECORD_VERSION,
+                        compress ? (uint32_t)RECORD_COMPRESSED : 0};
+  fwrite(header, sizeof(uint32_t), 3, f);
+  uint32_t type = MSVReplay::RECORD_FRAME;
+  double timestamp = 0;
+  int32_t index = 0;
+  int32_t count = 0;
+  int32_t dims[2] = {width, height};
+  fwrite(&type, sizeof(type), 1, f);
+  fwrite(&timestamp, sizeof(timestamp), 1, f);
+  fwrite(&index, sizeof(index), 1, f);
+  fwrite(&count, sizeof(count), 1, f);
+  fwrite(dims, sizeof(int32_t), 2, f);
+  fwrite(&size, sizeof(size), 1, f);
+  // Garbage payload
+  unsigned char junk[256];
+  memset(junk, 0x5a, sizeof(junk));
+  fwrite(junk, 1, sizeof(junk), f);
+  fclose(f);
+}
+
+static void
+checkCorrupt(const char *path)
+{
+  const int32_t dims[][2] = {{-1, 100}, {100, -1}, {0, 100},
+                             {65536, 65536}, {-65536, -65536}};
+  for (unsigned int i = 0; i < sizeof(dims)/sizeof(dims[0]); ++i) {
+    for (int compress = 0; compress < 2; ++compress) {
+      writeCorrupt(path, compress, dims[i][0], dims[i][1], 256);
+      MSVReplay replay;
+      CHECK(replay.open(path));
+      CHECK(replay.next() == MSVReplay::RECORD_NONE);
+    }
+  }
+  // Compressed size beyond what the image can take
+  writeCorrupt(path, true, 4, 4, 0x7fffffff);
+  MSVReplay replay;
+  CHECK(replay.open(path));
+  CHECK(replay.next() == MSVReplay::RECORD_NONE);
+  // Garbage that does not inflate to the image size
+  writeCorrupt(path, true, 8, 8, 256);
+  CHECK(replay.open(path));
+  CHECK(replay.next() == MSVReplay::RECORD_NONE);
+}
+
+int
+main(int argc, char **argv)
+{
+  char tmp[] = "/tmp/msvreplayXXXXXX";
+  int fd = mkstemp(tmp);
+  if (fd >= 0) close(fd);
+  CHECK(fd >= 0);
+
+  CHECK(record(tmp, false));
+  checkReplay(tmp);
+  CHECK(record(tmp, true));
+  checkReplay(tmp);
+  checkCorrupt(tmp);
+  unlink(tmp);
+
+  if (argc > 1) CHECK(record(argv[1], true));
+  return TEST_RESULT();
+}
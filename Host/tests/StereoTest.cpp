@@ -0,0 +1,164 @@
+/* Single-pass side-by-side stereo against a two-pass reference.
+ *
+ * The reference renders the model once per eye, in mono, with the eye
+ * projection. Each eye of the stereo pass must show that image as seen
+ * through the eye-sized window at the center of the view, moved into its
+ * half: same draw calls and model view projections, viewport translated
+ * accordingly and scissored to the half. Each mesh must only be bound
+ * once for both eyes.
+ */
+#include "GLObserver.h"
+#include "MSVController.h"
+#include "MSVFrame.h"
+#include "MSVModel.h"
+#include "MSVRenderer.h"
+#include "MSVSimulatedBackend.h"
+#include "MSVState.h"
+#include "MSVTest.h"
+#include "MSVTexture.h"
+
+#include <math.h>
+#include <string.h>
+
+#define WIDTH     640
+#define HEIGHT    480
+#define IPD       0.3f
+#define MAX_DRAWS 64
+
+struct Draw {
+  GLint viewport[4];
+  GLint scissor[4];
+  GLfloat mvp[16];
+};
+
+/** Records the state of each draw call */
+class DrawRecorder : public GLObserver {
+  public:
+    Draw draws[MAX_DRAWS];
+    int count;
+    /** Vertex buffers bound */
+    int binds;
+
+    DrawRecorder() : count(0), binds(0) {
+      memset(&current, 0, sizeof(current));
+    }
+
+    void bindBuffer(GLenum target, GLuint buffer) {
+      if (target == GL_ARRAY_BUFFER && buffer) binds++;
+    }
+    void viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+      GLint v[4] = {x, y, width, height};
+      memcpy(current.viewport, v, sizeof(v));
+    }
+    void scissor(GLint x, GLint y, GLsizei width, GLsizei height) {
+      GLint s[4] = {x, y, width, height};
+      memcpy(current.scissor, s, sizeof(s));
+    }
+    void uniformMatrix4(GLint, const GLfloat *matrix) {
+      // The model view projection is the last matrix set before drawing
+      memcpy(current.mvp, matrix, sizeof(current.mvp));
+    }
+    void drawElements(GLenum, GLsizei) {
+      if (count < MAX_DRAWS) draws[count++] = current;
+    }
+
+  private:
+    Draw current;
+};
+
+static MSVFrame frame;
+
+static void
+render(const MSVFrame &f, DrawRecorder *recorder)
+{
+  GLObserver::set(recorder);
+  glViewport(0, 0, WIDTH, HEIGHT);
+  MSVController::getRenderer()->renderFrame(f);
+  GLObserver::set(NULL);
+}
+
+static bool
+sameMatrix(const GLfloat *a, const GLfloat *b)
+{
+  for (int k = 0; k < 16; ++k)
+    if (fabsf(a[k] - b[k]) > 1e-5f) return false;
+  return true;
+}
+
+int
+main()
+{
+  MSVSimulatedBackend *backend = new MSVSimulatedBackend(WIDTH, HEIGHT, 30, 1);
+  MSVController::setBackend(backend);
+  MSVController::init();
+  MSVController::initRenderer();
+  MSVState::setGLViewSize(WIDTH, HEIGHT);
+
+  // Two parts with their own textures, i.e. two meshes
+  const int dims[2] = {2, 2};
+  const float scale[3] = {1, 1, 1};
+  MSVController::startTracking("target0", dims, "stereo");
+  unsigned char pixels[2*2*4];
+  memset(pixels, 0xff, sizeof(pixels));
+  const float transform[16] = {1, 0, 0, 0,
+                               0, 1, 0, 0,
+                               0, 0, 1, 0,
+                               3, 0, 0, 1};
+  MSVModel *model = new MSVModel();
+  model->addPart(NULL, NULL);
+  model->addPart(NULL, new MSVTexture(pixels, 2, 2), transform);
+  MSVController::setModel(model, scale);
+
+  frame.resultCount = 1;
+  strcpy(frame.results[0].name, "target0");
+  const float pose[12] = {1, 0, 0, 0,
+                          0, -1, 0, 0,
+                          0, 0, -1, 8};
+  memcpy(frame.results[0].pose, pose, sizeof(pose));
+  backend->getProjectionMatrix(0.04f, 50.0f, frame.projection);
+  // Uploads happen at the first frame
+  DrawRecorder warmUp;
+  render(frame, &warmUp);
+
+  // Reference: one mono pass per eye, the camera moved by half the IPD
+  DrawRecorder mono[2];
+  for (int e = 0; e < 2; ++e) {
+    MSVFrame eye = frame;
+    float shift = (e ? -0.5f : 0.5f)*IPD;
+    for (int k = 0; k < 4; ++k) eye.projection[12 + k] += shift*frame.projection[k];
+    render(eye, &mono[e]);
+  }
+  CHECK(mono[0].count == 2 && mono[1].count == 2);
+
+  MSVController::setStereo(true, IPD);
+  DrawRecorder stereo;
+  render(frame, &stereo);
+  MSVController::setStereo(false, 0);
+
+  CHECK(stereo.count == mono[0].count + mono[1].count);
+  CHECK(stereo.binds == mono[0].binds);
+  int next[2] = {0, 0};
+  for (int i = 0; i < stereo.count; ++i) {
+    const Draw *d = &stereo.draws[i];
+    int e = d->scissor[0] >= WIDTH/2 ? 1 : 0;
+    CHECK(d->scissor[0] == e*WIDTH/2 && d->scissor[1] == 0 &&
+          d->scissor[2] == WIDTH/2 && d->scissor[3] == HEIGHT);
+    if (next[e] >= mono[e].count) {
+      CHECK(!"more draws than in the reference");
+      continue;
+    }
+    const Draw *ref = &mono[e].draws[next[e]++];
+    // The center window of the reference, moved into the eye half
+    int dx = e*WIDTH/2 - WIDTH/4;
+    CHECK(d->viewport[0] == ref->viewport[0] + dx &&
+          d->viewport[1] == ref->viewport[1] &&
+          d->viewport[2] == ref->viewport[2] &&
+          d->viewport[3] == ref->viewport[3]);
+    CHECK(sameMatrix(d->mvp, ref->mvp));
+  }
+  CHECK(next[0] == mono[0].count && next[1] == mono[1].count);
+
+  MSVController::stopTracking();
+  MSVController::deInit();
+  return TEST_RESULT();
+}
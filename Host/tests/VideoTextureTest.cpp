@@ -0,0 +1,143 @@
+/* Playback of a Y4M clip through MSVVideoSource and MSVVideoTexture.
+ *
+ * Each frame of the clip has a uniform luma equal to a multiple of its
+ * index, so that the uploads seen by the GL stubs tell which frame is
+ * displayed. A consumer polling faster than the frame rate must display
+ * every frame in presentation order; a slowed one must still display them
+ * in order, but drop frames and display them late.
+ */
+#include "GLObserver.h"
+#include "MSVTest.h"
+#include "MSVVideoSource.h"
+#include "MSVVideoTexture.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define FRAMES 30
+#define FPS    50
+#define WIDTH  16
+#define HEIGHT 12
+#define LUMA_STEP 8
+
+/** Records the frames uploaded to the luma textures */
+class UploadObserver : public GLObserver {
+  public:
+    int frames[FRAMES];
+    int count;
+    bool ordered;
+
+    UploadObserver() : count(0), ordered(true) {}
+
+    void texImage(GLenum, GLsizei width, GLsizei height,
+                  GLenum format, const GLvoid *pixels) {
+      if (format != GL_LUMINANCE || width != WIDTH || height != HEIGHT) return;
+      int frame = ((const unsigned char *)pixels)[0] / LUMA_STEP;
+      if (count > 0 && frame <= frames[count - 1]) ordered = false;
+      if (count < FRAMES) frames[count++] = frame;
+    }
+};
+
+static bool
+writeClip(const char *path)
+{
+  FILE *f = fopen(path, "wb");
+  if (!f) return false;
+  fprintf(f, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", WIDTH, HEIGHT, FPS);
+  int chroma = 2*((WIDTH + 1)/2)*((HEIGHT + 1)/2);
+  unsigned char plane[WIDTH*HEIGHT];
+  for (int i = 0; i < FRAMES; ++i) {
+    fprintf(f, "FRAME\n");
+    memset(plane, i*LUMA_STEP, sizeof(plane));
+    fwrite(plane, 1, WIDTH*HEIGHT, f);
+    memset(plane, 128, chroma);
+    fwrite(plane, 1, chroma, f);
+  }
+  fclose(f);
+  return true;
+}
+
+static void
+checkSource(const char *path)
+{
+  MSVVideoSource *source = MSVVideoSource::open(path);
+  CHECK(source != NULL);
+  if (!source) return;
+  CHECK(source->getWidth() == WIDTH && source->getHeight() == HEIGHT);
+  CHECK(source->getFrameDuration() == 1.0/FPS);
+  CHECK(source->isI420());
+  unsigned char *planes = (unsigned char *)malloc(WIDTH*HEIGHT*4);
+  double pts;
+  int frames = 0;
+  while (source->readI420(planes, &pts)) {
+    CHECK(pts == frames/(double)FPS);
+    CHECK(planes[0] == frames*LUMA_STEP);
+    frames++;
+  }
+  CHECK(frames == FRAMES);
+  free(planes);
+  delete source;
+}
+
+static double
+now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/** Plays the whole clip, rendering a frame every `interval` seconds */
+static void
+play(const char *path, double interval, UploadObserver *uploads,
+     MSVVideoTexture::Stats *stats)
+{
+  GLObserver::set(uploads);
+  MSVVideoTexture *video = new MSVVideoTexture(MSVVideoSource::open(path), false);
+  double deadline = now() + 10;
+  float mtx[16];
+  do {
+    video->getTexture(mtx);
+    usleep((useconds_t)(interval*1e6));
+    video->getStats(stats);
+  } while (stats->presented + stats->dropped < FRAMES && now() < deadline);
+  delete video;
+  GLObserver::set(NULL);
+}
+
+int
+main()
+{
+  char path[] = "/tmp/msvvideoXXXXXX";
+  int fd = mkstemp(path);
+  if (fd >= 0) close(fd);
+  CHECK(fd >= 0 && writeClip(path));
+  checkSource(path);
+
+  UploadObserver fast;
+  MSVVideoTexture::Stats fastStats;
+  play(path, 0.002, &fast, &fastStats);
+  CHECK(fastStats.decoded == FRAMES);
+  CHECK(fastStats.presented + fastStats.dropped == FRAMES);
+  CHECK(fast.count == (int)fastStats.presented);
+  CHECK(fast.ordered);
+  CHECK(fast.count > 0 && fast.frames[0] == 0);
+
+  // Several frames are due at each render: the older ones are dropped, and
+  // the ones decoded while the ring was full are shown late
+  UploadObserver slow;
+  MSVVideoTexture::Stats slowStats;
+  play(path, 0.1, &slow, &slowStats);
+  CHECK(slowStats.decoded == FRAMES);
+  CHECK(slowStats.presented + slowStats.dropped == FRAMES);
+  CHECK(slow.count == (int)slowStats.presented);
+  CHECK(slow.ordered);
+  CHECK(slowStats.dropped > fastStats.dropped);
+  CHECK(slowStats.late > fastStats.late);
+  CHECK(slowStats.presented < fastStats.presented);
+
+  unlink(path);
+  return TEST_RESULT();
+}
@@ -50,6 +50,15 @@
  */
 - (void)orientationWillChange:(UIInterfaceOrientation)orientation;
 
+/**
+ * Sets how long a lost target stays ready to resume. During this window,
+ * scanning resumes, but if the target comes back into view it is tracked
+ * again instantly, with the same model, without a new recognition.
+ * Disabled by default.
+ * @param seconds the duration of the window, 0 to disable it.
+ */
+- (void)setLinger:(NSTimeInterval)seconds;
+
 /** 
  * Starts the session.
  * @param orientation the current UI orientation
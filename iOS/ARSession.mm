@@ -60,6 +60,10 @@
     _builtModel = nil;
 }
 
+- (void)setLinger:(NSTimeInterval)seconds {
+    [_vuforia setLingerTime:seconds];
+}
+
 - (void)startWithUIOrientation:(UIInterfaceOrientation)orientation error:(NSError *__autoreleasing *)error {
     [self orientationWillChange:orientation];
     [_vuforia start:error];
@@ -83,7 +87,7 @@
 - (void)onStatusUpdate {
     if (_paused) return;
     if ([_vuforia isTracking]) {
-        if ([_vuforia isNewTarget]) {
+        if ([_vuforia isNewTarget] && ![_vuforia isModelRestored]) {
             [self performSelectorInBackground:@selector(buildModel) withObject:nil];
         }
         else if (_builtModel) {
@@ -94,7 +98,7 @@
             _lastFound = [[NSDate date] timeIntervalSince1970];
         }
         else if ([[NSDate date] timeIntervalSince1970] - _lastFound > UNTRACK_DELAY){
-            [_vuforia stopTracking];
+            [_vuforia suspendTracking];
         }
         [_vuforia requireUpdate];
     }
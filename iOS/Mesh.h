@@ -1,6 +1,22 @@
 #import <Foundation/Foundation.h>
 
-/** Scaffold for 3D mesh class */
+/** 
+ * Class representing a 3D model, loaded natively from a Wavefront OBJ or
+ * binary glTF 2.0 (.glb) file.
+ */
 @interface Mesh : NSObject
-    // TODO
+
+/** The path of the model file */
+@property (nonatomic, copy) NSString *path;
+
+/** 
+ * Initializes a new Mesh from a model file. The file is parsed natively
+ * when the model is displayed, and a plane is displayed instead if it
+ * cannot be loaded.
+ * @param path the path of the .obj or .glb file. The textures it refers
+ * to are not loaded: use a Texture in the StaticModel.
+ * @return the Mesh object.
+ */
+- (id)initWithPath:(NSString *)path;
+
 @end
@@ -1,5 +1,13 @@
 #import "Mesh.h"
 
 @implementation Mesh
-    // TODO
+
+- (id)initWithPath:(NSString *)path {
+    self = [super init];
+    if (self) {
+        _path = [path copy];
+    }
+    return self;
+}
+
 @end
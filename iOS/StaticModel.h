@@ -13,6 +13,15 @@
 /** The 3D `Mesh` object */
 @property (nonatomic) Mesh *mesh;
 
+/** The meshes of the extra parts, `NSNull` standing for a plane */
+@property (nonatomic, readonly) NSArray *partMeshes;
+
+/** The textures of the extra parts */
+@property (nonatomic, readonly) NSArray *partTextures;
+
+/** The transforms of the extra parts, as 16 floats per part */
+@property (nonatomic, readonly) NSData *partTransforms;
+
 /**
  * Initializes a new Model with a `Mesh`.
  * **Should not be used until `Mesh` is implemented**
@@ -34,4 +43,14 @@
  */
 - (id)initWithTexture:(Texture *)tex scale:(const float[3])scale;
 
+/**
+ * Adds a part to the model, displayed along with its main mesh. Parts
+ * sharing a texture are merged natively, so that they are drawn at once.
+ * @param mesh the `Mesh` of the part, or nil for a 2x2 plane.
+ * @param tex the `Texture` of the part.
+ * @param transform the transform of the part relative to the model, as a
+ * 4x4 column-major matrix, or NULL for the identity.
+ */
+- (void)addPartWithMesh:(Mesh *)mesh texture:(Texture *)tex transform:(const float[16])transform;
+
 @end
@@ -8,6 +8,9 @@
     if (self) {
         _texture = tex;
         _mesh = mesh;
+        _partMeshes = [[NSMutableArray alloc] init];
+        _partTextures = [[NSMutableArray alloc] init];
+        _partTransforms = [[NSMutableData alloc] init];
         float *tmp = new float[3];
         memcpy(tmp, scale, 3*sizeof(float));
         [super setScale:tmp];
@@ -19,4 +22,15 @@
     return [self initWithTexture:tex mesh:nil scale:scale];
 }
 
+- (void)addPartWithMesh:(Mesh *)mesh texture:(Texture *)tex transform:(const float[16])transform {
+    static const float identity[16] = {1, 0, 0, 0,
+                                       0, 1, 0, 0,
+                                       0, 0, 1, 0,
+                                       0, 0, 0, 1};
+    [(NSMutableArray *)_partMeshes addObject:(mesh ? (id)mesh : [NSNull null])];
+    [(NSMutableArray *)_partTextures addObject:(tex ? (id)tex : [NSNull null])];
+    [(NSMutableData *)_partTransforms appendBytes:(transform ? transform : identity)
+                                           length:16*sizeof(float)];
+}
+
 @end
@@ -15,6 +15,8 @@
  * only RGBA is supported, so this value is set to `4`.
  */
 @property unsigned int channelCount;
+/** The path of the image file, if the Texture was initialized from one */
+@property (nonatomic, copy) NSString *path;
 
 /** 
  * Initializes a new Texture from a `CGImageRef` object.
@@ -31,4 +33,13 @@
  */
 - (id)initWithUIImage:(UIImage *)img;
 
+/** 
+ * Initializes a new Texture from a PNG or JPEG file. The file is decoded
+ * natively when the model is displayed, without going through a `UIImage`:
+ * large JPEG images are downscaled while decoding.
+ * @param path the path of the image file.
+ * @return the Texture object.
+ */
+- (id)initWithPath:(NSString *)path;
+
 @end
\ No newline at end of file
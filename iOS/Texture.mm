@@ -25,6 +25,14 @@
     return self;
 }
 
+- (id)initWithPath:(NSString *)path {
+    self = [super init];
+    if (self) {
+        [self setPath:path];
+    }
+    return self;
+}
+
 - (void)dealloc {
     if (_pixels) delete _pixels;
 }
@@ -3,6 +3,7 @@
 #import "AbstractModel.h"
 
 @protocol VuforiaControllerDelegate;
+@protocol VuforiaCaptureDelegate;
 
 /**
  * Class wrapping the Vuforia SDK.
@@ -56,6 +57,16 @@
 /** Stops the Vuforia SDK, camera preview and callbacks. */
 - (void)stop;
 
+/**
+ * Enable or disable the benchmark of the camera video modes. By default,
+ * the smallest video mode fitting the Moodstocks SDK requirements is used.
+ * When enabled, the first start of the camera on this device model measures
+ * the frame rate actually delivered by the candidate modes, which may block
+ * `start:` for a few seconds, and the choice is cached for the next starts.
+ * @param enabled `YES` to enable the benchmark.
+ */
+- (void)setCameraBenchmark:(BOOL)enabled;
+
 /**
  * Starts tracking a target.
  * Should be called only when not already tracking a target. Otherwise it will
@@ -69,6 +80,22 @@
 /** Stops tracking the current target, if any. */
 - (void)stopTracking;
 
+/**
+ * Stops tracking a lost target, but keeps it ready to resume during the
+ * linger window set with `setLingerTime:`. Meanwhile, `isTracking` returns
+ * `NO` so that scanning can resume. If the target is found again in the
+ * camera frames, or passed again to `startTrackingTarget:inDataset:`,
+ * tracking resumes instantly with the same model, and `isNewTarget` stays
+ * `NO`.
+ */
+- (void)suspendTracking;
+
+/**
+ * Sets the duration of the linger window used by `suspendTracking`.
+ * @param seconds the duration, 0 (default) to stop tracking right away.
+ */
+- (void)setLingerTime:(NSTimeInterval)seconds;
+
 /**
  * @return YES if the Vuforia SDK is currently tracking a target, NO otherwise.
  */
@@ -117,6 +144,149 @@
  */
 - (BOOL)isTargetLost;
 
+/**
+ * @return `YES` if the model of the target being tracked has been restored
+ * from the model cache, in which case it does not need to be built again.
+ */
+- (BOOL)isModelRestored;
+
+/**
+ * Sets the byte budget of the model cache, which keeps the static models of
+ * the targets once they are no longer tracked, so that they are restored
+ * immediately when tracked again.
+ * @param bytes the budget, 0 to disable the cache.
+ */
+- (void)setModelCacheBudget:(NSUInteger)bytes;
+
+/**
+ * @return the model cache statistics, with the `hits`, `misses`,
+ * `evictions`, `models` and `bytes` keys.
+ */
+- (NSDictionary *)modelCacheStats;
+
+/**
+ * @return the renderer culling statistics since startup, with the `drawn`
+ * and `culled` mesh counts, and the `modelsCulled` count of frames whose
+ * model was entirely out of the view.
+ */
+- (NSDictionary *)renderStats;
+
+/**
+ * Start capturing the rendered frames, video background and models
+ * included. Frames are read back asynchronously and reach the delegate a
+ * couple of frames after being rendered, without slowing rendering down.
+ * @param delegate the `VuforiaCaptureDelegate` receiving the frames, on a
+ * dedicated capture thread. It is retained until the capture is over.
+ * @param scale the size of the frames relative to the view, in (0, 1].
+ * @param frames the number of frames to capture, 0 to capture until
+ * `stopCapture` is called.
+ * @return `NO` if a capture is already in progress.
+ */
+- (BOOL)startCaptureWithDelegate:(id<VuforiaCaptureDelegate>)delegate
+                           scale:(float)scale
+                          frames:(NSUInteger)frames;
+
+/**
+ * Stop capturing the rendered frames.
+ */
+- (void)stopCapture;
+
+/**
+ * @return the frame capture statistics since startup, with the `captured`
+ * and `dropped` frame counts.
+ */
+- (NSDictionary *)captureStats;
+
+/**
+ * Finds the face of the tracked model displayed under a point of the view,
+ * for example to react to taps on a part of a 3D model. Fast enough to be
+ * called on every touch move.
+ * @param x the horizontal coordinate of the point, in pixels (not points)
+ * from the left of the GL view.
+ * @param y the vertical coordinate of the point, in pixels from the top of
+ * the GL view.
+ * @return `nil` if the model is not under the point. Otherwise the `part`
+ * index (0 for the main mesh, then 1 for the first part added with
+ * `addPartWithMesh:texture:transform:`, and so on), the `face` index in the
+ * mesh of that part, and the `barycentric`, `texCoords` and model space
+ * `position` coordinates of the point, as arrays.
+ */
+- (NSDictionary *)hitTestAtX:(float)x y:(float)y;
+
+/**
+ * Set the resolution at which the model is rendered, relative to the view.
+ * Below 1, the model is rendered offscreen at this scale, then upscaled over
+ * the camera image, which saves fill rate on Retina screens at the cost of
+ * sharpness. The adaptive quality governor may lower it further.
+ * @param scale the scale, between 0.25 and 1. 1 by default.
+ */
+- (void)setOverlayScale:(float)scale;
+
+/**
+ * @return the resolution at which the model is rendered, relative to the
+ * view.
+ */
+- (float)overlayScale;
+
+/**
+ * Enable or disable side-by-side stereo rendering, for headset viewers.
+ * Each half of the view then shows the camera image and the model as seen
+ * from one eye. Both eyes are drawn in a single pass. In stereo, the model
+ * is always rendered at full resolution, and `hitTestAtX:y:` applies to
+ * the left eye.
+ * @param enabled YES to render in stereo. NO by default.
+ * @param ipd the distance between the eyes, in the units of the target size.
+ */
+- (void)setStereo:(BOOL)enabled ipd:(float)ipd;
+
+/**
+ * @return YES if the view is rendered in stereo.
+ */
+- (BOOL)isStereo;
+
+/**
+ * Write the per-frame trace zones recorded by the native code, in the
+ * Chrome trace event JSON format.
+ * Only available if the wrapper has been built with `MSV_TRACE` defined.
+ * @param path the path of the file to write.
+ * @return `YES` if the trace has been written, `NO` otherwise.
+ */
+- (BOOL)dumpTrace:(NSString *)path;
+
+/**
+ * Start recording the camera frames, tracking results and projection
+ * matrices, so that the session can be replayed on a host for benchmarking.
+ * @param path the path of the file to write.
+ * @param compress `YES` to compress the camera frames.
+ * @return `YES` if the recording started, `NO` otherwise.
+ */
+- (BOOL)startRecording:(NSString *)path compress:(BOOL)compress;
+
+/** Stop the current recording, if any. */
+- (void)stopRecording;
+
+/**
+ * Enable or disable the adaptive quality governor, which lowers the model
+ * level of detail, texture and rendering resolutions and scan frequency
+ * when frames take longer than the budget, and restores them once there is
+ * headroom again.
+ * @param enabled `YES` to enable the governor, `NO` to disable it and go
+ * back to the full quality.
+ * @param budgetMs the target frame time, in milliseconds.
+ */
+- (void)setAdaptiveQuality:(BOOL)enabled budget:(float)budgetMs;
+
+/**
+ * @return the current quality level, 0 being the full quality.
+ */
+- (int)qualityLevel;
+
+/**
+ * @return descriptions of the latest quality level changes, with their
+ * reasons, oldest first.
+ */
+- (NSArray *)qualityChanges;
+
 @end
 
 /** 
@@ -128,4 +298,28 @@
 /** Called shortly after each call to `requireUpdate`. */
 - (void)onStatusUpdate;
 
-@end
\ No newline at end of file
+@end
+/**
+ * Protocol implemented to receive the frames captured by the
+ * VuforiaController.
+ */
+@protocol VuforiaCaptureDelegate <NSObject>
+
+/**
+ * Called on the capture thread for each captured frame.
+ * @param pixels the RGBA pixels, rows bottom-up. Only valid during the
+ * call: copy them to keep them.
+ * @param width the frame width.
+ * @param height the frame height.
+ * @param timestamp the timestamp of the camera frame, in seconds.
+ */
+- (void)onFrameCaptured:(NSData *)pixels
+                  width:(int)width
+                 height:(int)height
+              timestamp:(double)timestamp;
+
+@optional
+/** Called on the capture thread once the capture is over. */
+- (void)onCaptureFinished;
+
+@end
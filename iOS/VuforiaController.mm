@@ -10,6 +10,9 @@
 #include "MSVTargetInfo.h"
 #include "MSVTexture.h"
 #include "MSVMesh.h"
+#include "MSVModelLoader.h"
+#include "MSVPendingModel.h"
+#include <sys/utsname.h>
 
 #pragma mark - C++ `MSVCallback` subclass declaration
 
@@ -44,6 +47,18 @@ public:
     MSVMeshImpl(Mesh *m);
 };
 
+#pragma mark - C++ `MSVFrameCapture::Consumer` subclass declaration
+
+class MSVCaptureImpl : public MSVFrameCapture::Consumer {
+public:
+    MSVCaptureImpl(id<VuforiaCaptureDelegate> d);
+    void frameCaptured(const unsigned char *pixels, int width, int height,
+                       double timestamp);
+    void captureFinished();
+private:
+    id<VuforiaCaptureDelegate> delegate;
+};
+
 #pragma mark - C++ `MSVTextureCallback` subclass declaration
 
 /* 
@@ -79,6 +94,35 @@ private:
 
 @end
 
+#pragma mark - Model conversion
+
+static MSVMesh *
+newMesh(Mesh *m)
+{
+    MSVMesh *mesh = NULL;
+    if (m) mesh = new MSVMeshImpl(m);
+    if (mesh && !mesh->getVerticesCount()) {
+        // The model file could not be loaded: fall back to the plane
+        mesh->release();
+        mesh = NULL;
+    }
+    return mesh;
+}
+
+/* Adds a part to `model`, whose texture image file, if any, is decoded on
+ * the MSVImageDecoder worker thread rather than on the calling one.
+ */
+static void
+addPart(MSVPendingModel *model, Mesh *m, Texture *t, const float *transform = NULL)
+{
+    if ([t path]) {
+        model->addPart(newMesh(m), NULL, [[t path] fileSystemRepresentation],
+                       TEXTURE_MAX_SIZE, transform);
+        return;
+    }
+    model->addPart(newMesh(m), t ? new MSVTextureImpl(t) : NULL, NULL, 0, transform);
+}
+
 #pragma mark - VuforiaController implementation
 
 @implementation VuforiaController
@@ -180,6 +224,16 @@ static NSMutableArray *_datasets = [NSMutableArray arrayWithCapacity:15];
     MSVController::stopTracking();
 }
 
+- (void)suspendTracking {
+    if (_initFailed) return;
+    MSVController::suspendTracking();
+}
+
+- (void)setLingerTime:(NSTimeInterval)seconds {
+    if (_initFailed) return;
+    MSVController::setLingerTime(seconds);
+}
+
 - (BOOL)isTracking {
     if (_initFailed) return NO;
     return MSVController::isTracking();
@@ -187,18 +241,19 @@ static NSMutableArray *_datasets = [NSMutableArray arrayWithCapacity:15];
 
 - (Target *)getCurrentTarget {
     if (_initFailed) return nil;
-    const MSVTargetInfo *i = MSVController::getCurrentTarget();
-    if (!i) return nil;
+    char *name = NULL;
+    int dims[2];
+    if (!MSVController::copyCurrentTarget(&name, dims)) return nil;
     Target *t = [[Target alloc] init];
-    [t setName:[NSString stringWithCString:i->getName() encoding:NSUTF8StringEncoding]];
-    CGSize s = CGSizeMake(i->getWidth(), i->getHeight());
+    [t setName:[NSString stringWithCString:name encoding:NSUTF8StringEncoding]];
+    free(name);
+    CGSize s = CGSizeMake(dims[0], dims[1]);
     [t setDimensions:s];
     return t;
 }
 
 - (void)changeCurrentModel:(AbstractModel *)model {
     if (_initFailed) return;
-    MSVMesh *mesh = NULL;
     if ([model isDynamic]) {
         DynamicModel *mod = (DynamicModel *)model;
         MSVTextureCallback *cb = NULL;
@@ -208,12 +263,19 @@ static NSMutableArray *_datasets = [NSMutableArray arrayWithCapacity:15];
     }
     else {
         StaticModel *mod = (StaticModel *)model;
-        Mesh *m = [mod mesh];
-        if (m) mesh = new MSVMeshImpl(m);
-        MSVTexture *tex = NULL;
-        Texture *t = [mod texture];
-        if (t) tex = new MSVTextureImpl(t);
-        MSVController::setStaticModel(mesh, tex, [mod scale]);
+        // Set once its textures are decoded
+        MSVPendingModel *m = new MSVPendingModel();
+        addPart(m, [mod mesh], [mod texture]);
+        const float *transforms = (const float *)[[mod partTransforms] bytes];
+        NSArray *meshes = [mod partMeshes];
+        NSArray *textures = [mod partTextures];
+        for (NSUInteger i = 0; i < [meshes count]; ++i) {
+            id pm = [meshes objectAtIndex:i];
+            id pt = [textures objectAtIndex:i];
+            addPart(m, pm == [NSNull null] ? nil : pm, pt == [NSNull null] ? nil : pt,
+                    transforms + 16*i);
+        }
+        m->commit([mod scale]);
     }
 }
 
@@ -225,6 +287,18 @@ static NSMutableArray *_datasets = [NSMutableArray arrayWithCapacity:15];
     MSVCamera::stop();
 }
 
+- (void)setCameraBenchmark:(BOOL)enabled {
+    if (!enabled) {
+        MSVCamera::setProfileCache(NULL, NULL);
+        return;
+    }
+    NSString *dir = [NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES) objectAtIndex:0];
+    NSString *path = [dir stringByAppendingPathComponent:@"camera_profile"];
+    struct utsname info;
+    uname(&info);
+    MSVCamera::setProfileCache([path fileSystemRepresentation], info.machine);
+}
+
 - (void)requireUpdate {
     if (_initFailed) return;
     _cb->MSVCallback::requireUpdate();
@@ -245,6 +319,110 @@ static NSMutableArray *_datasets = [NSMutableArray arrayWithCapacity:15];
     return _cb->MSVCallback::isTargetLost();
 }
 
+- (BOOL)isModelRestored {
+    if (_initFailed) return NO;
+    return MSVController::isModelRestored();
+}
+
+- (void)setModelCacheBudget:(NSUInteger)bytes {
+    MSVController::setModelCacheBudget(bytes);
+}
+
+- (NSDictionary *)modelCacheStats {
+    MSVModelCache::Stats stats;
+    MSVController::getModelCacheStats(&stats);
+    return @{@"hits": @(stats.hits),
+             @"misses": @(stats.misses),
+             @"evictions": @(stats.evictions),
+             @"models": @(stats.models),
+             @"bytes": @(stats.bytes)};
+}
+
+- (NSDictionary *)renderStats {
+    MSVRenderer::Stats stats;
+    MSVController::getRenderStats(&stats);
+    return @{@"drawn": @(stats.drawn),
+             @"culled": @(stats.culled),
+             @"modelsCulled": @(stats.modelsCulled)};
+}
+
+- (BOOL)startCaptureWithDelegate:(id<VuforiaCaptureDelegate>)delegate
+                           scale:(float)scale
+                          frames:(NSUInteger)frames {
+    if (!delegate) return NO;
+    return MSVController::startCapture(new MSVCaptureImpl(delegate), scale, (unsigned int)frames) ? YES : NO;
+}
+
+- (void)stopCapture {
+    MSVController::stopCapture();
+}
+
+- (NSDictionary *)captureStats {
+    MSVFrameCapture::Stats stats;
+    MSVController::getCaptureStats(&stats);
+    return @{@"captured": @(stats.captured),
+             @"dropped": @(stats.dropped)};
+}
+
+- (NSDictionary *)hitTestAtX:(float)x y:(float)y {
+    MSVRenderer::Hit hit;
+    if (!MSVController::hitTest(x, y, &hit)) return nil;
+    return @{@"part": @(hit.part),
+             @"face": @(hit.face),
+             @"barycentric": @[@(hit.barycentric[0]), @(hit.barycentric[1]), @(hit.barycentric[2])],
+             @"texCoords": @[@(hit.texCoords[0]), @(hit.texCoords[1])],
+             @"position": @[@(hit.position[0]), @(hit.position[1]), @(hit.position[2])]};
+}
+
+- (void)setOverlayScale:(float)scale {
+    MSVController::setOverlayScale(scale);
+}
+
+- (float)overlayScale {
+    return MSVController::getOverlayScale();
+}
+
+- (void)setStereo:(BOOL)enabled ipd:(float)ipd {
+    MSVController::setStereo(enabled ? true : false, ipd);
+}
+
+- (BOOL)isStereo {
+    return MSVController::isStereo() ? YES : NO;
+}
+
+- (BOOL)dumpTrace:(NSString *)path {
+    return MSVController::dumpTrace([path fileSystemRepresentation]) ? YES : NO;
+}
+
+- (BOOL)startRecording:(NSString *)path compress:(BOOL)compress {
+    return MSVController::startRecording([path fileSystemRepresentation], compress) ? YES : NO;
+}
+
+- (void)stopRecording {
+    MSVController::stopRecording();
+}
+
+- (void)setAdaptiveQuality:(BOOL)enabled budget:(float)budgetMs {
+    MSVController::setAdaptiveQuality(enabled, budgetMs/1000);
+}
+
+- (int)qualityLevel {
+    return MSVController::getQualityLevel();
+}
+
+- (NSArray *)qualityChanges {
+    MSVGovernor::Change changes[QUALITY_HISTORY];
+    unsigned int n = MSVController::getQualityChanges(changes, QUALITY_HISTORY);
+    NSMutableArray *array = [NSMutableArray arrayWithCapacity:n];
+    for (unsigned int i = 0; i < n; ++i) {
+        [array addObject:[NSString stringWithFormat:@"frame %u: %d -> %d (%s, %.1f ms)",
+                          changes[i].frame, changes[i].from, changes[i].to,
+                          MSVGovernor::reasonName(changes[i].reason),
+                          1000*changes[i].frameTime]];
+    }
+    return array;
+}
+
 - (void)onStatusUpdate {
     if (_initFailed) return;
     [_delegate onStatusUpdate];
@@ -299,7 +477,41 @@ MSVTexture()
 MSVMeshImpl::MSVMeshImpl(Mesh *m) :
 MSVMesh()
 {
-    // TODO
+    MSVModelLoader::Model model;
+    if ([m path] && MSVModelLoader::load([[m path] fileSystemRepresentation], &model)) {
+        set(model.nVertices, model.vertices, model.normals, model.texCoords,
+            model.nFaces, model.faces);
+        MSVModelLoader::freeModel(&model);
+    }
+}
+
+#pragma mark - C++ `MSVFrameCapture::Consumer` subclass implementation
+
+MSVCaptureImpl::MSVCaptureImpl(id<VuforiaCaptureDelegate> d)
+{
+    delegate = d;
+}
+
+void
+MSVCaptureImpl::frameCaptured(const unsigned char *pixels, int width, int height,
+                              double timestamp)
+{
+    // The capture thread is a plain pthread, without autorelease pool
+    @autoreleasepool {
+        NSData *data = [NSData dataWithBytesNoCopy:(void *)pixels
+                                            length:4*(NSUInteger)width*height
+                                      freeWhenDone:NO];
+        [delegate onFrameCaptured:data width:width height:height timestamp:timestamp];
+    }
+}
+
+void
+MSVCaptureImpl::captureFinished()
+{
+    @autoreleasepool {
+        if ([delegate respondsToSelector:@selector(onCaptureFinished)])
+            [delegate onCaptureFinished];
+    }
 }
 
 #pragma mark - C++ `MSVTextureCallback` subclass implementation